@@ -986,6 +986,63 @@ end
         self.write_spec("output_capture", spec)
         self.run_spec("output_capture", "local.build_output_capture@v1")
 
+    @unittest.skipUnless(os.name != "nt", "requires POSIX shells")
+    def test_build_output_capture_spills_large_output(self):
+        """Captures past the in-memory limit come back as a readable file handle."""
+        spec = """IDENTITY = "local.build_output_capture_spill@v1"
+
+FETCH = {{
+  source = "{ARCHIVE_PATH}",
+  sha256 = "{ARCHIVE_HASH}"
+}}
+
+STAGE = {{strip = 1}}
+
+BUILD = function(install_dir, stage_dir, fetch_dir, tmp_dir, options)
+  local small = envy.run("echo small", {{ capture = true }})
+  if type(small.stdout) ~= "string" then error("small capture should be a string") end
+
+  -- 24 MiB of 64-byte lines, past the 16 MiB in-memory limit.
+  local big = envy.run([[yes "$(printf '%063d' 7)" | head -n 393216]], {{ capture = true }})
+  if type(big.stdout) == "string" then error("large capture should spill to a file") end
+
+  local count = 0
+  for line in big.stdout:lines() do
+    if #line ~= 63 then error("bad line length " .. #line) end
+    count = count + 1
+  end
+  big.stdout:close()
+  if count ~= 393216 then error("expected 393216 lines, got " .. count) end
+  if big.stderr ~= "" then error("stderr should be empty") end
+end
+"""
+        self.write_spec("output_capture_spill", spec)
+        self.run_spec("output_capture_spill", "local.build_output_capture_spill@v1")
+
+    @unittest.skipUnless(os.name != "nt", "requires POSIX shells")
+    def test_build_output_capture_keeps_long_lines(self):
+        """A captured line longer than 1 MiB comes back without inserted newlines."""
+        spec = """IDENTITY = "local.build_output_capture_long_line@v1"
+
+FETCH = {{
+  source = "{ARCHIVE_PATH}",
+  sha256 = "{ARCHIVE_HASH}"
+}}
+
+STAGE = {{strip = 1}}
+
+BUILD = function(install_dir, stage_dir, fetch_dir, tmp_dir, options)
+  -- 3 MiB + 5 bytes with no newline, then a short line.
+  local result = envy.run([[head -c 3145733 /dev/zero | tr '\\0' x; printf '\\nend\\n']],
+                          {{ capture = true }})
+  if result.stdout ~= string.rep("x", 3145733) .. "\\nend\\n" then
+    error("long line was altered in capture (" .. #result.stdout .. " bytes)")
+  end
+end
+"""
+        self.write_spec("output_capture_long_line", spec)
+        self.run_spec("output_capture_long_line", "local.build_output_capture_long_line@v1")
+
     # =========================================================================
     # Function return string tests
     # =========================================================================
@@ -342,6 +342,41 @@ end
             should_fail=True,
         )
 
+    @unittest.skipUnless(os.name != "nt", "requires POSIX shells")
+    def test_persistent_session(self):
+        """envy.run() with persistent=true reuses one shell but isolates scripts."""
+        spec = """-- Verify envy.run() persistent coprocess mode
+IDENTITY = "local.ctx_run_persistent@v1"
+
+FETCH = {{
+  source = "{ARCHIVE_PATH}",
+  sha256 = "{ARCHIVE_HASH}"
+}}
+
+STAGE = function(fetch_dir, stage_dir, tmp_dir, options)
+  envy.extract_all(fetch_dir, stage_dir, {{strip = 1}})
+
+  local first = envy.run("echo $$; export LEAK=1; cd /", {{ persistent = true, capture = true }})
+  local second = envy.run([[echo $$; echo "${{LEAK:-unset}}"; pwd]],
+                          {{ persistent = true, capture = true, env = {{ EXTRA = "x" }} }})
+  local pid1 = first.stdout:match("^(%d+)")
+  local pid2, leak = second.stdout:match("^(%d+)\\n(%S+)\\n")
+  if pid1 ~= pid2 then error("expected one coprocess, got " .. pid1 .. " and " .. pid2) end
+  if leak ~= "unset" then error("environment leaked between scripts") end
+
+  local failed = envy.run("echo oops >&2; exit 4", {{ persistent = true, check = false, capture = true }})
+  if failed.exit_code ~= 4 then error("expected exit code 4, got " .. failed.exit_code) end
+  if failed.stderr ~= "oops\\n" then error("unexpected stderr: " .. failed.stderr) end
+
+  envy.run("printf persistent > persistent_marker.txt", {{ persistent = true }})
+end
+"""
+        self.write_spec("ctx_run_persistent.lua", spec)
+        self.run_spec("local.ctx_run_persistent@v1", "ctx_run_persistent.lua")
+        pkg_path = self.get_pkg_path("local.ctx_run_persistent@v1")
+        assert pkg_path
+        self.assertEqual((pkg_path / "persistent_marker.txt").read_text(), "persistent")
+
     @unittest.skipUnless(os.name != "nt", "requires POSIX shells")
     def test_shell_sh(self):
         """envy.run() executes explicitly via /bin/sh."""
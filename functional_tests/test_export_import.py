@@ -375,6 +375,77 @@ PACKAGES = {{
         finally:
             shutil.rmtree(import_cache, ignore_errors=True)
 
+    def test_export_dedupe_content_roundtrip(self):
+        """--dedupe-content stores duplicates as hardlinks; import restores every copy."""
+        archive_lua_path = self.archive_path.as_posix()
+        (self.test_dir / "dup_pkg.lua").write_text(
+            f'''IDENTITY = "local.dup_pkg@v1"
+EXPORTABLE = true
+
+FETCH = {{
+  source = "{archive_lua_path}",
+  sha256 = "{self.archive_hash}"
+}}
+
+STAGE = {{strip = 1}}
+
+BUILD = function(install_dir, stage_dir, fetch_dir, tmp_dir, options)
+  for _, name in ipairs({{ "a.h", "b.h", "c.h" }}) do
+    local f = io.open(stage_dir .. name, "w")
+    f:write(string.rep("duplicated header\\n", 4096))
+    f:close()
+  end
+end
+''',
+            encoding="utf-8",
+        )
+        manifest = self.create_manifest(
+            f'''
+PACKAGES = {{
+    {{ spec = "local.dup_pkg@v1", source = "{self.lua_path(self.test_dir)}/dup_pkg.lua" }}
+}}
+'''
+        )
+
+        install = self.run_envy("install", "--manifest", str(manifest))
+        self.assertEqual(install.returncode, 0, f"install failed: {install.stderr}")
+
+        export = self.run_envy(
+            "export",
+            "local.dup_pkg@v1",
+            "--dedupe-content",
+            "-o",
+            str(self.output_dir),
+            "--manifest",
+            str(manifest),
+        )
+        self.assertEqual(export.returncode, 0, f"export failed: {export.stderr}")
+        sha_hex, archive_path = parse_export_line(export.stdout)
+        self.assertEqual(sha_hex, hashlib.sha256(archive_path.read_bytes()).hexdigest())
+
+        import_cache = Path(tempfile.mkdtemp(prefix="envy-dedupe-test-"))
+        try:
+            result = test_config.run(
+                [
+                    str(self.envy),
+                    "--cache-root",
+                    str(import_cache),
+                    "import",
+                    str(archive_path),
+                ],
+                cwd=self.project_root,
+                capture_output=True,
+                text=True,
+            )
+            self.assertEqual(result.returncode, 0, f"import failed: {result.stderr}")
+
+            imported = Path(result.stdout.strip())
+            expected = b"duplicated header\n" * 4096
+            for name in ("a.h", "b.h", "c.h"):
+                self.assertEqual((imported / name).read_bytes(), expected, name)
+        finally:
+            shutil.rmtree(import_cache, ignore_errors=True)
+
     def test_import_roundtrip_fetch_only(self):
         """Export fetch-only package, wipe, import: fetch/ tree restored byte-identical."""
         manifest = self.create_manifest(
@@ -91,6 +91,51 @@ class TestHash(unittest.TestCase):
         self.assertEqual(len(lines), 1)
         self.assertIn("test.tar.zst", lines[0])
 
+    def test_hash_recursive_include_sorted(self):
+        """Recursive walk applies --include globs and prints sorted relative paths."""
+        root = Path(self.tmpdir)
+        for rel in ["b.tar.zst", "a/z.tar.zst", "a/y.bin", "c/d/x.tar.zst", "skip.txt"]:
+            (root / rel).parent.mkdir(parents=True, exist_ok=True)
+            (root / rel).write_bytes(rel.encode())
+
+        result = test_config.run(
+            [str(self.envy), "hash", "-r", "--include", "*.tar.zst", "--include",
+             "a/*.bin", "-j", "3", "--prefix", "https://cdn/", self.tmpdir],
+            capture_output=True,
+            text=True,
+        )
+
+        self.assertEqual(result.returncode, 0, f"Hash command failed: {result.stderr}")
+        expected = [
+            f"{hashlib.sha256(rel.encode()).hexdigest()}  https://cdn/{rel}"
+            for rel in ["a/y.bin", "a/z.tar.zst", "b.tar.zst", "c/d/x.tar.zst"]
+        ]
+        self.assertEqual(result.stdout.splitlines(), expected)
+
+    def test_hash_both_algorithms_in_manifest_format(self):
+        """--algorithm both appends BLAKE3 as a depot manifest attribute."""
+        test_file = Path(self.tmpdir) / "test.png"
+        test_file.write_bytes(base64.b64decode(TEST_PNG_BASE64))
+
+        both = test_config.run(
+            [str(self.envy), "hash", "--algorithm", "both", str(test_file)],
+            capture_output=True,
+            text=True,
+        )
+        b3 = test_config.run(
+            [str(self.envy), "hash", "--algorithm", "blake3", str(test_file)],
+            capture_output=True,
+            text=True,
+        )
+
+        self.assertEqual(both.returncode, 0, f"Hash command failed: {both.stderr}")
+        self.assertEqual(b3.returncode, 0, f"Hash command failed: {b3.stderr}")
+        b3_hex, b3_name = b3.stdout.strip().split("  ")
+        self.assertEqual(b3_name, "test.png")
+        self.assertEqual(
+            both.stdout.strip(), f"{TEST_PNG_SHA256}  test.png  blake3={b3_hex}"
+        )
+
     def test_hash_missing_argument_fails(self):
         """Hash command fails when file argument is missing."""
         result = test_config.run(
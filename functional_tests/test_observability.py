@@ -215,6 +215,63 @@ class TestObservability(unittest.TestCase):
         self.assertIn(tool[0].raw["via"], ("identity", "registry", "fallback"))
 
 
+    # --- shell command usage ------------------------------------------------
+
+    @unittest.skipIf(sys.platform == "win32", "shell BUILD uses POSIX sh loops")
+    def test_shell_usage_events_and_summary(self):
+        """Each BUILD/INSTALL command emits shell_command_usage; the engine emits
+        per-phase shell_phase_usage totals and a --verbose summary table."""
+        spec = self.test_dir / "usage.lua"
+        spec.write_text(
+            'IDENTITY = "local.usage@v1"\n'
+            f'FETCH = {{ source = "file://{lua_path(self.payload)}" }}\n'
+            'BUILD = "i=0; while [ $i -lt 20000 ]; do i=$((i + 1)); done"\n'
+            "function INSTALL(install_dir, stage_dir, fetch_dir, tmp_dir, options)\n"
+            '  envy.run("head -c 1048576 /dev/zero > blob", { quiet = true })\n'
+            '  envy.run("cat blob > /dev/null", { quiet = true })\n'
+            "end\n",
+            encoding="utf-8",
+        )
+        self.manifest = self._manifest("usage", "local.usage@v1", spec)
+
+        trace = self.cache_root / "usage.jsonl"
+        r = self._install("--verbose", trace_file=trace)
+        self.assertEqual(r.returncode, 0, r.stderr)
+
+        parser = TraceParser(trace)
+        commands = parser.filter_by_spec_and_event(
+            "local.usage@v1", "shell_command_usage"
+        )
+        by_phase = {}
+        for e in commands:
+            by_phase.setdefault(e.raw["phase"], []).append(e.raw)
+        self.assertEqual(len(by_phase.get("build", [])), 1, commands)
+        self.assertEqual(len(by_phase.get("install", [])), 2, commands)
+        for raw in by_phase["build"] + by_phase["install"]:
+            self.assertEqual(raw["exit_code"], 0)
+            self.assertGreaterEqual(raw["wall_ms"], 0)
+            self.assertGreaterEqual(raw["user_cpu_ms"], 0)
+            self.assertGreater(raw["max_rss_kb"], 0)
+        first_install = by_phase["install"][0]
+        if sys.platform.startswith("linux") and first_install["write_bytes"] >= 0:
+            self.assertGreaterEqual(first_install["write_bytes"], 1048576)
+
+        totals = {
+            e.raw["phase"]: e.raw
+            for e in parser.filter_by_spec_and_event(
+                "local.usage@v1", "shell_phase_usage"
+            )
+        }
+        self.assertEqual(totals["build"]["commands"], 1)
+        self.assertEqual(totals["install"]["commands"], 2)
+        self.assertEqual(totals["install"]["failed"], 0)
+        self.assertEqual(
+            totals["build"]["user_cpu_ms"], by_phase["build"][0]["user_cpu_ms"]
+        )
+
+        self.assertIn("shell usage by package and phase:", r.stderr)
+        self.assertIn("local.usage@v1 install: 2 commands", r.stderr)
+
 class TestDeployObservability(unittest.TestCase):
     """deploy_script events require a full `sync` (deploy is command-level)."""
 
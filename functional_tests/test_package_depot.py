@@ -511,6 +511,187 @@ class TestPackageDepot(unittest.TestCase):
             srv.shutdown()
             srv.server_close()
 
+    def test_chunked_depot_file_url(self):
+        """Chunked export imports through a file:// depot; chunks land in the store."""
+        ids = ["local.depot_a@v1", "local.depot_b@v1"]
+        source_m = self._make_source_manifest(ids)
+        r = self._run("install", "--manifest", str(source_m))
+        self.assertEqual(r.returncode, 0, f"install failed: {r.stderr}")
+
+        r = self._run(
+            "export",
+            "-o",
+            str(self.output_dir),
+            "--chunked",
+            "--depot-prefix",
+            self.output_dir.as_uri() + "/",
+            "--manifest",
+            str(source_m),
+        )
+        self.assertEqual(r.returncode, 0, f"export failed: {r.stderr}")
+        lines = [l for l in r.stdout.strip().split("\n") if l.strip()]
+        self.assertEqual(len(lines), 2)
+        for line in lines:
+            self.assertTrue(line.endswith(".chunks"), line)
+        exported = {p.name for p in (self.output_dir / "chunks").iterdir()}
+        self.assertTrue(exported, "export should write chunk files")
+
+        depot = self.output_dir / "depot.txt"
+        depot.write_text(r.stdout.strip() + "\n", encoding="utf-8")
+        m = self._make_target_manifest(ids, [depot.as_uri()])
+
+        trace = self.test_dir / "chunked.jsonl"
+        r = self._run(
+            f"--trace=file:{trace}",
+            "sync",
+            "--manifest",
+            str(m),
+            cache_root=self.target_cache,
+        )
+        self.assertEqual(r.returncode, 0, f"sync failed: {r.stderr}")
+
+        checks = TraceParser(trace).filter_by_event("depot_check")
+        hits = [e for e in checks if e.raw.get("result") == "hit"]
+        self.assertEqual(len(hits), 2, f"expected two depot hits: {checks}")
+        for identity in ids:
+            self.assertTrue((self.target_cache / "packages" / identity).exists())
+
+        # Every exported chunk was needed once; chunks shared by both packages are
+        # stored (and fetched) a single time.
+        stored = {p.name for p in (self.target_cache / "chunks").iterdir()}
+        self.assertEqual(stored, exported)
+
+    def test_delta_depot_rebuilds_from_installed_version(self):
+        """A v1 -> v2 delta imports v2 from an installed v1 without the full archive."""
+        (self.test_dir / "pkg_a2.lua").write_text(
+            _spec_content("local.depot_a@v2", self.archive_path, self.archive_hash),
+            encoding="utf-8",
+        )
+        self.spec_lua["local.depot_a@v2"] = f"{self.test_dir.as_posix()}/pkg_a2.lua"
+
+        v1_dir = self.output_dir / "v1"
+        v1_dir.mkdir()
+        m1 = self._make_source_manifest(["local.depot_a@v1"])
+        r = self._run("install", "--manifest", str(m1))
+        self.assertEqual(r.returncode, 0, f"install v1 failed: {r.stderr}")
+        r = self._run(
+            "export",
+            "-o",
+            str(v1_dir),
+            "--depot-prefix",
+            v1_dir.as_uri() + "/",
+            "--manifest",
+            str(m1),
+        )
+        self.assertEqual(r.returncode, 0, f"export v1 failed: {r.stderr}")
+        v1_depot = self.output_dir / "v1.txt"
+        v1_depot.write_text(r.stdout.strip() + "\n", encoding="utf-8")
+
+        m2 = self._make_source_manifest(["local.depot_a@v2"])
+        r = self._run("install", "--manifest", str(m2))
+        self.assertEqual(r.returncode, 0, f"install v2 failed: {r.stderr}")
+        r = self._run(
+            "export",
+            "-o",
+            str(self.output_dir),
+            "--delta-from",
+            str(v1_dir),
+            "--depot-prefix",
+            self.output_dir.as_uri() + "/",
+            "--manifest",
+            str(m2),
+        )
+        self.assertEqual(r.returncode, 0, f"export v2 failed: {r.stderr}")
+        lines = [l for l in r.stdout.strip().split("\n") if l.strip()]
+        deltas = [l for l in lines if l.endswith(".delta")]
+        self.assertEqual(len(lines), 2, lines)
+        self.assertEqual(len(deltas), 1, lines)
+
+        # Target cache: v1 from its full archive, then v2 from a depot listing only the
+        # delta. With the source archive gone, a build from source would fail.
+        self.archive_path.unlink()
+        r = self._run(
+            "sync",
+            "--manifest",
+            str(self._make_target_manifest(["local.depot_a@v1"], [v1_depot.as_uri()])),
+            cache_root=self.target_cache,
+        )
+        self.assertEqual(r.returncode, 0, f"sync v1 failed: {r.stderr}")
+
+        delta_depot = self.output_dir / "delta.txt"
+        delta_depot.write_text(deltas[0] + "\n", encoding="utf-8")
+        trace = self.test_dir / "delta.jsonl"
+        r = self._run(
+            f"--trace=file:{trace}",
+            "sync",
+            "--manifest",
+            str(self._make_target_manifest(["local.depot_a@v2"], [delta_depot.as_uri()])),
+            cache_root=self.target_cache,
+        )
+        self.assertEqual(r.returncode, 0, f"sync v2 failed: {r.stderr}")
+
+        checks = TraceParser(trace).filter_by_event("depot_check")
+        self.assertTrue(any(e.raw.get("result") == "hit" for e in checks), checks)
+        self.assertTrue((self.target_cache / "packages" / "local.depot_a@v2").exists())
+
+    def test_dict_depot_fetches_dictionary_beside_archive(self):
+        """An export compressed with a trained dictionary imports over HTTP."""
+        samples = self.test_dir / "dict-samples"
+        for i in range(200):
+            f = samples / f"sub{i % 5}" / f"mod{i}.h"
+            f.parent.mkdir(parents=True, exist_ok=True)
+            f.write_text(
+                "// SPDX-License-Identifier: Apache-2.0\n"
+                f"#ifndef MOD{i}_H\n#define MOD{i}_H\n#include <stddef.h>\n"
+                f"int mod{i}_init(void *ctx, size_t len);\n#endif\n",
+                encoding="utf-8",
+            )
+        dict_path = self.test_dir / "pkgs.zdict"
+        r = self._run("train-dict", str(samples), "-o", str(dict_path), "--size", "4096")
+        self.assertEqual(r.returncode, 0, f"train-dict failed: {r.stderr}")
+        dict_id = r.stdout.split()[0]
+
+        m = self._make_source_manifest(["local.depot_a@v1"])
+        r = self._run("install", "--manifest", str(m))
+        self.assertEqual(r.returncode, 0, f"install failed: {r.stderr}")
+
+        srv, port = self._start_server()
+        try:
+            r = self._run(
+                "export",
+                "-o",
+                str(self.serve_dir),
+                "--dict",
+                str(dict_path),
+                "--depot-prefix",
+                f"http://127.0.0.1:{port}/",
+                "--manifest",
+                str(m),
+            )
+            self.assertEqual(r.returncode, 0, f"export failed: {r.stderr}")
+            line = r.stdout.strip()
+            dict_sha = hashlib.sha256(dict_path.read_bytes()).hexdigest()
+            self.assertTrue(
+                line.endswith(f"  dict={dict_id}  dict_sha256={dict_sha}"), line
+            )
+            self.assertTrue((self.serve_dir / "dicts" / f"{dict_id}.zdict").exists())
+            (self.serve_dir / "depot.txt").write_text(line + "\n", encoding="utf-8")
+
+            self.archive_path.unlink()  # A build from source would now fail
+            depot_url = f"http://127.0.0.1:{port}/depot.txt"
+            r = self._run(
+                "sync",
+                "--manifest",
+                str(self._make_target_manifest(["local.depot_a@v1"], [depot_url])),
+                cache_root=self.target_cache,
+            )
+            self.assertEqual(r.returncode, 0, f"sync failed: {r.stderr}")
+        finally:
+            srv.shutdown()
+
+        self.assertTrue((self.target_cache / "packages" / "local.depot_a@v1").exists())
+        self.assertTrue((self.target_cache / "dicts" / f"{dict_id}.zdict").exists())
+
     def test_depot_then_local_cache_hit(self):
         """Second sync gets local cache hit; no depot fetch needed."""
         archives = self._install_and_export(["local.depot_a@v1"])
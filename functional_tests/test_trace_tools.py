@@ -0,0 +1,221 @@
+"""Offline tools for a recorded trace: timeline export and run analysis.
+
+Runs a two-package install with --trace=file:<jsonl>,chrome:<json>, checks the live
+timeline against the Trace Event format, then converts the recorded JSONL offline
+with `envy trace export` and checks that the two timelines agree on their tracks and
+phase slices. `envy trace analyze` must put the package that finished last at the end
+of the critical path.
+"""
+
+import hashlib
+import io
+import json
+import shutil
+import tarfile
+import tempfile
+import unittest
+from collections import defaultdict
+from pathlib import Path
+
+from . import test_config
+
+DEP_SPEC = """IDENTITY = "local.chrome_dep@v1"
+
+FETCH = {{
+  source = "{archive}",
+  sha256 = "{sha256}"
+}}
+
+STAGE = function(fetch_dir, stage_dir, tmp_dir, options)
+  envy.extract_all(fetch_dir, stage_dir, {{strip = 1}})
+end
+
+BUILD = function(install_dir, stage_dir, fetch_dir, tmp_dir, options)
+  envy.run([[echo "dep built" > dep.txt]])
+end
+"""
+
+APP_SPEC = """IDENTITY = "local.chrome_app@v1"
+
+DEPENDENCIES = {{
+  {{ spec = "local.chrome_dep@v1", source = "{dep_spec}", needed_by = "build" }}
+}}
+
+FETCH = {{
+  source = "{archive}",
+  sha256 = "{sha256}"
+}}
+
+STAGE = function(fetch_dir, stage_dir, tmp_dir, options)
+  envy.extract_all(fetch_dir, stage_dir, {{strip = 1}})
+end
+
+BUILD = function(install_dir, stage_dir, fetch_dir, tmp_dir, options)
+  envy.package("local.chrome_dep@v1")
+  envy.run([[echo "app built" > app.txt]])
+end
+"""
+
+PHASES = {"X", "i", "s", "f", "C", "M"}
+
+
+def check_chrome_trace(test: unittest.TestCase, path: Path) -> dict:
+    """Validate a Trace Event JSON file; return its events grouped for assertions."""
+    doc = json.loads(path.read_text(encoding="utf-8"))
+    test.assertIsInstance(doc, dict)
+    events = doc["traceEvents"]
+    test.assertIsInstance(events, list)
+
+    tracks = {}
+    slices = defaultdict(list)
+    counters = defaultdict(list)
+    flows = defaultdict(list)
+    for e in events:
+        for key in ("name", "ph", "pid", "tid", "ts"):
+            test.assertIn(key, e, f"event lacks {key}: {e}")
+        test.assertIn(e["ph"], PHASES, e)
+        test.assertIsInstance(e["ts"], int, e)
+        test.assertGreaterEqual(e["ts"], 0, e)
+        if e["ph"] == "M" and e["name"] == "thread_name":
+            tracks[e["tid"]] = e["args"]["name"]
+        elif e["ph"] == "X":
+            test.assertGreaterEqual(e["dur"], 0, e)
+            slices[e["tid"]].append(e)
+        elif e["ph"] == "C":
+            counters[e["name"]].append(e["args"]["active"])
+        elif e["ph"] in ("s", "f"):
+            flows[e["id"]].append(e)
+
+    # Slices on one track nest and never partially overlap.
+    for track in slices.values():
+        track.sort(key=lambda e: (e["ts"], -e["dur"]))
+        for prev, cur in zip(track, track[1:]):
+            end = prev["ts"] + prev["dur"]
+            test.assertTrue(cur["ts"] >= end or cur["ts"] + cur["dur"] <= end, cur)
+
+    for ends in flows.values():
+        test.assertEqual([e["ph"] for e in ends], ["s", "f"])
+
+    return {"tracks": tracks, "slices": slices, "counters": counters}
+
+
+def phase_names(timeline: dict, identity: str) -> list:
+    tid = next(t for t, name in timeline["tracks"].items() if name == identity)
+    return sorted(
+        e["name"] for e in timeline["slices"][tid] if e.get("cat") == "phase"
+    )
+
+
+class TestTraceTools(unittest.TestCase):
+    def setUp(self):
+        self.cache_root = Path(tempfile.mkdtemp(prefix="envy-chrome-cache-"))
+        self.test_dir = Path(tempfile.mkdtemp(prefix="envy-chrome-"))
+        self.envy = test_config.get_envy_executable()
+
+        buf = io.BytesIO()
+        with tarfile.open(fileobj=buf, mode="w:gz") as tar:
+            data = b"payload\n"
+            info = tarfile.TarInfo(name="root/file.txt")
+            info.size = len(data)
+            tar.addfile(info, io.BytesIO(data))
+        archive = self.test_dir / "payload.tar.gz"
+        archive.write_bytes(buf.getvalue())
+        sha256 = hashlib.sha256(buf.getvalue()).hexdigest()
+
+        dep_spec = self.test_dir / "dep.lua"
+        dep_spec.write_text(
+            DEP_SPEC.format(archive=archive.as_posix(), sha256=sha256), encoding="utf-8"
+        )
+        app_spec = self.test_dir / "app.lua"
+        app_spec.write_text(
+            APP_SPEC.format(
+                archive=archive.as_posix(),
+                sha256=sha256,
+                dep_spec=dep_spec.as_posix(),
+            ),
+            encoding="utf-8",
+        )
+        self.manifest = test_config.write_spec_manifest(
+            self.test_dir, [("local.chrome_app@v1", app_spec)]
+        )
+
+    def tearDown(self):
+        shutil.rmtree(self.cache_root, ignore_errors=True)
+        shutil.rmtree(self.test_dir, ignore_errors=True)
+
+    def install_with_trace(self) -> tuple[Path, Path]:
+        jsonl = self.cache_root / "trace.jsonl"
+        live = self.cache_root / "live.json"
+        result = test_config.run(
+            [
+                str(self.envy),
+                f"--cache-root={self.cache_root}",
+                f"--trace=file:{jsonl},chrome:{live}",
+                "install",
+                "--manifest",
+                str(self.manifest),
+            ],
+            capture_output=True,
+            text=True,
+        )
+        self.assertEqual(result.returncode, 0, f"stderr: {result.stderr}")
+        return jsonl, live
+
+    def test_live_and_offline_timelines(self):
+        jsonl, live = self.install_with_trace()
+        timeline = check_chrome_trace(self, live)
+        self.assertEqual(timeline["tracks"][0], "engine")
+        self.assertIn("local.chrome_app@v1", timeline["tracks"].values())
+        self.assertIn("local.chrome_dep@v1", timeline["tracks"].values())
+        dep_phases = phase_names(timeline, "local.chrome_dep@v1")
+        for phase in ("fetch", "stage", "build"):
+            self.assertIn(phase, dep_phases)
+        self.assertGreaterEqual(max(timeline["counters"]["extractions"]), 1)
+        self.assertGreaterEqual(max(timeline["counters"]["shell commands"]), 1)
+        self.assertIn("downloads", timeline["counters"])
+
+        offline = self.cache_root / "offline.json"
+        result = test_config.run(
+            [str(self.envy), "trace", "export", str(jsonl), str(offline)],
+            capture_output=True,
+            text=True,
+        )
+        self.assertEqual(result.returncode, 0, f"stderr: {result.stderr}")
+
+        converted = check_chrome_trace(self, offline)
+        self.assertEqual(converted["tracks"], timeline["tracks"])
+        for identity in ("local.chrome_app@v1", "local.chrome_dep@v1"):
+            self.assertEqual(
+                phase_names(converted, identity), phase_names(timeline, identity)
+            )
+
+    def test_analyze_recorded_run(self):
+        jsonl, _ = self.install_with_trace()
+        result = test_config.run(
+            [str(self.envy), "trace", "analyze", str(jsonl), "--top", "2"],
+            capture_output=True,
+            text=True,
+        )
+        self.assertEqual(result.returncode, 0, f"stderr: {result.stderr}")
+        report = result.stdout
+        path = report.split("critical path:", 1)[1].split("packages", 1)[0]
+        # app finishes last, so the path ends in app's phases.
+        self.assertIn("local.chrome_app@v1", path.strip().splitlines()[-1])
+        self.assertIn("local.chrome_dep@v1", report)
+        opportunities = report.split("opportunities", 1)[1].strip().splitlines()[1:]
+        self.assertLessEqual(len(opportunities), 2)
+
+    def test_export_rejects_malformed_trace(self):
+        bad = self.test_dir / "bad.jsonl"
+        bad.write_text('{"seq":0}\n', encoding="utf-8")
+        result = test_config.run(
+            [str(self.envy), "trace", "export", str(bad), str(self.test_dir / "o.json")],
+            capture_output=True,
+            text=True,
+        )
+        self.assertNotEqual(result.returncode, 0)
+        self.assertIn("bad.jsonl:1", result.stderr)
+
+
+if __name__ == "__main__":
+    unittest.main()
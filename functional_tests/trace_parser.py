@@ -24,6 +24,7 @@ SCHEMA_VERSION = 2
 # Must match src/trace_events.def exactly.
 EVENT_REGISTRY = {
     "trace_start": ["schema:i64"],
+    "trace_dropped": ["thread:i64", "count:i64"],
     "spec_registered": ["key:str"],
     "dependency_added": ["dependency:str", "needed_by:phase"],
     "phase_start": ["phase:phase"],
@@ -59,6 +60,15 @@ EVENT_REGISTRY = {
         "allowed:bool",
         "reason:str",
     ],
+    "lua_memory": [
+        "phase:phase",
+        "gc_mode:str",
+        "current_bytes:i64",
+        "peak_bytes:i64",
+        "total_bytes:i64",
+        "allocations:i64",
+        "reserved_bytes:i64",
+    ],
     "depot_check": ["sha:str", "result:str"],
     "product_resolved": ["product:str", "provider:str", "via:str"],
     "deploy_script": ["product:str", "platform:str", "action:str"],
@@ -70,6 +80,35 @@ EVENT_REGISTRY = {
     "git_resolve": ["url:str", "ref:str", "sha:str", "method:str"],
     "extract_start": ["archive:str", "destination:str", "strip_components:i64"],
     "extract_complete": ["archive:str", "files_extracted:i64", "duration_ms:i64"],
+    "shell_command_usage": [
+        "phase:phase",
+        "exit_code:i64",
+        "wall_ms:i64",
+        "user_cpu_ms:i64",
+        "sys_cpu_ms:i64",
+        "max_rss_kb:i64",
+        "voluntary_ctx_switches:i64",
+        "involuntary_ctx_switches:i64",
+        "read_bytes:i64",
+        "write_bytes:i64",
+        "disk_read_bytes:i64",
+        "disk_write_bytes:i64",
+    ],
+    "shell_phase_usage": [
+        "phase:phase",
+        "commands:i64",
+        "failed:i64",
+        "wall_ms:i64",
+        "user_cpu_ms:i64",
+        "sys_cpu_ms:i64",
+        "max_rss_kb:i64",
+        "voluntary_ctx_switches:i64",
+        "involuntary_ctx_switches:i64",
+        "read_bytes:i64",
+        "write_bytes:i64",
+        "disk_read_bytes:i64",
+        "disk_write_bytes:i64",
+    ],
 }
 
 
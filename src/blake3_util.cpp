@@ -2,11 +2,236 @@
 
 #include "blake3.h"
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// BLAKE3 internals from blake3_impl.h. The public API only emits root outputs; subtree
+// chaining values need the raw compressors. blake3_hash_many is the SIMD-dispatched
+// multi-input path blake3_hasher_update itself uses. blake3_impl.h is C with GCC/MSVC
+// intrinsics and does not compile as C++, so its prototypes are restated here and
+// pinned to the vendored release (ENVY_BLAKE3_VERSION in cmake/Dependencies.cmake).
+static_assert(std::string_view{ BLAKE3_VERSION_STRING } == "1.8.5",
+              "BLAKE3 changed: check these prototypes against its c/blake3_impl.h");
+extern "C" {
+void blake3_compress_in_place(std::uint32_t cv[8],
+                              std::uint8_t const block[64],
+                              std::uint8_t block_len,
+                              std::uint64_t counter,
+                              std::uint8_t flags);
+void blake3_hash_many(std::uint8_t const *const *inputs,
+                      std::size_t num_inputs,
+                      std::size_t blocks,
+                      std::uint32_t const key[8],
+                      std::uint64_t counter,
+                      bool increment_counter,
+                      std::uint8_t flags,
+                      std::uint8_t flags_start,
+                      std::uint8_t flags_end,
+                      std::uint8_t *out);
+}
+
 namespace envy {
 
+namespace {
+
+constexpr std::size_t kBlockLen{ 64 };
+constexpr std::size_t kChunkLen{ BLAKE3_CHUNK_LEN };
+constexpr std::size_t kBlocksPerChunk{ kChunkLen / kBlockLen };
+
+// Work unit: 1 MiB subtrees keep every thread inside one SIMD-wide hash_many call for a
+// while. Below a few units, thread startup costs more than it saves.
+constexpr std::size_t kSubtreeChunks{ 1024 };
+constexpr std::size_t kMinParallelLength{ 4 * kSubtreeChunks * kChunkLen };
+
+constexpr std::uint32_t kIv[8]{ 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+                                0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 };
+
+enum : std::uint8_t { CHUNK_START = 1, CHUNK_END = 2, PARENT = 4, ROOT = 8 };
+
+using cv_t = std::array<std::uint8_t, 32>;
+
+cv_t store_cv(std::uint32_t const words[8]) {
+  cv_t out;
+  for (std::size_t i{ 0 }; i < 8; ++i) {
+    for (std::size_t b{ 0 }; b < 4; ++b) {
+      out[i * 4 + b] = static_cast<std::uint8_t>(words[i] >> (8 * b));
+    }
+  }
+  return out;
+}
+
+cv_t parent_cv(cv_t const &left, cv_t const &right, std::uint8_t flags) {
+  std::uint8_t block[kBlockLen];
+  std::memcpy(block, left.data(), left.size());
+  std::memcpy(block + left.size(), right.data(), right.size());
+  std::uint32_t cv[8];
+  std::memcpy(cv, kIv, sizeof cv);
+  blake3_compress_in_place(cv, block, kBlockLen, 0, PARENT | flags);
+  return store_cv(cv);
+}
+
+// Chaining value of the complete subtree of `chunks` (a power of two) full chunks whose
+// first chunk has index `counter`.
+cv_t subtree_cv(std::uint8_t const *data, std::size_t chunks, std::uint64_t counter) {
+  std::vector<std::uint8_t const *> inputs(chunks);
+  for (std::size_t i{ 0 }; i < chunks; ++i) { inputs[i] = data + i * kChunkLen; }
+  std::vector<std::uint8_t> cvs(chunks * 32);
+  std::vector<std::uint8_t> parents(chunks / 2 * 32);
+  blake3_hash_many(inputs.data(),
+                   chunks,
+                   kBlocksPerChunk,
+                   kIv,
+                   counter,
+                   true,
+                   0,
+                   CHUNK_START,
+                   CHUNK_END,
+                   cvs.data());
+
+  for (std::size_t n{ chunks }; n > 1; n /= 2) {
+    for (std::size_t i{ 0 }; i < n / 2; ++i) { inputs[i] = cvs.data() + i * 64; }
+    blake3_hash_many(inputs.data(), n / 2, 1, kIv, 0, false, PARENT, 0, 0, parents.data());
+    std::swap(cvs, parents);
+  }
+
+  cv_t out;
+  std::memcpy(out.data(), cvs.data(), out.size());
+  return out;
+}
+
+// Chaining value of the last chunk (1..kChunkLen bytes, possibly partial). Never the
+// root here: the parallel path only runs on multi-chunk inputs.
+cv_t last_chunk_cv(std::uint8_t const *data, std::size_t length, std::uint64_t counter) {
+  std::uint32_t cv[8];
+  std::memcpy(cv, kIv, sizeof cv);
+  std::size_t const blocks{ (length + kBlockLen - 1) / kBlockLen };
+  for (std::size_t b{ 0 }; b < blocks; ++b) {
+    std::uint8_t block[kBlockLen]{};
+    std::size_t const n{ std::min(kBlockLen, length - b * kBlockLen) };
+    std::memcpy(block, data + b * kBlockLen, n);
+    std::uint8_t const flags{ static_cast<std::uint8_t>(
+        (b == 0 ? CHUNK_START : 0) | (b + 1 == blocks ? CHUNK_END : 0)) };
+    blake3_compress_in_place(cv, block, static_cast<std::uint8_t>(n), counter, flags);
+  }
+  return store_cv(cv);
+}
+
+struct subtree {
+  std::uint64_t counter;  // Index of its first chunk
+  std::size_t chunks;
+};
+
+// Parallel tree hash of `length` bytes (more than one chunk). Each worker calls
+// make_reader() once; the reader returns a pointer to the `size` bytes at `offset`,
+// valid until its next call. A reader that throws stops the hash and the first
+// exception is rethrown.
+template <typename MakeReader>
+blake3_t hash_tree(std::size_t length, std::size_t jobs, MakeReader const &make_reader) {
+  // Like blake3_hasher, hold back the final chunk: it closes the tree. Everything before
+  // it splits into aligned power-of-two subtrees, the same boundaries the serial hasher
+  // would pick.
+  std::size_t const full_chunks{ (length - 1) / kChunkLen };
+  std::vector<subtree> units;
+  for (std::size_t c{ 0 }; c < full_chunks;) {
+    std::size_t size{ std::min(kSubtreeChunks, std::bit_floor(full_chunks - c)) };
+    while (c % size != 0) { size /= 2; }
+    units.push_back({ .counter = c, .chunks = size });
+    c += size;
+  }
+
+  std::vector<cv_t> cvs(units.size());
+  std::atomic<std::size_t> next{ 0 };
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  auto const work{ [&] {
+    try {
+      auto read{ make_reader() };
+      while (true) {
+        std::size_t const i{ next.fetch_add(1, std::memory_order_relaxed) };
+        if (i >= units.size()) { return; }
+        auto const &u{ units[i] };
+        cvs[i] = subtree_cv(read(u.counter * kChunkLen, u.chunks * kChunkLen),
+                            u.chunks,
+                            u.counter);
+      }
+    } catch (...) {
+      next.store(units.size(), std::memory_order_relaxed);
+      std::lock_guard const lock{ error_mutex };
+      if (!error) { error = std::current_exception(); }
+    }
+  } };
+  std::vector<std::thread> workers;
+  jobs = std::min(jobs, units.size());
+  for (std::size_t t{ 1 }; t < jobs; ++t) { workers.emplace_back(work); }
+  work();
+  for (auto &w : workers) { w.join(); }
+  if (error) { std::rethrow_exception(error); }
+
+  // Merge chaining values the way blake3_hasher's CV stack does: after n chunks the stack
+  // holds one subtree per set bit of n.
+  std::vector<cv_t> stack;
+  auto const merge{ [&](std::uint64_t total_chunks) {
+    while (stack.size() > static_cast<std::size_t>(std::popcount(total_chunks))) {
+      cv_t const right{ stack.back() };
+      stack.pop_back();
+      stack.back() = parent_cv(stack.back(), right, 0);
+    }
+  } };
+  for (std::size_t i{ 0 }; i < units.size(); ++i) {
+    merge(units[i].counter);
+    stack.push_back(cvs[i]);
+  }
+  merge(full_chunks);
+
+  std::size_t const tail{ length - full_chunks * kChunkLen };
+  auto read_tail{ make_reader() };
+  cv_t cv{ last_chunk_cv(read_tail(full_chunks * kChunkLen, tail), tail, full_chunks) };
+  for (std::size_t i{ stack.size() - 1 }; i > 0; --i) { cv = parent_cv(stack[i], cv, 0); }
+  return parent_cv(stack.front(), cv, ROOT);
+}
+
+// Positioned reads through a stream of its own, so workers never share a file offset.
+class file_reader {
+ public:
+  explicit file_reader(std::filesystem::path const &path)
+      : path_{ path }, in_{ path, std::ios::binary } {
+    if (!in_) {
+      throw std::runtime_error("blake3: failed to open file: " + path.string());
+    }
+  }
+
+  std::uint8_t const *operator()(std::uint64_t offset, std::size_t size) {
+    buffer_.resize(size);
+    in_.seekg(static_cast<std::streamoff>(offset));
+    in_.read(reinterpret_cast<char *>(buffer_.data()), static_cast<std::streamsize>(size));
+    if (static_cast<std::size_t>(in_.gcount()) != size) {
+      throw std::runtime_error("blake3: file changed while hashing: " + path_.string());
+    }
+    return buffer_.data();
+  }
+
+ private:
+  std::filesystem::path const &path_;
+  std::ifstream in_;
+  std::vector<std::uint8_t> buffer_;
+};
+
+}  // namespace
+
 blake3_t blake3_hash(void const *data, size_t length) {
   blake3_t digest;
-  blake3_hasher hasher;
+  ::blake3_hasher hasher;
 
   blake3_hasher_init(&hasher);
   blake3_hasher_update(&hasher, data, length);
@@ -14,4 +239,67 @@ blake3_t blake3_hash(void const *data, size_t length) {
   return digest;
 }
 
+blake3_t blake3_file(std::filesystem::path const &path) {
+  file_ptr_t file{ util_open_file(path, "rb") };
+  if (!file) { throw std::runtime_error("blake3: failed to open file: " + path.string()); }
+
+  blake3_hasher hasher;
+  std::vector<unsigned char> buffer(1024 * 1024);
+  while (true) {
+    auto const read_bytes{ std::fread(buffer.data(), 1, buffer.size(), file.get()) };
+    if (read_bytes > 0) { hasher.update(buffer.data(), read_bytes); }
+    if (read_bytes < buffer.size()) {
+      if (std::ferror(file.get())) { throw std::runtime_error("blake3: fread failed"); }
+      break;
+    }
+  }
+  return hasher.finalize();
+}
+
+blake3_t blake3_hash_parallel(void const *data, size_t length, size_t jobs) {
+  if (jobs == 0) { jobs = std::max(1u, std::thread::hardware_concurrency()); }
+  if (jobs == 1 || length < kMinParallelLength) { return blake3_hash(data, length); }
+
+  auto const *bytes{ static_cast<std::uint8_t const *>(data) };
+  return hash_tree(length, jobs, [bytes] {
+    return [bytes](std::uint64_t offset, std::size_t) { return bytes + offset; };
+  });
+}
+
+blake3_t blake3_file_parallel(std::filesystem::path const &path, size_t jobs) {
+  if (jobs == 0) { jobs = std::max(1u, std::thread::hardware_concurrency()); }
+  std::error_code ec;
+  auto const length{ std::filesystem::file_size(path, ec) };
+  if (ec) { throw std::runtime_error("blake3: failed to open file: " + path.string()); }
+  if (jobs == 1 || length < kMinParallelLength) { return blake3_file(path); }
+  return hash_tree(static_cast<std::size_t>(length), jobs, [&path] {
+    return file_reader{ path };
+  });
+}
+
+struct blake3_hasher::impl {
+  ::blake3_hasher state;
+  bool finalized{ false };
+};
+
+blake3_hasher::blake3_hasher() : impl_{ std::make_unique<impl>() } {
+  blake3_hasher_init(&impl_->state);
+}
+
+blake3_hasher::~blake3_hasher() = default;
+
+void blake3_hasher::update(void const *data, size_t length) {
+  if (impl_->finalized) { throw std::logic_error("blake3: update after finalize"); }
+  blake3_hasher_update(&impl_->state, data, length);
+}
+
+blake3_t blake3_hasher::finalize() {
+  if (impl_->finalized) { throw std::logic_error("blake3: finalize called twice"); }
+  impl_->finalized = true;
+
+  blake3_t digest;
+  blake3_hasher_finalize(&impl_->state, digest.data(), digest.size());
+  return digest;
+}
+
 }  // namespace envy
@@ -1,11 +1,42 @@
 #pragma once
 
+#include "util.h"
+
 #include <array>
 #include <cstddef>
+#include <filesystem>
+#include <memory>
 
 namespace envy {
 
 using blake3_t = std::array<unsigned char, 32>;
 blake3_t blake3_hash(void const *data, size_t length);
 
+// Hash a file's contents. Throws std::runtime_error if it cannot be opened or read.
+blake3_t blake3_file(std::filesystem::path const &path);
+
+// Same digest as blake3_hash, computed on up to `jobs` threads (0 = hardware concurrency)
+// by hashing aligned power-of-two chunk subtrees concurrently and merging their chaining
+// values in tree order. Inputs too small to benefit are hashed serially.
+blake3_t blake3_hash_parallel(void const *data, size_t length, size_t jobs = 0);
+
+// Hash a file like blake3_hash_parallel, each thread reading its own subtrees. Reads
+// rather than maps, so a file truncated meanwhile throws instead of raising SIGBUS.
+// Throws std::runtime_error if it cannot be opened or read.
+blake3_t blake3_file_parallel(std::filesystem::path const &path, size_t jobs = 0);
+
+// Incremental BLAKE3 over streamed bytes; finalize() may be called once.
+class blake3_hasher : unmovable {
+ public:
+  blake3_hasher();
+  ~blake3_hasher();
+
+  void update(void const *data, size_t length);
+  blake3_t finalize();
+
+ private:
+  struct impl;
+  std::unique_ptr<impl> impl_;
+};
+
 }  // namespace envy
@@ -1,8 +1,18 @@
 #include "blake3_util.h"
 
+#include "util.h"
+
 #include "doctest.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <random>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace {
 
@@ -47,3 +57,74 @@ TEST_CASE("blake3_hash different inputs produce different outputs") {
   auto const digest2{ envy::blake3_hash(input2.data(), input2.size()) };
   CHECK(digest1 != digest2);
 }
+
+TEST_CASE("blake3_hasher matches one-shot hash across split updates") {
+  std::string const input(100000, 'q');
+  envy::blake3_hasher hasher;
+  hasher.update(input.data(), 1);
+  hasher.update(input.data() + 1, 4095);
+  hasher.update(input.data() + 4096, input.size() - 4096);
+  CHECK(hasher.finalize() == envy::blake3_hash(input.data(), input.size()));
+}
+
+TEST_CASE("blake3_hash_parallel matches the serial hash at many sizes and alignments") {
+  std::vector<unsigned char> data(13 * 1024 * 1024 + 4096);
+  std::mt19937 rng{ 3 };
+  for (auto &c : data) { c = static_cast<unsigned char>(rng()); }
+
+  constexpr std::size_t kMiB{ 1024 * 1024 };
+  for (std::size_t const size :
+       { std::size_t{ 0 }, std::size_t{ 1 }, std::size_t{ 1024 }, std::size_t{ 1025 },
+         4 * kMiB - 1, 4 * kMiB, 4 * kMiB + 1, 4 * kMiB + 1023, 4 * kMiB + 1024,
+         5 * kMiB + 64, 7 * kMiB + 3 * 1024 + 17, 8 * kMiB, 13 * kMiB + 777 }) {
+    for (std::size_t const offset : { 0, 1, 3, 64 }) {
+      CAPTURE(size);
+      CAPTURE(offset);
+      auto const serial{ envy::blake3_hash(data.data() + offset, size) };
+      CHECK(envy::blake3_hash_parallel(data.data() + offset, size, 4) == serial);
+      CHECK(envy::blake3_hash_parallel(data.data() + offset, size, 3) == serial);
+    }
+  }
+}
+
+TEST_CASE("blake3_hash_parallel matches a reference digest") {
+  // Reference: BLAKE3 of bytes i % 251 for 9 MiB + 5 bytes.
+  std::vector<unsigned char> data(9 * 1024 * 1024 + 5);
+  for (std::size_t i{ 0 }; i < data.size(); ++i) {
+    data[i] = static_cast<unsigned char>(i % 251);
+  }
+  auto const digest{ envy::blake3_hash_parallel(data.data(), data.size(), 8) };
+  CHECK(envy::util_bytes_to_hex(digest.data(), digest.size()) ==
+        "e11450dc26fdc8b2c25371e1ba3938ff1251e865968608e20140add7c40a6fde");
+}
+
+TEST_CASE("blake3_file_parallel matches blake3_file") {
+  auto const dir{ std::filesystem::temp_directory_path() /
+                  ("envy-blake3-file-test-" + std::to_string(std::random_device{}())) };
+  std::filesystem::create_directories(dir);
+  std::string big(6 * 1024 * 1024 + 333, '\0');
+  std::mt19937 rng{ 5 };
+  for (auto &c : big) { c = static_cast<char>(rng()); }
+  std::ofstream{ dir / "big.bin", std::ios::binary } << big;
+  std::ofstream{ dir / "empty.bin", std::ios::binary };
+
+  auto const expected{ envy::blake3_file(dir / "big.bin") };
+  CHECK(envy::blake3_file_parallel(dir / "big.bin") == expected);
+  CHECK(envy::blake3_file_parallel(dir / "big.bin", 3) == expected);
+  CHECK(envy::blake3_file_parallel(dir / "empty.bin") == envy::blake3_hash("", 0));
+  CHECK_THROWS(envy::blake3_file_parallel(dir / "missing.bin"));
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("blake3_hash_parallel throughput by thread count" * doctest::skip()) {
+  std::vector<unsigned char> data(512 * 1024 * 1024, 0x5a);
+  unsigned const cores{ std::max(1u, std::thread::hardware_concurrency()) };
+  for (unsigned jobs{ 1 }; jobs <= cores; jobs *= 2) {
+    auto const start{ std::chrono::steady_clock::now() };
+    envy::blake3_hash_parallel(data.data(), data.size(), jobs);
+    std::chrono::duration<double> const elapsed{ std::chrono::steady_clock::now() -
+                                                 start };
+    MESSAGE("jobs=" << jobs << ": " << 512 / elapsed.count() << " MB/s");
+  }
+}
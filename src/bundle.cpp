@@ -1,11 +1,14 @@
 #include "bundle.h"
 
+#include "lua_state_pool.h"
 #include "manifest.h"
 #include "sol_util.h"
 #include "spec_util.h"
 #include "uri.h"
 #include "util.h"
 
+#include <algorithm>
+#include <atomic>
 #include <optional>
 #include <stdexcept>
 #include <thread>
@@ -255,39 +258,53 @@ void bundle::configure_package_path(sol::state &lua) const {
       bundle_root + "/?.lua;" + bundle_root + "/?/init.lua;" + current_path;
 }
 
-void bundle::validate() const {
+void bundle::validate(spec_meta_cache const *meta_cache) const {
   struct validation_result {
     std::string spec_key;
+    std::filesystem::path spec_path;
     std::optional<std::string> error;
   };
 
-  std::vector<validation_result> results(specs.size());
-  std::vector<std::thread> threads;
-  threads.reserve(specs.size());
-
-  size_t i{ 0 };
+  std::vector<validation_result> results;
+  results.reserve(specs.size());
   for (auto const &[expected_id, relative_path] : specs) {
-    results[i].spec_key = expected_id;
-    threads.emplace_back([this, expected_id, relative_path, &r = results[i]] {
-      std::filesystem::path const spec_path{ cache_path / relative_path };
-
-      if (!std::filesystem::exists(spec_path)) {
-        r.error = "file not found: " + spec_path.string();
-        return;
-      }
-
-      try {  // Execute spec and verify IDENTITY matches key
-        std::string const actual_id{ extract_spec_identity(spec_path, cache_path) };
-        if (actual_id != expected_id) {
-          r.error =
-              "IDENTITY mismatch: expected '" + expected_id + "', got '" + actual_id + "'";
-        }
-      } catch (std::exception const &e) { r.error = e.what(); }
-    });
-    ++i;
+    results.push_back(
+        { .spec_key = expected_id, .spec_path = cache_path / relative_path });
   }
 
-  for (auto &t : threads) { t.join(); }
+  auto const check{ [&](validation_result &r) {
+    if (!std::filesystem::exists(r.spec_path)) {
+      r.error = "file not found: " + r.spec_path.string();
+      return;
+    }
+
+    try {  // Execute spec and verify IDENTITY matches key
+      std::string const actual_id{
+        extract_spec_identity(r.spec_path, cache_path, meta_cache)
+      };
+      if (actual_id != r.spec_key) {
+        r.error =
+            "IDENTITY mismatch: expected '" + r.spec_key + "', got '" + actual_id + "'";
+      }
+    } catch (std::exception const &e) { r.error = e.what(); }
+  } };
+
+  // Each check leases a pooled Lua state. With no more workers than the pool keeps idle,
+  // a worker's next check reuses the state its last one returned, so a large bundle
+  // builds a handful of states instead of one per spec.
+  std::size_t const jobs{ std::min(
+      { results.size(),
+        lua_state_pool::kDefaultMaxIdle,
+        std::max<std::size_t>(1, std::thread::hardware_concurrency()) }) };
+  std::atomic<std::size_t> next{ 0 };
+  auto const work{ [&] {
+    for (std::size_t i{ next++ }; i < results.size(); i = next++) { check(results[i]); }
+  } };
+  std::vector<std::thread> workers;
+  workers.reserve(jobs);
+  for (std::size_t t{ 1 }; t < jobs; ++t) { workers.emplace_back(work); }
+  if (jobs > 0) { work(); }
+  for (auto &w : workers) { w.join(); }
 
   for (auto const &r : results) {
     if (r.error) {
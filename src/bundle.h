@@ -10,6 +10,8 @@
 
 namespace envy {
 
+class spec_meta_cache;
+
 // Parsed in-memory representation of envy-bundle.lua
 // Immutable after construction, shared across all specs from this bundle
 struct bundle {
@@ -29,8 +31,9 @@ struct bundle {
   // - All spec files exist at declared paths
   // - All spec files execute successfully in Lua
   // - All spec files have IDENTITY matching the SPECS table key
+  // Specs found in meta_cache are checked without running them.
   // Throws with detailed error message on failure
-  void validate() const;
+  void validate(spec_meta_cache const *meta_cache = nullptr) const;
 
   // Parse BUNDLES table from manifest into alias -> fetch config map
   // Returns empty map if bundles_obj is nil or missing
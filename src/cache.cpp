@@ -187,6 +187,7 @@ cache::scoped_entry_lock::~scoped_entry_lock() {
                   fetch_dir().string().c_str(),
                   ec.message().c_str());
       }
+      remove_all_noexcept(fetch_hashes_path());
     }
     platform::touch_file(m->entry_dir_ / "envy-complete");
     platform::flush_directory(m->entry_dir_);
@@ -221,6 +222,7 @@ cache::scoped_entry_lock::~scoped_entry_lock() {
     if (install_dir_empty && fetch_dir_empty) {
       disposition = "cleaned_failure";
       remove_all_noexcept(fetch_dir());
+      remove_all_noexcept(fetch_hashes_path());
     }
   }
 
@@ -266,6 +268,9 @@ bool cache::scoped_entry_lock::is_fetch_complete() const {
 
 cache::path cache::scoped_entry_lock::stage_dir() const { return work_dir() / "stage"; }
 cache::path cache::scoped_entry_lock::fetch_dir() const { return m->entry_dir_ / "fetch"; }
+cache::path cache::scoped_entry_lock::fetch_hashes_path() const {
+  return m->entry_dir_ / "fetch-hashes";
+}
 cache::path cache::scoped_entry_lock::work_dir() const { return m->entry_dir_ / "work"; }
 cache::path cache::scoped_entry_lock::tmp_dir() const { return work_dir() / "tmp"; }
 
@@ -45,6 +45,7 @@ class cache : unmovable {
     path install_dir() const;
     path stage_dir() const;
     path fetch_dir() const;
+    path fetch_hashes_path() const;  // verified_hash_db sidecar for fetch_dir()
     path work_dir() const;
     path tmp_dir() const;
 
@@ -36,11 +36,19 @@ cli_args cli_parse(int argc, char **argv) {
   auto *trace_option{ app.add_option("--trace",
                                      trace_spec,
                                      "Enable trace logging. Provide a comma-separated "
-                                     "list: 'stderr' for human-readable stderr and/or "
-                                     "'file:<path>' for JSONL file output. Defaults to "
-                                     "stderr if no value provided.") };
+                                     "list: 'stderr' for human-readable stderr, "
+                                     "'file:<path>' for JSONL file output and/or "
+                                     "'chrome:<path>' for a Chrome/Perfetto timeline. "
+                                     "Defaults to stderr if no value provided.") };
   trace_option->expected(0, 1);
 
+  std::optional<std::filesystem::path> lua_profile;
+  app.add_option("--lua-profile",
+                 lua_profile,
+                 "Sample Lua spec and manifest code; write collapsed stacks (for "
+                 "flamegraph tools) to this file and log the hottest lines on exit")
+      ->envname("ENVY_LUA_PROFILE");
+
   // Support version flags (-v / --version) triggering version command directly.
   bool version_flag_short{ false };
   bool version_flag_long{ false };
@@ -72,10 +80,12 @@ cli_args cli_parse(int argc, char **argv) {
                            cmd_fetch,
                            cmd_git_resolve,
                            cmd_hash,
+                           cmd_train_dict,
                            cmd_lua,
                            cmd_merge_depot,
                            cmd_mirror_envy,
-                           cmd_cache
+                           cmd_cache,
+                           cmd_trace
 #ifdef ENVY_FUNCTIONAL_TESTER
                            ,
                            cmd_trace_schema
@@ -129,6 +139,9 @@ cli_args cli_parse(int argc, char **argv) {
     } else if (spec.rfind("file:", 0) == 0 && spec.size() > 5) {
       args.trace_outputs.push_back(
           { tui::trace_output_type::file, std::filesystem::path{ spec.substr(5) } });
+    } else if (spec.rfind("chrome:", 0) == 0 && spec.size() > 7) {
+      args.trace_outputs.push_back(
+          { tui::trace_output_type::chrome, std::filesystem::path{ spec.substr(7) } });
     } else {
       args.cli_output = "Invalid trace output spec: " + spec;
       args.trace_outputs.clear();
@@ -166,6 +179,7 @@ cli_args cli_parse(int argc, char **argv) {
   }
 
   args.cache_root = cache_root;
+  args.lua_profile = lua_profile;
   return args;
 }
 
@@ -18,6 +18,8 @@
 #include "cmds/cmd_run.h"
 #include "cmds/cmd_shell.h"
 #include "cmds/cmd_sync.h"
+#include "cmds/cmd_trace.h"
+#include "cmds/cmd_train_dict.h"
 #include "cmds/cmd_version.h"
 #ifdef ENVY_FUNCTIONAL_TESTER
 #include "cmds/cmd_cache_functional_test.h"
@@ -51,6 +53,8 @@ struct cli_args {
                                  cmd_run::cfg,
                                  cmd_shell::cfg,
                                  cmd_sync::cfg,
+                                 cmd_trace::cfg,
+                                 cmd_train_dict::cfg,
                                  cmd_version::cfg
 #ifdef ENVY_FUNCTIONAL_TESTER
                                  ,
@@ -65,6 +69,7 @@ struct cli_args {
   std::optional<tui::level> verbosity;
   bool decorated_logging{ false };
   std::vector<tui::trace_output_spec> trace_outputs;
+  std::optional<std::filesystem::path> lua_profile;  // --lua-profile collapsed-stack file
   std::string cli_output;
 };
 
@@ -17,6 +17,8 @@
 #include "cmds/cmd_run.h"
 #include "cmds/cmd_shell.h"
 #include "cmds/cmd_sync.h"
+#include "cmds/cmd_trace.h"
+#include "cmds/cmd_train_dict.h"
 #include "cmds/cmd_version.h"
 #include "envy_release.h"
 
@@ -308,6 +310,56 @@ TEST_CASE("cli_parse: cmd_cache") {
   }
 }
 
+TEST_CASE("cli_parse: cmd_trace") {
+  SUBCASE("export") {
+    std::vector<std::string> args{ "envy", "trace", "export", "t.jsonl", "t.json" };
+    auto argv{ make_argv(args) };
+
+    auto parsed{ envy::cli_parse(static_cast<int>(args.size()), argv.data()) };
+
+    REQUIRE(parsed.cmd_cfg.has_value());
+    auto const *cfg{ std::get_if<envy::cmd_trace::cfg>(&*parsed.cmd_cfg) };
+    REQUIRE(cfg != nullptr);
+    CHECK(cfg->act == envy::cmd_trace::cfg::action::export_chrome);
+    CHECK(cfg->input == "t.jsonl");
+    CHECK(cfg->output == "t.json");
+  }
+
+  SUBCASE("export requires an output path") {
+    std::vector<std::string> args{ "envy", "trace", "export", "t.jsonl" };
+    auto argv{ make_argv(args) };
+
+    auto parsed{ envy::cli_parse(static_cast<int>(args.size()), argv.data()) };
+
+    CHECK_FALSE(parsed.cmd_cfg.has_value());
+    CHECK_FALSE(parsed.cli_output.empty());
+  }
+
+  SUBCASE("analyze") {
+    std::vector<std::string> args{ "envy", "trace", "analyze", "t.jsonl", "--top", "3" };
+    auto argv{ make_argv(args) };
+
+    auto parsed{ envy::cli_parse(static_cast<int>(args.size()), argv.data()) };
+
+    REQUIRE(parsed.cmd_cfg.has_value());
+    auto const *cfg{ std::get_if<envy::cmd_trace::cfg>(&*parsed.cmd_cfg) };
+    REQUIRE(cfg != nullptr);
+    CHECK(cfg->act == envy::cmd_trace::cfg::action::analyze);
+    CHECK(cfg->input == "t.jsonl");
+    CHECK(cfg->top == 3);
+  }
+
+  SUBCASE("requires a subcommand") {
+    std::vector<std::string> args{ "envy", "trace" };
+    auto argv{ make_argv(args) };
+
+    auto parsed{ envy::cli_parse(static_cast<int>(args.size()), argv.data()) };
+
+    CHECK_FALSE(parsed.cmd_cfg.has_value());
+    CHECK_FALSE(parsed.cli_output.empty());
+  }
+}
+
 TEST_CASE("cli_parse: cmd_hash") {
   SUBCASE("single file") {
     auto temp_path{ std::filesystem::temp_directory_path() / "cli_test_hash.txt" };
@@ -329,6 +381,9 @@ TEST_CASE("cli_parse: cmd_hash") {
     REQUIRE(cfg->paths.size() == 1);
     CHECK(cfg->paths[0] == temp_path);
     CHECK_FALSE(cfg->prefix.has_value());
+    CHECK(cfg->algorithm == "sha256");
+    CHECK_FALSE(cfg->recursive);
+    CHECK(cfg->jobs == 0);
   }
 
   SUBCASE("multiple files") {
@@ -391,6 +446,36 @@ TEST_CASE("cli_parse: cmd_hash") {
     CHECK(cfg->paths.size() == 1);
   }
 
+  SUBCASE("algorithm, walk and jobs options") {
+    auto temp_dir{ std::filesystem::temp_directory_path() };
+
+    std::vector<std::string> args{ "envy",      "hash",      "-a",
+                                   "both",      "-r",        "-j",
+                                   "4",         "--include", "*.tar.zst",
+                                   "--include", "*.zdict",   temp_dir.string() };
+    auto argv{ make_argv(args) };
+
+    auto parsed{ envy::cli_parse(static_cast<int>(args.size()), argv.data()) };
+
+    REQUIRE(parsed.cmd_cfg.has_value());
+    auto const *cfg{ std::get_if<envy::cmd_hash::cfg>(&*parsed.cmd_cfg) };
+    REQUIRE(cfg != nullptr);
+    CHECK(cfg->algorithm == "both");
+    CHECK(cfg->recursive);
+    CHECK(cfg->jobs == 4);
+    CHECK(cfg->include == std::vector<std::string>{ "*.tar.zst", "*.zdict" });
+  }
+
+  SUBCASE("unknown algorithm rejected") {
+    std::vector<std::string> args{ "envy", "hash", "--algorithm", "md5", "x" };
+    auto argv{ make_argv(args) };
+
+    auto parsed{ envy::cli_parse(static_cast<int>(args.size()), argv.data()) };
+
+    CHECK_FALSE(parsed.cmd_cfg.has_value());
+    CHECK_FALSE(parsed.cli_output.empty());
+  }
+
   SUBCASE("directory accepted as path") {
     auto temp_dir{ std::filesystem::temp_directory_path() };
 
@@ -667,6 +752,22 @@ TEST_CASE("cli_parse: trace flag enables structured outputs") {
     CHECK(parsed.trace_outputs[1].file_path->string() == trace_path.string());
   }
 
+  SUBCASE("chrome timeline alongside jsonl") {
+    std::vector<std::string> args{ "envy",
+                                   "--trace=file:/tmp/t.jsonl,chrome:/tmp/t.json",
+                                   "version" };
+    auto argv{ make_argv(args) };
+
+    auto parsed{ envy::cli_parse(static_cast<int>(args.size()), argv.data()) };
+
+    REQUIRE(parsed.cmd_cfg.has_value());
+    REQUIRE(parsed.trace_outputs.size() == 2);
+    CHECK(parsed.trace_outputs[0].type == envy::tui::trace_output_type::file);
+    CHECK(parsed.trace_outputs[1].type == envy::tui::trace_output_type::chrome);
+    REQUIRE(parsed.trace_outputs[1].file_path.has_value());
+    CHECK(parsed.trace_outputs[1].file_path->string() == "/tmp/t.json");
+  }
+
   SUBCASE("invalid trace spec rejected") {
     std::vector<std::string> args{ "envy", "--trace=bogus", "version" };
     auto argv{ make_argv(args) };
@@ -679,6 +780,30 @@ TEST_CASE("cli_parse: trace flag enables structured outputs") {
   }
 }
 
+TEST_CASE("cli_parse: lua-profile flag") {
+  SUBCASE("off by default") {
+    std::vector<std::string> args{ "envy", "version" };
+    auto argv{ make_argv(args) };
+
+    auto parsed{ envy::cli_parse(static_cast<int>(args.size()), argv.data()) };
+
+    CHECK_FALSE(parsed.lua_profile.has_value());
+  }
+
+  SUBCASE("path given") {
+    std::vector<std::string> args{
+      "envy", "--lua-profile", "/tmp/envy.folded", "version"
+    };
+    auto argv{ make_argv(args) };
+
+    auto parsed{ envy::cli_parse(static_cast<int>(args.size()), argv.data()) };
+
+    REQUIRE(parsed.cmd_cfg.has_value());
+    REQUIRE(parsed.lua_profile.has_value());
+    CHECK(parsed.lua_profile->string() == "/tmp/envy.folded");
+  }
+}
+
 TEST_CASE("cli_parse: global cache-root flag") {
   SUBCASE("no cache-root by default") {
     std::vector<std::string> args{ "envy", "version" };
@@ -1492,6 +1617,64 @@ TEST_CASE("cli_parse: cmd_export") {
     REQUIRE(cfg != nullptr);
     CHECK_FALSE(cfg->ignore_depot);
   }
+
+  SUBCASE("--dict") {
+    auto const dict_path{ std::filesystem::temp_directory_path() /
+                          "cli_test_export.zdict" };
+    { std::ofstream{ dict_path } << "dict"; }
+
+    std::vector<std::string> args{ "envy", "export", "--dict", dict_path.string() };
+    auto argv{ make_argv(args) };
+    auto parsed{ envy::cli_parse(static_cast<int>(args.size()), argv.data()) };
+
+    std::vector<std::string> chunked_args{
+      "envy", "export", "--dict", dict_path.string(), "--chunked"
+    };
+    auto chunked_argv{ make_argv(chunked_args) };
+    auto chunked_parsed{ envy::cli_parse(static_cast<int>(chunked_args.size()),
+                                         chunked_argv.data()) };
+
+    std::filesystem::remove(dict_path);
+
+    REQUIRE(parsed.cmd_cfg.has_value());
+    auto const *cfg{ std::get_if<envy::cmd_export::cfg>(&*parsed.cmd_cfg) };
+    REQUIRE(cfg != nullptr);
+    REQUIRE(cfg->dict.has_value());
+    CHECK(*cfg->dict == dict_path);
+
+    CHECK_FALSE(chunked_parsed.cmd_cfg.has_value());
+  }
+}
+
+TEST_CASE("cli_parse: cmd_train_dict") {
+  SUBCASE("inputs and output") {
+    auto const input{ std::filesystem::temp_directory_path() };
+    std::vector<std::string> args{
+      "envy", "train-dict", input.string(), "-o", "out.zdict", "--size", "65536"
+    };
+    auto argv{ make_argv(args) };
+
+    auto parsed{ envy::cli_parse(static_cast<int>(args.size()), argv.data()) };
+
+    REQUIRE(parsed.cmd_cfg.has_value());
+    auto const *cfg{ std::get_if<envy::cmd_train_dict::cfg>(&*parsed.cmd_cfg) };
+    REQUIRE(cfg != nullptr);
+    REQUIRE(cfg->inputs.size() == 1);
+    CHECK(cfg->inputs[0] == input);
+    CHECK(cfg->output == "out.zdict");
+    REQUIRE(cfg->size.has_value());
+    CHECK(*cfg->size == 65536);
+  }
+
+  SUBCASE("output is required") {
+    auto const input{ std::filesystem::temp_directory_path() };
+    std::vector<std::string> args{ "envy", "train-dict", input.string() };
+    auto argv{ make_argv(args) };
+
+    auto parsed{ envy::cli_parse(static_cast<int>(args.size()), argv.data()) };
+
+    CHECK_FALSE(parsed.cmd_cfg.has_value());
+  }
 }
 
 TEST_CASE("cli_parse: cmd_import") {
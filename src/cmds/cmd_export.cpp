@@ -1,5 +1,6 @@
 #include "cmd_export.h"
 
+#include "depot_dict.h"
 #include "engine.h"
 #include "manifest.h"
 #include "pkg.h"
@@ -31,6 +32,22 @@ void cmd_export::register_cli(CLI::App &app, std::function<void(cfg)> on_selecte
   sub->add_option("--depot-prefix",
                   cfg_ptr->depot_prefix,
                   "URL prefix for depot manifest output");
+  sub->add_flag("--dedupe-content",
+                cfg_ptr->dedupe_content,
+                "Store files with identical content as hardlinks in the archive");
+  auto *chunked_flag{ sub->add_flag(
+      "--chunked",
+      cfg_ptr->chunked,
+      "Write a content-defined chunk index and chunks/ instead of .tar.zst") };
+  sub->add_option("--delta-from",
+                  cfg_ptr->delta_from,
+                  "Also write .delta artifacts against earlier .tar.zst exports in DIR")
+      ->check(CLI::ExistingDirectory);
+  sub->add_option("--dict",
+                  cfg_ptr->dict,
+                  "Compress .tar.zst archives with a dictionary from 'envy train-dict'")
+      ->check(CLI::ExistingFile)
+      ->excludes(chunked_flag);
   sub->add_flag("--ignore-depot",
                 cfg_ptr->ignore_depot,
                 "Ignore package depot; rebuild from source")
@@ -100,6 +117,17 @@ void cmd_export::execute() {
     }
   }
 
+  // Publish the dictionary beside the archives, where importers look for it.
+  std::vector<unsigned char> dictionary;
+  if (cfg_.dict) {
+    dictionary = depot_dict_load(*cfg_.dict);
+    auto const dicts_dir{ output_dir / "dicts" };
+    std::filesystem::create_directories(dicts_dir);
+    std::filesystem::copy_file(*cfg_.dict,
+                               dicts_dir / depot_dict_filename(depot_dict_id(dictionary)),
+                               std::filesystem::copy_options::overwrite_existing);
+  }
+
   engine eng{ *c, m.get() };
   if (cfg_.ignore_depot) { eng.set_ignore_depot(true); }
 
@@ -108,6 +136,10 @@ void cmd_export::execute() {
       .output_dir = output_dir,
       .depot_prefix = cfg_.depot_prefix,
       .explicitly_requested = !cfg_.queries.empty(),
+      .dedupe_content = cfg_.dedupe_content,
+      .chunked = cfg_.chunked,
+      .delta_from = cfg_.delta_from,
+      .zstd_dictionary = std::move(dictionary),
       .export_targets =
           [&] {
             std::unordered_set<pkg_key> s;
@@ -20,6 +20,10 @@ class cmd_export : public cmd {
     std::optional<std::filesystem::path> manifest_path;
     std::optional<std::string> depot_prefix;
     bool ignore_depot = false;
+    bool dedupe_content = false;
+    bool chunked = false;
+    std::optional<std::filesystem::path> delta_from;
+    std::optional<std::filesystem::path> dict;
   };
 
   static void register_cli(CLI::App &app, std::function<void(cfg)> on_selected);
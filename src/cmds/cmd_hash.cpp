@@ -1,6 +1,6 @@
 #include "cmd_hash.h"
 
-#include "sha256.h"
+#include "file_hash.h"
 #include "tui.h"
 #include "util.h"
 
@@ -14,26 +14,43 @@ namespace envy {
 
 namespace {
 
-void hash_one_file(std::filesystem::path const &file,
+struct hash_target {
+  std::filesystem::path path;
+  std::string name;  // As printed: filename, or path relative to a directory argument
+};
+
+void print_digests(file_digests const &d,
+                   std::string const &name,
                    std::optional<std::string> const &prefix) {
-  auto const hash{ sha256(file) };
-  auto const hex{ util_bytes_to_hex(hash.data(), hash.size()) };
-  auto const name{ file.filename().string() };
+  auto const &digest{ d.sha256 ? *d.sha256 : *d.blake3 };
+  auto const hex{ util_bytes_to_hex(digest.data(), digest.size()) };
+  std::string const url{ prefix.value_or("") + name };
 
-  if (prefix) {
-    tui::print_stdout("%s  %s%s\n", hex.c_str(), prefix->c_str(), name.c_str());
+  // With both, BLAKE3 rides along as a depot manifest attribute.
+  if (d.sha256 && d.blake3) {
+    auto const b3{ util_bytes_to_hex(d.blake3->data(), d.blake3->size()) };
+    tui::print_stdout("%s  %s  blake3=%s\n", hex.c_str(), url.c_str(), b3.c_str());
   } else {
-    tui::print_stdout("%s  %s\n", hex.c_str(), name.c_str());
+    tui::print_stdout("%s  %s\n", hex.c_str(), url.c_str());
   }
 }
 
 }  // namespace
 
 void cmd_hash::register_cli(CLI::App &app, std::function<void(cfg)> on_selected) {
-  auto *sub{ app.add_subcommand("hash", "Compute SHA256 hash of files") };
+  auto *sub{ app.add_subcommand("hash", "Compute SHA256 and/or BLAKE3 hashes of files") };
   auto cfg_ptr{ std::make_shared<cfg>() };
   sub->add_option("paths", cfg_ptr->paths, "Files and/or directories to hash")->required();
   sub->add_option("--prefix", cfg_ptr->prefix, "URL prefix for output lines");
+  sub->add_option("-a,--algorithm",
+                  cfg_ptr->algorithm,
+                  "sha256 (default), blake3, or both")
+      ->check(CLI::IsMember({ "sha256", "blake3", "both" }));
+  sub->add_flag("-r,--recursive", cfg_ptr->recursive, "Walk directories recursively");
+  sub->add_option("--include",
+                  cfg_ptr->include,
+                  "Glob for files in directories (repeatable; default *.tar.zst)");
+  sub->add_option("-j,--jobs", cfg_ptr->jobs, "Hashing threads (default: CPU count)");
   sub->callback(
       [cfg_ptr, on_selected = std::move(on_selected)] { on_selected(*cfg_ptr); });
 }
@@ -49,24 +66,40 @@ void cmd_hash::execute() {
     throw std::runtime_error("hash: at least one path is required");
   }
 
+  file_hash_walk_options const walk{
+    .recursive = cfg_.recursive,
+    .include = cfg_.include.empty() ? std::vector<std::string>{ "*.tar.zst" }
+                                    : cfg_.include,
+  };
+
+  // Collect everything first so output follows argument and path order while the
+  // hashing itself runs in parallel.
+  std::vector<hash_target> targets;
   for (auto const &path : cfg_.paths) {
     if (!fs::exists(path)) {
       throw std::runtime_error("hash: path does not exist: " + path.string());
     }
 
     if (fs::is_directory(path)) {
-      for (auto const &e : fs::directory_iterator(path)) {
-        if (!e.is_regular_file()) { continue; }
-        auto const &p{ e.path() };
-        if (p.extension() != ".zst") { continue; }
-        auto stem_path{ p.stem() };
-        if (stem_path.extension() != ".tar") { continue; }
-        hash_one_file(p, cfg_.prefix);
+      for (auto const &rel : file_hash_walk(path, walk)) {
+        targets.push_back({ .path = path / rel, .name = rel.generic_string() });
       }
     } else {
-      hash_one_file(path, cfg_.prefix);
+      targets.push_back({ .path = path, .name = path.filename().string() });
     }
   }
+
+  std::vector<fs::path> files;
+  files.reserve(targets.size());
+  for (auto const &t : targets) { files.push_back(t.path); }
+
+  auto const digests{ file_hash_all(files,
+                                    { .sha256 = cfg_.algorithm != "blake3",
+                                      .blake3 = cfg_.algorithm != "sha256" },
+                                    cfg_.jobs) };
+  for (std::size_t i{ 0 }; i < targets.size(); ++i) {
+    print_digests(digests[i], targets[i].name, cfg_.prefix);
+  }
 }
 
 }  // namespace envy
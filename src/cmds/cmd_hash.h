@@ -2,6 +2,7 @@
 
 #include "cmd.h"
 
+#include <cstddef>
 #include <filesystem>
 #include <functional>
 #include <optional>
@@ -17,6 +18,10 @@ class cmd_hash : public cmd {
   struct cfg : cmd_cfg<cmd_hash> {
     std::vector<std::filesystem::path> paths;
     std::optional<std::string> prefix;
+    std::string algorithm{ "sha256" };  // sha256, blake3, or both
+    bool recursive{ false };
+    std::vector<std::string> include;  // Directory filters; default *.tar.zst
+    std::size_t jobs{ 0 };             // 0 = hardware concurrency
   };
 
   static void register_cli(CLI::App &app, std::function<void(cfg)> on_selected);
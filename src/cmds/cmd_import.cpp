@@ -1,6 +1,7 @@
 #include "cmd_import.h"
 
 #include "cache.h"
+#include "depot_dict.h"
 #include "engine.h"
 #include "extract.h"
 #include "manifest.h"
@@ -13,6 +14,7 @@
 
 #include "CLI11.hpp"
 
+#include <algorithm>
 #include <cctype>
 #include <chrono>
 #include <filesystem>
@@ -93,7 +95,7 @@ import_result import_one_archive(cache &c,
                                 .start_time = std::chrono::steady_clock::now() } });
   }
 
-  extract_options opts;
+  extract_options opts{ .clone_hardlinks = true };
   if (section) {
     opts.progress = [&](extract_progress const &ep) -> bool {
       double percent{ 0.0 };
@@ -115,6 +117,14 @@ import_result import_one_archive(cache &c,
       return true;
     };
   }
+  // A dictionary-compressed export reads its dictionary from the dicts/ beside it.
+  std::vector<unsigned char> dictionary;
+  if (auto const dict_id{ depot_dict_id_of_archive(archive_path) }) {
+    dictionary = depot_dict_load(
+        archive_path.parent_path() / "dicts" / depot_dict_filename(*dict_id),
+        dict_id);
+  }
+  opts.zstd_dictionary = dictionary;
   extract(archive_path, result.entry_path, opts);
 
   if (directory_has_entries(result.lock->install_dir())) {
@@ -182,6 +192,7 @@ std::vector<depot_entry> parse_checksums_file(std::filesystem::path const &path)
       c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
     }
     std::string url{ line.substr(66) };
+    url.resize(std::min(url.size(), url.find("  ")));  // Drop trailing attributes
 
     entries.push_back(depot_entry{ std::move(url), std::move(hash) });
   }
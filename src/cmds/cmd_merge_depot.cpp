@@ -57,7 +57,15 @@ std::vector<depot_manifest_entry> parse_manifest_lines(std::istream &in) {
       c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
     }
 
-    entries.push_back(depot_manifest_entry{ std::move(hash), line.substr(66) });
+    // Attributes after the path (e.g. "dict=<id>") travel with it verbatim.
+    std::string path{ line.substr(66) };
+    std::string attrs;
+    if (auto const pos{ path.find("  ") }; pos != std::string::npos) {
+      attrs = path.substr(pos + 2);
+      path.resize(pos);
+    }
+    entries.push_back(
+        depot_manifest_entry{ std::move(hash), std::move(path), std::move(attrs) });
   }
   return entries;
 }
@@ -175,6 +183,7 @@ cmd_merge_depot::cmd_merge_depot(
 void cmd_merge_depot::execute() {
   std::map<std::string, std::string> merged;  // path -> hash, sorted
   std::map<std::string, std::string> existing_hashes;
+  std::map<std::string, std::string> attrs;  // path -> trailing attributes, if any
 
   if (cfg_.existing_path) {
     std::vector<depot_manifest_entry> existing_entries;
@@ -215,6 +224,7 @@ void cmd_merge_depot::execute() {
 
     for (auto &e : existing_entries) {
       if (auto [it, inserted]{ merged.emplace(e.path, e.hash) }; inserted) {
+        if (!e.attrs.empty()) { attrs.emplace(e.path, std::move(e.attrs)); }
         existing_hashes.emplace(std::move(e.path), std::move(e.hash));
       } else {
         tui::warn("merge-depot: duplicate path in existing manifest: %s", e.path.c_str());
@@ -244,6 +254,11 @@ void cmd_merge_depot::execute() {
       }
 
       new_paths.insert(e.path);
+      if (e.attrs.empty()) {
+        attrs.erase(e.path);
+      } else {
+        attrs.insert_or_assign(e.path, std::move(e.attrs));
+      }
       merged.insert_or_assign(std::move(e.path), std::move(e.hash));
     }
   }
@@ -317,7 +332,11 @@ void cmd_merge_depot::execute() {
     }
   }
   for (auto const &[path, hash] : merged) {
-    tui::print_stdout("%s  %s\n", hash.c_str(), path.c_str());
+    if (auto const it{ attrs.find(path) }; it != attrs.end()) {
+      tui::print_stdout("%s  %s  %s\n", hash.c_str(), path.c_str(), it->second.c_str());
+    } else {
+      tui::print_stdout("%s  %s\n", hash.c_str(), path.c_str());
+    }
   }
 }
 
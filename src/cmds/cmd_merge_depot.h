@@ -17,6 +17,7 @@ namespace envy {
 struct depot_manifest_entry {
   std::string hash;  // lowercase 64-char hex
   std::string path;
+  std::string attrs;  // Trailing "key=value" fields after the path, verbatim; may be empty
 };
 
 std::vector<depot_manifest_entry> parse_depot_manifest(std::filesystem::path const &file);
@@ -70,6 +70,16 @@ TEST_CASE("parse_depot_manifest: preserves url paths with depot prefix") {
   CHECK(entries[0].path == "https://cdn.example.com/depot/pkg@v1-darwin-arm64.tar.zst");
 }
 
+TEST_CASE("parse_depot_manifest: splits trailing attributes from path") {
+  auto entries{ envy::parse_depot_manifest(std::string(kFixtureDir) + "/attributes.txt") };
+
+  REQUIRE(entries.size() == 2);
+  CHECK(entries[0].path == "pkg-darwin-arm64.tar.zst");
+  CHECK(entries[0].attrs == "dict=305419896");
+  CHECK(entries[1].path == "pkg-linux-x86_64.tar.zst");
+  CHECK(entries[1].attrs.empty());
+}
+
 TEST_CASE("parse_s3_ls_lines: extracts keys from standard output") {
   auto input{ std::istringstream{
       "2024-01-15 12:34:56       1234 pkg-darwin-arm64.tar.zst\n"
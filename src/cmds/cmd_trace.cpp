@@ -0,0 +1,71 @@
+#include "cmd_trace.h"
+
+#include "trace.h"
+#include "trace_analyze.h"
+#include "trace_chrome.h"
+#include "tui.h"
+#include "util.h"
+
+#include "CLI11.hpp"
+
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace envy {
+
+void cmd_trace::register_cli(CLI::App &app, std::function<void(cfg)> on_selected) {
+  auto *sub{ app.add_subcommand("trace", "Inspect and convert recorded JSONL traces") };
+  sub->require_subcommand(1);
+
+  auto *exp{ sub->add_subcommand(
+      "export",
+      "Convert a JSONL trace into a Chrome/Perfetto timeline (Trace Event JSON)") };
+  auto cfg_ptr{ std::make_shared<cfg>() };
+  exp->add_option("input", cfg_ptr->input, "JSONL trace (--trace=file:<path>)")
+      ->required();
+  exp->add_option("output", cfg_ptr->output, "Timeline JSON to write")->required();
+  exp->callback([cfg_ptr, on_selected] {
+    cfg_ptr->act = cfg::action::export_chrome;
+    on_selected(*cfg_ptr);
+  });
+
+  auto *analyze{ sub->add_subcommand(
+      "analyze",
+      "Report the critical path, per-package slack and what would shorten the run") };
+  analyze->add_option("input", cfg_ptr->input, "JSONL trace (--trace=file:<path>)")
+      ->required();
+  analyze->add_option("--top", cfg_ptr->top, "Opportunities to list (default 5)");
+  analyze->callback([cfg_ptr, on_selected] {
+    cfg_ptr->act = cfg::action::analyze;
+    on_selected(*cfg_ptr);
+  });
+}
+
+cmd_trace::cmd_trace(cmd_trace::cfg cfg,
+                     std::optional<std::filesystem::path> const & /*cli_cache_root*/)
+    : cfg_{ std::move(cfg) } {}
+
+void cmd_trace::execute() {
+  auto const records{ trace_read_jsonl(cfg_.input) };
+  if (cfg_.act == cfg::action::analyze) {
+    tui::print_stdout("%s",
+                      trace_analysis_format(trace_analyze(records), cfg_.top).c_str());
+    return;
+  }
+
+  trace_chrome_exporter exporter;
+  for (auto const &rec : records) { exporter.add(rec); }
+  auto const json{ exporter.finish() };
+
+  auto const file{ util_open_file(cfg_.output, "wb") };
+  if (!file || std::fwrite(json.data(), 1, json.size(), file.get()) != json.size()) {
+    throw std::runtime_error("trace export: failed to write " + cfg_.output.string());
+  }
+  tui::info("Wrote %zu trace records to %s",
+            records.size(),
+            cfg_.output.string().c_str());
+}
+
+}  // namespace envy
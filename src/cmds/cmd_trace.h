@@ -0,0 +1,36 @@
+#pragma once
+
+#include "cmd.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <optional>
+
+namespace CLI { class App; }
+
+namespace envy {
+
+// Offline tools for JSONL traces written with --trace=file:<path>.
+class cmd_trace : public cmd {
+ public:
+  struct cfg : cmd_cfg<cmd_trace> {
+    enum class action { export_chrome, analyze };
+
+    action act{ action::export_chrome };
+    std::filesystem::path input;   // JSONL trace
+    std::filesystem::path output;  // export: Chrome Trace Event JSON
+    std::size_t top{ 5 };          // analyze: opportunities to list
+  };
+
+  static void register_cli(CLI::App &app, std::function<void(cfg)> on_selected);
+
+  cmd_trace(cfg cfg, std::optional<std::filesystem::path> const &cli_cache_root);
+
+  void execute() override;
+
+ private:
+  cfg cfg_;
+};
+
+}  // namespace envy
@@ -0,0 +1,59 @@
+#include "cmd_train_dict.h"
+
+#include "depot_dict.h"
+#include "tui.h"
+#include "util.h"
+
+#include "CLI11.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+namespace envy {
+
+void cmd_train_dict::register_cli(CLI::App &app, std::function<void(cfg)> on_selected) {
+  auto *sub{ app.add_subcommand(
+      "train-dict",
+      "Train a zstd dictionary for 'envy export --dict' from sample trees") };
+  auto cfg_ptr{ std::make_shared<cfg>() };
+  sub->add_option("inputs",
+                  cfg_ptr->inputs,
+                  "Package trees and/or exported .tar.zst archives to sample")
+      ->required()
+      ->check(CLI::ExistingPath);
+  sub->add_option("-o,--output", cfg_ptr->output, "Dictionary file to write")->required();
+  sub->add_option("--size", cfg_ptr->size, "Dictionary size in bytes (default 112 KiB)")
+      ->check(CLI::Range(std::size_t{ 1024 }, std::size_t{ 16 * 1024 * 1024 }));
+  sub->callback(
+      [cfg_ptr, on_selected = std::move(on_selected)] { on_selected(*cfg_ptr); });
+}
+
+cmd_train_dict::cmd_train_dict(
+    cmd_train_dict::cfg cfg,
+    std::optional<std::filesystem::path> const & /*cli_cache_root*/)
+    : cfg_{ std::move(cfg) } {}
+
+void cmd_train_dict::execute() {
+  depot_dict_train_options options;
+  if (cfg_.size) { options.dict_size = *cfg_.size; }
+
+  auto const dict{ depot_dict_train(cfg_.inputs, options) };
+  auto const id{ depot_dict_id(dict) };
+
+  if (cfg_.output.has_parent_path()) {
+    std::filesystem::create_directories(cfg_.output.parent_path());
+  }
+  std::ofstream out{ cfg_.output, std::ios::binary };
+  out.write(reinterpret_cast<char const *>(dict.data()),
+            static_cast<std::streamsize>(dict.size()));
+  if (!out.flush()) {
+    throw std::runtime_error("train-dict: failed to write " + cfg_.output.string());
+  }
+
+  tui::info("train-dict: %s dictionary", util_format_bytes(dict.size()).c_str());
+  tui::print_stdout("%u  %s\n", static_cast<unsigned>(id), cfg_.output.string().c_str());
+}
+
+}  // namespace envy
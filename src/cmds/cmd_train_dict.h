@@ -0,0 +1,33 @@
+#pragma once
+
+#include "cmd.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <vector>
+
+namespace CLI { class App; }
+
+namespace envy {
+
+class cmd_train_dict : public cmd {
+ public:
+  struct cfg : cmd_cfg<cmd_train_dict> {
+    std::vector<std::filesystem::path> inputs;  // Directories and/or exported archives
+    std::filesystem::path output;
+    std::optional<std::size_t> size;  // Dictionary size in bytes
+  };
+
+  static void register_cli(CLI::App &app, std::function<void(cfg)> on_selected);
+
+  cmd_train_dict(cfg cfg, std::optional<std::filesystem::path> const &cli_cache_root);
+
+  void execute() override;
+
+ private:
+  cfg cfg_;
+};
+
+}  // namespace envy
@@ -0,0 +1,342 @@
+#include "depot_chunks.h"
+
+#include "platform.h"
+#include "util.h"
+
+#include "zstd.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace envy {
+
+namespace {
+
+// splitmix64 over a fixed seed; any change here re-chunks every published artifact.
+constexpr std::array<std::uint64_t, 256> make_gear_table() {
+  std::array<std::uint64_t, 256> table{};
+  std::uint64_t state{ 0x656e76792d636463ull };  // "envy-cdc"
+  for (auto &v : table) {
+    state += 0x9e3779b97f4a7c15ull;
+    std::uint64_t z{ state };
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    v = z ^ (z >> 31);
+  }
+  return table;
+}
+
+constexpr auto kGear{ make_gear_table() };
+
+constexpr std::string_view kIndexHeader{ "envy-chunks 1" };
+
+// The gear hash shifts left once per byte, so its high bits summarize the longest
+// window; masks select from the top.
+constexpr std::uint64_t top_bits(unsigned n) { return ~std::uint64_t{ 0 } << (64 - n); }
+
+void validate_params(cdc_params const &p) {
+  if (!std::has_single_bit(p.avg_size) || p.avg_size < 256 || p.min_size == 0 ||
+      p.min_size >= p.avg_size || p.max_size <= p.avg_size) {
+    throw std::runtime_error("cdc: invalid chunk size parameters");
+  }
+}
+
+std::string blake3_hex(blake3_t const &hash) {
+  return util_bytes_to_hex(hash.data(), hash.size());
+}
+
+blake3_t parse_blake3_hex(std::string const &hex) {
+  if (hex.size() != 64) { throw std::runtime_error("chunk index: bad hash: " + hex); }
+  auto const bytes{ util_hex_to_bytes(hex) };
+  blake3_t hash{};
+  std::ranges::copy(bytes, hash.begin());
+  return hash;
+}
+
+// Unique sibling temp path, so concurrent writers of the same chunk never share one.
+std::filesystem::path temp_path_for(std::filesystem::path const &path) {
+  static std::atomic<std::uint64_t> counter{ 0 };
+  return path.parent_path() / (".envy-tmp-" + std::to_string(platform::get_process_id()) +
+                               "-" + std::to_string(counter++) + "-" +
+                               path.filename().string());
+}
+
+void write_file_atomically(std::filesystem::path const &path,
+                           void const *data,
+                           std::size_t size) {
+  auto const tmp{ temp_path_for(path) };
+  {
+    auto const file{ util_open_file(tmp, "wb") };
+    if (!file || std::fwrite(data, 1, size, file.get()) != size ||
+        std::fflush(file.get()) != 0) {
+      std::error_code ec;
+      std::filesystem::remove(tmp, ec);
+      throw std::runtime_error("chunk store: failed to write " + tmp.string());
+    }
+  }
+  try {
+    platform::atomic_rename(tmp, path);
+  } catch (...) {
+    std::error_code ec;
+    std::filesystem::remove(tmp, ec);
+    throw;
+  }
+}
+
+// Decompress one chunk frame and check it against ref. The output buffer is exactly
+// ref.size bytes, so a hostile frame cannot inflate past it.
+std::vector<unsigned char> decompress_chunk(depot_chunk_ref const &ref,
+                                            unsigned char const *data,
+                                            std::size_t size) {
+  std::vector<unsigned char> out(static_cast<std::size_t>(ref.size));
+  std::size_t const n{ ZSTD_decompress(out.data(), out.size(), data, size) };
+  if (ZSTD_isError(n)) {
+    throw std::runtime_error("chunk " + blake3_hex(ref.hash) +
+                             ": decompression failed: " + ZSTD_getErrorName(n));
+  }
+  if (n != out.size() || blake3_hash(out.data(), out.size()) != ref.hash) {
+    throw std::runtime_error("chunk " + blake3_hex(ref.hash) + ": content mismatch");
+  }
+  return out;
+}
+
+}  // namespace
+
+std::size_t cdc_cut_point(unsigned char const *data,
+                          std::size_t size,
+                          cdc_params const &params) {
+  if (size <= params.min_size) { return size; }
+
+  std::size_t const limit{ std::min(size, params.max_size) };
+  std::size_t const normal{ std::min(limit, params.avg_size) };
+
+  // Normalized chunking: a stricter mask below the average size and a looser one above
+  // it pull chunk sizes toward avg_size.
+  auto const bits{ static_cast<unsigned>(std::countr_zero(params.avg_size)) };
+  std::uint64_t const mask_small{ top_bits(bits + 2) };
+  std::uint64_t const mask_large{ top_bits(bits - 2) };
+
+  // Bytes before min_size can never end a chunk, so they are not hashed at all.
+  std::uint64_t fp{ 0 };
+  std::size_t i{ params.min_size };
+  for (; i < normal; ++i) {
+    fp = (fp << 1) + kGear[data[i]];
+    if (!(fp & mask_small)) { return i + 1; }
+  }
+  for (; i < limit; ++i) {
+    fp = (fp << 1) + kGear[data[i]];
+    if (!(fp & mask_large)) { return i + 1; }
+  }
+  return limit;
+}
+
+cdc_chunker::cdc_chunker(chunk_cb_t on_chunk, cdc_params params)
+    : on_chunk_{ std::move(on_chunk) }, params_{ params } {
+  validate_params(params_);
+}
+
+void cdc_chunker::update(void const *data, std::size_t size) {
+  auto const *bytes{ static_cast<unsigned char const *>(data) };
+  buf_.insert(buf_.end(), bytes, bytes + size);
+
+  // Batch cutting so the compaction below moves less than max_size bytes per several
+  // max_size of input. With at least max_size bytes in hand a cut point is final.
+  if (buf_.size() - pos_ < 4 * params_.max_size) { return; }
+  emit_while(params_.max_size);
+  buf_.erase(buf_.begin(), buf_.begin() + static_cast<std::ptrdiff_t>(pos_));
+  pos_ = 0;
+}
+
+void cdc_chunker::finish() {
+  emit_while(1);
+  buf_.clear();
+  pos_ = 0;
+}
+
+void cdc_chunker::emit_while(std::size_t keep) {
+  while (buf_.size() - pos_ >= keep) {
+    std::size_t const len{
+      cdc_cut_point(buf_.data() + pos_, buf_.size() - pos_, params_)
+    };
+    on_chunk_(buf_.data() + pos_, len);
+    pos_ += len;
+  }
+}
+
+std::string depot_chunk_index_serialize(depot_chunk_index const &index) {
+  std::ostringstream out;
+  out << kIndexHeader << "\n";
+  out << "archive " << blake3_hex(index.archive_blake3) << " " << index.archive_size
+      << "\n";
+  for (auto const &c : index.chunks) {
+    out << "chunk " << blake3_hex(c.hash) << " " << c.size << "\n";
+  }
+  return out.str();
+}
+
+depot_chunk_index depot_chunk_index_parse(std::string_view text) {
+  std::istringstream stream{ std::string{ text } };
+  std::string line;
+
+  if (!std::getline(stream, line)) { throw std::runtime_error("chunk index: empty"); }
+  if (!line.empty() && line.back() == '\r') { line.pop_back(); }
+  if (line != kIndexHeader) {
+    throw std::runtime_error("chunk index: unsupported header: " + line);
+  }
+
+  depot_chunk_index index;
+  bool have_archive{ false };
+  std::uint64_t chunk_total{ 0 };
+
+  while (std::getline(stream, line)) {
+    if (!line.empty() && line.back() == '\r') { line.pop_back(); }
+    if (line.empty() || line[0] == '#') { continue; }
+
+    std::istringstream fields{ line };
+    std::string kind;
+    std::string hex;
+    std::uint64_t size{ 0 };
+    std::string extra;
+    if (!(fields >> kind >> hex >> size) || (fields >> extra)) {
+      throw std::runtime_error("chunk index: malformed line: " + line);
+    }
+
+    if (kind == "archive" && !have_archive) {
+      index.archive_blake3 = parse_blake3_hex(hex);
+      index.archive_size = size;
+      have_archive = true;
+    } else if (kind == "chunk" && size > 0) {
+      index.chunks.push_back({ .hash = parse_blake3_hex(hex), .size = size });
+      chunk_total += size;
+    } else {
+      throw std::runtime_error("chunk index: unexpected line: " + line);
+    }
+  }
+
+  if (!have_archive) { throw std::runtime_error("chunk index: missing archive line"); }
+  if (chunk_total != index.archive_size) {
+    throw std::runtime_error("chunk index: chunk sizes do not sum to archive size");
+  }
+  return index;
+}
+
+depot_chunk_store::depot_chunk_store(std::filesystem::path root)
+    : root_{ std::move(root) } {}
+
+std::filesystem::path const &depot_chunk_store::root() const { return root_; }
+
+std::filesystem::path depot_chunk_store::chunk_path(blake3_t const &hash) const {
+  return root_ / (blake3_hex(hash) + ".zst");
+}
+
+bool depot_chunk_store::contains(blake3_t const &hash) const {
+  return platform::file_exists(chunk_path(hash));
+}
+
+bool depot_chunk_store::put(blake3_t const &hash, void const *data, std::size_t size) {
+  if (contains(hash)) { return false; }
+
+  std::vector<unsigned char> compressed(ZSTD_compressBound(size));
+  std::size_t const n{
+    ZSTD_compress(compressed.data(), compressed.size(), data, size, ZSTD_CLEVEL_DEFAULT)
+  };
+  if (ZSTD_isError(n)) {
+    throw std::runtime_error("chunk " + blake3_hex(hash) +
+                             ": compression failed: " + ZSTD_getErrorName(n));
+  }
+
+  std::filesystem::create_directories(root_);
+  write_file_atomically(chunk_path(hash), compressed.data(), n);
+  return true;
+}
+
+void depot_chunk_store::put_compressed(depot_chunk_ref const &ref,
+                                       std::filesystem::path const &source) {
+  auto const compressed{ util_load_file(source) };
+  decompress_chunk(ref, compressed.data(), compressed.size());
+
+  std::filesystem::create_directories(root_);
+  write_file_atomically(chunk_path(ref.hash), compressed.data(), compressed.size());
+}
+
+std::vector<unsigned char> depot_chunk_store::read(depot_chunk_ref const &ref) const {
+  auto const compressed{ util_load_file(chunk_path(ref.hash)) };
+  return decompress_chunk(ref, compressed.data(), compressed.size());
+}
+
+depot_chunked_export_result depot_export_chunked(
+    std::filesystem::path const &index_path,
+    std::filesystem::path const &source_dir,
+    std::string const &prefix,
+    archive_create_options const &options) {
+  depot_chunk_store store{ index_path.parent_path() / "chunks" };
+  depot_chunked_export_result result{};
+  depot_chunk_index index;
+
+  cdc_chunker chunker{ [&](unsigned char const *data, std::size_t size) {
+    auto const hash{ blake3_hash(data, size) };
+    index.chunks.push_back({ .hash = hash, .size = size });
+    index.archive_size += size;
+    if (store.put(hash, data, size)) {
+      ++result.new_chunks;
+      result.new_chunk_bytes += size;
+    }
+  } };
+
+  result.archive = archive_create_tar(
+      [&](void const *data, std::size_t size) { chunker.update(data, size); },
+      source_dir,
+      prefix,
+      options);
+  chunker.finish();
+
+  index.archive_blake3 = result.archive.blake3;
+  result.chunks = index.chunks.size();
+  util_write_file(index_path, depot_chunk_index_serialize(index));
+  return result;
+}
+
+void depot_reassemble_chunks(depot_chunk_index const &index,
+                             depot_chunk_store const &store,
+                             std::filesystem::path const &output_path) {
+  auto const file{ util_open_file(output_path, "wb") };
+  if (!file) {
+    throw std::runtime_error("Failed to open output: " + output_path.string());
+  }
+
+  blake3_hasher hasher;
+  std::uint64_t written{ 0 };
+  for (auto const &ref : index.chunks) {
+    auto const data{ store.read(ref) };
+    if (std::fwrite(data.data(), 1, data.size(), file.get()) != data.size()) {
+      throw std::runtime_error("write failed: " + output_path.string());
+    }
+    hasher.update(data.data(), data.size());
+    written += data.size();
+  }
+
+  if (std::fflush(file.get()) != 0) {
+    throw std::runtime_error("flush failed: " + output_path.string());
+  }
+  if (written != index.archive_size || hasher.finalize() != index.archive_blake3) {
+    throw std::runtime_error("reassembled archive does not match chunk index");
+  }
+}
+
+std::string depot_chunk_url(std::string_view index_url, blake3_t const &hash) {
+  auto const sep{ index_url.find_last_of("/\\") };
+  std::string url{ sep == std::string_view::npos ? std::string_view{}
+                                                 : index_url.substr(0, sep + 1) };
+  url += "chunks/";
+  url += blake3_hex(hash);
+  url += ".zst";
+  return url;
+}
+
+}  // namespace envy
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "blake3_util.h"
+#include "extract.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace envy {
+
+// Chunked depot artifacts. Instead of one monolithic .tar.zst, a package is published as
+// a small text index (<stem>.chunks) naming the content-defined chunks of its
+// uncompressed tar stream, plus one zstd-compressed file per chunk under chunks/ next to
+// the index. Chunk boundaries follow content (FastCDC), so an edit to one file only
+// changes the chunks that cover it; importing version N+1 after version N downloads just
+// those. Chunks are addressed by the BLAKE3 of their uncompressed bytes.
+
+// Chunk size bounds in bytes; avg_size must be a power of two. The gear table and mask
+// derivation are part of the format: changing them changes every chunk boundary.
+struct cdc_params {
+  std::size_t min_size{ 16 * 1024 };
+  std::size_t avg_size{ 64 * 1024 };
+  std::size_t max_size{ 256 * 1024 };
+};
+
+// Length of the first chunk of data[0, size): a FastCDC cut point with normalized
+// chunking, or min(size, max_size) when no cut point is found.
+std::size_t cdc_cut_point(unsigned char const *data,
+                          std::size_t size,
+                          cdc_params const &params = {});
+
+// Streaming chunker: feed bytes with update(), then finish() to flush the tail. The
+// callback sees each chunk exactly once, in stream order.
+class cdc_chunker : unmovable {
+ public:
+  using chunk_cb_t = std::function<void(unsigned char const *data, std::size_t size)>;
+
+  explicit cdc_chunker(chunk_cb_t on_chunk, cdc_params params = {});
+
+  void update(void const *data, std::size_t size);
+  void finish();
+
+ private:
+  void emit_while(std::size_t keep);
+
+  chunk_cb_t on_chunk_;
+  cdc_params params_;
+  std::vector<unsigned char> buf_;
+  std::size_t pos_{ 0 };  // Start of unchunked bytes in buf_
+};
+
+struct depot_chunk_ref {
+  blake3_t hash{};
+  std::uint64_t size{ 0 };  // Uncompressed bytes
+};
+
+struct depot_chunk_index {
+  blake3_t archive_blake3{};  // BLAKE3 of the reassembled tar stream
+  std::uint64_t archive_size{ 0 };
+  std::vector<depot_chunk_ref> chunks;
+};
+
+// Index text format:
+//   envy-chunks 1
+//   archive <64hex blake3> <size>
+//   chunk <64hex blake3> <size>      (one line per chunk, in stream order)
+std::string depot_chunk_index_serialize(depot_chunk_index const &index);
+
+// Throws std::runtime_error on a bad header, malformed line, or chunk sizes that do not
+// sum to the archive size.
+depot_chunk_index depot_chunk_index_parse(std::string_view text);
+
+// Flat directory of <64hex>.zst files. The same layout serves as the export output
+// (<output_dir>/chunks) and the local store under the cache root (<cache>/chunks).
+// Writers publish via rename, so concurrent producers of one chunk are harmless.
+class depot_chunk_store {
+ public:
+  explicit depot_chunk_store(std::filesystem::path root);
+
+  std::filesystem::path const &root() const;
+  std::filesystem::path chunk_path(blake3_t const &hash) const;
+  bool contains(blake3_t const &hash) const;
+
+  // Compress and publish raw chunk bytes unless already present. Returns true if written.
+  bool put(blake3_t const &hash, void const *data, std::size_t size);
+
+  // Publish a compressed chunk file (e.g. freshly downloaded) after verifying that it
+  // decompresses to ref.size bytes hashing to ref.hash. Throws on mismatch, publishing
+  // nothing; the source file is left in place.
+  void put_compressed(depot_chunk_ref const &ref, std::filesystem::path const &source);
+
+  // Decompress a stored chunk, verifying size and BLAKE3. Throws if missing or corrupt.
+  std::vector<unsigned char> read(depot_chunk_ref const &ref) const;
+
+ private:
+  std::filesystem::path root_;
+};
+
+struct depot_chunked_export_result {
+  archive_create_result archive;  // Digests cover the uncompressed tar stream
+  std::uint64_t chunks{ 0 };
+  std::uint64_t new_chunks{ 0 };  // Chunks not already present in the chunk store
+  std::uint64_t new_chunk_bytes{ 0 };
+};
+
+// Archive source_dir (as archive_create_tar), chunk the tar stream and write
+// index_path plus any missing chunks into the chunks/ directory beside it.
+depot_chunked_export_result depot_export_chunked(
+    std::filesystem::path const &index_path,
+    std::filesystem::path const &source_dir,
+    std::string const &prefix,
+    archive_create_options const &options = {});
+
+// Concatenate the chunks of index from store into output_path, verifying the archive
+// size and BLAKE3. Throws on a missing or corrupt chunk.
+void depot_reassemble_chunks(depot_chunk_index const &index,
+                             depot_chunk_store const &store,
+                             std::filesystem::path const &output_path);
+
+// URL (or path) of a chunk published beside the index at index_url.
+std::string depot_chunk_url(std::string_view index_url, blake3_t const &hash);
+
+}  // namespace envy
@@ -0,0 +1,221 @@
+#include "depot_chunks.h"
+
+#include "extract.h"
+#include "util.h"
+
+#include "doctest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::filesystem::path make_temp_dir() {
+  static std::mt19937_64 rng{ std::random_device{}() };
+  auto dir{ std::filesystem::temp_directory_path() /
+            ("envy-depot-chunks-test-" + std::to_string(rng())) };
+  std::filesystem::create_directories(dir);
+  return dir;
+}
+
+std::vector<unsigned char> random_bytes(std::size_t n, std::uint64_t seed) {
+  std::mt19937_64 rng{ seed };
+  std::vector<unsigned char> out(n);
+  for (auto &b : out) { b = static_cast<unsigned char>(rng()); }
+  return out;
+}
+
+std::vector<std::vector<unsigned char>> chunk_all(std::vector<unsigned char> const &data,
+                                                  std::size_t feed_size) {
+  std::vector<std::vector<unsigned char>> chunks;
+  envy::cdc_chunker chunker{ [&](unsigned char const *p, std::size_t n) {
+    chunks.emplace_back(p, p + n);
+  } };
+  for (std::size_t off{ 0 }; off < data.size(); off += feed_size) {
+    chunker.update(data.data() + off, std::min(feed_size, data.size() - off));
+  }
+  chunker.finish();
+  return chunks;
+}
+
+std::set<envy::blake3_t> chunk_hashes(std::vector<std::vector<unsigned char>> const &c) {
+  std::set<envy::blake3_t> hashes;
+  for (auto const &chunk : c) {
+    hashes.insert(envy::blake3_hash(chunk.data(), chunk.size()));
+  }
+  return hashes;
+}
+
+void write_file(std::filesystem::path const &path,
+                std::vector<unsigned char> const &data) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream out{ path, std::ios::binary };
+  out.write(reinterpret_cast<char const *>(data.data()),
+            static_cast<std::streamsize>(data.size()));
+}
+
+}  // namespace
+
+TEST_CASE("cdc_chunker respects size bounds and reproduces the input") {
+  auto const data{ random_bytes(3 * 1024 * 1024, 1) };
+  auto const chunks{ chunk_all(data, 10240) };
+
+  envy::cdc_params const params{};
+  std::vector<unsigned char> joined;
+  for (std::size_t i{ 0 }; i < chunks.size(); ++i) {
+    CHECK(chunks[i].size() <= params.max_size);
+    if (i + 1 < chunks.size()) { CHECK(chunks[i].size() >= params.min_size); }
+    joined.insert(joined.end(), chunks[i].begin(), chunks[i].end());
+  }
+  CHECK(joined == data);
+  CHECK(chunks.size() > 3 * 1024 * 1024 / params.max_size);
+}
+
+TEST_CASE("cdc_chunker boundaries do not depend on how input is fed") {
+  auto const data{ random_bytes(2 * 1024 * 1024, 2) };
+  auto const whole{ chunk_all(data, data.size()) };
+  CHECK(chunk_all(data, 1) == whole);
+  CHECK(chunk_all(data, 4096) == whole);
+  CHECK(chunk_all(data, 777) == chunk_all(data, 1024 * 1024));
+}
+
+TEST_CASE("cdc_chunker resynchronizes after a local edit") {
+  auto const base{ random_bytes(4 * 1024 * 1024, 3) };
+  auto edited{ base };
+  edited.insert(edited.begin() + 2 * 1024 * 1024, 100, 0x5a);  // Shifts all later bytes
+
+  auto const before{ chunk_hashes(chunk_all(base, 65536)) };
+  auto const after{ chunk_hashes(chunk_all(edited, 65536)) };
+
+  std::size_t shared{ 0 };
+  for (auto const &h : after) { shared += before.contains(h) ? 1 : 0; }
+  CHECK(after.size() - shared <= 3);  // Only chunks around the edit change
+}
+
+TEST_CASE("cdc_chunker rejects invalid parameters") {
+  auto const noop{ [](unsigned char const *, std::size_t) {} };
+  CHECK_THROWS(envy::cdc_chunker{ noop, { .min_size = 1024, .avg_size = 3000 } });
+  CHECK_THROWS(envy::cdc_chunker{
+      noop,
+      { .min_size = 8192, .avg_size = 4096, .max_size = 16384 } });
+}
+
+TEST_CASE("depot chunk index round-trips and validates") {
+  envy::depot_chunk_index index;
+  index.archive_blake3 = envy::blake3_hash("abc", 3);
+  index.chunks.push_back({ .hash = envy::blake3_hash("a", 1), .size = 10 });
+  index.chunks.push_back({ .hash = envy::blake3_hash("b", 1), .size = 32 });
+  index.archive_size = 42;
+
+  auto const text{ envy::depot_chunk_index_serialize(index) };
+  auto const parsed{ envy::depot_chunk_index_parse(text) };
+  CHECK(parsed.archive_blake3 == index.archive_blake3);
+  CHECK(parsed.archive_size == 42);
+  REQUIRE(parsed.chunks.size() == 2);
+  CHECK(parsed.chunks[1].hash == index.chunks[1].hash);
+  CHECK(parsed.chunks[1].size == 32);
+
+  CHECK_THROWS(envy::depot_chunk_index_parse("envy-chunks 2\n"));
+  CHECK_THROWS(envy::depot_chunk_index_parse(text + "chunk zz 1\n"));
+  index.archive_size = 43;
+  CHECK_THROWS(
+      envy::depot_chunk_index_parse(envy::depot_chunk_index_serialize(index)));
+}
+
+TEST_CASE("depot_chunk_store verifies chunk content") {
+  auto const root{ make_temp_dir() };
+  envy::depot_chunk_store store{ root / "chunks" };
+
+  auto const data{ random_bytes(5000, 4) };
+  envy::depot_chunk_ref const ref{ .hash = envy::blake3_hash(data.data(), data.size()),
+                                   .size = data.size() };
+  CHECK_FALSE(store.contains(ref.hash));
+  CHECK(store.put(ref.hash, data.data(), data.size()));
+  CHECK_FALSE(store.put(ref.hash, data.data(), data.size()));
+  CHECK(store.read(ref) == data);
+
+  // A downloaded frame is only published if it matches its reference.
+  envy::depot_chunk_store other{ root / "other" };
+  other.put_compressed(ref, store.chunk_path(ref.hash));
+  CHECK(other.read(ref) == data);
+
+  envy::depot_chunk_ref wrong{ ref };
+  wrong.hash = envy::blake3_hash("x", 1);
+  CHECK_THROWS(other.put_compressed(wrong, store.chunk_path(ref.hash)));
+  CHECK_FALSE(other.contains(wrong.hash));
+
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("depot_export_chunked reuses chunks across package versions") {
+  auto const root{ make_temp_dir() };
+  auto const v1{ root / "v1" };
+  auto const v2{ root / "v2" };
+  for (int i{ 0 }; i < 8; ++i) {
+    auto const data{ random_bytes(256 * 1024, 10 + static_cast<std::uint64_t>(i)) };
+    auto const name{ "lib" + std::to_string(i) + ".a" };
+    write_file(v1 / name, data);
+    write_file(v2 / name, data);
+  }
+  write_file(v2 / "lib3.a", random_bytes(256 * 1024, 99));  // One file changes
+
+  auto const depot{ root / "depot" };
+  auto const r1{ envy::depot_export_chunked(depot / "v1.chunks", v1, "pkg") };
+  auto const r2{ envy::depot_export_chunked(depot / "v2.chunks", v2, "pkg") };
+
+  CHECK(r1.new_chunks == r1.chunks);
+  CHECK(r2.new_chunks > 0);
+  CHECK(r2.new_chunk_bytes < r2.archive.bytes / 4);
+
+  // Reassembly reproduces the tar stream, which extracts to the v2 tree.
+  auto const index{ envy::depot_chunk_index_parse(
+      [&] {
+        auto const bytes{ envy::util_load_file(depot / "v2.chunks") };
+        return std::string(bytes.begin(), bytes.end());
+      }()) };
+  CHECK(index.archive_blake3 == r2.archive.blake3);
+
+  envy::depot_chunk_store const store{ depot / "chunks" };
+  auto const tar{ root / "v2.tar" };
+  envy::depot_reassemble_chunks(index, store, tar);
+  CHECK(envy::blake3_file(tar) == r2.archive.blake3);
+
+  auto const out{ root / "out" };
+  CHECK(envy::extract(tar, out) == 8);
+  CHECK(envy::blake3_file(out / "pkg" / "lib3.a") == envy::blake3_file(v2 / "lib3.a"));
+
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("depot_reassemble_chunks rejects a corrupt chunk") {
+  auto const root{ make_temp_dir() };
+  write_file(root / "src" / "a.bin", random_bytes(100000, 5));
+  envy::depot_export_chunked(root / "depot" / "a.chunks", root / "src", "pkg");
+
+  auto const bytes{ envy::util_load_file(root / "depot" / "a.chunks") };
+  auto const index{ envy::depot_chunk_index_parse(
+      std::string(bytes.begin(), bytes.end())) };
+  envy::depot_chunk_store const store{ root / "depot" / "chunks" };
+  REQUIRE_FALSE(index.chunks.empty());
+
+  auto const victim{ store.chunk_path(index.chunks.front().hash) };
+  auto other{ random_bytes(64, 6) };
+  write_file(victim, other);
+
+  CHECK_THROWS(envy::depot_reassemble_chunks(index, store, root / "out.tar"));
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("depot_chunk_url resolves beside the index") {
+  auto const h{ envy::blake3_hash("x", 1) };
+  auto const hex{ envy::util_bytes_to_hex(h.data(), h.size()) };
+  CHECK(envy::depot_chunk_url("https://d.example/a/foo.chunks", h) ==
+        "https://d.example/a/chunks/" + hex + ".zst");
+  CHECK(envy::depot_chunk_url("file:///srv/depot/foo.chunks", h) ==
+        "file:///srv/depot/chunks/" + hex + ".zst");
+  CHECK(envy::depot_chunk_url("foo.chunks", h) == "chunks/" + hex + ".zst");
+}
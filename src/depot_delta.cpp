@@ -0,0 +1,328 @@
+#include "depot_delta.h"
+
+#include "extract.h"
+#include "platform.h"
+#include "util.h"
+
+#include "zstd.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace envy {
+
+namespace {
+
+constexpr std::string_view kDeltaHeader{ "envy-delta 1" };
+constexpr std::string_view kDeltaSuffix{ ".delta" };
+constexpr std::size_t kMaxHeaderLine{ 256 };
+
+using cctx_ptr = std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)>;
+using dctx_ptr = std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)>;
+
+void zstd_check(std::size_t rc, char const *what) {
+  if (ZSTD_isError(rc)) {
+    throw std::runtime_error(std::string("zstd: ") + what + ": " + ZSTD_getErrorName(rc));
+  }
+}
+
+// Frames made against a large prefix declare windows beyond the streaming decoder's
+// default limit (128 MiB); accept anything the library can represent.
+dctx_ptr make_dctx() {
+  dctx_ptr dctx{ ZSTD_createDCtx(), &ZSTD_freeDCtx };
+  if (!dctx) { throw std::runtime_error("zstd: ZSTD_createDCtx failed"); }
+  zstd_check(ZSTD_DCtx_setParameter(dctx.get(),
+                                    ZSTD_d_windowLogMax,
+                                    ZSTD_dParam_getBounds(ZSTD_d_windowLogMax).upperBound),
+             "set windowLogMax");
+  return dctx;
+}
+
+std::string sha256_hex(sha256_t const &hash) {
+  return util_bytes_to_hex(hash.data(), hash.size());
+}
+
+sha256_t parse_sha256_hex(std::string const &hex) {
+  if (hex.size() != 64) { throw std::runtime_error("delta: bad sha256: " + hex); }
+  auto const bytes{ util_hex_to_bytes(hex) };
+  sha256_t hash{};
+  std::ranges::copy(bytes, hash.begin());
+  return hash;
+}
+
+std::string read_header_line(FILE *f) {
+  std::string line;
+  for (int c{ std::fgetc(f) }; c != '\n'; c = std::fgetc(f)) {
+    if (c == EOF || line.size() >= kMaxHeaderLine) {
+      throw std::runtime_error("delta: truncated or malformed header");
+    }
+    line.push_back(static_cast<char>(c));
+  }
+  return line;
+}
+
+// Leaves f positioned at the first byte of the zstd frame.
+depot_delta_header read_header(FILE *f) {
+  if (read_header_line(f) != kDeltaHeader) {
+    throw std::runtime_error("delta: unsupported header");
+  }
+
+  depot_delta_header header;
+  bool have_base{ false };
+  bool have_target{ false };
+  for (std::string line{ read_header_line(f) }; !line.empty();
+       line = read_header_line(f)) {
+    std::istringstream fields{ line };
+    std::string kind;
+    std::string hex;
+    fields >> kind >> hex;
+    if (kind == "base" && fields.eof()) {
+      header.base_sha256 = parse_sha256_hex(hex);
+      have_base = true;
+    } else if (kind == "target" && (fields >> header.target_size) && fields.eof()) {
+      header.target_sha256 = parse_sha256_hex(hex);
+      have_target = true;
+    } else {
+      throw std::runtime_error("delta: malformed header line: " + line);
+    }
+  }
+
+  if (!have_base || !have_target) { throw std::runtime_error("delta: incomplete header"); }
+  return header;
+}
+
+}  // namespace
+
+depot_delta_tree depot_delta_serialize_tree(std::filesystem::path const &dir,
+                                            std::string const &prefix,
+                                            std::filesystem::path const &tar_path) {
+  auto const file{ util_open_file(tar_path, "wb") };
+  if (!file) { throw std::runtime_error("Failed to open " + tar_path.string()); }
+
+  depot_delta_tree tree{ .tar = tar_path };
+  auto const result{ archive_create_tar(
+      [&](void const *data, std::size_t size) {
+        if (std::fwrite(data, 1, size, file.get()) != size) {
+          throw std::runtime_error("write failed: " + tar_path.string());
+        }
+        tree.size += size;
+      },
+      dir,
+      prefix) };
+  if (std::fflush(file.get()) != 0) {
+    throw std::runtime_error("flush failed: " + tar_path.string());
+  }
+  tree.sha256 = result.sha256;
+  return tree;
+}
+
+depot_delta_tree depot_delta_load_tar_zst(std::filesystem::path const &path,
+                                          std::filesystem::path const &tar_path,
+                                          std::span<unsigned char const> zstd_dictionary) {
+  auto const file{ util_open_file(path, "rb") };
+  if (!file) { throw std::runtime_error("Failed to open " + path.string()); }
+  auto const out_file{ util_open_file(tar_path, "wb") };
+  if (!out_file) { throw std::runtime_error("Failed to open " + tar_path.string()); }
+
+  auto const dctx{ make_dctx() };
+  if (!zstd_dictionary.empty()) {
+    zstd_check(ZSTD_DCtx_loadDictionary(dctx.get(),
+                                        zstd_dictionary.data(),
+                                        zstd_dictionary.size()),
+               "load dictionary");
+  }
+  depot_delta_tree tree{ .tar = tar_path };
+  sha256_hasher hasher;
+  std::vector<unsigned char> in(ZSTD_DStreamInSize());
+  std::vector<unsigned char> out(ZSTD_DStreamOutSize());
+  std::size_t rc{ 0 };
+
+  while (std::size_t const n{ std::fread(in.data(), 1, in.size(), file.get()) }) {
+    ZSTD_inBuffer input{ in.data(), n, 0 };
+    while (input.pos < input.size) {
+      ZSTD_outBuffer output{ out.data(), out.size(), 0 };
+      rc = ZSTD_decompressStream(dctx.get(), &output, &input);
+      zstd_check(rc, "decompress");
+      if (std::fwrite(out.data(), 1, output.pos, out_file.get()) != output.pos) {
+        throw std::runtime_error("write failed: " + tar_path.string());
+      }
+      tree.size += output.pos;
+      hasher.update(out.data(), output.pos);
+    }
+  }
+  if (std::ferror(file.get()) || rc != 0) {
+    throw std::runtime_error("delta: truncated or unreadable archive " + path.string());
+  }
+  if (std::fflush(out_file.get()) != 0) {
+    throw std::runtime_error("flush failed: " + tar_path.string());
+  }
+
+  tree.sha256 = hasher.finalize();
+  return tree;
+}
+
+std::uint64_t depot_delta_create(std::filesystem::path const &output_path,
+                                 depot_delta_tree const &base,
+                                 depot_delta_tree const &target) {
+  cctx_ptr const cctx{ ZSTD_createCCtx(), &ZSTD_freeCCtx };
+  if (!cctx) { throw std::runtime_error("zstd: ZSTD_createCCtx failed"); }
+
+  // As zstd --patch-from: a window spanning prefix + input so the whole base stays
+  // addressable, and long-distance matching to find its distant repeats cheaply.
+  auto const bounds{ ZSTD_cParam_getBounds(ZSTD_c_windowLog) };
+  std::uint64_t const span{ base.size + target.size };
+  int window_log{ bounds.lowerBound };
+  while (window_log < bounds.upperBound && (std::uint64_t{ 1 } << window_log) < span) {
+    ++window_log;
+  }
+
+  platform::mapped_file const base_map{ base.tar };
+  auto const prefix{ base_map.bytes() };
+  zstd_check(ZSTD_CCtx_setParameter(cctx.get(),
+                                    ZSTD_c_compressionLevel,
+                                    ZSTD_CLEVEL_DEFAULT),
+             "set level");
+  zstd_check(ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_windowLog, window_log),
+             "set windowLog");
+  zstd_check(ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_enableLongDistanceMatching, 1),
+             "enable long distance matching");
+  zstd_check(ZSTD_CCtx_setPledgedSrcSize(cctx.get(), target.size), "set source size");
+  zstd_check(ZSTD_CCtx_refPrefix(cctx.get(), prefix.data(), prefix.size()),
+             "reference base");
+
+  std::ostringstream header;
+  header << kDeltaHeader << "\n"
+         << "base " << sha256_hex(base.sha256) << "\n"
+         << "target " << sha256_hex(target.sha256) << " " << target.size << "\n\n";
+  std::string const header_text{ header.str() };
+
+  auto const in_file{ util_open_file(target.tar, "rb") };
+  if (!in_file) { throw std::runtime_error("Failed to open " + target.tar.string()); }
+  auto const out_file{ util_open_file(output_path, "wb") };
+  auto const write_failed{ [&] {
+    return std::runtime_error("Failed to write delta: " + output_path.string());
+  } };
+  if (!out_file ||
+      std::fwrite(header_text.data(), 1, header_text.size(), out_file.get()) !=
+          header_text.size()) {
+    throw write_failed();
+  }
+
+  std::uint64_t written{ header_text.size() };
+  std::vector<unsigned char> in(ZSTD_CStreamInSize());
+  std::vector<unsigned char> out(ZSTD_CStreamOutSize());
+  bool finished{ false };
+  while (!finished) {
+    std::size_t const n{ std::fread(in.data(), 1, in.size(), in_file.get()) };
+    if (std::ferror(in_file.get())) {
+      throw std::runtime_error("read failed: " + target.tar.string());
+    }
+    bool const last{ n < in.size() };
+    ZSTD_EndDirective const mode{ last ? ZSTD_e_end : ZSTD_e_continue };
+    ZSTD_inBuffer input{ in.data(), n, 0 };
+    do {
+      ZSTD_outBuffer output{ out.data(), out.size(), 0 };
+      std::size_t const remaining{
+        ZSTD_compressStream2(cctx.get(), &output, &input, mode)
+      };
+      zstd_check(remaining, "compress");
+      if (std::fwrite(out.data(), 1, output.pos, out_file.get()) != output.pos) {
+        throw write_failed();
+      }
+      written += output.pos;
+      finished = last && remaining == 0;
+    } while (last ? !finished : input.pos < input.size);
+  }
+
+  if (std::fflush(out_file.get()) != 0) { throw write_failed(); }
+  return written;
+}
+
+depot_delta_header depot_delta_read_header(std::filesystem::path const &delta_path) {
+  auto const file{ util_open_file(delta_path, "rb") };
+  if (!file) { throw std::runtime_error("Failed to open " + delta_path.string()); }
+  return read_header(file.get());
+}
+
+void depot_delta_apply(std::filesystem::path const &delta_path,
+                       depot_delta_tree const &base,
+                       std::filesystem::path const &output_path) {
+  auto const in_file{ util_open_file(delta_path, "rb") };
+  if (!in_file) { throw std::runtime_error("Failed to open " + delta_path.string()); }
+
+  auto const header{ read_header(in_file.get()) };
+  if (base.sha256 != header.base_sha256) {
+    throw std::runtime_error("delta: local base " + sha256_hex(base.sha256) +
+                             " does not match " + sha256_hex(header.base_sha256));
+  }
+
+  auto const out_file{ util_open_file(output_path, "wb") };
+  if (!out_file) { throw std::runtime_error("Failed to open " + output_path.string()); }
+
+  platform::mapped_file const base_map{ base.tar };
+  auto const prefix{ base_map.bytes() };
+  auto const dctx{ make_dctx() };
+  zstd_check(ZSTD_DCtx_refPrefix(dctx.get(), prefix.data(), prefix.size()),
+             "reference base");
+
+  sha256_hasher hasher;
+  std::uint64_t written{ 0 };
+  std::vector<unsigned char> in(ZSTD_DStreamInSize());
+  std::vector<unsigned char> out(ZSTD_DStreamOutSize());
+  std::size_t rc{ 0 };
+
+  while (std::size_t const n{ std::fread(in.data(), 1, in.size(), in_file.get()) }) {
+    ZSTD_inBuffer input{ in.data(), n, 0 };
+    while (input.pos < input.size) {
+      ZSTD_outBuffer output{ out.data(), out.size(), 0 };
+      rc = ZSTD_decompressStream(dctx.get(), &output, &input);
+      zstd_check(rc, "apply delta");
+      written += output.pos;
+      if (written > header.target_size) {
+        throw std::runtime_error("delta: output exceeds declared size");
+      }
+      if (std::fwrite(out.data(), 1, output.pos, out_file.get()) != output.pos) {
+        throw std::runtime_error("write failed: " + output_path.string());
+      }
+      hasher.update(out.data(), output.pos);
+    }
+  }
+
+  if (std::ferror(in_file.get()) || rc != 0) {
+    throw std::runtime_error("delta: truncated frame in " + delta_path.string());
+  }
+  if (std::fflush(out_file.get()) != 0) {
+    throw std::runtime_error("flush failed: " + output_path.string());
+  }
+  if (written != header.target_size || hasher.finalize() != header.target_sha256) {
+    throw std::runtime_error("delta: SHA256 mismatch in reconstructed archive");
+  }
+}
+
+std::string depot_delta_filename(std::string_view target_stem,
+                                 std::string_view base_stem) {
+  std::string name{ target_stem };
+  name += '~';
+  name += base_stem;
+  name += kDeltaSuffix;
+  return name;
+}
+
+std::optional<depot_delta_stems> depot_delta_parse_filename(std::string_view filename) {
+  if (!filename.ends_with(kDeltaSuffix)) { return std::nullopt; }
+  filename.remove_suffix(kDeltaSuffix.size());
+
+  auto const sep{ filename.find('~') };
+  if (sep == std::string_view::npos || sep == 0 || sep + 1 == filename.size() ||
+      filename.find('~', sep + 1) != std::string_view::npos) {
+    return std::nullopt;
+  }
+  return depot_delta_stems{ .target = std::string{ filename.substr(0, sep) },
+                            .base = std::string{ filename.substr(sep + 1) } };
+}
+
+}  // namespace envy
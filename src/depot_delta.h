@@ -0,0 +1,79 @@
+#pragma once
+
+#include "sha256.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace envy {
+
+// Delta depot artifacts (<target stem>~<base stem>.delta). A delta is the uncompressed
+// tar of one package version compressed with zstd against the uncompressed tar of an
+// earlier version as a referenced prefix (zstd --patch-from). The base tar never ships:
+// an importer rebuilds it by re-serializing the base package's installed pkg/ tree with
+// archive_create_tar, which is deterministic, and checks its SHA256 against the header.
+//
+// File layout: a text header, a blank line, then one zstd frame.
+//   envy-delta 1
+//   base <64hex sha256 of base tar>
+//   target <64hex sha256 of target tar> <target tar size>
+//
+// Both tars are spilled to files. The base is memory-mapped as the zstd prefix and the
+// target is streamed through the compressor, so neither is copied onto the heap.
+
+struct depot_delta_header {
+  sha256_t base_sha256{};
+  sha256_t target_sha256{};
+  std::uint64_t target_size{ 0 };
+};
+
+// An uncompressed tar written to `tar`, with its size and SHA256.
+struct depot_delta_tree {
+  std::filesystem::path tar;
+  sha256_t sha256{};
+  std::uint64_t size{ 0 };
+};
+
+// Deterministic uncompressed tar of dir stored under prefix/ — the byte stream an export
+// of the same tree compresses into its .tar.zst — written to tar_path.
+depot_delta_tree depot_delta_serialize_tree(std::filesystem::path const &dir,
+                                            std::string const &prefix,
+                                            std::filesystem::path const &tar_path);
+
+// Decompress a .tar.zst artifact back to its tar bytes in tar_path, through
+// zstd_dictionary when the artifact was compressed with one (see depot_dict.h).
+depot_delta_tree depot_delta_load_tar_zst(
+    std::filesystem::path const &path,
+    std::filesystem::path const &tar_path,
+    std::span<unsigned char const> zstd_dictionary = {});
+
+// Write a delta reproducing target from base. Returns the delta file size.
+std::uint64_t depot_delta_create(std::filesystem::path const &output_path,
+                                 depot_delta_tree const &base,
+                                 depot_delta_tree const &target);
+
+// Throws std::runtime_error on a missing or malformed header.
+depot_delta_header depot_delta_read_header(std::filesystem::path const &delta_path);
+
+// Rebuild the target tar into output_path. Throws if base does not match the header or
+// the result's size or SHA256 does not.
+void depot_delta_apply(std::filesystem::path const &delta_path,
+                       depot_delta_tree const &base,
+                       std::filesystem::path const &output_path);
+
+// "<target_stem>~<base_stem>.delta"; '~' cannot occur in a cache key.
+std::string depot_delta_filename(std::string_view target_stem, std::string_view base_stem);
+
+struct depot_delta_stems {
+  std::string target;
+  std::string base;
+};
+
+// Inverse of depot_delta_filename; nullopt unless both stems are non-empty.
+std::optional<depot_delta_stems> depot_delta_parse_filename(std::string_view filename);
+
+}  // namespace envy
@@ -0,0 +1,148 @@
+#include "depot_delta.h"
+
+#include "extract.h"
+#include "sha256.h"
+#include "util.h"
+
+#include "doctest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::filesystem::path make_temp_dir() {
+  static std::mt19937_64 rng{ std::random_device{}() };
+  auto dir{ std::filesystem::temp_directory_path() /
+            ("envy-depot-delta-test-" + std::to_string(rng())) };
+  std::filesystem::create_directories(dir);
+  return dir;
+}
+
+void write_random_file(std::filesystem::path const &path,
+                       std::size_t n,
+                       std::uint64_t seed) {
+  std::filesystem::create_directories(path.parent_path());
+  std::mt19937_64 rng{ seed };
+  std::string data(n, '\0');
+  for (auto &c : data) { c = static_cast<char>(rng()); }
+  std::ofstream{ path, std::ios::binary } << data;
+}
+
+// A synthetic "version N" tree: a handful of binaries and headers.
+void write_version(std::filesystem::path const &root, int version) {
+  for (int i{ 0 }; i < 6; ++i) {
+    write_random_file(root / "lib" / ("lib" + std::to_string(i) + ".a"),
+                      128 * 1024,
+                      static_cast<std::uint64_t>(i));
+  }
+  std::ofstream{ root / "include" / "version.h" }
+      << "#define VERSION " << version << "\n";
+}
+
+}  // namespace
+
+TEST_CASE("depot_delta_serialize_tree matches the tar inside an exported .tar.zst") {
+  auto const root{ make_temp_dir() };
+  std::filesystem::create_directories(root / "v1" / "include");
+  write_version(root / "v1", 1);
+
+  envy::archive_create_tar_zst(root / "v1.tar.zst", root / "v1", "pkg");
+  auto const loaded{ envy::depot_delta_load_tar_zst(root / "v1.tar.zst",
+                                                    root / "loaded.tar") };
+  auto const serialized{ envy::depot_delta_serialize_tree(root / "v1",
+                                                          "pkg",
+                                                          root / "serialized.tar") };
+
+  CHECK(loaded.sha256 == serialized.sha256);
+  CHECK(loaded.size == serialized.size);
+  CHECK(loaded.size == std::filesystem::file_size(root / "serialized.tar"));
+  CHECK(envy::sha256(root / "loaded.tar") == serialized.sha256);
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("depot delta reproduces the next version from the previous tree") {
+  auto const root{ make_temp_dir() };
+  std::filesystem::create_directories(root / "v1" / "include");
+  std::filesystem::create_directories(root / "v2" / "include");
+  write_version(root / "v1", 1);
+  write_version(root / "v2", 2);
+  write_random_file(root / "v2" / "lib" / "lib4.a", 128 * 1024, 44);  // One changed lib
+
+  auto const base{ envy::depot_delta_serialize_tree(root / "v1", "pkg", root / "b.tar") };
+  auto const target{
+    envy::depot_delta_serialize_tree(root / "v2", "pkg", root / "t.tar")
+  };
+  envy::archive_create_tar_zst(root / "v2.tar.zst", root / "v2", "pkg");
+
+  auto const delta_path{ root / "v2.delta" };
+  auto const delta_size{ envy::depot_delta_create(delta_path, base, target) };
+  CHECK(delta_size < std::filesystem::file_size(root / "v2.tar.zst") / 3);
+
+  auto const header{ envy::depot_delta_read_header(delta_path) };
+  CHECK(header.base_sha256 == base.sha256);
+  CHECK(header.target_sha256 == target.sha256);
+  CHECK(header.target_size == target.size);
+
+  auto const out{ root / "v2.tar" };
+  envy::depot_delta_apply(delta_path, base, out);
+  CHECK(envy::sha256(out) == target.sha256);
+
+  // Extracting the reconstruction yields the v2 tree.
+  CHECK(envy::extract(out, root / "x") == 7);
+  CHECK(envy::sha256(root / "x" / "pkg" / "lib" / "lib4.a") ==
+        envy::sha256(root / "v2" / "lib" / "lib4.a"));
+
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("depot_delta_apply rejects a different base") {
+  auto const root{ make_temp_dir() };
+  std::filesystem::create_directories(root / "v1" / "include");
+  std::filesystem::create_directories(root / "v2" / "include");
+  write_version(root / "v1", 1);
+  write_version(root / "v2", 2);
+
+  auto const base{ envy::depot_delta_serialize_tree(root / "v1", "pkg", root / "b.tar") };
+  auto const target{
+    envy::depot_delta_serialize_tree(root / "v2", "pkg", root / "t.tar")
+  };
+  envy::depot_delta_create(root / "d.delta", base, target);
+
+  std::ofstream{ root / "v1" / "include" / "extra.h" } << "// local edit\n";
+  auto const drifted{ envy::depot_delta_serialize_tree(root / "v1",
+                                                       "pkg",
+                                                       root / "drifted.tar") };
+  CHECK_THROWS(envy::depot_delta_apply(root / "d.delta", drifted, root / "out.tar"));
+
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("depot_delta_read_header rejects malformed files") {
+  auto const root{ make_temp_dir() };
+  std::ofstream{ root / "a.delta" } << "envy-delta 2\n\n";
+  std::ofstream{ root / "b.delta" } << "envy-delta 1\nbase abc\n\n";
+  std::ofstream{ root / "c.delta" } << "envy-delta 1\n";
+  CHECK_THROWS(envy::depot_delta_read_header(root / "a.delta"));
+  CHECK_THROWS(envy::depot_delta_read_header(root / "b.delta"));
+  CHECK_THROWS(envy::depot_delta_read_header(root / "c.delta"));
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("depot delta filenames round-trip") {
+  auto const name{ envy::depot_delta_filename("a.b@v2-linux-x86_64-blake3-2222",
+                                              "a.b@v1-linux-x86_64-blake3-1111") };
+  CHECK(name == "a.b@v2-linux-x86_64-blake3-2222~a.b@v1-linux-x86_64-blake3-1111.delta");
+
+  auto const stems{ envy::depot_delta_parse_filename(name) };
+  REQUIRE(stems.has_value());
+  CHECK(stems->target == "a.b@v2-linux-x86_64-blake3-2222");
+  CHECK(stems->base == "a.b@v1-linux-x86_64-blake3-1111");
+
+  CHECK_FALSE(envy::depot_delta_parse_filename("a~b.tar.zst").has_value());
+  CHECK_FALSE(envy::depot_delta_parse_filename("~b.delta").has_value());
+  CHECK_FALSE(envy::depot_delta_parse_filename("a~b~c.delta").has_value());
+}
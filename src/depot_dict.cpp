@@ -0,0 +1,265 @@
+#include "depot_dict.h"
+
+#include "extract.h"
+#include "sha256.h"
+#include "util.h"
+
+#include "archive.h"
+#include "archive_entry.h"
+#include "zdict.h"
+#include "zstd.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+namespace envy {
+
+namespace {
+
+// Largest zstd frame header (magic + descriptor + window + 4-byte dict ID + 8-byte size).
+constexpr std::size_t kMaxFrameHeader{ 18 };
+
+// Directory inputs are sampled as the tar an export of them would write.
+constexpr char kTarPrefix[]{ "pkg" };
+
+struct dict_samples {
+  std::vector<unsigned char> data;
+  std::vector<std::size_t> sizes;
+};
+
+class sample_collector {
+ public:
+  explicit sample_collector(depot_dict_train_options const &options)
+      : options_{ options } {}
+
+  bool full() const { return samples_.data.size() >= options_.max_total_size; }
+
+  // Room left for the next sample; 0 once the budget is spent.
+  std::size_t next_capacity() const {
+    if (full()) { return 0; }
+    return std::min(options_.max_sample_size,
+                    options_.max_total_size - samples_.data.size());
+  }
+
+  void add(unsigned char const *data, std::size_t size) {
+    if (size == 0) { return; }
+    samples_.data.insert(samples_.data.end(), data, data + size);
+    samples_.sizes.push_back(size);
+  }
+
+  dict_samples take() { return std::move(samples_); }
+
+ private:
+  depot_dict_train_options options_;
+  dict_samples samples_;
+};
+
+// Splits an uncompressed tar stream into one sample per entry: header block, data and
+// padding. The dictionary is applied to that stream, not to bare file contents, so it
+// has to learn tar headers and NUL padding as well as the files themselves.
+class tar_sample_splitter {
+ public:
+  explicit tar_sample_splitter(sample_collector &collector) : collector_{ collector } {}
+
+  void feed(unsigned char const *data, std::size_t size) {
+    while (size > 0) {
+      if (!in_entry_) {
+        std::size_t const n{ std::min(size, kBlock - header_.size()) };
+        header_.insert(header_.end(), data, data + n);
+        data += n;
+        size -= n;
+        if (header_.size() == kBlock) { begin_entry(); }
+        continue;
+      }
+      std::size_t const n{ static_cast<std::size_t>(
+          std::min<std::uint64_t>(size, remaining_)) };
+      std::size_t const keep{ std::min(n, cap_ - std::min(cap_, sample_.size())) };
+      sample_.insert(sample_.end(), data, data + keep);
+      data += n;
+      size -= n;
+      remaining_ -= n;
+      if (remaining_ == 0) { end_entry(); }
+    }
+  }
+
+ private:
+  static constexpr std::size_t kBlock{ 512 };
+
+  // Size field: octal, or base-256 when the high bit of its first byte is set.
+  std::uint64_t header_size() const {
+    unsigned char const *field{ header_.data() + 124 };
+    std::uint64_t size{ 0 };
+    if (field[0] & 0x80) {
+      for (int i{ 4 }; i < 12; ++i) { size = (size << 8) | field[i]; }
+      return size;
+    }
+    for (int i{ 0 }; i < 12 && field[i] >= '0' && field[i] <= '7'; ++i) {
+      size = size * 8 + static_cast<std::uint64_t>(field[i] - '0');
+    }
+    return size;
+  }
+
+  void begin_entry() {
+    if (std::ranges::all_of(header_, [](unsigned char c) { return c == 0; })) {
+      header_.clear();  // End-of-archive block
+      return;
+    }
+    cap_ = collector_.next_capacity();
+    sample_.assign(header_.begin(), header_.begin() + std::min(kBlock, cap_));
+    std::uint64_t const size{ header_size() };
+    remaining_ = (size + kBlock - 1) / kBlock * kBlock;
+    header_.clear();
+    in_entry_ = true;
+    if (remaining_ == 0) { end_entry(); }
+  }
+
+  void end_entry() {
+    collector_.add(sample_.data(), sample_.size());
+    sample_.clear();
+    in_entry_ = false;
+  }
+
+  sample_collector &collector_;
+  std::vector<unsigned char> header_;
+  std::vector<unsigned char> sample_;
+  std::size_t cap_{ 0 };
+  std::uint64_t remaining_{ 0 };
+  bool in_entry_{ false };
+};
+
+void collect_directory(std::filesystem::path const &dir, sample_collector &collector) {
+  tar_sample_splitter splitter{ collector };
+  archive_create_tar(
+      [&](void const *data, std::size_t size) {
+        splitter.feed(static_cast<unsigned char const *>(data), size);
+      },
+      dir,
+      kTarPrefix);
+}
+
+// Decompress an archive's outer filters (zstd, gzip, ...) and split the tar inside.
+void collect_archive(std::filesystem::path const &path, sample_collector &collector) {
+  std::unique_ptr<archive, decltype(&archive_read_free)> reader{ archive_read_new(),
+                                                                 &archive_read_free };
+  if (!reader) { throw std::runtime_error("archive_read_new failed"); }
+  archive_read_support_filter_all(reader.get());
+  archive_read_support_format_raw(reader.get());
+  if (archive_read_open_filename(reader.get(), path.string().c_str(), 10240) !=
+      ARCHIVE_OK) {
+    throw std::runtime_error(std::string("Failed to open archive: ") +
+                             archive_error_string(reader.get()));
+  }
+  archive_entry *entry{ nullptr };
+  if (archive_read_next_header(reader.get(), &entry) != ARCHIVE_OK) {
+    throw std::runtime_error(std::string("Failed to read archive: ") +
+                             archive_error_string(reader.get()));
+  }
+
+  tar_sample_splitter splitter{ collector };
+  std::vector<unsigned char> buf(64 * 1024);
+  while (!collector.full()) {
+    la_ssize_t const n{ archive_read_data(reader.get(), buf.data(), buf.size()) };
+    if (n < 0) {
+      throw std::runtime_error(std::string("Failed to read archive data: ") +
+                               archive_error_string(reader.get()));
+    }
+    if (n == 0) { return; }
+    splitter.feed(buf.data(), static_cast<std::size_t>(n));
+  }
+}
+
+}  // namespace
+
+std::vector<unsigned char> depot_dict_train(
+    std::vector<std::filesystem::path> const &inputs,
+    depot_dict_train_options const &options) {
+  sample_collector collector{ options };
+  for (auto const &input : inputs) {
+    if (collector.full()) { break; }
+    if (std::filesystem::is_directory(input)) {
+      collect_directory(input, collector);
+    } else {
+      collect_archive(input, collector);
+    }
+  }
+
+  auto const samples{ collector.take() };
+  if (samples.sizes.empty()) {
+    throw std::runtime_error("dictionary training: no sample files in inputs");
+  }
+
+  std::vector<unsigned char> dict(options.dict_size);
+  std::size_t const size{
+    ZDICT_trainFromBuffer(dict.data(),
+                          dict.size(),
+                          samples.data.data(),
+                          samples.sizes.data(),
+                          static_cast<unsigned>(samples.sizes.size()))
+  };
+  if (ZDICT_isError(size)) {
+    throw std::runtime_error(std::string("dictionary training failed: ") +
+                             ZDICT_getErrorName(size));
+  }
+  dict.resize(size);
+  return dict;
+}
+
+std::uint32_t depot_dict_id(std::span<unsigned char const> dict) {
+  unsigned const id{ ZDICT_getDictID(dict.data(), dict.size()) };
+  if (id == 0) { throw std::runtime_error("not a zstd dictionary"); }
+  return id;
+}
+
+std::string depot_dict_sha256(std::span<unsigned char const> dict) {
+  sha256_hasher hasher;
+  hasher.update(dict.data(), dict.size());
+  auto const digest{ hasher.finalize() };
+  return util_bytes_to_hex(digest.data(), digest.size());
+}
+
+std::vector<unsigned char> depot_dict_load(
+    std::filesystem::path const &path,
+    std::optional<std::uint32_t> expected_id,
+    std::optional<std::string> const &expected_sha256) {
+  auto dict{ util_load_file(path) };
+  std::uint32_t const id{ depot_dict_id(dict) };
+  if (expected_id && id != *expected_id) {
+    throw std::runtime_error("dictionary " + path.string() + " has ID " +
+                             std::to_string(id) + ", expected " +
+                             std::to_string(*expected_id));
+  }
+  if (expected_sha256) {
+    auto const actual{ depot_dict_sha256(dict) };
+    if (actual != *expected_sha256) {
+      throw std::runtime_error("dictionary " + path.string() + " has SHA256 " + actual +
+                               ", expected " + *expected_sha256);
+    }
+  }
+  return dict;
+}
+
+std::optional<std::uint32_t> depot_dict_id_of_archive(std::filesystem::path const &path) {
+  auto const file{ util_open_file(path, "rb") };
+  if (!file) { throw std::runtime_error("Failed to open " + path.string()); }
+  std::array<unsigned char, kMaxFrameHeader> header{};
+  std::size_t const n{ std::fread(header.data(), 1, header.size(), file.get()) };
+  unsigned const id{ ZSTD_getDictID_fromFrame(header.data(), n) };
+  return id ? std::optional<std::uint32_t>{ id } : std::nullopt;
+}
+
+std::string depot_dict_filename(std::uint32_t id) { return std::to_string(id) + ".zdict"; }
+
+std::string depot_dict_url(std::string_view archive_url, std::uint32_t id) {
+  auto const sep{ archive_url.find_last_of("/\\") };
+  std::string url{ sep == std::string_view::npos ? std::string_view{}
+                                                 : archive_url.substr(0, sep + 1) };
+  url += "dicts/";
+  url += depot_dict_filename(id);
+  return url;
+}
+
+}  // namespace envy
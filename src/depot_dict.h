@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace envy {
+
+// Trained zstd dictionaries for depot archives. Trees of many small files (headers,
+// scripts, license texts) share a great deal of boilerplate that a single zstd stream
+// only learns as it goes; a dictionary trained on earlier exports supplies it up front.
+//
+// A dictionary is identified by the ID zstd embeds in it (and in the header of every
+// frame compressed with it). It is published beside the archives that use it as
+// dicts/<id>.zdict, and each such archive's manifest line carries trailing
+// "  dict=<id>  dict_sha256=<64hex>" fields. An ID is only 32 bits and anyone may pick
+// it, so importers check the SHA256 before using a fetched dictionary. They keep
+// fetched dictionaries under <cache>/dicts/.
+
+struct depot_dict_train_options {
+  std::size_t dict_size{ 112 * 1024 };         // zstd CLI default
+  std::size_t max_sample_size{ 128 * 1024 };   // Bytes taken from any one tar entry
+  std::size_t max_total_size{ 64 * 1024 * 1024 };  // Sample budget across all inputs
+};
+
+// Train a dictionary from the given inputs, each either a directory or a compressed tar
+// (e.g. an exported .tar.zst). Samples are the inputs' tar entries (header, data and
+// padding, as archive_create_tar lays them out), in order, until the sample budget is
+// spent. Throws if training fails, typically for too few or too uniform samples.
+std::vector<unsigned char> depot_dict_train(
+    std::vector<std::filesystem::path> const &inputs,
+    depot_dict_train_options const &options = {});
+
+// ID embedded in a zstd dictionary. Throws if dict is not one (raw content, ID 0).
+std::uint32_t depot_dict_id(std::span<unsigned char const> dict);
+
+// Lowercase hex SHA256 of a dictionary, as recorded in dict_sha256=.
+std::string depot_dict_sha256(std::span<unsigned char const> dict);
+
+// Read a dictionary file, checking its ID and SHA256 when they are given.
+std::vector<unsigned char> depot_dict_load(
+    std::filesystem::path const &path,
+    std::optional<std::uint32_t> expected_id = {},
+    std::optional<std::string> const &expected_sha256 = {});
+
+// Dictionary ID recorded in the first frame header of a zstd file; nullopt for a file
+// compressed without a dictionary or one that is not zstd at all.
+std::optional<std::uint32_t> depot_dict_id_of_archive(std::filesystem::path const &path);
+
+// "<id>.zdict"
+std::string depot_dict_filename(std::uint32_t id);
+
+// URL (or path) of a dictionary published beside the archive at archive_url.
+std::string depot_dict_url(std::string_view archive_url, std::uint32_t id);
+
+}  // namespace envy
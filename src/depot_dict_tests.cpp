@@ -0,0 +1,159 @@
+#include "depot_dict.h"
+
+#include "extract.h"
+#include "sha256.h"
+
+#include "doctest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::filesystem::path make_temp_dir() {
+  static std::mt19937_64 rng{ std::random_device{}() };
+  auto dir{ std::filesystem::temp_directory_path() /
+            ("envy-depot-dict-test-" + std::to_string(rng())) };
+  std::filesystem::create_directories(dir);
+  return dir;
+}
+
+// A header-heavy tree: many small files sharing license and declaration boilerplate,
+// each with its own names. `seed` varies the names between trees.
+void write_header_tree(std::filesystem::path const &root, int files, unsigned seed) {
+  std::mt19937 rng{ seed };
+  for (int i{ 0 }; i < files; ++i) {
+    std::string const name{ "mod" + std::to_string(rng() % 100000) + "_" +
+                            std::to_string(i) };
+    auto const path{ root / "include" / ("sub" + std::to_string(i % 7)) / (name + ".h") };
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream out{ path };
+    out << "// SPDX-License-Identifier: Apache-2.0\n"
+        << "// Copyright (c) The Example Toolchain Authors. All rights reserved.\n"
+        << "// Licensed under the Apache License, Version 2.0 (the \"License\").\n\n"
+        << "#ifndef EXAMPLE_" << name << "_H\n#define EXAMPLE_" << name << "_H\n\n"
+        << "#include <stddef.h>\n#include <stdint.h>\n\n"
+        << "#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n"
+        << "typedef struct " << name << "_ctx " << name << "_ctx_t;\n\n"
+        << name << "_ctx_t *" << name << "_create(size_t capacity);\n"
+        << "void " << name << "_destroy(" << name << "_ctx_t *ctx);\n"
+        << "int " << name << "_update(" << name
+        << "_ctx_t *ctx, const void *data, size_t len);\n"
+        << "uint32_t " << name << "_finish(" << name << "_ctx_t *ctx);\n\n"
+        << "#ifdef __cplusplus\n}  /* extern \"C\" */\n#endif\n\n"
+        << "#endif  /* EXAMPLE_" << name << "_H */\n";
+  }
+}
+
+}  // namespace
+
+TEST_CASE("depot dictionary round trip on a header-heavy tree") {
+  auto const root{ make_temp_dir() };
+  write_header_tree(root / "train", 400, 1);
+  write_header_tree(root / "tree", 16, 2);  // Small: where a dictionary pays off most
+
+  auto const dict{ envy::depot_dict_train({ root / "train" }) };
+  auto const id{ envy::depot_dict_id(dict) };
+  CHECK(id != 0);
+
+  envy::archive_create_tar_zst(root / "plain.tar.zst", root / "tree", "pkg");
+  auto const result{ envy::archive_create_tar_zst(root / "dict.tar.zst",
+                                                  root / "tree",
+                                                  "pkg",
+                                                  { .zstd_dictionary = dict }) };
+  CHECK(result.files == 16);
+  CHECK(result.sha256 == envy::sha256(root / "dict.tar.zst"));
+
+  auto const plain_size{ std::filesystem::file_size(root / "plain.tar.zst") };
+  auto const dict_size{ std::filesystem::file_size(root / "dict.tar.zst") };
+  CHECK(dict_size < plain_size);
+
+  CHECK_FALSE(envy::depot_dict_id_of_archive(root / "plain.tar.zst").has_value());
+  auto const frame_id{ envy::depot_dict_id_of_archive(root / "dict.tar.zst") };
+  REQUIRE(frame_id.has_value());
+  CHECK(*frame_id == id);
+
+  SUBCASE("with the dictionary") {
+    auto const totals{ envy::compute_archive_totals(root / "dict.tar.zst", dict) };
+    CHECK(totals.files == 16);
+    CHECK(envy::extract(root / "dict.tar.zst",
+                        root / "out",
+                        { .zstd_dictionary = dict }) == 16);
+    for (auto const &e : std::filesystem::recursive_directory_iterator(root / "tree")) {
+      if (!e.is_regular_file()) { continue; }
+      auto const rel{ std::filesystem::relative(e.path(), root / "tree") };
+      CHECK(envy::sha256(root / "out" / "pkg" / rel) == envy::sha256(e.path()));
+    }
+  }
+
+  SUBCASE("without a dictionary") {
+    CHECK(envy::extract(root / "plain.tar.zst", root / "out") == 16);
+    CHECK_THROWS(envy::extract(root / "dict.tar.zst", root / "out2"));
+  }
+
+  SUBCASE("with the wrong dictionary") {
+    write_header_tree(root / "other", 200, 3);
+    auto const other{ envy::depot_dict_train({ root / "other" }, { .dict_size = 4096 }) };
+    CHECK_THROWS(envy::extract(root / "dict.tar.zst",
+                               root / "out3",
+                               { .zstd_dictionary = other }));
+  }
+
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("depot_dict_train samples exported archives") {
+  auto const root{ make_temp_dir() };
+  write_header_tree(root / "tree", 300, 4);
+  envy::archive_create_tar_zst(root / "a.tar.zst", root / "tree", "pkg");
+
+  auto const from_archive{ envy::depot_dict_train({ root / "a.tar.zst" }) };
+  auto const from_dir{ envy::depot_dict_train({ root / "tree" }) };
+  CHECK(envy::depot_dict_id(from_archive) != 0);
+  // Same file contents in the same order either way.
+  CHECK(from_archive == from_dir);
+
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("depot_dict_train rejects inputs without files") {
+  auto const root{ make_temp_dir() };
+  std::filesystem::create_directories(root / "empty");
+  CHECK_THROWS(envy::depot_dict_train({ root / "empty" }));
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("depot_dict_load checks the dictionary ID and SHA256") {
+  auto const root{ make_temp_dir() };
+  write_header_tree(root / "tree", 300, 5);
+  auto const dict{ envy::depot_dict_train({ root / "tree" }) };
+  auto const id{ envy::depot_dict_id(dict) };
+  {
+    std::ofstream out{ root / "d.zdict", std::ios::binary };
+    out.write(reinterpret_cast<char const *>(dict.data()),
+              static_cast<std::streamsize>(dict.size()));
+  }
+  std::ofstream{ root / "raw.zdict" } << "not a dictionary";
+
+  CHECK(envy::depot_dict_load(root / "d.zdict", id) == dict);
+  CHECK(envy::depot_dict_load(root / "d.zdict") == dict);
+  CHECK_THROWS(envy::depot_dict_load(root / "d.zdict", id + 1));
+  CHECK_THROWS(envy::depot_dict_load(root / "raw.zdict"));
+
+  auto const sha{ envy::depot_dict_sha256(dict) };
+  CHECK(sha.size() == 64);
+  CHECK(envy::depot_dict_load(root / "d.zdict", id, sha) == dict);
+  CHECK_THROWS(envy::depot_dict_load(root / "d.zdict", id, std::string(64, '0')));
+
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("depot_dict_url resolves beside the archive") {
+  CHECK(envy::depot_dict_url("https://cdn/depot/a@v1-linux-x86_64-blake3-00.tar.zst",
+                             42) == "https://cdn/depot/dicts/42.zdict");
+  CHECK(envy::depot_dict_url("a.tar.zst", 7) == "dicts/7.zdict");
+  CHECK(envy::depot_dict_filename(7) == "7.zdict");
+}
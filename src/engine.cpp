@@ -21,9 +21,13 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <exception>
 #include <filesystem>
+#include <optional>
 #include <sstream>
 #include <string_view>
+#include <thread>
 #include <unordered_set>
 #include <vector>
 
@@ -44,6 +48,10 @@ static_assert(kDependencySatisfiedWatermark == static_cast<int>(pkg_phase::pkg_e
                   kDependencySatisfiedWatermark < static_cast<int>(pkg_phase::completion),
               "pkg_setup must be followed by pkg_export before completion");
 
+// Depot FETCH functions mostly wait on the network, but each running call holds a
+// manifest worker state (a re-run of the manifest), so only a few run at once.
+constexpr std::size_t kMaxDepotFetchJobs{ 4 };
+
 using phase_func_t = void (*)(pkg *, engine &);
 
 constexpr std::array<phase_func_t, pkg_phase_count> phase_dispatch_table{
@@ -342,9 +350,17 @@ engine::engine(cache &cache, manifest const *manifest)
     : cache_(cache),
       default_shell_(manifest ? manifest->get_default_shell() : std::nullopt),
       manifest_(manifest),
+      spec_meta_(cache.root() / "spec-meta"),
       core_(make_trace_observer()) {}
 
-engine::~engine() = default;  // core_ (declared last) fails + joins workers first
+// core_ (declared last) fails + joins workers after this body. Commands still running
+// then (only after a failure) are missing from the shell usage report.
+engine::~engine() {
+  try {
+    shell_stats_.report();
+  } catch (...) {}
+  spec_meta_.prune();
+}
 
 std::string engine::trace_display(std::string const &key) const {
   if (is_setup_pair_key(key)) { return key; }
@@ -646,6 +662,8 @@ void engine::extend_dependencies_to_completion(pkg *p) {
 
 std::filesystem::path const &engine::cache_root() const { return cache_.root(); }
 
+cache const &engine::get_cache() const { return cache_; }
+
 manifest const *engine::get_manifest() const { return manifest_; }
 
 void engine::set_depot_index(package_depot_index idx) {
@@ -668,6 +686,10 @@ void engine::record_export_result(pkg_key const &key, std::string output_line) {
   export_results_[key.canonical()] = std::move(output_line);
 }
 
+shell_stats &engine::shell_usage() { return shell_stats_; }
+
+spec_meta_cache const &engine::spec_metadata() const { return spec_meta_; }
+
 std::string const *engine::get_export_result(pkg_key const &key) const {
   std::lock_guard const lock{ mutex_ };
   auto it{ export_results_.find(key.canonical()) };
@@ -793,7 +815,14 @@ void engine::run_depot_step() {
     }
     merged.merge(package_depot_index::build(urls, depot_tmp));
 
-    for (auto const &[lua_index, deps] : depot_fn_deps_) {
+    // FETCH functions run concurrently on up to kMaxDepotFetchJobs threads, each call in
+    // a manifest worker state; results merge in declaration order so later depots still
+    // win ties.
+    std::vector<std::optional<manifest::depot_fetch_result>> results(
+        depot_fn_deps_.size());
+    std::vector<std::exception_ptr> errors(depot_fn_deps_.size());
+    auto const run_fetch{ [&](std::size_t i) {
+      auto const &[lua_index, deps]{ depot_fn_deps_[i] };
       std::vector<std::pair<std::string, std::string>> dep_paths;
       dep_paths.reserve(deps.size());
       for (pkg *dep : deps) {
@@ -804,9 +833,32 @@ void engine::run_depot_step() {
                          .p = nullptr,
                          .run_dir = depot_tmp,
                          .lock = nullptr };
-      auto const result{
-        manifest_->run_depot_fetch(lua_index, &ctx, depot_tmp, dep_paths)
-      };
+      try {
+        results[i] = manifest_->run_depot_fetch(lua_index, &ctx, depot_tmp, dep_paths);
+      } catch (...) { errors[i] = std::current_exception(); }
+    } };
+
+    {
+      std::size_t const jobs{ std::min(
+          { depot_fn_deps_.size(),
+            kMaxDepotFetchJobs,
+            std::max<std::size_t>(1, std::thread::hardware_concurrency()) }) };
+      std::atomic<std::size_t> next{ 0 };
+      auto const work{ [&] {
+        for (std::size_t i{ next++ }; i < depot_fn_deps_.size(); i = next++) {
+          run_fetch(i);
+        }
+      } };
+      std::vector<std::thread> workers;
+      workers.reserve(jobs);
+      for (std::size_t t{ 1 }; t < jobs; ++t) { workers.emplace_back(work); }
+      if (jobs > 0) { work(); }
+      for (auto &w : workers) { w.join(); }
+    }
+
+    for (std::size_t i{ 0 }; i < results.size(); ++i) {
+      if (errors[i]) { std::rethrow_exception(errors[i]); }
+      auto const &result{ *results[i] };
 
       if (auto const *text{ std::get_if<std::string>(&result) }) {
         // A newline-free string naming an existing file is a path to depot
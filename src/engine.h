@@ -7,6 +7,8 @@
 #include "pkg_key.h"
 #include "pkg_phase.h"
 #include "shell.h"
+#include "shell_stats.h"
+#include "spec_meta_cache.h"
 #include "task_engine.h"
 #include "util.h"
 
@@ -45,6 +47,10 @@ struct export_phase_config {
   std::filesystem::path output_dir;
   std::optional<std::string> depot_prefix;
   bool explicitly_requested{ false };
+  bool dedupe_content{ false };
+  bool chunked{ false };  // Write a chunk index + chunks/ instead of one .tar.zst
+  std::optional<std::filesystem::path> delta_from;  // Dir of earlier .tar.zst artifacts
+  std::vector<unsigned char> zstd_dictionary;  // See depot_dict.h; empty for none
   std::unordered_set<pkg_key> export_targets;
 };
 
@@ -106,6 +112,7 @@ class engine : unmovable {
   void extend_dependencies_to_completion(pkg *p);
 
   std::filesystem::path const &cache_root() const;
+  cache const &get_cache() const;
 
   // Bundle registry management
   // Register a fetched bundle; returns existing if already registered
@@ -140,6 +147,12 @@ class engine : unmovable {
   void record_export_result(pkg_key const &key, std::string output_line);
   std::string const *get_export_result(pkg_key const &key) const;
 
+  // Resource usage of package shell commands; reported when the engine is destroyed
+  shell_stats &shell_usage();
+
+  // Static spec facts keyed by spec content, under $CACHE/spec-meta
+  spec_meta_cache const &spec_metadata() const;
+
 #ifdef ENVY_UNIT_TEST
   pkg_phase get_pkg_target_phase(pkg_key const &key) const;
 #endif
@@ -204,6 +217,9 @@ class engine : unmovable {
   std::optional<export_phase_config> export_config_;
   std::unordered_map<std::string, std::string> export_results_;  // guarded by mutex_
 
+  shell_stats shell_stats_;
+  spec_meta_cache spec_meta_;
+
   // Declared last: workers capture pkg*/this, so the core (which joins them)
   // must be destroyed before the maps above.
   task_engine core_;
@@ -1,22 +1,30 @@
 #include "extract.h"
 
+#include "platform.h"
 #include "trace.h"
 #include "tui.h"
 #include "util.h"
 
 #include "archive.h"
 #include "archive_entry.h"
+#include "zstd.h"
 
 #include <algorithm>
+#include <cerrno>
 #include <chrono>
 #include <cstdint>
+#include <cstdio>
 #include <filesystem>
 #include <fstream>
+#include <map>
+#include <memory>
 #include <optional>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace envy {
@@ -63,6 +71,209 @@ struct archive_writer : unmovable {
   archive *handle{ nullptr };
 };
 
+// Output sink for archive_write_open2: forwards archive bytes to the caller's sink and
+// folds them into both digests in the same pass.
+struct archive_digest_sink : unmovable {
+  explicit archive_digest_sink(archive_byte_sink_t const &out) : out{ out } {}
+
+  static la_ssize_t write_cb(archive *a, void *client, void const *buf, size_t len) {
+    auto *self{ static_cast<archive_digest_sink *>(client) };
+    try {  // Never let an exception unwind through libarchive's C frames
+      self->out(buf, len);
+      self->sha256.update(buf, len);
+      self->blake3.update(buf, len);
+    } catch (std::exception const &e) {
+      archive_set_error(a, EIO, "%s", e.what());
+      return -1;
+    }
+    return static_cast<la_ssize_t>(len);
+  }
+
+  archive_byte_sink_t const &out;
+  sha256_hasher sha256;
+  blake3_hasher blake3;
+};
+
+struct archive_stream_writer : unmovable {
+  archive_stream_writer() : handle(archive_write_new()) {
+    if (!handle) { throw std::runtime_error("archive_write_new failed"); }
+  }
+
+  ~archive_stream_writer() {
+    if (handle) { archive_write_free(handle); }
+  }
+
+  archive *handle{ nullptr };
+};
+
+void zstd_check(std::size_t rc, char const *what) {
+  if (ZSTD_isError(rc)) {
+    throw std::runtime_error(std::string("zstd: ") + what + ": " + ZSTD_getErrorName(rc));
+  }
+}
+
+// libarchive's zstd filter cannot load a dictionary. This source decompresses such a file
+// itself and hands libarchive the plain tar through archive_read_open.
+struct zstd_dict_source : unmovable {
+  zstd_dict_source(std::filesystem::path const &path,
+                   std::span<unsigned char const> dictionary)
+      : file{ util_open_file(path, "rb") },
+        dctx{ ZSTD_createDCtx(), &ZSTD_freeDCtx },
+        in(ZSTD_DStreamInSize()),
+        out(ZSTD_DStreamOutSize()) {
+    if (!file) { throw std::runtime_error("Failed to open archive: " + path.string()); }
+    if (!dctx) { throw std::runtime_error("zstd: ZSTD_createDCtx failed"); }
+    zstd_check(ZSTD_DCtx_loadDictionary(dctx.get(), dictionary.data(), dictionary.size()),
+               "load dictionary");
+  }
+
+  static la_ssize_t read_cb(archive *a, void *client, void const **buffer) {
+    auto *self{ static_cast<zstd_dict_source *>(client) };
+    while (true) {
+      if (self->input.pos == self->input.size) {
+        std::size_t const n{
+          std::fread(self->in.data(), 1, self->in.size(), self->file.get())
+        };
+        if (n == 0) {
+          if (std::ferror(self->file.get()) || self->last_rc != 0) {
+            archive_set_error(a, EIO, "zstd: truncated or unreadable archive");
+            return -1;
+          }
+          return 0;
+        }
+        self->input = ZSTD_inBuffer{ self->in.data(), n, 0 };
+      }
+
+      ZSTD_outBuffer output{ self->out.data(), self->out.size(), 0 };
+      self->last_rc = ZSTD_decompressStream(self->dctx.get(), &output, &self->input);
+      if (ZSTD_isError(self->last_rc)) {
+        archive_set_error(a, EIO, "zstd: %s", ZSTD_getErrorName(self->last_rc));
+        return -1;
+      }
+      if (output.pos > 0) {
+        *buffer = self->out.data();
+        return static_cast<la_ssize_t>(output.pos);
+      }
+    }
+  }
+
+  file_ptr_t file;
+  std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx;
+  std::vector<unsigned char> in;
+  std::vector<unsigned char> out;
+  ZSTD_inBuffer input{};
+  std::size_t last_rc{ 0 };
+};
+
+// Opens archive_path on reader, through source when a dictionary is given. source must
+// outlive the reader's use of it. Returns libarchive's status.
+int open_archive(archive_reader &reader,
+                 std::filesystem::path const &archive_path,
+                 std::span<unsigned char const> zstd_dictionary,
+                 std::optional<zstd_dict_source> &source) {
+  if (zstd_dictionary.empty()) {
+    return archive_read_open_filename(reader.handle, archive_path.string().c_str(), 10240);
+  }
+  source.emplace(archive_path, zstd_dictionary);
+  return archive_read_open(reader.handle,
+                           &*source,
+                           nullptr,
+                           zstd_dict_source::read_cb,
+                           nullptr);
+}
+
+// Streaming zstd compressor against a dictionary, for archive_create_tar_zst. Mirrors the
+// libarchive filter's defaults plus a content checksum, so a wrong dictionary of the
+// right ID cannot go unnoticed.
+class zstd_dict_compressor : unmovable {
+ public:
+  zstd_dict_compressor(std::span<unsigned char const> dictionary, archive_byte_sink_t out)
+      : cctx_{ ZSTD_createCCtx(), &ZSTD_freeCCtx },
+        out_{ std::move(out) },
+        buf_(ZSTD_CStreamOutSize()) {
+    if (!cctx_) { throw std::runtime_error("zstd: ZSTD_createCCtx failed"); }
+    zstd_check(ZSTD_CCtx_setParameter(cctx_.get(),
+                                      ZSTD_c_compressionLevel,
+                                      ZSTD_CLEVEL_DEFAULT),
+               "set level");
+    zstd_check(ZSTD_CCtx_setParameter(cctx_.get(), ZSTD_c_checksumFlag, 1),
+               "set checksum");
+    zstd_check(ZSTD_CCtx_loadDictionary(cctx_.get(), dictionary.data(), dictionary.size()),
+               "load dictionary");
+  }
+
+  void update(void const *data, std::size_t size) {
+    ZSTD_inBuffer input{ data, size, 0 };
+    while (input.pos < input.size) { drain(input, ZSTD_e_continue); }
+  }
+
+  void finish() {
+    ZSTD_inBuffer input{ nullptr, 0, 0 };
+    while (drain(input, ZSTD_e_end) != 0) {}
+  }
+
+ private:
+  std::size_t drain(ZSTD_inBuffer &input, ZSTD_EndDirective mode) {
+    ZSTD_outBuffer output{ buf_.data(), buf_.size(), 0 };
+    std::size_t const remaining{
+      ZSTD_compressStream2(cctx_.get(), &output, &input, mode)
+    };
+    zstd_check(remaining, "compress");
+    if (output.pos > 0) { out_(buf_.data(), output.pos); }
+    return remaining;
+  }
+
+  std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx_;
+  archive_byte_sink_t out_;
+  std::vector<unsigned char> buf_;
+};
+
+struct archive_source_entry {
+  std::filesystem::path path;
+  std::filesystem::path rel;
+  std::filesystem::file_type type{ std::filesystem::file_type::none };
+  std::uint64_t size{ 0 };
+  std::optional<std::filesystem::perms> perms;
+  std::optional<std::pair<std::uint64_t, std::uint64_t>> inode;  // Set when nlink > 1
+  std::optional<std::size_t> link_to;  // Index of the earlier entry this one hardlinks
+};
+
+// Link later regular files to an earlier entry with identical size, permissions and
+// BLAKE3. Only sizes shared by two or more unlinked files are hashed at all.
+void link_duplicate_content(std::vector<archive_source_entry> &entries) {
+  std::map<std::uint64_t, std::vector<std::size_t>> by_size;
+  for (std::size_t i{ 0 }; i < entries.size(); ++i) {
+    auto const &e{ entries[i] };
+    if (e.type == std::filesystem::file_type::regular && !e.link_to && e.size > 0) {
+      by_size[e.size].push_back(i);
+    }
+  }
+
+  for (auto const &[size, indices] : by_size) {
+    if (indices.size() < 2) { continue; }
+    std::map<blake3_t, std::vector<std::size_t>> by_content;
+    for (std::size_t const i : indices) {
+      auto &candidates{ by_content[blake3_file_parallel(entries[i].path)] };
+      auto const match{ std::ranges::find_if(candidates, [&](std::size_t c) {
+        return entries[c].perms == entries[i].perms;
+      }) };
+      if (match != candidates.end()) {
+        entries[i].link_to = *match;
+      } else {
+        candidates.push_back(i);
+      }
+    }
+  }
+
+  // Inode followers may point at an entry that content dedupe just linked; collapse
+  // chains so every link names a stored file. Targets always precede their links.
+  for (auto &e : entries) {
+    while (e.link_to && entries[*e.link_to].link_to) {
+      e.link_to = entries[*e.link_to].link_to;
+    }
+  }
+}
+
 void ensure_directory(std::filesystem::path const &path) {
   auto const dir{ path.parent_path() };
   if (dir.empty()) { return; }
@@ -74,6 +285,17 @@ void ensure_directory(std::filesystem::path const &path) {
   }
 }
 
+// True if path, with symlinks resolved, is root or lies beneath it. root must already be
+// canonical.
+bool resolves_within(std::filesystem::path const &root,
+                     std::filesystem::path const &path) {
+  std::error_code ec;
+  auto const resolved{ std::filesystem::weakly_canonical(path, ec) };
+  if (ec) { return false; }
+  auto const rel{ resolved.lexically_relative(root) };
+  return !rel.empty() && *rel.begin() != "..";
+}
+
 std::optional<std::string> strip_path_components(char const *path, int strip_count) {
   if (!path) { return std::nullopt; }
   if (strip_count <= 0) { return std::string(path); }
@@ -219,6 +441,175 @@ struct extract_tui_state {
   }
 };
 
+archive_create_result write_archive(archive_byte_sink_t const &out,
+                                    bool compress,
+                                    std::filesystem::path const &source_dir,
+                                    std::string const &prefix,
+                                    archive_create_options const &options) {
+  // Single metadata walk: everything the archive loop and the progress totals need.
+  // Regular files with more than one link are keyed by inode so later names are stored
+  // as hardlinks to the first.
+  std::vector<archive_source_entry> entries;
+  std::map<std::pair<std::uint64_t, std::uint64_t>, std::size_t> first_by_inode;
+  for (auto const &dir_entry : std::filesystem::recursive_directory_iterator(source_dir)) {
+    archive_source_entry e{ .path = dir_entry.path(),
+                            .rel = dir_entry.path().lexically_relative(source_dir) };
+    if (dir_entry.is_symlink()) {
+      e.type = std::filesystem::file_type::symlink;
+    } else if (dir_entry.is_directory()) {
+      e.type = std::filesystem::file_type::directory;
+    } else if (dir_entry.is_regular_file()) {
+      e.type = std::filesystem::file_type::regular;
+      e.size = dir_entry.file_size();
+      if (auto const id{ platform::get_file_identity(dir_entry.path()) };
+          id && id->link_count > 1) {
+        e.inode = std::pair{ id->device, id->inode };
+      }
+    } else {
+      continue;
+    }
+
+    std::error_code ec;
+    auto const st{ std::filesystem::status(dir_entry.path(), ec) };
+    if (!ec) { e.perms = st.permissions(); }
+    entries.push_back(std::move(e));
+  }
+
+  // Directory iteration order is filesystem-specific; sort so the stream is reproducible.
+  // Parents sort before their children, and hardlink targets before their links.
+  std::ranges::sort(entries, {}, &archive_source_entry::rel);
+  for (std::size_t i{ 0 }; i < entries.size(); ++i) {
+    if (!entries[i].inode) { continue; }
+    auto const [it, inserted]{ first_by_inode.try_emplace(*entries[i].inode, i) };
+    if (!inserted) { entries[i].link_to = it->second; }
+  }
+
+  if (options.dedupe_content) { link_duplicate_content(entries); }
+
+  extract_totals totals{};
+  for (auto const &e : entries) {
+    if (e.type != std::filesystem::file_type::regular) { continue; }
+    ++totals.files;
+    if (!e.link_to) { totals.bytes += e.size; }
+  }
+
+  archive_digest_sink sink{ out };
+  archive_stream_writer writer;
+  archive *const a{ writer.handle };
+
+  archive_write_set_format_pax_restricted(a);
+  if (compress) { archive_write_add_filter_zstd(a); }
+  // Custom sinks default to padding the final block with zeros; the output (and its
+  // digests) should end where the stream does. This also keeps the plain tar identical
+  // to what the zstd filter consumes for the same tree.
+  archive_write_set_bytes_in_last_block(a, 1);
+
+  if (archive_write_open2(a,
+                          &sink,
+                          nullptr,
+                          archive_digest_sink::write_cb,
+                          nullptr,
+                          nullptr) != ARCHIVE_OK) {
+    throw std::runtime_error(std::string("Failed to open output: ") +
+                             archive_error_string(a));
+  }
+
+  archive_entry *entry{ archive_entry_new() };
+  std::unique_ptr<archive_entry, decltype(&archive_entry_free)> entry_scope{
+    entry,
+    &archive_entry_free
+  };
+
+  archive_create_result result{};
+  std::vector<char> buffer(1024 * 1024);
+
+  auto const report{ [&](std::filesystem::path const &rel, bool is_regular) {
+    if (!options.progress) { return; }
+    options.progress({ .bytes_processed = result.bytes,
+                       .total_bytes = totals.bytes,
+                       .files_processed = result.files,
+                       .total_files = totals.files,
+                       .current_entry = rel,
+                       .is_regular_file = is_regular });
+  } };
+
+  for (auto const &e : entries) {
+    std::string const archived_path{ prefix + "/" + e.rel.generic_string() };
+    bool const is_regular{ e.type == std::filesystem::file_type::regular };
+
+    archive_entry_clear(entry);
+    archive_entry_set_pathname(entry, archived_path.c_str());
+
+    switch (e.type) {
+      case std::filesystem::file_type::symlink: {
+        archive_entry_set_filetype(entry, AE_IFLNK);
+        auto const target{ std::filesystem::read_symlink(e.path) };
+        archive_entry_set_symlink(entry, target.string().c_str());
+        archive_entry_set_size(entry, 0);
+        break;
+      }
+      case std::filesystem::file_type::directory:
+        archive_entry_set_filetype(entry, AE_IFDIR);
+        archive_entry_set_size(entry, 0);
+        break;
+      default:
+        archive_entry_set_filetype(entry, AE_IFREG);
+        if (e.link_to) {
+          std::string const target{ prefix + "/" +
+                                    entries[*e.link_to].rel.generic_string() };
+          archive_entry_set_hardlink(entry, target.c_str());
+          archive_entry_set_size(entry, 0);
+        } else {
+          archive_entry_set_size(entry, static_cast<la_int64_t>(e.size));
+        }
+        break;
+    }
+
+    // Preserve permissions
+    if (e.perms) { archive_entry_set_perm(entry, static_cast<__LA_MODE_T>(*e.perms)); }
+
+    report(e.rel, is_regular);
+
+    if (archive_write_header(a, entry) != ARCHIVE_OK) {
+      throw std::runtime_error(std::string("Failed to write header: ") +
+                               archive_error_string(a));
+    }
+
+    if (!is_regular) { continue; }
+    if (e.link_to) {
+      ++result.files;
+      ++result.hardlinks;
+      continue;
+    }
+
+    std::ifstream in{ e.path, std::ios::binary };
+    if (!in) { throw std::runtime_error("Failed to open file: " + e.path.string()); }
+
+    while (in) {
+      in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+      auto const bytes_read{ in.gcount() };
+      if (bytes_read <= 0) { continue; }
+      if (archive_write_data(a, buffer.data(), static_cast<size_t>(bytes_read)) < 0) {
+        throw std::runtime_error(std::string("Failed to write data: ") +
+                                 archive_error_string(a));
+      }
+      result.bytes += static_cast<std::uint64_t>(bytes_read);
+      report(e.rel, true);
+    }
+    ++result.files;
+  }
+
+  // Close flushes the final zstd frame through the sink; only then are digests complete.
+  if (archive_write_close(a) != ARCHIVE_OK) {
+    throw std::runtime_error(std::string("Failed to finalize archive: ") +
+                             archive_error_string(a));
+  }
+
+  result.sha256 = sink.sha256.finalize();
+  result.blake3 = sink.blake3.finalize();
+  return result;
+}
+
 }  // namespace
 
 bool extract_is_safe_archive_path(char const *path) {
@@ -239,112 +630,57 @@ bool extract_is_safe_archive_path(char const *path) {
   return true;
 }
 
-std::uint64_t archive_create_tar_zst(std::filesystem::path const &output_path,
-                                     std::filesystem::path const &source_dir,
-                                     std::string const &prefix,
-                                     extract_progress_cb_t const &progress) {
-  archive *a{ archive_write_new() };
-  if (!a) { throw std::runtime_error("archive_write_new failed"); }
-
-  archive_write_set_format_pax_restricted(a);
-  archive_write_add_filter_zstd(a);
-
+archive_create_result archive_create_tar_zst(std::filesystem::path const &output_path,
+                                             std::filesystem::path const &source_dir,
+                                             std::string const &prefix,
+                                             archive_create_options const &options) {
   ensure_directory(output_path);
-
-  if (archive_write_open_filename(a, output_path.string().c_str()) != ARCHIVE_OK) {
-    std::string msg{ std::string("Failed to open output: ") + archive_error_string(a) };
-    archive_write_free(a);
-    throw std::runtime_error(msg);
+  auto const file{ util_open_file(output_path, "wb") };
+  if (!file) {
+    throw std::runtime_error("Failed to open output: " + output_path.string());
   }
 
-  archive_entry *entry{ archive_entry_new() };
-  std::uint64_t files_archived{ 0 };
-  std::uint64_t bytes_processed{ 0 };
-  std::vector<char> buffer(1024 * 1024);
-
-  for (auto const &dir_entry : std::filesystem::recursive_directory_iterator(source_dir)) {
-    std::filesystem::path const rel{ dir_entry.path().lexically_relative(source_dir) };
-    std::string const archived_path{ prefix + "/" + rel.generic_string() };
-
-    archive_entry_clear(entry);
-    archive_entry_set_pathname(entry, archived_path.c_str());
-
-    bool const is_regular{ dir_entry.is_regular_file() };
-
-    if (dir_entry.is_symlink()) {
-      archive_entry_set_filetype(entry, AE_IFLNK);
-      auto const target{ std::filesystem::read_symlink(dir_entry.path()) };
-      archive_entry_set_symlink(entry, target.string().c_str());
-      archive_entry_set_size(entry, 0);
-    } else if (dir_entry.is_directory()) {
-      archive_entry_set_filetype(entry, AE_IFDIR);
-      archive_entry_set_size(entry, 0);
-    } else if (is_regular) {
-      archive_entry_set_filetype(entry, AE_IFREG);
-      auto const sz{ std::filesystem::file_size(dir_entry.path()) };
-      archive_entry_set_size(entry, static_cast<la_int64_t>(sz));
-    } else {
-      continue;
-    }
-
-    // Preserve permissions
-    std::error_code ec;
-    auto const perms{ std::filesystem::status(dir_entry.path(), ec).permissions() };
-    if (!ec) { archive_entry_set_perm(entry, static_cast<__LA_MODE_T>(perms)); }
-
-    if (progress) {
-      progress({ .bytes_processed = bytes_processed,
-                 .files_processed = files_archived,
-                 .current_entry = rel,
-                 .is_regular_file = is_regular });
+  auto const write_file{ [&](void const *data, std::size_t size) {
+    if (std::fwrite(data, 1, size, file.get()) != size) {
+      throw std::runtime_error("write failed: " + output_path.string());
     }
+  } };
+
+  archive_create_result result;
+  if (options.zstd_dictionary.empty()) {
+    result = write_archive(write_file, true, source_dir, prefix, options);
+  } else {
+    // Compress the plain tar here; the digests must cover the compressed bytes.
+    sha256_hasher sha;
+    blake3_hasher b3;
+    zstd_dict_compressor compressor{ options.zstd_dictionary,
+                                     [&](void const *data, std::size_t size) {
+                                       write_file(data, size);
+                                       sha.update(data, size);
+                                       b3.update(data, size);
+                                     } };
+    result = write_archive(
+        [&](void const *data, std::size_t size) { compressor.update(data, size); },
+        false,
+        source_dir,
+        prefix,
+        options);
+    compressor.finish();
+    result.sha256 = sha.finalize();
+    result.blake3 = b3.finalize();
+  }
 
-    if (archive_write_header(a, entry) != ARCHIVE_OK) {
-      std::string msg{ std::string("Failed to write header: ") + archive_error_string(a) };
-      archive_entry_free(entry);
-      archive_write_close(a);
-      archive_write_free(a);
-      throw std::runtime_error(msg);
-    }
-
-    if (is_regular) {
-      std::ifstream in{ dir_entry.path(), std::ios::binary };
-      if (!in) {
-        archive_entry_free(entry);
-        archive_write_close(a);
-        archive_write_free(a);
-        throw std::runtime_error("Failed to open file: " + dir_entry.path().string());
-      }
-
-      while (in) {
-        in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
-        auto const bytes_read{ in.gcount() };
-        if (bytes_read > 0) {
-          if (archive_write_data(a, buffer.data(), static_cast<size_t>(bytes_read)) < 0) {
-            std::string msg{ std::string("Failed to write data: ") +
-                             archive_error_string(a) };
-            archive_entry_free(entry);
-            archive_write_close(a);
-            archive_write_free(a);
-            throw std::runtime_error(msg);
-          }
-          bytes_processed += static_cast<std::uint64_t>(bytes_read);
-          if (progress) {
-            progress({ .bytes_processed = bytes_processed,
-                       .files_processed = files_archived,
-                       .current_entry = rel,
-                       .is_regular_file = true });
-          }
-        }
-      }
-      ++files_archived;
-    }
+  if (std::fflush(file.get()) != 0) {
+    throw std::runtime_error("flush failed: " + output_path.string());
   }
+  return result;
+}
 
-  archive_entry_free(entry);
-  archive_write_close(a);
-  archive_write_free(a);
-  return files_archived;
+archive_create_result archive_create_tar(archive_byte_sink_t const &sink,
+                                         std::filesystem::path const &source_dir,
+                                         std::string const &prefix,
+                                         archive_create_options const &options) {
+  return write_archive(sink, false, source_dir, prefix, options);
 }
 
 std::uint64_t extract(std::filesystem::path const &archive_path,
@@ -363,11 +699,11 @@ std::uint64_t extract(std::filesystem::path const &archive_path,
         archive_path.string());
   }
 
+  std::optional<zstd_dict_source> source;
   archive_reader reader{ bare_name.has_value() };
   archive_writer writer;
 
-  if (archive_read_open_filename(reader.handle, archive_path.string().c_str(), 10240) !=
-      ARCHIVE_OK) {
+  if (open_archive(reader, archive_path, options.zstd_dictionary, source) != ARCHIVE_OK) {
     throw std::runtime_error(std::string("Failed to open archive: ") +
                              archive_error_string(reader.handle));
   }
@@ -404,7 +740,9 @@ std::uint64_t extract(std::filesystem::path const &archive_path,
     char const *entry_path{ archive_entry_pathname(entry) };
     if (!entry_path) { throw std::runtime_error("Archive entry has null pathname"); }
 
-    bool const is_regular_file{ archive_entry_filetype(entry) == AE_IFREG };
+    // Tar hardlink entries carry no file type of their own; they name a regular file.
+    bool const is_regular_file{ archive_entry_filetype(entry) == AE_IFREG ||
+                                archive_entry_hardlink(entry) != nullptr };
 
     std::string stripped_path;
     if (options.strip_components > 0) {
@@ -427,6 +765,7 @@ std::uint64_t extract(std::filesystem::path const &archive_path,
       archive_entry_copy_pathname(entry, full_path_str.c_str());
     }
 
+    bool cloned{ false };
     if (char const *hardlink{ archive_entry_hardlink(entry) }) {
       std::string hardlink_str{ hardlink };
       if (options.strip_components > 0) {
@@ -439,6 +778,18 @@ std::uint64_t extract(std::filesystem::path const &archive_path,
       }
       std::string const hardlink_full{ (destination / hardlink_str).string() };
       archive_entry_copy_hardlink(entry, hardlink_full.c_str());
+
+      // Cloning bypasses libarchive's symlink checks, so both ends must resolve inside
+      // the destination; anything else takes the hard-link path below.
+      if (options.clone_hardlinks) {
+        std::filesystem::path const target{ destination / hardlink_str };
+        std::error_code ec;
+        cloned = std::filesystem::symlink_status(target, ec).type() ==
+                     std::filesystem::file_type::regular &&
+                 resolves_within(destination, target) &&
+                 resolves_within(destination, full_path.parent_path()) &&
+                 platform::clone_file(target, full_path);
+      }
     }
 
     if (options.progress &&
@@ -451,6 +802,11 @@ std::uint64_t extract(std::filesystem::path const &archive_path,
       throw std::runtime_error("extract: aborted by progress callback");
     }
 
+    if (cloned) {
+      ++files_extracted;
+      continue;
+    }
+
     if (int const write_header_result{ archive_write_header(writer.handle, entry) };
         write_header_result != ARCHIVE_OK && write_header_result != ARCHIVE_WARN) {
       throw std::runtime_error(std::string("Failed to write entry header: ") +
@@ -548,12 +904,13 @@ std::optional<std::filesystem::path> extract_bare_compressed_output_name(
   return stem;
 }
 
-extract_totals compute_archive_totals(std::filesystem::path const &archive_path) {
+extract_totals compute_archive_totals(std::filesystem::path const &archive_path,
+                                      std::span<unsigned char const> zstd_dictionary) {
   extract_totals totals{};
   bool const enable_raw{ extract_bare_compressed_output_name(archive_path).has_value() };
+  std::optional<zstd_dict_source> source;
   archive_reader reader{ enable_raw };
-  if (archive_read_open_filename(reader.handle, archive_path.string().c_str(), 10240) !=
-      ARCHIVE_OK) {
+  if (open_archive(reader, archive_path, zstd_dictionary, source) != ARCHIVE_OK) {
     throw std::runtime_error(std::string("compute_archive_totals: failed to open ") +
                              archive_path.string() + ": " +
                              archive_error_string(reader.handle));
@@ -577,7 +934,10 @@ extract_totals compute_archive_totals(std::filesystem::path const &archive_path)
           std::string("compute_archive_totals: not a valid compressed stream: ") +
           archive_path.string());
     }
-    if (!is_raw_stream && archive_entry_filetype(entry) != AE_IFREG) { continue; }
+    if (!is_raw_stream && archive_entry_filetype(entry) != AE_IFREG &&
+        !archive_entry_hardlink(entry)) {
+      continue;
+    }
     la_int64_t const size{ archive_entry_size(entry) };
     if (size > 0) {
       totals.bytes += static_cast<std::uint64_t>(size);
@@ -638,7 +998,10 @@ extract_totals compute_extract_totals(std::filesystem::path const &fetch_dir) {
             std::string("compute_extract_totals: not a valid compressed stream: ") +
             entry.path().string());
       }
-      if (!is_raw_stream && archive_entry_filetype(ent) != AE_IFREG) { continue; }
+      if (!is_raw_stream && archive_entry_filetype(ent) != AE_IFREG &&
+          !archive_entry_hardlink(ent)) {
+        continue;
+      }
 
       la_int64_t const size{ archive_entry_size(ent) };
       if (size > 0) {
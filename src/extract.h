@@ -1,10 +1,14 @@
 #pragma once
 
+#include "blake3_util.h"
+#include "sha256.h"
 #include "tui.h"
 
+#include <cstddef>
 #include <filesystem>
 #include <functional>
 #include <optional>
+#include <span>
 
 namespace envy {
 
@@ -27,6 +31,13 @@ struct extract_totals {
 struct extract_options {
   int strip_components{ 0 };
   extract_progress_cb_t progress;
+  // Materialize tar hardlink entries as copy-on-write clones of their target where the
+  // filesystem supports it (platform::clone_file), keeping the files independent; falls
+  // back to a hard link otherwise.
+  bool clone_hardlinks{ false };
+  // Dictionary the archive's zstd stream was compressed with (see depot_dict.h). When set,
+  // the file is decompressed with it before libarchive reads the tar inside.
+  std::span<unsigned char const> zstd_dictionary;
 };
 
 // Extract a single archive to destination
@@ -47,13 +58,45 @@ bool extract_is_safe_archive_path(char const *path);
 std::optional<std::filesystem::path> extract_bare_compressed_output_name(
     std::filesystem::path const &archive_path);
 
+struct archive_create_options {
+  extract_progress_cb_t progress;
+  // BLAKE3 pre-pass over same-size regular files; later files whose content and
+  // permissions match an earlier one are stored as tar hardlinks to it. Files that
+  // already share an inode are stored as hardlinks regardless.
+  bool dedupe_content{ false };
+  // archive_create_tar_zst only: compress against this trained dictionary. Readers must
+  // pass the same dictionary to extract().
+  std::span<unsigned char const> zstd_dictionary;
+};
+
+struct archive_create_result {
+  std::uint64_t files{ 0 };      // Regular files, including those stored as hardlinks
+  std::uint64_t hardlinks{ 0 };  // Entries stored as hardlinks (no data in the archive)
+  std::uint64_t bytes{ 0 };      // Uncompressed regular-file bytes read from source_dir
+  sha256_t sha256{};             // Digests of the compressed archive as written
+  blake3_t blake3{};
+};
+
 // Create tar.zst archive from source_dir contents, stored under prefix/ (e.g., "pkg/").
-// Returns number of files archived. Optional progress callback invoked per-header and
-// per-chunk.
-std::uint64_t archive_create_tar_zst(std::filesystem::path const &output_path,
-                                     std::filesystem::path const &source_dir,
-                                     std::string const &prefix,
-                                     extract_progress_cb_t const &progress = {});
+// source_dir is walked once; each file is read once, and the compressed output is hashed
+// on its way to disk so callers never re-read the archive. The progress callback is
+// invoked per-header and per-chunk with totals gathered during the walk.
+archive_create_result archive_create_tar_zst(std::filesystem::path const &output_path,
+                                             std::filesystem::path const &source_dir,
+                                             std::string const &prefix,
+                                             archive_create_options const &options = {});
+
+// Receives archive bytes as they are produced; throw to abort archive creation.
+using archive_byte_sink_t = std::function<void(void const *data, std::size_t size)>;
+
+// Stream an uncompressed tar of source_dir to sink (same entries, order and options as
+// archive_create_tar_zst); the result digests cover the tar bytes. Entries are written in
+// sorted path order with no timestamps or ownership, so identical trees yield identical
+// streams — the property depot chunking relies on.
+archive_create_result archive_create_tar(archive_byte_sink_t const &sink,
+                                         std::filesystem::path const &source_dir,
+                                         std::string const &prefix,
+                                         archive_create_options const &options = {});
 
 // Extract all archives in fetch_dir to dest_dir.
 // If section != kInvalidSection, shows spinner during totals computation and progress bar
@@ -65,7 +108,9 @@ void extract_all_archives(std::filesystem::path const &fetch_dir,
                           tui::section_handle section);
 
 // Pre-scan a single archive to count files and total uncompressed bytes.
-extract_totals compute_archive_totals(std::filesystem::path const &archive_path);
+extract_totals compute_archive_totals(
+    std::filesystem::path const &archive_path,
+    std::span<unsigned char const> zstd_dictionary = {});
 
 #ifdef ENVY_UNIT_TEST
 // Exposed for unit tests only - computes totals by scanning archives in a directory
@@ -1,5 +1,9 @@
 #include "extract.h"
 
+#include "blake3_util.h"
+#include "sha256.h"
+#include "util.h"
+
 #include "doctest.h"
 
 #include <algorithm>
@@ -254,8 +258,9 @@ TEST_CASE("archive_create_tar_zst round-trip with files and directories") {
   { std::ofstream{ source / "subdir" / "file2.txt" } << "world"; }
 
   auto const archive{ make_temp_dir() / "test.tar.zst" };
-  auto const files_archived{ envy::archive_create_tar_zst(archive, source, "pkg") };
-  CHECK(files_archived == 2);
+  auto const result{ envy::archive_create_tar_zst(archive, source, "pkg") };
+  CHECK(result.files == 2);
+  CHECK(result.bytes == 10);
   CHECK(std::filesystem::exists(archive));
   CHECK(std::filesystem::file_size(archive) > 0);
 
@@ -284,6 +289,127 @@ TEST_CASE("archive_create_tar_zst round-trip with files and directories") {
   std::filesystem::remove_all(archive.parent_path());
 }
 
+TEST_CASE("archive_create_tar_zst digests match the written archive") {
+  auto const source{ make_temp_dir() };
+  std::filesystem::create_directories(source / "bin");
+  { std::ofstream{ source / "bin" / "tool" } << std::string(3 * 1024 * 1024, 'x'); }
+  { std::ofstream{ source / "README" } << "readme"; }
+
+  auto const archive{ make_temp_dir() / "digest.tar.zst" };
+  auto const result{ envy::archive_create_tar_zst(archive, source, "pkg") };
+
+  CHECK(result.sha256 == envy::sha256(archive));
+
+  auto const bytes{ envy::util_load_file(archive) };
+  CHECK(result.blake3 == envy::blake3_hash(bytes.data(), bytes.size()));
+
+  std::filesystem::remove_all(source);
+  std::filesystem::remove_all(archive.parent_path());
+}
+
+TEST_CASE("archive_create_tar_zst reports walk totals with every progress callback") {
+  auto const source{ make_temp_dir() };
+  std::filesystem::create_directories(source / "a" / "b");
+  { std::ofstream{ source / "one.txt" } << "12345"; }
+  { std::ofstream{ source / "a" / "two.txt" } << "1234567890"; }
+  { std::ofstream{ source / "a" / "b" / "three.txt" } << "123"; }
+
+  std::vector<envy::extract_progress> calls;
+  auto const archive{ make_temp_dir() / "progress.tar.zst" };
+  auto const result{ envy::archive_create_tar_zst(
+      archive,
+      source,
+      "pkg",
+      { .progress = [&](envy::extract_progress const &ep) {
+        calls.push_back(ep);
+        return true;
+      } }) };
+
+  CHECK(result.files == 3);
+  CHECK(result.bytes == 18);
+  REQUIRE_FALSE(calls.empty());
+  for (auto const &c : calls) {
+    REQUIRE(c.total_bytes.has_value());
+    REQUIRE(c.total_files.has_value());
+    CHECK(*c.total_bytes == 18);
+    CHECK(*c.total_files == 3);
+    CHECK(c.bytes_processed <= 18);
+  }
+  CHECK(calls.back().bytes_processed == 18);
+
+  std::filesystem::remove_all(source);
+  std::filesystem::remove_all(archive.parent_path());
+}
+
+#ifndef _WIN32
+TEST_CASE("archive_create_tar_zst stores shared inodes as hardlinks") {
+  auto const source{ make_temp_dir() };
+  auto const dest{ make_temp_dir() };
+  std::string const payload(256 * 1024, 'b');
+
+  std::filesystem::create_directories(source / "bin");
+  { std::ofstream{ source / "bin" / "busybox" } << payload; }
+  std::filesystem::create_hard_link(source / "bin" / "busybox", source / "bin" / "ls");
+  std::filesystem::create_hard_link(source / "bin" / "busybox", source / "bin" / "cat");
+
+  auto const archive{ make_temp_dir() / "links.tar.zst" };
+  auto const result{ envy::archive_create_tar_zst(archive, source, "pkg") };
+  CHECK(result.files == 3);
+  CHECK(result.hardlinks == 2);
+  CHECK(result.bytes == payload.size());
+
+  CHECK(envy::extract(archive, dest) == 3);
+  CHECK(std::filesystem::hard_link_count(dest / "pkg" / "bin" / "busybox") == 3);
+  CHECK(std::filesystem::equivalent(dest / "pkg" / "bin" / "busybox",
+                                    dest / "pkg" / "bin" / "ls"));
+  CHECK(sum_file_sizes(dest) == 3 * payload.size());
+
+  std::filesystem::remove_all(source);
+  std::filesystem::remove_all(dest);
+  std::filesystem::remove_all(archive.parent_path());
+}
+#endif
+
+TEST_CASE("archive_create_tar_zst dedupe_content links identical files only") {
+  auto const source{ make_temp_dir() };
+  auto const dest{ make_temp_dir() };
+  std::string const header(64 * 1024, 'h');
+  std::string const other(64 * 1024, 'o');  // Same size, different content
+
+  for (auto const *target : { "arm", "riscv", "x86" }) {
+    std::filesystem::create_directories(source / target / "include");
+    std::ofstream{ source / target / "include" / "common.h" } << header;
+  }
+  { std::ofstream{ source / "other.h" } << other; }
+
+  auto const plain_archive{ make_temp_dir() / "plain.tar.zst" };
+  auto const plain{ envy::archive_create_tar_zst(plain_archive, source, "pkg") };
+  CHECK(plain.hardlinks == 0);
+
+  auto const archive{ make_temp_dir() / "dedupe.tar.zst" };
+  auto const result{
+    envy::archive_create_tar_zst(archive, source, "pkg", { .dedupe_content = true })
+  };
+  CHECK(result.files == 4);
+  CHECK(result.hardlinks == 2);
+  CHECK(result.bytes == header.size() + other.size());
+
+  CHECK(envy::extract(archive, dest, { .clone_hardlinks = true }) == 4);
+  for (auto const *target : { "arm", "riscv", "x86" }) {
+    std::ifstream in{ dest / "pkg" / target / "include" / "common.h" };
+    CHECK(std::string{ std::istreambuf_iterator<char>{ in }, {} } == header);
+  }
+  {
+    std::ifstream in{ dest / "pkg" / "other.h" };
+    CHECK(std::string{ std::istreambuf_iterator<char>{ in }, {} } == other);
+  }
+
+  std::filesystem::remove_all(source);
+  std::filesystem::remove_all(dest);
+  std::filesystem::remove_all(archive.parent_path());
+  std::filesystem::remove_all(plain_archive.parent_path());
+}
+
 #ifndef _WIN32
 TEST_CASE("archive_create_tar_zst preserves symlinks") {
   auto const source{ make_temp_dir() };
@@ -0,0 +1,165 @@
+#include "file_hash.h"
+
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+namespace envy {
+
+namespace {
+
+constexpr std::size_t kReadBufferSize{ 1024 * 1024 };
+
+file_digests hash_with_buffer(std::filesystem::path const &path,
+                              file_hash_algorithms algorithms,
+                              std::vector<unsigned char> &buffer) {
+  file_ptr_t file{ util_open_file(path, "rb") };
+  if (!file) { throw std::runtime_error("hash: failed to open file: " + path.string()); }
+
+  std::optional<sha256_hasher> sha;
+  std::optional<blake3_hasher> b3;
+  if (algorithms.sha256) { sha.emplace(); }
+  if (algorithms.blake3) { b3.emplace(); }
+
+  while (true) {
+    auto const read_bytes{ std::fread(buffer.data(), 1, buffer.size(), file.get()) };
+    if (read_bytes > 0) {
+      if (sha) { sha->update(buffer.data(), read_bytes); }
+      if (b3) { b3->update(buffer.data(), read_bytes); }
+    }
+    if (read_bytes < buffer.size()) {
+      if (std::ferror(file.get())) {
+        throw std::runtime_error("hash: failed to read file: " + path.string());
+      }
+      break;
+    }
+  }
+
+  file_digests digests;
+  if (sha) { digests.sha256 = sha->finalize(); }
+  if (b3) { digests.blake3 = b3->finalize(); }
+  return digests;
+}
+
+bool glob_match(std::string_view p, std::string_view s) {
+  while (!p.empty()) {
+    if (p.starts_with("**")) {
+      p.remove_prefix(2);
+      if (p.empty()) { return true; }
+      bool const whole_components{ p.front() == '/' };
+      if (whole_components) { p.remove_prefix(1); }
+      for (std::size_t i{ 0 }; i <= s.size(); ++i) {
+        if (whole_components && i > 0 && s[i - 1] != '/') { continue; }
+        if (glob_match(p, s.substr(i))) { return true; }
+      }
+      return false;
+    }
+    if (p.front() == '*') {
+      p.remove_prefix(1);
+      for (std::size_t i{ 0 }; i <= s.size(); ++i) {
+        if (glob_match(p, s.substr(i))) { return true; }
+        if (i < s.size() && s[i] == '/') { break; }
+      }
+      return false;
+    }
+    if (s.empty()) { return false; }
+    if (p.front() == '?' ? s.front() == '/' : p.front() != s.front()) { return false; }
+    p.remove_prefix(1);
+    s.remove_prefix(1);
+  }
+  return s.empty();
+}
+
+}  // namespace
+
+file_digests file_hash(std::filesystem::path const &path,
+                       file_hash_algorithms algorithms) {
+  std::vector<unsigned char> buffer(kReadBufferSize);
+  return hash_with_buffer(path, algorithms, buffer);
+}
+
+std::vector<file_digests> file_hash_all(std::vector<std::filesystem::path> const &files,
+                                        file_hash_algorithms algorithms,
+                                        std::size_t jobs) {
+  std::vector<file_digests> results(files.size());
+  std::vector<std::exception_ptr> errors(files.size());
+
+  if (jobs == 0) { jobs = std::max(1u, std::thread::hardware_concurrency()); }
+  jobs = std::min(jobs, files.size());
+
+  // Workers claim indices in order, so once one fails every earlier index has already
+  // been claimed and will finish; later ones are skipped.
+  std::atomic<std::size_t> next{ 0 };
+  std::atomic<bool> failed{ false };
+  auto const work{ [&] {
+    std::vector<unsigned char> buffer(kReadBufferSize);
+    while (!failed.load(std::memory_order_relaxed)) {
+      std::size_t const i{ next.fetch_add(1, std::memory_order_relaxed) };
+      if (i >= files.size()) { return; }
+      try {
+        results[i] = hash_with_buffer(files[i], algorithms, buffer);
+      } catch (...) {
+        errors[i] = std::current_exception();
+        failed.store(true, std::memory_order_relaxed);
+      }
+    }
+  } };
+
+  std::vector<std::thread> workers;
+  workers.reserve(jobs);
+  for (std::size_t t{ 1 }; t < jobs; ++t) { workers.emplace_back(work); }
+  if (jobs > 0) { work(); }
+  for (auto &w : workers) { w.join(); }
+
+  for (auto const &e : errors) {
+    if (e) { std::rethrow_exception(e); }
+  }
+  return results;
+}
+
+bool file_hash_glob_match(std::string_view pattern, std::string_view path) {
+  if (pattern.find('/') == std::string_view::npos) {
+    if (auto const sep{ path.rfind('/') }; sep != std::string_view::npos) {
+      path.remove_prefix(sep + 1);
+    }
+  }
+  return glob_match(pattern, path);
+}
+
+std::vector<std::filesystem::path> file_hash_walk(std::filesystem::path const &root,
+                                                  file_hash_walk_options const &options) {
+  std::vector<std::pair<std::string, std::filesystem::path>> found;
+  auto const consider{ [&](std::filesystem::directory_entry const &e) {
+    if (!e.is_regular_file()) { return; }
+    auto rel{ e.path().lexically_relative(root) };
+    auto key{ rel.generic_string() };
+    if (!options.include.empty() &&
+        std::ranges::none_of(options.include, [&](std::string const &pattern) {
+          return file_hash_glob_match(pattern, key);
+        })) {
+      return;
+    }
+    found.emplace_back(std::move(key), std::move(rel));
+  } };
+
+  if (options.recursive) {
+    for (auto const &e : std::filesystem::recursive_directory_iterator(root)) {
+      consider(e);
+    }
+  } else {
+    for (auto const &e : std::filesystem::directory_iterator(root)) { consider(e); }
+  }
+
+  std::ranges::sort(found, {}, &decltype(found)::value_type::first);
+  std::vector<std::filesystem::path> files;
+  files.reserve(found.size());
+  for (auto &[key, rel] : found) { files.push_back(std::move(rel)); }
+  return files;
+}
+
+}  // namespace envy
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "blake3_util.h"
+#include "sha256.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace envy {
+
+struct file_hash_algorithms {
+  bool sha256{ true };
+  bool blake3{ false };
+};
+
+// Digests for the algorithms requested; the others stay empty.
+struct file_digests {
+  std::optional<sha256_t> sha256;
+  std::optional<blake3_t> blake3;
+};
+
+// Hash one file, feeding every requested algorithm from a single read pass.
+file_digests file_hash(std::filesystem::path const &path, file_hash_algorithms algorithms);
+
+// Hash files on up to `jobs` threads (0 = hardware concurrency). Result i belongs to
+// files[i] whatever order the work finishes in. If any file fails, the error of the
+// earliest failing file is rethrown once all workers have stopped.
+std::vector<file_digests> file_hash_all(std::vector<std::filesystem::path> const &files,
+                                        file_hash_algorithms algorithms,
+                                        std::size_t jobs = 0);
+
+// Glob over '/'-separated relative paths: '*' and '?' stay within one component, '**'
+// spans any number of them. A pattern without '/' is matched against the filename only.
+bool file_hash_glob_match(std::string_view pattern, std::string_view path);
+
+struct file_hash_walk_options {
+  bool recursive{ false };
+  std::vector<std::string> include;  // Empty: every regular file
+};
+
+// Regular files under `root` that match `include`, as paths relative to root, sorted by
+// their generic ('/') form so output does not depend on directory enumeration order.
+std::vector<std::filesystem::path> file_hash_walk(std::filesystem::path const &root,
+                                                  file_hash_walk_options const &options);
+
+}  // namespace envy
@@ -0,0 +1,156 @@
+#include "file_hash.h"
+
+#include "doctest.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::filesystem::path make_temp_dir() {
+  static std::mt19937_64 rng{ std::random_device{}() };
+  auto dir{ std::filesystem::temp_directory_path() /
+            ("envy-file-hash-test-" + std::to_string(rng())) };
+  std::filesystem::create_directories(dir);
+  return dir;
+}
+
+void write_file(std::filesystem::path const &path, std::string const &content) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream{ path, std::ios::binary } << content;
+}
+
+std::vector<std::string> generic(std::vector<std::filesystem::path> const &paths) {
+  std::vector<std::string> out;
+  for (auto const &p : paths) { out.push_back(p.generic_string()); }
+  return out;
+}
+
+}  // namespace
+
+TEST_CASE("file_hash matches the single-algorithm hashers") {
+  auto const root{ make_temp_dir() };
+  std::string big(3 * 1024 * 1024 + 17, '\0');  // Spans several read buffers
+  std::mt19937 rng{ 7 };
+  for (auto &c : big) { c = static_cast<char>(rng()); }
+  write_file(root / "big.bin", big);
+  write_file(root / "empty.bin", "");
+
+  for (auto const *name : { "big.bin", "empty.bin" }) {
+    auto const path{ root / name };
+    auto const both{ envy::file_hash(path, { .sha256 = true, .blake3 = true }) };
+    REQUIRE(both.sha256.has_value());
+    REQUIRE(both.blake3.has_value());
+    CHECK(*both.sha256 == envy::sha256(path));
+    CHECK(*both.blake3 == envy::blake3_file(path));
+
+    auto const only_b3{ envy::file_hash(path, { .sha256 = false, .blake3 = true }) };
+    CHECK_FALSE(only_b3.sha256.has_value());
+    CHECK(only_b3.blake3 == both.blake3);
+  }
+
+  CHECK_THROWS(envy::file_hash(root / "missing", {}));
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("file_hash_all keeps input order regardless of completion order") {
+  auto const root{ make_temp_dir() };
+  std::vector<std::filesystem::path> files;
+  for (int i{ 0 }; i < 64; ++i) {
+    // Large files first so early indices tend to finish last.
+    auto const size{ static_cast<std::size_t>(64 - i) * 16 * 1024 };
+    files.push_back(root / ("f" + std::to_string(i)));
+    write_file(files.back(), std::string(size, static_cast<char>('a' + i % 26)));
+  }
+
+  auto const serial{ envy::file_hash_all(files, { .blake3 = true }, 1) };
+  auto const parallel{ envy::file_hash_all(files, { .blake3 = true }, 8) };
+  REQUIRE(parallel.size() == files.size());
+  for (std::size_t i{ 0 }; i < files.size(); ++i) {
+    CHECK(*parallel[i].sha256 == envy::sha256(files[i]));
+    CHECK(*parallel[i].blake3 == envy::blake3_file(files[i]));
+    CHECK(parallel[i].sha256 == serial[i].sha256);
+  }
+
+  CHECK(envy::file_hash_all({}, {}, 4).empty());
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("file_hash_all reports the earliest failing file") {
+  auto const root{ make_temp_dir() };
+  std::vector<std::filesystem::path> files;
+  for (int i{ 0 }; i < 16; ++i) {
+    files.push_back(root / ("f" + std::to_string(i)));
+    if (i != 5 && i != 11) { write_file(files.back(), "x"); }
+  }
+  CHECK_THROWS_WITH(envy::file_hash_all(files, {}, 4),
+                    doctest::Contains((root / "f5").string().c_str()));
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("file_hash_glob_match") {
+  CHECK(envy::file_hash_glob_match("*.tar.zst", "a.tar.zst"));
+  CHECK(envy::file_hash_glob_match("*.tar.zst", "sub/dir/a.tar.zst"));  // Filename only
+  CHECK_FALSE(envy::file_hash_glob_match("*.tar.zst", "a.tar.gz"));
+  CHECK(envy::file_hash_glob_match("a?c", "abc"));
+  CHECK_FALSE(envy::file_hash_glob_match("a?c", "ac"));
+
+  CHECK(envy::file_hash_glob_match("sub/*.zst", "sub/a.zst"));
+  CHECK_FALSE(envy::file_hash_glob_match("sub/*.zst", "sub/x/a.zst"));
+  CHECK_FALSE(envy::file_hash_glob_match("s?b/a", "s/b/a"));
+  CHECK(envy::file_hash_glob_match("sub/**/*.zst", "sub/a.zst"));
+  CHECK(envy::file_hash_glob_match("sub/**/*.zst", "sub/x/y/a.zst"));
+  CHECK_FALSE(envy::file_hash_glob_match("sub/**/*.zst", "subx/a.zst"));
+  CHECK(envy::file_hash_glob_match("sub/**", "sub/x/y"));
+  CHECK(envy::file_hash_glob_match("**/a.zst", "a.zst"));
+  CHECK_FALSE(envy::file_hash_glob_match("**/a.zst", "xa.zst"));
+}
+
+TEST_CASE("file_hash_walk filters and sorts") {
+  auto const root{ make_temp_dir() };
+  for (auto const *rel : { "b.tar.zst", "a.tar.zst", "notes.txt", "z/c.tar.zst",
+                           "z/y/d.tar.zst", "m/e.txt" }) {
+    write_file(root / rel, rel);
+  }
+
+  CHECK(generic(envy::file_hash_walk(root, { .include = { "*.tar.zst" } })) ==
+        std::vector<std::string>{ "a.tar.zst", "b.tar.zst" });
+  CHECK(generic(envy::file_hash_walk(root,
+                                     { .recursive = true, .include = { "*.tar.zst" } })) ==
+        std::vector<std::string>{ "a.tar.zst", "b.tar.zst", "z/c.tar.zst",
+                                  "z/y/d.tar.zst" });
+  CHECK(generic(envy::file_hash_walk(root,
+                                     { .recursive = true,
+                                       .include = { "z/**/*.zst", "*.txt" } })) ==
+        std::vector<std::string>{ "m/e.txt", "notes.txt", "z/c.tar.zst",
+                                  "z/y/d.tar.zst" });
+  CHECK(envy::file_hash_walk(root, { .recursive = true }).size() == 6);
+
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("file_hash_all throughput on 5000 files" * doctest::skip()) {
+  auto const root{ make_temp_dir() };
+  std::vector<std::filesystem::path> files;
+  std::mt19937 rng{ 1 };
+  for (int i{ 0 }; i < 5000; ++i) {
+    files.push_back(root / ("f" + std::to_string(i)));
+    write_file(files.back(), std::string(4096 + rng() % (256 * 1024), 'x'));
+  }
+
+  for (std::size_t const jobs : { std::size_t{ 1 }, std::size_t{ 0 } }) {
+    for (bool const blake3 : { false, true }) {
+      auto const start{ std::chrono::steady_clock::now() };
+      envy::file_hash_all(files, { .blake3 = blake3 }, jobs);
+      std::chrono::duration<double> const elapsed{ std::chrono::steady_clock::now() -
+                                                   start };
+      MESSAGE("jobs=" << jobs << (blake3 ? " sha256+blake3: " : " sha256: ")
+                      << elapsed.count() * 1000 << " ms");
+    }
+  }
+  std::filesystem::remove_all(root);
+}
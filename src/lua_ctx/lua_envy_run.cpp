@@ -5,16 +5,21 @@
 #include "lua_shell.h"
 #include "pkg.h"
 #include "shell.h"
+#include "shell_capture.h"
 #include "sol_util.h"
 #include "tui.h"
 #include "tui_actions.h"
 #include "util.h"
 
+#include <chrono>
 #include <filesystem>
+#include <initializer_list>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <system_error>
 
 namespace envy {
 namespace {
@@ -62,6 +67,38 @@ std::string join_script_array(sol::table const &tbl) {
   return oss.str();
 }
 
+// Captured text as a Lua string, or, once it spilled to disk, an io file handle opened on
+// the spill file so the script reads it lazily (handle:lines(), handle:read(n)).
+sol::object captured_output(sol::state_view lua, shell_capture const &capture) {
+  if (!capture.spilled()) { return sol::make_object(lua, capture.str()); }
+
+  auto const path{ capture.spill_path() };
+  sol::protected_function io_open{ lua["io"]["open"] };
+  sol::protected_function_result opened{ io_open(path.string(), "rb") };
+  if (!opened.valid() || opened.get_type() != sol::type::userdata) {
+    throw std::runtime_error("envy.run: failed to open captured output " + path.string());
+  }
+  return opened.get<sol::object>();
+}
+
+// Outside a cache entry there is no work dir to reclaim spill files, so they are removed
+// on every exit from envy.run, failed runs included. A returned handle keeps its file
+// alive (POSIX); on Windows removal fails while it is open and the file stays in the
+// temp dir.
+struct spill_remover {
+  shell_capture const &out;
+  shell_capture const &err;
+  bool active;
+
+  ~spill_remover() {
+    if (!active) { return; }
+    for (auto const *capture : { &out, &err }) {
+      std::error_code ec;
+      if (capture->spilled()) { std::filesystem::remove(capture->spill_path(), ec); }
+    }
+  }
+};
+
 }  // namespace
 
 void lua_envy_run_install(sol::table &envy_table) {
@@ -137,24 +174,48 @@ void lua_envy_run_install(sol::table &envy_table) {
     bool capture{ false };
     bool check{ true };
     bool interactive{ false };
+    bool persistent{ false };
     if (opts_table) {
       sol::table opts{ *opts_table };
       quiet = sol_util_get_or_default<bool>(opts, "quiet", false, "envy.run");
       capture = sol_util_get_or_default<bool>(opts, "capture", false, "envy.run");
       check = sol_util_get_or_default<bool>(opts, "check", true, "envy.run");
       interactive = sol_util_get_or_default<bool>(opts, "interactive", false, "envy.run");
+      persistent = sol_util_get_or_default<bool>(opts, "persistent", false, "envy.run");
     }
 
-    std::ostringstream stdout_stream;
-    std::ostringstream stderr_stream;
+    // Interactive scripts need a terminal, not the coprocess's control pipe.
+    shell_session *session{ nullptr };
+    if (persistent && ctx && !interactive) {
+      if (!ctx->persistent_shell) {
+        ctx->persistent_shell = std::make_unique<shell_session>();
+      }
+      session = ctx->persistent_shell.get();
+    }
+
+    // Captured streams spill to the entry's work/tmp past the memory limit. Uncaptured
+    // ones are only kept for error messages, so they keep just a head and tail.
+    bool const spill_in_entry{ p && p->lock };
+    shell_capture::options const capture_opts{
+      .memory_limit = capture ? shell_capture::kDefaultMemoryLimit
+                              : 2 * shell_capture::kDefaultExcerptBytes,
+      .spill_dir = capture ? std::optional{ spill_in_entry
+                                                ? p->lock->tmp_dir()
+                                                : std::filesystem::temp_directory_path() }
+                           : std::nullopt
+    };
+    shell_capture stdout_capture{ capture_opts };
+    shell_capture stderr_capture{ capture_opts };
+    spill_remover const remove_spills{ stdout_capture, stderr_capture, !spill_in_entry };
 
     shell_run_cfg cfg{
-      .on_stdout_line = [&](std::string_view line) { stdout_stream << line << '\n'; },
-      .on_stderr_line = [&](std::string_view line) { stderr_stream << line << '\n'; },
+      .on_stdout_line = [&](std::string_view line) { stdout_capture.append_line(line); },
+      .on_stderr_line = [&](std::string_view line) { stderr_capture.append_line(line); },
       .cwd = cwd,
       .env = std::move(env),
       .shell = shell,
-      .check = check
+      .check = check,
+      .max_line_length = capture ? 0 : shell_run_cfg::kLoggedLineLength
     };
 
     std::optional<tui::interactive_mode_guard> guard;
@@ -176,23 +237,33 @@ void lua_envy_run_install(sol::table &envy_table) {
     engine *eng{ ctx ? ctx->eng : nullptr };
     bool const use_progress{ p && p->tui_section && eng && !quiet && !interactive };
 
-    shell_result const result{ use_progress ? tui_actions::run_shell_with_progress(
-                                                  script_view,
-                                                  p->tui_section,
-                                                  p->cfg->identity,
-                                                  eng->cache_root(),
-                                                  std::move(cfg))
-                                            : shell_run(script_view, std::move(cfg)) };
+    auto const start{ std::chrono::steady_clock::now() };
+    shell_result const result{
+      use_progress ? tui_actions::run_shell_with_progress(script_view,
+                                                          p->tui_section,
+                                                          p->cfg->identity,
+                                                          eng->cache_root(),
+                                                          std::move(cfg),
+                                                          session)
+      : session    ? session->run(script_view, cfg)
+                   : shell_run(script_view, cfg)
+    };
+    if (p && eng) {
+      eng->shell_usage().record(p->cfg->identity,
+                                p->current_phase.load(),
+                                result,
+                                std::chrono::steady_clock::now() - start);
+    }
 
-    std::string const stdout_str{ stdout_stream.str() };
-    std::string const stderr_str{ stderr_stream.str() };
+    stdout_capture.finish();
+    stderr_capture.finish();
 
     if (result.signal) {
       auto const err{ format_run_error(script_view,
                                        result.exit_code,
                                        result.signal,
-                                       stdout_str,
-                                       stderr_str) };
+                                       stdout_capture.excerpt(),
+                                       stderr_capture.excerpt()) };
       tui::error("%s", err.c_str());
       throw std::runtime_error(err);
     }
@@ -201,8 +272,8 @@ void lua_envy_run_install(sol::table &envy_table) {
       auto const err{ format_run_error(script_view,
                                        result.exit_code,
                                        std::nullopt,
-                                       stdout_str,
-                                       stderr_str) };
+                                       stdout_capture.excerpt(),
+                                       stderr_capture.excerpt()) };
       tui::error("%s", err.c_str());
       throw std::runtime_error(err);
     }
@@ -211,8 +282,8 @@ void lua_envy_run_install(sol::table &envy_table) {
     sol::table return_table{ lua_view.create_table() };
     return_table["exit_code"] = result.exit_code;
     if (capture) {
-      return_table["stdout"] = stdout_str;
-      return_table["stderr"] = stderr_str;
+      return_table["stdout"] = captured_output(lua_view, stdout_capture);
+      return_table["stderr"] = captured_output(lua_view, stderr_capture);
     } else {
       return_table["stdout"] = sol::lua_nil;
       return_table["stderr"] = sol::lua_nil;
@@ -1,6 +1,8 @@
 #include "lua_phase_context.h"
 
 #include "lua_envy.h"
+#include "lua_memory.h"
+#include "lua_profiler.h"
 #include "pkg.h"
 
 namespace envy {
@@ -22,6 +24,8 @@ phase_context_guard::phase_context_guard(engine *eng,
 
   sol::state_view lua{ lua_state_ };
   lua.registry()[ENVY_PHASE_CTX_RIDX] = static_cast<void *>(&ctx_);
+  if (p) { lua_set_gc_mode(lua_state_, lua_gc_mode_for_phase(p->current_phase)); }
+  lua_profiler_attach(lua_state_);
 }
 
 phase_context_guard::~phase_context_guard() {
@@ -29,6 +33,9 @@ phase_context_guard::~phase_context_guard() {
 
   sol::state_view lua{ lua_state_ };
   lua.registry()[ENVY_PHASE_CTX_RIDX] = sol::lua_nil;
+  if (ctx_.p) {
+    lua_memory_trace(ctx_.p->cfg->identity, ctx_.p->current_phase, lua_state_);
+  }
 }
 
 }  // namespace envy
@@ -1,11 +1,13 @@
 #pragma once
 
 #include "cache.h"
+#include "shell.h"
 #include "util.h"
 
 #include "sol/sol.hpp"
 
 #include <filesystem>
+#include <memory>
 #include <optional>
 
 namespace envy {
@@ -23,6 +25,10 @@ struct phase_context {
 
   // May not be the same as p->lock: "custom fetch" runs with child package's lock!
   cache::scoped_entry_lock const *lock;
+
+  // Coprocess shared by envy.run{persistent = true} calls; started on first use and
+  // ended with the phase.
+  mutable std::unique_ptr<shell_session> persistent_shell{};
 };
 
 // Get phase context from Lua registry (returns nullptr if not in phase execution)
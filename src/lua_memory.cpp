@@ -0,0 +1,239 @@
+#include "lua_memory.h"
+
+#include "trace.h"
+#include "tui.h"
+
+#include "sol/sol.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace envy {
+
+namespace {
+
+constexpr std::size_t class_index(std::size_t size) {
+  return (size + lua_arena::kGranularity - 1) / lua_arena::kGranularity - 1;
+}
+
+constexpr std::size_t class_bytes(std::size_t index) {
+  return (index + 1) * lua_arena::kGranularity;
+}
+
+std::optional<lua_gc_mode> parse_mode(std::string_view name) {
+  if (name == "incremental") { return lua_gc_mode::incremental; }
+  if (name == "generational") { return lua_gc_mode::generational; }
+  return std::nullopt;
+}
+
+std::string_view trim(std::string_view s) {
+  while (!s.empty() && s.front() == ' ') { s.remove_prefix(1); }
+  while (!s.empty() && s.back() == ' ') { s.remove_suffix(1); }
+  return s;
+}
+
+lua_gc_modes env_gc_modes() {
+  char const *const value{ std::getenv("ENVY_LUA_GC") };
+  if (!value || !*value) { return lua_gc_modes_parse("incremental"); }
+  try {
+    return lua_gc_modes_parse(value);
+  } catch (std::exception const &e) {
+    tui::warn("ENVY_LUA_GC ignored: %s", e.what());
+    return lua_gc_modes_parse("incremental");
+  }
+}
+
+}  // namespace
+
+lua_arena::~lua_arena() {
+  for (void *chunk : chunks_) { std::free(chunk); }
+}
+
+void lua_arena::reset_counters() {
+  stats_.peak_bytes = stats_.current_bytes;
+  stats_.total_bytes = 0;
+  stats_.allocations = 0;
+}
+
+void *lua_arena::alloc(void *ud,
+                       void *ptr,
+                       std::size_t osize,
+                       std::size_t nsize) noexcept {
+  auto *const self{ static_cast<lua_arena *>(ud) };
+  if (!ptr) {  // osize encodes the object type, not a size, when ptr is null
+    return nsize == 0 ? nullptr : self->allocate(nsize);
+  }
+  if (nsize == 0) {
+    self->deallocate(ptr, osize);
+    return nullptr;
+  }
+  return self->reallocate(ptr, osize, nsize);
+}
+
+void *lua_arena::allocate(std::size_t size) noexcept {
+  void *block{ nullptr };
+  if (size > kMaxSmall) {
+    block = std::malloc(size);
+    if (block) { stats_.reserved_bytes += static_cast<std::int64_t>(size); }
+  } else if (auto &head{ free_lists_[class_index(size)] }; head) {
+    block = head;
+    head = *static_cast<void **>(head);
+  } else {
+    block = carve(class_bytes(class_index(size)));
+  }
+  if (!block) { return nullptr; }
+
+  stats_.current_bytes += static_cast<std::int64_t>(size);
+  stats_.total_bytes += static_cast<std::int64_t>(size);
+  stats_.peak_bytes = std::max(stats_.peak_bytes, stats_.current_bytes);
+  ++stats_.allocations;
+  return block;
+}
+
+void lua_arena::deallocate(void *ptr, std::size_t size) noexcept {
+  stats_.current_bytes -= static_cast<std::int64_t>(size);
+  if (size > kMaxSmall) {
+    std::free(ptr);
+    stats_.reserved_bytes -= static_cast<std::int64_t>(size);
+    return;
+  }
+  auto &head{ free_lists_[class_index(size)] };
+  *static_cast<void **>(ptr) = head;
+  head = ptr;
+}
+
+void *lua_arena::reallocate(void *ptr, std::size_t osize, std::size_t nsize) noexcept {
+  bool const small_before{ osize <= kMaxSmall };
+  bool const small_after{ nsize <= kMaxSmall };
+
+  if (small_before && small_after && class_index(osize) == class_index(nsize)) {
+    stats_.current_bytes += static_cast<std::int64_t>(nsize) -
+                            static_cast<std::int64_t>(osize);
+    stats_.peak_bytes = std::max(stats_.peak_bytes, stats_.current_bytes);
+    return ptr;
+  }
+
+  if (!small_before && !small_after) {
+    void *const block{ std::realloc(ptr, nsize) };
+    if (!block) { return nullptr; }
+    auto const delta{ static_cast<std::int64_t>(nsize) -
+                      static_cast<std::int64_t>(osize) };
+    stats_.current_bytes += delta;
+    stats_.reserved_bytes += delta;
+    stats_.peak_bytes = std::max(stats_.peak_bytes, stats_.current_bytes);
+    if (delta > 0) {
+      stats_.total_bytes += delta;
+      ++stats_.allocations;
+    }
+    return block;
+  }
+
+  // Crossing a size class or the small/large boundary: Lua keeps the old block if this
+  // fails, so only release it once the copy exists.
+  void *const block{ allocate(nsize) };
+  if (!block) { return nullptr; }
+  std::memcpy(block, ptr, std::min(osize, nsize));
+  deallocate(ptr, osize);
+  return block;
+}
+
+void *lua_arena::carve(std::size_t bytes) noexcept {
+  if (static_cast<std::size_t>(bump_end_ - bump_) < bytes) {
+    void *const chunk{ std::malloc(kChunkBytes) };
+    if (!chunk) { return nullptr; }
+    try {
+      chunks_.push_back(chunk);
+    } catch (...) {
+      std::free(chunk);
+      return nullptr;
+    }
+    stats_.reserved_bytes += static_cast<std::int64_t>(kChunkBytes);
+    // The tail of the previous chunk is abandoned; it is at most kMaxSmall bytes.
+    bump_ = static_cast<char *>(chunk);
+    bump_end_ = bump_ + kChunkBytes;
+  }
+  void *const block{ bump_ };
+  bump_ += bytes;
+  return block;
+}
+
+std::optional<lua_memory_stats> lua_memory_stats_of(lua_State *L) {
+  void *ud{ nullptr };
+  if (lua_getallocf(L, &ud) != &lua_arena::alloc) { return std::nullopt; }
+  return static_cast<lua_arena const *>(ud)->stats();
+}
+
+void lua_memory_reset_counters(lua_State *L) {
+  void *ud{ nullptr };
+  if (lua_getallocf(L, &ud) == &lua_arena::alloc) {
+    static_cast<lua_arena *>(ud)->reset_counters();
+  }
+}
+
+void lua_memory_trace(std::string const &pkg_identity, pkg_phase phase, lua_State *L) {
+  if (!tui::trace_enabled()) { return; }
+  auto const stats{ lua_memory_stats_of(L) };
+  if (!stats) { return; }
+  ENVY_TRACE(lua_memory,
+             pkg_identity,
+             .phase = phase,
+             .gc_mode = std::string{ lua_gc_mode_name(lua_gc_mode_for_phase(phase)) },
+             .current_bytes = stats->current_bytes,
+             .peak_bytes = stats->peak_bytes,
+             .total_bytes = stats->total_bytes,
+             .allocations = stats->allocations,
+             .reserved_bytes = stats->reserved_bytes);
+}
+
+std::string_view lua_gc_mode_name(lua_gc_mode mode) {
+  return mode == lua_gc_mode::generational ? "generational" : "incremental";
+}
+
+lua_gc_modes lua_gc_modes_parse(std::string_view spec) {
+  lua_gc_modes modes;
+  modes.fill(lua_gc_mode::incremental);
+
+  if (auto const all{ parse_mode(trim(spec)) }) {
+    modes.fill(*all);
+    return modes;
+  }
+
+  while (!spec.empty()) {
+    auto const comma{ spec.find(',') };
+    std::string_view const item{ trim(spec.substr(0, comma)) };
+    spec = comma == std::string_view::npos ? std::string_view{} : spec.substr(comma + 1);
+
+    auto const eq{ item.find('=') };
+    if (eq == std::string_view::npos) {
+      throw std::runtime_error("Lua GC mode: expected 'phase=mode', got '" +
+                               std::string{ item } + "'");
+    }
+    auto const phase{ pkg_phase_parse(trim(item.substr(0, eq))) };
+    if (!phase || *phase == pkg_phase::none) {
+      throw std::runtime_error("Lua GC mode: unknown phase '" +
+                               std::string{ trim(item.substr(0, eq)) } + "'");
+    }
+    auto const mode{ parse_mode(trim(item.substr(eq + 1))) };
+    if (!mode) {
+      throw std::runtime_error("Lua GC mode: expected incremental or generational, got '" +
+                               std::string{ trim(item.substr(eq + 1)) } + "'");
+    }
+    modes[static_cast<std::size_t>(*phase)] = *mode;
+  }
+  return modes;
+}
+
+lua_gc_mode lua_gc_mode_for_phase(pkg_phase phase) {
+  static lua_gc_modes const modes{ env_gc_modes() };
+  if (phase == pkg_phase::none) { return lua_gc_mode::incremental; }
+  return modes[static_cast<std::size_t>(phase)];
+}
+
+void lua_set_gc_mode(lua_State *L, lua_gc_mode mode) {
+  lua_gc(L, mode == lua_gc_mode::generational ? LUA_GCGEN : LUA_GCINC, 0, 0);
+}
+
+}  // namespace envy
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "pkg_phase.h"
+#include "util.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct lua_State;
+
+namespace envy {
+
+struct lua_memory_stats {
+  std::int64_t current_bytes{ 0 };   // Live bytes, as requested by Lua
+  std::int64_t peak_bytes{ 0 };      // Largest current_bytes so far
+  std::int64_t total_bytes{ 0 };     // Sum of every allocation's size
+  std::int64_t allocations{ 0 };     // Allocations, including growing reallocations
+  std::int64_t reserved_bytes{ 0 };  // Held from malloc: chunks plus large blocks
+};
+
+// Allocator for one Lua state (lua_newstate's lua_Alloc). Blocks up to kMaxSmall bytes
+// are rounded up to a kGranularity size class and carved from kChunkBytes chunks; freed
+// blocks go on their class's free list and are reused by the same state. Chunks are
+// only returned to malloc when the arena is destroyed, after its state is closed, so a
+// state's small allocations never interleave with other states' in the global heap.
+// lua_state_pool does not keep a state whose arena has grown large.
+// Larger blocks go straight to malloc. Not thread-safe: like the state it serves, an
+// arena is used by one thread at a time.
+class lua_arena : unmovable {
+ public:
+  static constexpr std::size_t kGranularity{ 16 };
+  static constexpr std::size_t kMaxSmall{ 512 };
+  static constexpr std::size_t kChunkBytes{ 64 * 1024 };
+
+  lua_arena() = default;
+  ~lua_arena();
+
+  // lua_Alloc: ud is the arena. nsize == 0 frees; returns nullptr on exhaustion.
+  static void *alloc(void *ud, void *ptr, std::size_t osize, std::size_t nsize) noexcept;
+
+  lua_memory_stats const &stats() const { return stats_; }
+
+  // Starts a new accounting window: peak drops to the live size and the cumulative
+  // counters restart from zero. Live and reserved bytes are unaffected.
+  void reset_counters();
+
+ private:
+  static constexpr std::size_t kClasses{ kMaxSmall / kGranularity };
+
+  void *allocate(std::size_t size) noexcept;
+  void deallocate(void *ptr, std::size_t size) noexcept;
+  void *reallocate(void *ptr, std::size_t osize, std::size_t nsize) noexcept;
+  void *carve(std::size_t class_bytes) noexcept;
+
+  std::array<void *, kClasses> free_lists_{};
+  std::vector<void *> chunks_;
+  char *bump_{ nullptr };
+  char *bump_end_{ nullptr };
+  lua_memory_stats stats_;
+};
+
+// Counters of a state whose allocator is a lua_arena (every state from
+// sol_util_make_lua_state); nullopt for any other state.
+std::optional<lua_memory_stats> lua_memory_stats_of(lua_State *L);
+
+// reset_counters() on the arena of L, if it has one.
+void lua_memory_reset_counters(lua_State *L);
+
+// Emits a lua_memory trace event for a package's state at the end of `phase`.
+void lua_memory_trace(std::string const &pkg_identity, pkg_phase phase, lua_State *L);
+
+enum class lua_gc_mode { incremental, generational };
+using lua_gc_modes = std::array<lua_gc_mode, pkg_phase_count>;  // Indexed by phase
+
+std::string_view lua_gc_mode_name(lua_gc_mode mode);
+
+// "incremental" or "generational" for every phase, or comma-separated phase=mode pairs
+// ("spec_fetch=generational,build=incremental"). Unnamed phases are incremental, Lua's
+// own default. Throws std::runtime_error on anything else.
+lua_gc_modes lua_gc_modes_parse(std::string_view spec);
+
+// Mode for `phase` from ENVY_LUA_GC, read once per process. An invalid value is reported
+// once as a warning and ignored.
+lua_gc_mode lua_gc_mode_for_phase(pkg_phase phase);
+
+// Switches the collector of L to `mode`, keeping its tuning parameters.
+void lua_set_gc_mode(lua_State *L, lua_gc_mode mode);
+
+}  // namespace envy
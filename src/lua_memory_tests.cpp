@@ -0,0 +1,288 @@
+#include "lua_memory.h"
+
+#include "lua_envy.h"
+#include "lua_state_pool.h"
+#include "sol_util.h"
+
+#include "doctest.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace envy {
+
+namespace {
+
+void *arena_alloc(lua_arena &arena, std::size_t size) {
+  return lua_arena::alloc(&arena, nullptr, 0, size);
+}
+
+void *arena_realloc(lua_arena &arena, void *ptr, std::size_t osize, std::size_t nsize) {
+  return lua_arena::alloc(&arena, ptr, osize, nsize);
+}
+
+void arena_free(lua_arena &arena, void *ptr, std::size_t size) {
+  CHECK(lua_arena::alloc(&arena, ptr, size, 0) == nullptr);
+}
+
+// Resident set size in KiB, or -1 where /proc is unavailable.
+long resident_kb() {
+  std::ifstream statm{ "/proc/self/statm" };
+  long size{ 0 };
+  long resident{ 0 };
+  if (!(statm >> size >> resident)) { return -1; }
+  return resident * 4;  // Pages; 4 KiB on every platform envy runs this on
+}
+
+// Returns free heap pages to the system. Without it, a measurement that follows another
+// reuses the pages the earlier one freed, and its RSS growth reads far too low.
+void release_free_heap() {
+#if defined(__GLIBC__)
+  malloc_trim(0);
+#endif
+}
+
+}  // namespace
+
+TEST_CASE("lua_arena recycles small blocks within their size class") {
+  lua_arena arena;
+  void *const a{ arena_alloc(arena, 24) };
+  REQUIRE(a != nullptr);
+  arena_free(arena, a, 24);
+
+  CHECK(arena_alloc(arena, 32) == a);  // 24 and 32 share the 32-byte class
+  CHECK(arena.stats().reserved_bytes ==
+        static_cast<std::int64_t>(lua_arena::kChunkBytes));
+}
+
+TEST_CASE("lua_arena keeps blocks aligned and disjoint") {
+  lua_arena arena;
+  std::vector<char *> blocks;
+  for (std::size_t size{ 1 }; size <= lua_arena::kMaxSmall; size += 7) {
+    auto *const block{ static_cast<char *>(arena_alloc(arena, size)) };
+    REQUIRE(block != nullptr);
+    CHECK(reinterpret_cast<std::uintptr_t>(block) % alignof(std::max_align_t) == 0);
+    std::memset(block, static_cast<int>(size & 0xff), size);
+    blocks.push_back(block);
+  }
+  std::size_t size{ 1 };
+  for (char *block : blocks) {
+    for (std::size_t i{ 0 }; i < size; ++i) {
+      REQUIRE(static_cast<unsigned char>(block[i]) == (size & 0xff));
+    }
+    size += 7;
+  }
+}
+
+TEST_CASE("lua_arena reallocation") {
+  lua_arena arena;
+  auto *const block{ static_cast<char *>(arena_alloc(arena, 20)) };
+  std::memcpy(block, "0123456789abcdefghi", 20);
+
+  SUBCASE("within a size class keeps the block") {
+    CHECK(arena_realloc(arena, block, 20, 30) == block);
+    CHECK(arena.stats().current_bytes == 30);
+  }
+
+  SUBCASE("across size classes copies the contents") {
+    auto *const grown{ static_cast<char *>(arena_realloc(arena, block, 20, 100)) };
+    REQUIRE(grown != nullptr);
+    CHECK(std::string{ grown } == "0123456789abcdefghi");
+    CHECK(arena.stats().current_bytes == 100);
+  }
+
+  SUBCASE("into and out of large blocks") {
+    auto *const large{ static_cast<char *>(arena_realloc(arena, block, 20, 4096)) };
+    REQUIRE(large != nullptr);
+    CHECK(std::string{ large } == "0123456789abcdefghi");
+    CHECK(arena.stats().reserved_bytes ==
+          static_cast<std::int64_t>(lua_arena::kChunkBytes + 4096));
+
+    auto *const larger{ static_cast<char *>(arena_realloc(arena, large, 4096, 8192)) };
+    REQUIRE(larger != nullptr);
+    CHECK(std::string{ larger } == "0123456789abcdefghi");
+
+    auto *const small{ static_cast<char *>(arena_realloc(arena, larger, 8192, 64)) };
+    REQUIRE(small != nullptr);
+    CHECK(std::string{ small } == "0123456789abcdefghi");
+    CHECK(arena.stats().reserved_bytes ==
+          static_cast<std::int64_t>(lua_arena::kChunkBytes));
+    arena_free(arena, small, 64);
+    CHECK(arena.stats().current_bytes == 0);
+  }
+}
+
+TEST_CASE("lua_arena counts current, peak and total bytes") {
+  lua_arena arena;
+  void *const a{ arena_alloc(arena, 100) };
+  void *const b{ arena_alloc(arena, 1000) };
+  arena_free(arena, a, 100);
+  void *const c{ arena_alloc(arena, 50) };
+
+  auto const &stats{ arena.stats() };
+  CHECK(stats.current_bytes == 1050);
+  CHECK(stats.peak_bytes == 1100);
+  CHECK(stats.total_bytes == 1150);
+  CHECK(stats.allocations == 3);
+
+  arena.reset_counters();
+  CHECK(stats.peak_bytes == 1050);
+  CHECK(stats.total_bytes == 0);
+  CHECK(stats.allocations == 0);
+
+  arena_free(arena, b, 1000);
+  arena_free(arena, c, 50);
+  CHECK(stats.current_bytes == 0);
+  CHECK(stats.peak_bytes == 1050);
+}
+
+TEST_CASE("lua_arena ignores the type tag Lua passes for new objects") {
+  lua_arena arena;
+  void *const block{ lua_arena::alloc(&arena, nullptr, 5 /* LUA_TTABLE */, 56) };
+  REQUIRE(block != nullptr);
+  CHECK(arena.stats().current_bytes == 56);
+  CHECK(lua_arena::alloc(&arena, nullptr, 0, 0) == nullptr);
+}
+
+TEST_CASE("lua_gc_modes_parse") {
+  SUBCASE("one mode for every phase") {
+    auto const modes{ lua_gc_modes_parse("generational") };
+    for (auto const mode : modes) { CHECK(mode == lua_gc_mode::generational); }
+  }
+
+  SUBCASE("per phase, others incremental") {
+    auto const modes{
+        lua_gc_modes_parse("spec_fetch=generational, build = generational") };
+    CHECK(modes[static_cast<int>(pkg_phase::spec_fetch)] == lua_gc_mode::generational);
+    CHECK(modes[static_cast<int>(pkg_phase::pkg_build)] == lua_gc_mode::generational);
+    CHECK(modes[static_cast<int>(pkg_phase::pkg_install)] == lua_gc_mode::incremental);
+  }
+
+  SUBCASE("empty means the default") {
+    for (auto const mode : lua_gc_modes_parse("")) {
+      CHECK(mode == lua_gc_mode::incremental);
+    }
+  }
+
+  SUBCASE("rejects unknown phases and modes") {
+    CHECK_THROWS_WITH_AS(lua_gc_modes_parse("compile=generational"),
+                         doctest::Contains("unknown phase 'compile'"),
+                         std::runtime_error);
+    CHECK_THROWS_WITH_AS(lua_gc_modes_parse("build=emergency"),
+                         doctest::Contains("got 'emergency'"),
+                         std::runtime_error);
+    CHECK_THROWS_WITH_AS(lua_gc_modes_parse("build"),
+                         doctest::Contains("expected 'phase=mode'"),
+                         std::runtime_error);
+  }
+}
+
+TEST_CASE("sol_util_make_lua_state allocates from an arena") {
+  auto lua{ sol_util_make_lua_state() };
+  auto const before{ lua_memory_stats_of(lua->lua_state()) };
+  REQUIRE(before);
+  CHECK(before->current_bytes > 0);
+
+  lua->script("local t = {} for i = 1, 10000 do t[i] = tostring(i) end");
+  auto const after{ lua_memory_stats_of(lua->lua_state()) };
+  REQUIRE(after);
+  CHECK(after->peak_bytes > before->peak_bytes);
+  CHECK(after->total_bytes > before->total_bytes);
+  CHECK(after->reserved_bytes >= after->current_bytes);
+}
+
+TEST_CASE("lua_memory_stats_of is empty for states without an arena") {
+  sol::state lua;
+  CHECK_FALSE(lua_memory_stats_of(lua.lua_state()));
+}
+
+TEST_CASE("lua_set_gc_mode switches the collector") {
+  auto lua{ sol_util_make_lua_state() };
+  lua_set_gc_mode(lua->lua_state(), lua_gc_mode::generational);
+  CHECK(lua->script("return collectgarbage('incremental')").get<std::string>() ==
+        "generational");
+  lua_set_gc_mode(lua->lua_state(), lua_gc_mode::incremental);
+  CHECK(lua->script("return collectgarbage('incremental')").get<std::string>() ==
+        "incremental");
+}
+
+TEST_CASE("lua_state_pool starts each lease with fresh memory counters") {
+  lua_state_pool pool{ 1 };
+  std::int64_t first_peak{ 0 };
+  {
+    lua_state_pool::lease const lua{ pool };
+    lua->script("BIG = {} for i = 1, 20000 do BIG[i] = tostring(i) end");
+    first_peak = lua_memory_stats_of(lua->lua_state())->peak_bytes;
+  }
+
+  lua_state_pool::lease const lua{ pool };
+  auto const stats{ lua_memory_stats_of(lua->lua_state()) };
+  REQUIRE(stats);
+  CHECK(stats->peak_bytes < first_peak);
+  CHECK(stats->allocations == 0);
+  CHECK(lua->script("return collectgarbage('incremental')").get<std::string>() ==
+        "incremental");
+}
+
+TEST_CASE("1000 package spec states, arena vs default allocator" * doctest::skip()) {
+  constexpr int kPackages{ 1000 };
+  constexpr char kSpec[]{ R"lua(
+IDENTITY = "local.tool@v1"
+DEPENDENCIES = { { spec = "local.dep@v1", source = "dep.lua" } }
+FETCH = { source = "https://example.com/tool.tar.gz", sha256 = string.rep("a", 64) }
+PRODUCTS = { tool = "bin/tool" }
+INSTALL = function(install_dir) envy.info(install_dir) end
+)lua" };
+
+  // A package holds its state from spec_fetch to completion, so in a wide graph most
+  // of them are live together; hold all of them at once.
+  auto const run{ [&](auto &&make_state, char const *label) {
+    release_free_heap();
+    long const rss_before{ resident_kb() };
+    auto const start{ std::chrono::steady_clock::now() };
+    std::vector<sol_state_ptr> states;
+    for (int i{ 0 }; i < kPackages; ++i) {
+      auto lua{ make_state() };
+      lua_envy_install(*lua);
+      lua->script(kSpec);
+      states.push_back(std::move(lua));
+    }
+    auto const built{ std::chrono::steady_clock::now() };
+    long const rss_after{ resident_kb() };
+    states.clear();
+    auto const destroyed{ std::chrono::steady_clock::now() };
+
+    using ms = std::chrono::duration<double, std::milli>;
+    MESSAGE(label << ": load " << ms(built - start).count() << " ms, destroy "
+                  << ms(destroyed - built).count() << " ms, RSS +"
+                  << (rss_after - rss_before) << " KiB");
+  } };
+
+  run([] { return sol_util_make_lua_state(); }, "arena");
+  run(
+      [] {
+        sol_state_ptr lua{ new sol::state() };
+        lua->open_libraries(sol::lib::base,
+                            sol::lib::package,
+                            sol::lib::coroutine,
+                            sol::lib::string,
+                            sol::lib::os,
+                            sol::lib::math,
+                            sol::lib::table,
+                            sol::lib::debug,
+                            sol::lib::bit32,
+                            sol::lib::io);
+        return lua;
+      },
+      "default allocator");
+}
+
+}  // namespace envy
@@ -0,0 +1,180 @@
+#include "lua_profiler.h"
+
+#include "tui.h"
+
+#include "sol/sol.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace envy {
+
+namespace {
+
+// Address is the registry key holding the attached profiler as light userdata.
+constexpr char kRegistryKey{ 0 };
+
+std::atomic<lua_profiler *> g_session_profiler{ nullptr };
+
+// Collapsed-stack consumers split frames on ';' and the count off the last space.
+std::string frame_name(lua_Debug const &ar) {
+  std::string name;
+  if (std::strcmp(ar.what, "main") == 0) {
+    name = "main chunk (" + std::string{ ar.short_src } + ")";
+  } else if (std::strcmp(ar.what, "C") == 0) {
+    name = "[C] " + std::string{ ar.name ? ar.name : "?" };
+  } else {
+    name = std::string{ ar.name ? ar.name : "function" } + " (" +
+           std::string{ ar.short_src } + ":" + std::to_string(ar.linedefined) + ")";
+  }
+  std::replace(name.begin(), name.end(), ';', ':');
+  return name;
+}
+
+}  // namespace
+
+lua_profiler::lua_profiler(int instruction_interval)
+    : interval_{ std::max(instruction_interval, 1) } {}
+
+void lua_profiler::attach(lua_State *L) {
+  lua_pushlightuserdata(L, this);
+  lua_rawsetp(L, LUA_REGISTRYINDEX, &kRegistryKey);
+  lua_sethook(L, &lua_profiler::hook, LUA_MASKCOUNT, interval_);
+}
+
+void lua_profiler::detach(lua_State *L) {
+  lua_sethook(L, nullptr, 0, 0);
+  lua_pushnil(L);
+  lua_rawsetp(L, LUA_REGISTRYINDEX, &kRegistryKey);
+}
+
+void lua_profiler::hook(lua_State *L, lua_Debug *ar) {
+  if (ar->event != LUA_HOOKCOUNT) { return; }
+  lua_rawgetp(L, LUA_REGISTRYINDEX, &kRegistryKey);
+  auto *const self{ static_cast<lua_profiler *>(lua_touserdata(L, -1)) };
+  lua_pop(L, 1);
+  if (self) { self->sample(L); }
+}
+
+void lua_profiler::sample(lua_State *L) {
+  std::vector<std::string> frames;  // Leaf first
+  std::string leaf_source;
+  int leaf_line{ -1 };
+
+  lua_Debug ar;
+  for (int level{ 0 }; level < kMaxDepth && lua_getstack(L, level, &ar); ++level) {
+    if (!lua_getinfo(L, "Sln", &ar)) { break; }
+    frames.push_back(frame_name(ar));
+    if (level == 0) {
+      leaf_source = ar.short_src;
+      leaf_line = ar.currentline;
+    }
+  }
+  if (frames.empty()) { return; }
+
+  std::string stack;
+  for (auto it{ frames.rbegin() }; it != frames.rend(); ++it) {
+    if (!stack.empty()) { stack += ';'; }
+    stack += *it;
+  }
+
+  std::lock_guard const lock{ mutex_ };
+  ++samples_;
+  ++stacks_[std::move(stack)];
+  ++lines_[{ std::move(frames.front()), std::move(leaf_source), leaf_line }];
+}
+
+std::uint64_t lua_profiler::sample_count() const {
+  std::lock_guard const lock{ mutex_ };
+  return samples_;
+}
+
+std::string lua_profiler::collapsed() const {
+  std::lock_guard const lock{ mutex_ };
+  std::string out;
+  for (auto const &[stack, count] : stacks_) {
+    out += stack;
+    out += ' ';
+    out += std::to_string(count);
+    out += '\n';
+  }
+  return out;
+}
+
+std::vector<lua_profile_hotspot> lua_profiler::top(std::size_t n) const {
+  std::vector<lua_profile_hotspot> result;
+  {
+    std::lock_guard const lock{ mutex_ };
+    result.reserve(lines_.size());
+    for (auto const &[key, count] : lines_) {
+      auto const &[function, source, line]{ key };
+      result.push_back({ function, source, line, count });
+    }
+  }
+  std::stable_sort(result.begin(), result.end(), [](auto const &a, auto const &b) {
+    return a.samples > b.samples;
+  });
+  if (result.size() > n) { result.resize(n); }
+  return result;
+}
+
+std::string lua_profiler::summary(std::size_t n) const {
+  auto const total{ sample_count() };
+  std::string out{ "Lua profile: " + std::to_string(total) + " samples, one per " +
+                   std::to_string(interval_) + " instructions\n" };
+  if (total == 0) { return out; }
+
+  out += "  samples      %  function, line\n";
+  for (auto const &h : top(n)) {
+    char row[64];
+    std::snprintf(row,
+                  sizeof(row),
+                  "  %7llu %6.1f  ",
+                  static_cast<unsigned long long>(h.samples),
+                  100.0 * static_cast<double>(h.samples) / static_cast<double>(total));
+    out += row;
+    out += h.function;
+    if (h.line >= 0) { out += ", line " + std::to_string(h.line); }
+    out += '\n';
+  }
+  return out;
+}
+
+void lua_profiler::write_collapsed(std::filesystem::path const &path) const {
+  std::ofstream out{ path, std::ios::binary | std::ios::trunc };
+  out << collapsed();
+  if (!out.flush()) {
+    throw std::runtime_error("Failed to write Lua profile: " + path.string());
+  }
+}
+
+lua_profiler_session::lua_profiler_session(std::optional<std::filesystem::path> path)
+    : path_{ std::move(path) } {
+  if (path_) { g_session_profiler.store(new lua_profiler{}); }
+}
+
+lua_profiler_session::~lua_profiler_session() {
+  if (!path_) { return; }
+  // Package and manifest states are gone by now, so nothing samples into it anymore.
+  std::unique_ptr<lua_profiler> const profiler{ g_session_profiler.exchange(nullptr) };
+  try {
+    profiler->write_collapsed(*path_);
+    tui::info("%sCollapsed stacks written to %s",
+              profiler->summary(10).c_str(),
+              path_->string().c_str());
+  } catch (std::exception const &e) {
+    tui::warn("%s", e.what());
+  }
+}
+
+void lua_profiler_attach(lua_State *L) {
+  if (auto *const profiler{ g_session_profiler.load() }) { profiler->attach(L); }
+}
+
+}  // namespace envy
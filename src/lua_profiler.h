@@ -0,0 +1,85 @@
+#pragma once
+
+#include "util.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+struct lua_State;
+struct lua_Debug;
+
+namespace envy {
+
+struct lua_profile_hotspot {
+  std::string function;  // Frame name as in the collapsed stacks
+  std::string source;    // Chunk short_src
+  int line;              // Line executing when sampled; -1 for C functions
+  std::uint64_t samples;
+};
+
+// Sampling profiler for Lua code. attach() installs a count hook that fires every
+// `instruction_interval` VM instructions and records the running call stack. Samples
+// from every attached state, on any thread, aggregate into one profile.
+class lua_profiler : unmovable {
+ public:
+  static constexpr int kDefaultInterval{ 10000 };
+  static constexpr int kMaxDepth{ 64 };  // Deeper frames are dropped from the root end
+
+  explicit lua_profiler(int instruction_interval = kDefaultInterval);
+
+  // Replaces any hook on L. The profiler must outlive L or a detach() of it.
+  void attach(lua_State *L);
+  static void detach(lua_State *L);
+
+  std::uint64_t sample_count() const;
+
+  // Collapsed stacks ("root;caller;leaf count" per line, sorted), as consumed by
+  // flamegraph.pl, inferno and speedscope. Frames are "name (source:linedefined)".
+  std::string collapsed() const;
+
+  // The n most sampled leaf function lines, most samples first.
+  std::vector<lua_profile_hotspot> top(std::size_t n) const;
+
+  // Human-readable table of top(n) with sample percentages.
+  std::string summary(std::size_t n) const;
+
+  // Writes collapsed() to `path`. Throws std::runtime_error if the file can't be written.
+  void write_collapsed(std::filesystem::path const &path) const;
+
+ private:
+  using line_key = std::tuple<std::string, std::string, int>;  // function, source, line
+
+  static void hook(lua_State *L, lua_Debug *ar);
+  void sample(lua_State *L);
+
+  int const interval_;
+  mutable std::mutex mutex_;
+  std::uint64_t samples_{ 0 };
+  std::map<std::string, std::uint64_t> stacks_;
+  std::map<line_key, std::uint64_t> lines_;
+};
+
+// Process-wide profiling behind --lua-profile. While a session with a path is alive,
+// lua_profiler_attach() hooks states into it; on destruction it writes the collapsed
+// stacks to the path and logs the top functions.
+class lua_profiler_session : unmovable {
+ public:
+  explicit lua_profiler_session(std::optional<std::filesystem::path> path);
+  ~lua_profiler_session();
+
+ private:
+  std::optional<std::filesystem::path> path_;
+};
+
+// Attaches the session profiler to a package or manifest state; no-op when profiling
+// is off.
+void lua_profiler_attach(lua_State *L);
+
+}  // namespace envy
@@ -0,0 +1,129 @@
+#include "lua_profiler.h"
+
+#include "sol_util.h"
+
+#include "doctest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace envy {
+
+namespace {
+
+// Line 5 is the hot loop; cold() runs a handful of instructions.
+constexpr char kHotSpec[]{ R"lua(IDENTITY = "local.hot@v1"
+
+local function hot(n)
+  local s = 0
+  for i = 1, n do s = s + (i * 7) % 13 end
+  return s
+end
+
+local function cold()
+  return 1
+end
+
+RESULT = hot(2000000) + cold()
+)lua" };
+
+void run_spec(sol::state &lua, char const *script) {
+  sol::protected_function_result result{
+    lua.safe_script(script, sol::script_pass_on_error, "@hot_spec.lua")
+  };
+  REQUIRE(result.valid());
+}
+
+}  // namespace
+
+TEST_CASE("lua_profiler attributes a hot loop to its function and line") {
+  lua_profiler profiler{ 100 };
+  auto lua{ sol_util_make_lua_state() };
+  profiler.attach(lua->lua_state());
+  run_spec(*lua, kHotSpec);
+
+  REQUIRE(profiler.sample_count() > 100);
+  auto const hottest{ profiler.top(3) };
+  REQUIRE_FALSE(hottest.empty());
+  CHECK(hottest[0].function == "hot (hot_spec.lua:3)");
+  CHECK(hottest[0].source == "hot_spec.lua");
+  CHECK(hottest[0].line == 5);
+  CHECK(hottest[0].samples * 10 > profiler.sample_count() * 9);
+
+  auto const folded{ profiler.collapsed() };
+  CHECK(folded.find("main chunk (hot_spec.lua);hot (hot_spec.lua:3) ") !=
+        std::string::npos);
+
+  auto const text{ profiler.summary(5) };
+  CHECK(text.find("hot (hot_spec.lua:3), line 5") != std::string::npos);
+}
+
+TEST_CASE("lua_profiler collapsed output is one 'stack count' line per stack") {
+  lua_profiler profiler{ 100 };
+  auto lua{ sol_util_make_lua_state() };
+  profiler.attach(lua->lua_state());
+  run_spec(*lua, kHotSpec);
+
+  std::uint64_t total{ 0 };
+  std::string const folded{ profiler.collapsed() };
+  std::size_t start{ 0 };
+  while (start < folded.size()) {
+    auto const end{ folded.find('\n', start) };
+    REQUIRE(end != std::string::npos);
+    std::string const line{ folded.substr(start, end - start) };
+    auto const space{ line.rfind(' ') };
+    REQUIRE(space != std::string::npos);
+    total += std::stoull(line.substr(space + 1));
+    start = end + 1;
+  }
+  CHECK(total == profiler.sample_count());
+}
+
+TEST_CASE("lua_profiler aggregates across states and threads") {
+  lua_profiler profiler{ 1000 };
+  std::vector<std::thread> threads;
+  for (int i{ 0 }; i < 4; ++i) {
+    threads.emplace_back([&] {
+      auto lua{ sol_util_make_lua_state() };
+      profiler.attach(lua->lua_state());
+      run_spec(*lua, kHotSpec);
+      lua_profiler::detach(lua->lua_state());
+    });
+  }
+  for (auto &t : threads) { t.join(); }
+
+  auto const hottest{ profiler.top(1) };
+  REQUIRE(hottest.size() == 1);
+  CHECK(hottest[0].line == 5);
+  CHECK(hottest[0].samples > 4 * 100);
+}
+
+TEST_CASE("lua_profiler stops sampling after detach") {
+  lua_profiler profiler{ 100 };
+  auto lua{ sol_util_make_lua_state() };
+  profiler.attach(lua->lua_state());
+  lua_profiler::detach(lua->lua_state());
+  run_spec(*lua, kHotSpec);
+  CHECK(profiler.sample_count() == 0);
+  CHECK(profiler.collapsed().empty());
+}
+
+TEST_CASE("lua_profiler writes collapsed stacks to a file") {
+  lua_profiler profiler{ 100 };
+  auto lua{ sol_util_make_lua_state() };
+  profiler.attach(lua->lua_state());
+  run_spec(*lua, kHotSpec);
+
+  auto const path{ std::filesystem::temp_directory_path() / "envy-lua-profile.folded" };
+  profiler.write_collapsed(path);
+  std::ifstream in{ path, std::ios::binary };
+  std::string const content{ std::istreambuf_iterator<char>{ in }, {} };
+  CHECK(content == profiler.collapsed());
+  std::filesystem::remove(path);
+}
+
+}  // namespace envy
@@ -0,0 +1,206 @@
+#include "lua_state_pool.h"
+
+#include "lua_envy.h"
+#include "lua_memory.h"
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace envy {
+
+namespace {
+
+constexpr char kRestoreRegistryKey[] = "envy.lua_state_pool.restore";
+
+// Snapshots every table reachable from _G, the registry and the string metatable, and
+// the upvalues of every function reachable from them. Returns a function that puts them
+// all back and reseeds math.random, as a fresh state would be. Library functions are
+// captured up front so a script that replaces next/rawset/debug cannot break the
+// restore. Takes the registry key the restore function will be stored under.
+constexpr char kSnapshotLua[] = R"lua(
+local keep_key = ...
+local next, rawset, type, math_type = next, rawset, type, math.type
+local getmt, setmt = debug.getmetatable, debug.setmetatable
+local getupvalue, setupvalue = debug.getupvalue, debug.setupvalue
+local sethook, collectgarbage = debug.sethook, collectgarbage
+local randomseed = math.randomseed
+local registry = debug.getregistry()
+
+local saved, upvalues = {}, {}
+local walk
+
+local function walk_value(v)
+  if type(v) == "table" then
+    walk(v)
+  elseif type(v) == "function" and not upvalues[v] then
+    local ups = {}
+    upvalues[v] = ups
+    local i = 1
+    while true do
+      local name, up = getupvalue(v, i)
+      if name == nil then break end
+      ups[i] = up
+      walk_value(up)
+      i = i + 1
+    end
+    ups.n = i - 1
+  end
+end
+
+function walk(t)
+  if saved[t] then return end
+  local entry = { copy = {}, mt = getmt(t) }
+  saved[t] = entry
+  for k, v in next, t do
+    entry.copy[k] = v
+    walk_value(k)
+    walk_value(v)
+  end
+  walk_value(entry.mt)
+end
+
+-- Integer registry keys are luaL_ref slots owned by whoever holds the reference, and
+-- "sol." keys are sol2's per-type metatables; everything else (package.loaded, io's
+-- default files, keys a script added) is put back.
+local function registry_key(k)
+  return math_type(k) ~= "integer" and k ~= keep_key and
+         not (type(k) == "string" and k:sub(1, 4) == "sol.")
+end
+local registry_copy = {}
+for k, v in next, registry do
+  if registry_key(k) then
+    registry_copy[k] = v
+    walk_value(v)
+  end
+end
+
+walk(_G)
+local string_mt = getmt("")
+walk_value(string_mt)
+
+return function()
+  for k in next, registry do
+    if registry_key(k) and registry_copy[k] == nil then rawset(registry, k, nil) end
+  end
+  for k, v in next, registry_copy do rawset(registry, k, v) end
+  for t, entry in next, saved do
+    if t ~= registry then
+      for k in next, t do
+        if entry.copy[k] == nil then rawset(t, k, nil) end
+      end
+      for k, v in next, entry.copy do rawset(t, k, v) end
+      setmt(t, entry.mt)
+    end
+  end
+  for f, ups in next, upvalues do
+    for i = 1, ups.n do setupvalue(f, i, ups[i]) end
+  end
+  setmt("", string_mt)
+  sethook()
+  randomseed()
+  collectgarbage("restart")
+  collectgarbage("collect")
+end
+)lua";
+
+sol_state_ptr build_state() {
+  auto lua{ sol_util_make_lua_state() };
+  lua_envy_install(*lua);
+
+  sol::load_result chunk{ lua->load(kSnapshotLua, "=envy.lua_state_pool") };
+  if (!chunk.valid()) {
+    sol::error err = chunk;
+    throw std::runtime_error(std::string("lua_state_pool: snapshot failed: ") +
+                             err.what());
+  }
+  sol::protected_function_result snapshot{
+    chunk.get<sol::protected_function>()(kRestoreRegistryKey)
+  };
+  if (!snapshot.valid()) {
+    sol::error err = snapshot;
+    throw std::runtime_error(std::string("lua_state_pool: snapshot failed: ") +
+                             err.what());
+  }
+  lua->registry()[kRestoreRegistryKey] = snapshot.get<sol::protected_function>();
+  return lua;
+}
+
+bool sanitize(sol::state &lua) {
+  if (lua_status(lua.lua_state()) != LUA_OK) { return false; }
+  lua_settop(lua.lua_state(), 0);
+
+  lua.registry()[ENVY_OPTIONS_RIDX] = sol::lua_nil;
+  lua.registry()[ENVY_PHASE_CTX_RIDX] = sol::lua_nil;
+  lua_set_gc_mode(lua.lua_state(), lua_gc_mode::incremental);
+
+  sol::object const restore_obj{ lua.registry()[kRestoreRegistryKey] };
+  if (!restore_obj.is<sol::protected_function>()) { return false; }
+  return restore_obj.as<sol::protected_function>()().valid();
+}
+
+}  // namespace
+
+lua_state_pool::lua_state_pool(std::size_t max_idle, std::int64_t max_arena_growth)
+    : max_idle_{ max_idle }, max_arena_growth_{ max_arena_growth } {}
+
+lua_state_pool &lua_state_pool::shared() {
+  static lua_state_pool pool;
+  return pool;
+}
+
+sol_state_ptr lua_state_pool::acquire() {
+  sol_state_ptr state;
+  {
+    std::lock_guard const lock{ mutex_ };
+    if (!idle_.empty()) {
+      state = std::move(idle_.back());
+      idle_.pop_back();
+    }
+  }
+  if (!state) {
+    state = build_state();
+    if (auto const stats{ lua_memory_stats_of(state->lua_state()) }) {
+      auto seen{ fresh_reserved_bytes_.load() };
+      while (seen < stats->reserved_bytes &&
+             !fresh_reserved_bytes_.compare_exchange_weak(seen, stats->reserved_bytes)) {}
+    }
+  }
+  // Memory counters describe one lease, not the state's earlier tenants.
+  lua_memory_reset_counters(state->lua_state());
+  return state;
+}
+
+void lua_state_pool::release(sol_state_ptr state) {
+  if (!state) { return; }
+  {
+    std::lock_guard const lock{ mutex_ };
+    if (idle_.size() >= max_idle_) { return; }
+  }
+
+  // A throwing restore leaves the state in an unknown shape; drop it.
+  try {
+    if (!sanitize(*state)) { return; }
+  } catch (...) { return; }
+
+  // Measured after sanitize's full collection, so only chunks the arena keeps count.
+  if (auto const stats{ lua_memory_stats_of(state->lua_state()) };
+      stats && stats->reserved_bytes > fresh_reserved_bytes_.load() + max_arena_growth_) {
+    return;
+  }
+
+  std::lock_guard const lock{ mutex_ };
+  if (idle_.size() < max_idle_) { idle_.push_back(std::move(state)); }
+}
+
+std::size_t lua_state_pool::idle_count() const {
+  std::lock_guard const lock{ mutex_ };
+  return idle_.size();
+}
+
+lua_state_pool::lease::lease(lua_state_pool &pool)
+    : pool_{ pool }, state_{ pool.acquire() } {}
+
+lua_state_pool::lease::~lease() { pool_.release(std::move(state_)); }
+
+}  // namespace envy
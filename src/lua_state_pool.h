@@ -0,0 +1,72 @@
+#pragma once
+
+#include "sol_util.h"
+#include "util.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace envy {
+
+// Ready-to-use Lua states: standard libraries plus the envy API (lua_envy_install).
+// Building one means a new VM, the library tables and the embedded helper scripts, so
+// released states are kept and handed out again: spec identity checks return theirs at
+// once, packages at their completion phase and manifests when they are destroyed. When a
+// state is built, every table reachable from _G, the registry and the string metatable is
+// snapshotted, along with the upvalues of every function reachable from them. release()
+// restores all of it in place (added keys removed, replaced or deleted ones put back,
+// metatables and upvalues reset; io's default files live in the registry), clears envy's
+// registry slots, removes hooks, reseeds math.random and runs a full GC. Only luaL_ref
+// slots and sol2's per-type metatables are left alone. A state that fails to restore is
+// dropped, and so is one whose arena holds more than max_arena_growth bytes beyond a
+// freshly built state's: lua_arena keeps its chunks until the state closes, so an idle
+// state would otherwise keep its tenant's peak. Thread-safe.
+class lua_state_pool : unmovable {
+ public:
+  // Enough for the identity checks a few threads run at once. Every idle state holds
+  // its arena, so more would mostly keep memory.
+  static constexpr std::size_t kDefaultMaxIdle{ 8 };
+  // Room for an ordinary spec's leftovers; a state that ran a large one is rebuilt.
+  static constexpr std::int64_t kDefaultMaxArenaGrowth{ 2 * 1024 * 1024 };
+
+  explicit lua_state_pool(std::size_t max_idle = kDefaultMaxIdle,
+                          std::int64_t max_arena_growth = kDefaultMaxArenaGrowth);
+
+  // Process-wide pool used by spec, bundle and manifest loading.
+  static lua_state_pool &shared();
+
+  // An idle state, or a newly built one. The caller owns it until it calls release().
+  sol_state_ptr acquire();
+
+  // Sanitize and keep for reuse, or destroy when the pool already holds max_idle or
+  // the state's arena has grown past max_arena_growth.
+  void release(sol_state_ptr state);
+
+  std::size_t idle_count() const;
+
+  // Borrows a state for one scope and releases it on exit.
+  class lease : unmovable {
+   public:
+    explicit lease(lua_state_pool &pool = shared());
+    ~lease();
+
+    sol::state &operator*() const { return *state_; }
+    sol::state *operator->() const { return state_.get(); }
+
+   private:
+    lua_state_pool &pool_;
+    sol_state_ptr state_;
+  };
+
+ private:
+  std::size_t const max_idle_;
+  std::int64_t const max_arena_growth_;
+  std::atomic<std::int64_t> fresh_reserved_bytes_{ 0 };  // Largest seen at build
+  mutable std::mutex mutex_;
+  std::vector<sol_state_ptr> idle_;  // guarded by mutex_
+};
+
+}  // namespace envy
@@ -0,0 +1,246 @@
+#include "lua_state_pool.h"
+
+#include "lua_envy.h"
+
+#include "doctest.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace envy {
+
+namespace {
+
+// Runs `script` in a freshly leased state and returns its single result.
+template <typename T>
+T run_leased(lua_state_pool &pool, char const *script) {
+  lua_state_pool::lease const lua{ pool };
+  sol::protected_function_result result{ lua->safe_script(script,
+                                                          sol::script_pass_on_error) };
+  REQUIRE(result.valid());
+  return result.get<T>();
+}
+
+}  // namespace
+
+TEST_CASE("lua_state_pool hands out states with the envy API installed") {
+  lua_state_pool pool;
+  lua_state_pool::lease const lua{ pool };
+
+  sol::table envy_table = (*lua)["envy"];
+  REQUIRE(envy_table.valid());
+  CHECK((*lua)["envy"]["PLATFORM"].valid());
+  CHECK((*lua)["string"]["upper"].valid());
+}
+
+TEST_CASE("lua_state_pool reuses released states") {
+  lua_state_pool pool;
+  sol::state *first{ nullptr };
+  {
+    lua_state_pool::lease const lua{ pool };
+    first = &*lua;
+  }
+  CHECK(pool.idle_count() == 1);
+
+  lua_state_pool::lease const lua{ pool };
+  CHECK(&*lua == first);
+  CHECK(pool.idle_count() == 0);
+}
+
+TEST_CASE("lua_state_pool isolates globals between specs") {
+  lua_state_pool pool{ 1 };  // One idle slot: every lease reuses the same state
+
+  run_leased<bool>(pool, R"lua(
+    IDENTITY = "first.spec@v1"
+    FETCH = function() end
+    helper_cache = { "x" }
+    return true
+  )lua");
+
+  CHECK(run_leased<bool>(pool, R"lua(
+    return IDENTITY == nil and FETCH == nil and helper_cache == nil
+  )lua"));
+}
+
+TEST_CASE("lua_state_pool restores replaced and deleted library members") {
+  lua_state_pool pool{ 1 };
+
+  run_leased<bool>(pool, R"lua(
+    string.shout = function(s) return s:upper() .. "!" end
+    table.insert = nil
+    envy.PLATFORM = "plan9"
+    envy.info = nil
+    print = nil
+    os = nil
+    return true
+  )lua");
+
+  CHECK(run_leased<bool>(pool, R"lua(
+    return string.shout == nil and type(table.insert) == "function" and
+           envy.PLATFORM ~= "plan9" and type(envy.info) == "function" and
+           type(print) == "function" and type(os.time) == "function"
+  )lua"));
+}
+
+TEST_CASE("lua_state_pool restores metatables") {
+  lua_state_pool pool{ 1 };
+
+  run_leased<bool>(pool, R"lua(
+    setmetatable(_G, { __index = function(_, k) return "leaked " .. k end })
+    getmetatable("").__index = { len = function() return -1 end }
+    return true
+  )lua");
+
+  CHECK(run_leased<bool>(pool, R"lua(
+    return undefined_global == nil and getmetatable(_G) == nil and
+           ("abc"):len() == 3 and ("abc"):upper() == "ABC"
+  )lua"));
+}
+
+TEST_CASE("lua_state_pool restores package.path and package.loaded") {
+  lua_state_pool pool{ 1 };
+
+  auto const original_path{ run_leased<std::string>(pool, "return package.path") };
+  run_leased<bool>(pool, R"lua(
+    package.path = "/bundle/?.lua;" .. package.path
+    package.loaded["bundle.helpers"] = { answer = 42 }
+    return true
+  )lua");
+
+  CHECK(run_leased<std::string>(pool, "return package.path") == original_path);
+  CHECK(run_leased<bool>(pool, R"lua(return package.loaded["bundle.helpers"] == nil)lua"));
+}
+
+TEST_CASE("lua_state_pool clears envy registry slots") {
+  lua_state_pool pool{ 1 };
+  int options_sentinel{ 0 };
+  {
+    lua_state_pool::lease const lua{ pool };
+    lua->registry()[ENVY_OPTIONS_RIDX] = lua->create_table();
+    lua->registry()[ENVY_PHASE_CTX_RIDX] = static_cast<void *>(&options_sentinel);
+  }
+
+  lua_state_pool::lease const lua{ pool };
+  CHECK_FALSE(sol::object(lua->registry()[ENVY_OPTIONS_RIDX]).valid());
+  CHECK_FALSE(sol::object(lua->registry()[ENVY_PHASE_CTX_RIDX]).valid());
+}
+
+TEST_CASE("lua_state_pool restores upvalues and registry entries") {
+  lua_state_pool pool{ 1 };
+  run_leased<bool>(pool, R"lua(
+    debug.setupvalue(require, 1, {})
+    debug.getregistry().leak = true
+    return true
+  )lua");
+
+  CHECK(run_leased<bool>(pool, R"lua(
+    return select(2, debug.getupvalue(require, 1)) == package
+  )lua"));
+  CHECK(run_leased<bool>(pool, "return debug.getregistry().leak == nil"));
+}
+
+TEST_CASE("lua_state_pool restores io defaults and reseeds math.random") {
+  lua_state_pool pool{ 1 };
+  auto const seeded{ run_leased<lua_Integer>(pool, R"lua(
+    io.output(io.stderr)
+    math.randomseed(42)
+    return math.random(1, 1000000000)
+  )lua") };
+
+  CHECK(run_leased<bool>(pool, "return io.output() == io.stdout"));
+  CHECK(run_leased<lua_Integer>(pool, "return math.random(1, 1000000000)") != seeded);
+}
+
+TEST_CASE("lua_state_pool keeps 8 idle states by default") {
+  lua_state_pool pool;
+  std::vector<sol_state_ptr> states;
+  for (int i{ 0 }; i < 10; ++i) { states.push_back(pool.acquire()); }
+  for (auto &s : states) { pool.release(std::move(s)); }
+  CHECK(pool.idle_count() == 8);
+}
+
+TEST_CASE("lua_state_pool keeps at most max_idle states") {
+  lua_state_pool pool{ 2 };
+  std::vector<sol_state_ptr> states;
+  for (int i{ 0 }; i < 4; ++i) { states.push_back(pool.acquire()); }
+  for (auto &s : states) { pool.release(std::move(s)); }
+  CHECK(pool.idle_count() == 2);
+}
+
+TEST_CASE("lua_state_pool drops states whose arena grew large") {
+  lua_state_pool pool{ 1 };
+  run_leased<bool>(pool, R"lua(
+    local t = {}
+    for i = 1, 200000 do t[i] = { i } end
+    return true
+  )lua");
+  CHECK(pool.idle_count() == 0);
+
+  run_leased<bool>(pool, "return true");
+  CHECK(pool.idle_count() == 1);
+}
+
+TEST_CASE("lua_state_pool is safe to share across threads") {
+  lua_state_pool pool{ 4 };
+  std::vector<std::thread> threads;
+  std::vector<int> ok(8, 0);
+  for (int t{ 0 }; t < 8; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i{ 0 }; i < 25; ++i) {
+        lua_state_pool::lease const lua{ pool };
+        bool const clean{ !(*lua)["MARK"].valid() };
+        (*lua)["MARK"] = t;
+        if (clean) { ++ok[t]; }
+      }
+    });
+  }
+  for (auto &th : threads) { th.join(); }
+  for (int t{ 0 }; t < 8; ++t) { CHECK(ok[t] == 25); }
+}
+
+TEST_CASE("spec loading for 1000 packages, fresh vs pooled states" * doctest::skip()) {
+  constexpr int kPackages{ 1000 };
+  constexpr char kSpec[]{ R"lua(
+IDENTITY = "local.tool@v1"
+DEPENDENCIES = { { spec = "local.dep@v1", source = "dep.lua" } }
+FETCH = { source = "https://example.com/tool.tar.gz", sha256 = string.rep("a", 64) }
+INSTALL = function(install_dir) envy.info(install_dir) end
+)lua" };
+
+  auto const load_spec{ [&](sol::state &lua) {
+    sol::protected_function_result result{ lua.safe_script(kSpec,
+                                                           sol::script_pass_on_error) };
+    REQUIRE(result.valid());
+    CHECK(lua["IDENTITY"].get<std::string>() == "local.tool@v1");
+  } };
+  auto const time_ms{ [](auto &&fn) {
+    auto const start{ std::chrono::steady_clock::now() };
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                     start)
+        .count();
+  } };
+
+  auto const fresh_ms{ time_ms([&] {
+    for (int i{ 0 }; i < kPackages; ++i) {
+      auto lua{ sol_util_make_lua_state() };
+      lua_envy_install(*lua);
+      load_spec(*lua);
+    }
+  }) };
+
+  lua_state_pool pool;
+  auto const pooled_ms{ time_ms([&] {
+    for (int i{ 0 }; i < kPackages; ++i) {
+      lua_state_pool::lease const lua{ pool };
+      load_spec(*lua);
+    }
+  }) };
+
+  MESSAGE(kPackages << " spec loads: fresh states " << fresh_ms << " ms, pooled "
+                    << pooled_ms << " ms");
+}
+
+}  // namespace envy
@@ -1,6 +1,7 @@
 #include "aws_util.h"
 #include "cli.h"
 #include "libgit2_util.h"
+#include "lua_profiler.h"
 #include "reexec.h"
 #include "self_deploy.h"
 #include "shell.h"
@@ -40,6 +41,7 @@ int main(int argc, char *argv[]) {
 
   envy::self_deploy::ensure(args.cache_root, std::nullopt, {});
 
+  envy::lua_profiler_session lua_profile{ args.lua_profile };
   auto cmd{ std::visit(
       [&args](auto const &cfg) { return envy::cmd::create(cfg, args.cache_root); },
       *args.cmd_cfg) };
@@ -4,12 +4,15 @@
 #include "engine.h"
 #include "envy_release.h"
 #include "lua_envy.h"
+#include "lua_profiler.h"
 #include "lua_shell.h"
+#include "lua_state_pool.h"
 #include "shell.h"
 #include "sol_util.h"
 #include "tui.h"
 
 #include <cstring>
+#include <mutex>
 #include <stdexcept>
 
 namespace envy {
@@ -403,8 +406,138 @@ manifest::discovery read_manifest(std::filesystem::path manifest_path) {
   return { std::move(manifest_path), std::move(meta), std::move(content) };
 }
 
+// Installed while a fetch worker re-runs the manifest's top level (see
+// manifest::fetch_state_lease). The first run already produced the manifest's output and
+// effects, so logging is silenced and anything that changes the outside world raises.
+// Returns a function that lifts the guard. Replacements check `active` rather than being
+// swapped back, so top-level code that kept a reference (local run = envy.run) still
+// gets the real function when a fetch later calls it.
+constexpr char kRerunGuardLua[] = R"(
+local active = true
+local why = "manifest top-level code runs again for each concurrent fetch, " ..
+            "so it must not have side effects (%s)"
+
+local function guard(t, name, replacement)
+  local original = type(t) == "table" and t[name]
+  if type(original) ~= "function" then return end
+  t[name] = function(...)
+    if active then return replacement(original, ...) end
+    return original(...)
+  end
+end
+
+local function forbid(t, prefix, names)
+  for _, name in ipairs(names) do
+    guard(t, name, function() error(string.format(why, prefix .. name), 3) end)
+  end
+end
+
+local function silence(t, names)
+  for _, name in ipairs(names) do guard(t, name, function() end) end
+end
+
+forbid(os, "os.", { "execute", "exit", "remove", "rename", "tmpname" })
+forbid(io, "io.", { "popen" })
+guard(io, "open", function(open, path, mode)
+  if mode ~= nil and not tostring(mode):match("^rb?$") then
+    error(string.format(why, "io.open for writing"), 3)
+  end
+  return open(path, mode)
+end)
+guard(io, "output", function(output, ...)
+  if select("#", ...) > 0 then error(string.format(why, "io.output"), 3) end
+  return output()
+end)
+silence(_G, { "print" })
+silence(io, { "write" })
+if type(envy) == "table" then
+  forbid(envy, "envy.", { "run", "copy", "move", "remove", "fetch", "commit_fetch",
+                          "extract", "extract_all" })
+  silence(envy, { "debug", "info", "warn", "error", "stdout" })
+end
+
+return function() active = false end
+)";
+
+// Run the manifest on a fresh state. A rerun (a fetch worker) runs under kRerunGuardLua.
+sol_state_ptr execute_manifest_script(std::string const &script,
+                                      std::filesystem::path const &manifest_path,
+                                      bool rerun = false) {
+  auto state{ lua_state_pool::shared().acquire() };
+  lua_profiler_attach(state->lua_state());
+
+  sol::protected_function lift_guard;
+  if (rerun) {
+    lift_guard = state->safe_script(kRerunGuardLua, "=envy.manifest_rerun")
+                     .get<sol::protected_function>();
+  }
+
+  // Use manifest path as chunk name so debug.getinfo can find it for envy.loadenv()
+  std::string const chunk_name{ "@" + manifest_path.string() };
+  sol::protected_function_result const result{
+    state->safe_script(script, sol::script_pass_on_error, chunk_name)
+  };
+  if (lift_guard.valid()) { lift_guard(); }
+  if (!result.valid()) {
+    sol::error err = result;
+    throw std::runtime_error(std::string("Failed to execute manifest script: ") +
+                             err.what());
+  }
+  return state;
+}
+
 }  // namespace
 
+manifest::~manifest() {
+  auto &pool{ lua_state_pool::shared() };
+  pool.release(std::move(lua_));
+  for (auto &state : idle_fetch_states_) { pool.release(std::move(state)); }
+}
+
+// A worker state checked out for one fetch call and put back on the idle list after it.
+// When the guarded re-run fails, the manifest's top level has side effects; the call then
+// runs in the state that loaded the manifest, one at a time, as fetches did before
+// workers existed.
+class manifest::fetch_state_lease : unmovable {
+ public:
+  explicit fetch_state_lease(manifest const &m) : m_{ m } {
+    bool rerun_failed{ false };
+    {
+      std::lock_guard const lock{ m_.fetch_states_mutex_ };
+      if (!m_.idle_fetch_states_.empty()) {
+        state_ = std::move(m_.idle_fetch_states_.back());
+        m_.idle_fetch_states_.pop_back();
+      }
+      rerun_failed = m_.rerun_failed_;
+    }
+    if (!state_ && !rerun_failed) {
+      try {
+        state_ = execute_manifest_script(m_.script_, m_.manifest_path, true);
+      } catch (std::exception const &e) {
+        tui::debug("%s: fetch functions run one at a time in the manifest's state: %s",
+                   m_.manifest_path.string().c_str(),
+                   e.what());
+        std::lock_guard const lock{ m_.fetch_states_mutex_ };
+        m_.rerun_failed_ = true;
+      }
+    }
+    if (!state_) { primary_lock_ = std::unique_lock{ m_.lua_mutex_ }; }
+  }
+
+  ~fetch_state_lease() {
+    if (!state_) { return; }  // primary_lock_ hands lua_ to the next fetch
+    std::lock_guard const lock{ m_.fetch_states_mutex_ };
+    m_.idle_fetch_states_.push_back(std::move(state_));
+  }
+
+  sol::state &state() const { return state_ ? *state_ : *m_.lua_; }
+
+ private:
+  manifest const &m_;
+  sol_state_ptr state_;
+  std::unique_lock<std::mutex> primary_lock_;
+};
+
 std::optional<manifest::discovery> manifest::discover(
     bool nearest,
     std::filesystem::path const &start_dir) {
@@ -495,22 +628,12 @@ std::unique_ptr<manifest> manifest::load(std::vector<unsigned char> const &conte
         "Add to manifest header, e.g.: -- @envy bin \"tools\"");
   }
 
-  auto state{ sol_util_make_lua_state() };
-  lua_envy_install(*state);
-
-  // Use manifest path as chunk name so debug.getinfo can find it for envy.loadenv()
-  std::string const chunk_name{ "@" + manifest_path.string() };
-  if (sol::protected_function_result const result{
-          state->safe_script(script, sol::script_pass_on_error, chunk_name) };
-      !result.valid()) {
-    sol::error err = result;
-    throw std::runtime_error(std::string("Failed to execute manifest script: ") +
-                             err.what());
-  }
+  auto state{ execute_manifest_script(script, manifest_path) };
 
   auto m{ std::make_unique<manifest>() };
   m->manifest_path = manifest_path;
   m->meta = std::move(meta);
+  m->script_ = script;
   m->lua_ = std::move(state);  // Keep lua state alive for DEFAULT_SHELL access
 
   auto const bundles{ bundle::parse_aliases((*m->lua_)["BUNDLES"], manifest_path) };
@@ -608,11 +731,12 @@ std::optional<std::string> manifest::run_bundle_fetch(
     std::string const &bundle_identity,
     void *phase_ctx,
     std::filesystem::path const &tmp_dir) const {
-  std::lock_guard const lock(lua_mutex_);
-
   if (!lua_) { return "manifest Lua state unavailable"; }
 
-  sol::object bundles_obj{ (*lua_)["BUNDLES"] };
+  fetch_state_lease const worker{ *this };
+  sol::state_view lua_view{ worker.state() };
+
+  sol::object bundles_obj{ lua_view["BUNDLES"] };
   if (!bundles_obj.valid() || !bundles_obj.is<sol::table>()) {
     return "BUNDLES table not found";
   }
@@ -645,7 +769,6 @@ std::optional<std::string> manifest::run_bundle_fetch(
   }
 
   // RAII guard to clear registry on scope exit (including exceptions)
-  sol::state_view lua_view{ *lua_ };
   struct registry_guard {
     sol::state_view &lua;
     ~registry_guard() { lua.registry()[ENVY_PHASE_CTX_RIDX] = sol::lua_nil; }
@@ -667,13 +790,12 @@ manifest::depot_fetch_result manifest::run_depot_fetch(
     void *phase_ctx,
     std::filesystem::path const &tmp_dir,
     std::vector<std::pair<std::string, std::string>> const &deps) const {
-  std::lock_guard const lock(lua_mutex_);
-
   std::string const label{ "PACKAGE_DEPOTS[" + std::to_string(lua_index) + "]" };
 
   if (!lua_) { throw std::runtime_error(label + ": manifest Lua state unavailable"); }
 
-  sol::state_view lua_view{ *lua_ };
+  fetch_state_lease const worker{ *this };
+  sol::state_view lua_view{ worker.state() };
 
   sol::protected_function const fetch_func{ [&] {
     sol::object depots_obj{ lua_view["PACKAGE_DEPOTS"] };
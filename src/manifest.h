@@ -60,6 +60,7 @@ struct manifest : unmovable {
   envy_meta meta;
 
   manifest() = default;
+  ~manifest();  // Returns its Lua states to lua_state_pool
 
   // Find manifest path: use provided path if given, otherwise discover from current
   // directory. When nearest=true, return the first envy.lua found (subproject mode).
@@ -97,6 +98,15 @@ struct manifest : unmovable {
   // Returns nullopt if no DEFAULT_SHELL specified
   default_shell_cfg_t get_default_shell() const;
 
+  // Custom fetch functions (BUNDLES source.fetch, PACKAGE_DEPOTS FETCH) do not run in
+  // the state that loaded the manifest. Each call borrows a worker state, built by
+  // executing the manifest script again, so fetches that block on the network proceed
+  // concurrently. Idle workers are reused. Upvalues and globals are therefore per
+  // worker: fetch functions cannot share mutable state with each other or with later
+  // manifest queries. A worker re-runs the top level with output silenced and effectful
+  // builtins raising (see manifest.cpp). If that fails, the top level has side effects,
+  // and fetches instead run one at a time in the state that loaded the manifest.
+
   // Execute bundle custom fetch function from BUNDLES table
   // Sets up phase context, executes fetch function, cleans up
   // Returns nullopt if bundle not found or has no custom fetch
@@ -105,7 +115,7 @@ struct manifest : unmovable {
                                               void *phase_ctx,
                                               std::filesystem::path const &tmp_dir) const;
 
-  // Execute PACKAGE_DEPOTS[lua_index].FETCH(ctx) under the manifest Lua lock.
+  // Execute PACKAGE_DEPOTS[lua_index].FETCH(ctx) in a worker state.
   // `deps` (identity → pkg_path) populates ctx.deps; ctx.tmp_dir = tmp_dir.
   // Throws on Lua error or an invalid return shape.
   depot_fetch_result run_depot_fetch(
@@ -115,8 +125,15 @@ struct manifest : unmovable {
       std::vector<std::pair<std::string, std::string>> const &deps) const;
 
  private:
-  mutable std::mutex lua_mutex_;  // Protects lua_ access from concurrent threads
+  class fetch_state_lease;
+
+  std::string script_;  // Manifest source, executed again for each new worker state
   sol_state_ptr lua_;
+  mutable std::mutex lua_mutex_;  // Serializes fetches that fall back to lua_
+
+  mutable std::mutex fetch_states_mutex_;
+  mutable std::vector<sol_state_ptr> idle_fetch_states_;  // guarded by fetch_states_mutex_
+  mutable bool rerun_failed_{ false };                    // guarded by fetch_states_mutex_
 };
 
 }  // namespace envy
@@ -6,10 +6,15 @@
 
 #include "doctest.h"
 
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <optional>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace {
 
@@ -1373,6 +1378,201 @@ PACKAGE_DEPOTS = { { FETCH = function(ctx) return { { sha256 = string.rep("a", 6
                        std::runtime_error);
 }
 
+TEST_CASE("PACKAGE_DEPOTS: run_depot_fetch reuses an idle worker state") {
+  auto m{ envy::manifest::load(R"(-- @envy bin "tools"
+PACKAGES = {}
+calls = 0
+PACKAGE_DEPOTS = {
+  {
+    FETCH = function(ctx)
+      calls = calls + 1
+      return tostring(calls)
+    end,
+  },
+}
+)",
+                               fs::path("/fake/envy.lua")) };
+
+  // Sequential calls reuse one idle worker, so its globals persist across calls
+  for (std::string const expected : { "1", "2" }) {
+    auto const result{ m->run_depot_fetch(1, nullptr, fs::path("/fake/tmp"), {}) };
+    auto const *text{ std::get_if<std::string>(&result) };
+    REQUIRE(text);
+    CHECK(*text == expected);
+  }
+}
+
+TEST_CASE("PACKAGE_DEPOTS: top-level side effects move fetches to the manifest's state") {
+  auto m{ envy::manifest::load(R"(-- @envy bin "tools"
+PACKAGES = {}
+local scratch = os.tmpname()
+os.remove(scratch)
+calls = 0
+PACKAGE_DEPOTS = {
+  {
+    FETCH = function(ctx)
+      calls = calls + 1
+      return scratch .. " " .. calls
+    end,
+  },
+}
+)",
+                               fs::path("/fake/envy.lua")) };
+
+  // The guarded re-run raises on os.tmpname, so every call runs in the state that
+  // loaded the manifest: one scratch name, one counter, calls serialized.
+  std::vector<std::string> results(4);
+  std::vector<std::thread> threads;
+  for (std::size_t i{ 0 }; i < results.size(); ++i) {
+    threads.emplace_back([&, i] {
+      auto const result{ m->run_depot_fetch(1, nullptr, fs::path("/fake/tmp"), {}) };
+      if (auto const *text{ std::get_if<std::string>(&result) }) { results[i] = *text; }
+    });
+  }
+  for (auto &t : threads) { t.join(); }
+
+  std::sort(results.begin(), results.end());
+  auto const scratch{ results[0].substr(0, results[0].rfind(' ')) };
+  CHECK_FALSE(scratch.empty());
+  for (std::size_t i{ 0 }; i < results.size(); ++i) {
+    CHECK(results[i] == scratch + " " + std::to_string(i + 1));
+  }
+}
+
+TEST_CASE("PACKAGE_DEPOTS: fetch functions keep the real builtins") {
+  auto const marker{ fs::temp_directory_path() / "envy-test-manifest-rerun-marker" };
+  std::ofstream{ marker } << "x";
+
+  std::string const manifest_text{ R"(-- @envy bin "tools"
+PACKAGES = {}
+local remove = os.remove
+print("logged once")
+PACKAGE_DEPOTS = {
+  { FETCH = function(ctx) return tostring(remove(")" +
+                            marker.generic_string() + R"(")) end },
+}
+)" };
+  auto m{ envy::manifest::load(manifest_text.c_str(), fs::path("/fake/envy.lua")) };
+
+  // The worker re-ran the top level under the guard, yet the captured os.remove works.
+  auto const result{ m->run_depot_fetch(1, nullptr, fs::path("/fake/tmp"), {}) };
+  auto const *text{ std::get_if<std::string>(&result) };
+  REQUIRE(text);
+  CHECK(*text == "true");
+  CHECK_FALSE(fs::exists(marker));
+}
+
+namespace {
+
+// N bundles whose fetch functions each drop a marker file, then wait until all N
+// markers exist. They can only all return if the calls overlap.
+std::string overlapping_bundles_script(fs::path const &marker_dir, int count) {
+  std::string script{ R"(-- @envy bin "tools"
+local marker_dir = ")" + marker_dir.generic_string() + R"("
+local count = )" + std::to_string(count) + R"(
+
+local function fetch_waiting_for_all(name)
+  return function(tmp_dir)
+    local f = assert(io.open(marker_dir .. "/" .. name, "w"))
+    f:close()
+    local deadline = os.time() + 10
+    while true do
+      local seen = 0
+      for i = 1, count do
+        local m = io.open(marker_dir .. "/b" .. i, "r")
+        if m then
+          m:close()
+          seen = seen + 1
+        end
+      end
+      if seen == count then return end
+      if os.time() > deadline then
+        error(name .. " saw " .. seen .. " of " .. count .. " fetches running")
+      end
+    end
+  end
+end
+
+BUNDLES = {
+)" };
+  for (int i{ 1 }; i <= count; ++i) {
+    auto const n{ std::to_string(i) };
+    script += "  b" + n + " = { identity = \"local.b" + n +
+              "@v1\", source = { fetch = fetch_waiting_for_all(\"b" + n + "\") } },\n";
+  }
+  script += "}\nPACKAGES = {}\n";
+  return script;
+}
+
+}  // namespace
+
+TEST_CASE("manifest::run_bundle_fetch runs fetch functions concurrently") {
+  constexpr int kBundles{ 4 };
+  auto const marker_dir{ fs::temp_directory_path() / "envy-test-bundle-fetch-overlap" };
+  fs::remove_all(marker_dir);
+  fs::create_directories(marker_dir);
+
+  auto m{ envy::manifest::load(overlapping_bundles_script(marker_dir, kBundles),
+                               fs::path("/fake/envy.lua")) };
+
+  std::vector<std::optional<std::string>> errors(kBundles);
+  std::vector<std::thread> threads;
+  for (int i{ 0 }; i < kBundles; ++i) {
+    threads.emplace_back([&, i] {
+      errors[i] = m->run_bundle_fetch("local.b" + std::to_string(i + 1) + "@v1",
+                                      nullptr,
+                                      marker_dir);
+    });
+  }
+  for (auto &t : threads) { t.join(); }
+
+  for (auto const &err : errors) { CHECK_MESSAGE(!err, err.value_or("")); }
+
+  fs::remove_all(marker_dir);
+}
+
+TEST_CASE("run_bundle_fetch wall time, serial vs concurrent" * doctest::skip()) {
+  constexpr int kBundles{ 8 };
+  std::string script{ "-- @envy bin \"tools\"\nBUNDLES = {\n" };
+  for (int i{ 1 }; i <= kBundles; ++i) {
+    auto const n{ std::to_string(i) };
+    script += "  b" + n + " = { identity = \"local.b" + n +
+              "@v1\", source = { fetch = function() os.execute(\"sleep 0.2\") end } },\n";
+  }
+  script += "}\nPACKAGES = {}\n";
+  auto m{ envy::manifest::load(script, fs::path("/fake/envy.lua")) };
+  auto const tmp{ fs::temp_directory_path() };
+
+  auto const time_ms{ [](auto &&fn) {
+    auto const start{ std::chrono::steady_clock::now() };
+    fn();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  } };
+
+  auto const serial_ms{ time_ms([&] {
+    for (int i{ 1 }; i <= kBundles; ++i) {
+      auto const err{
+        m->run_bundle_fetch("local.b" + std::to_string(i) + "@v1", nullptr, tmp)
+      };
+      CHECK_FALSE(err);
+    }
+  }) };
+  auto const concurrent_ms{ time_ms([&] {
+    std::vector<std::thread> threads;
+    for (int i{ 1 }; i <= kBundles; ++i) {
+      threads.emplace_back([&, i] {
+        m->run_bundle_fetch("local.b" + std::to_string(i) + "@v1", nullptr, tmp);
+      });
+    }
+    for (auto &t : threads) { t.join(); }
+  }) };
+
+  MESSAGE(kBundles << " fetches of 200 ms: serial " << serial_ms << " ms, concurrent "
+                   << concurrent_ms << " ms");
+}
+
 // ============================================================================
 // manifest::discover() with root directive tests
 // ============================================================================
@@ -1,12 +1,16 @@
 #include "package_depot.h"
 
 #include "cache.h"
+#include "depot_delta.h"
 #include "fetch.h"
 #include "tui.h"
 #include "tui_actions.h"
 #include "util.h"
 
+#include <algorithm>
 #include <cctype>
+#include <charconv>
+#include <cstdint>
 #include <filesystem>
 #include <sstream>
 #include <string>
@@ -36,21 +40,28 @@ bool is_valid_sha256_hex(std::string_view hex) {
   return true;
 }
 
-// Extract the archive filename stem (filename minus .tar.zst) from a URL.
-// Returns nullopt (with a warning naming `context`) when the URL has no
-// .tar.zst extension or the stem doesn't parse as an archive filename.
-std::optional<std::string> stem_from_url(std::string_view url, std::string_view context) {
+constexpr std::string_view kArchiveSuffix{ ".tar.zst" };
+constexpr std::string_view kChunkIndexSuffix{ ".chunks" };
+constexpr std::string_view kDeltaSuffix{ ".delta" };
+
+std::string_view filename_from_url(std::string_view url) {
   auto const slash_pos{ url.rfind('/') };
-  std::string_view filename{ (slash_pos != std::string_view::npos &&
-                              slash_pos + 1 < url.size())
-                                 ? url.substr(slash_pos + 1)
-                                 : url };
-
-  std::string_view stem{ filename };
-  if (stem.size() > 8 && stem.substr(stem.size() - 8) == ".tar.zst") {
-    stem = stem.substr(0, stem.size() - 8);
+  return (slash_pos != std::string_view::npos && slash_pos + 1 < url.size())
+             ? url.substr(slash_pos + 1)
+             : url;
+}
+
+// Extract the archive filename stem (filename minus .tar.zst or .chunks) from a URL.
+// Returns nullopt (with a warning naming `context`) when the URL has neither
+// extension or the stem doesn't parse as an archive filename.
+std::optional<std::string> stem_from_url(std::string_view url, std::string_view context) {
+  std::string_view stem{ filename_from_url(url) };
+  if (stem.size() > kArchiveSuffix.size() && stem.ends_with(kArchiveSuffix)) {
+    stem.remove_suffix(kArchiveSuffix.size());
+  } else if (stem.size() > kChunkIndexSuffix.size() && stem.ends_with(kChunkIndexSuffix)) {
+    stem.remove_suffix(kChunkIndexSuffix.size());
   } else {
-    tui::warn("depot: skipping entry without .tar.zst extension: %s",
+    tui::warn("depot: skipping entry without .tar.zst or .chunks extension: %s",
               std::string(context).c_str());
     return std::nullopt;
   }
@@ -63,13 +74,63 @@ std::optional<std::string> stem_from_url(std::string_view url, std::string_view
   return std::string{ stem };
 }
 
-// Parse a single manifest text into a map of filename stem → depot entry.
-// Supports two line formats:
+// Target and base stems of a .delta URL; nullopt (warned) unless both parse as archive
+// filenames.
+std::optional<depot_delta_stems> delta_stems_from_url(std::string_view url,
+                                                      std::string_view context) {
+  auto stems{ depot_delta_parse_filename(filename_from_url(url)) };
+  if (!stems || !util_parse_archive_filename(stems->target) ||
+      !util_parse_archive_filename(stems->base)) {
+    tui::warn("depot: skipping unparseable delta: %s", std::string(context).c_str());
+    return std::nullopt;
+  }
+  return stems;
+}
+
+// Apply the "key=value" attributes trailing a manifest line's URL. Unknown keys are
+// ignored so older envy can read manifests that carry newer attributes.
+void parse_manifest_attributes(std::string_view attrs, depot_entry &entry) {
+  while (!attrs.empty()) {
+    auto const start{ attrs.find_first_not_of(' ') };
+    if (start == std::string_view::npos) { break; }
+    attrs.remove_prefix(start);
+    auto const field{ attrs.substr(0, attrs.find(' ')) };
+    attrs.remove_prefix(field.size());
+
+    if (field.starts_with("dict_sha256=")) {
+      auto const value{ field.substr(12) };
+      if (!is_valid_sha256_hex(value)) {
+        tui::warn("depot: ignoring malformed %s for %s",
+                  std::string(field).c_str(),
+                  entry.url.c_str());
+        continue;
+      }
+      entry.dict_sha256 = lowercase_hex(value);
+      continue;
+    }
+
+    if (!field.starts_with("dict=")) { continue; }
+    auto const value{ field.substr(5) };
+    std::uint32_t id{ 0 };
+    auto const [end, ec]{ std::from_chars(value.data(), value.data() + value.size(), id) };
+    if (ec != std::errc{} || end != value.data() + value.size() || id == 0) {
+      tui::warn("depot: ignoring malformed %s for %s",
+                std::string(field).c_str(),
+                entry.url.c_str());
+      continue;
+    }
+    entry.dict_id = id;
+  }
+}
+
+// Parse a single manifest text into depot entries, one per usable line.
+// Supports two line formats, each optionally followed by two spaces and attributes:
 //   <URL>                           (plain URL, no hash — rejected when require_sha256)
 //   <64hex>  <URL>                  (SHA256 hash + two spaces + URL)
-std::unordered_map<std::string, depot_entry> parse_manifest_text(std::string_view text,
-                                                                 bool require_sha256) {
-  std::unordered_map<std::string, depot_entry> entries;
+//   <64hex>  <URL>  dict=<id>  dict_sha256=<64hex>
+//                                   (archive compressed with a depot_dict.h dictionary)
+std::vector<depot_entry> parse_manifest_text(std::string_view text, bool require_sha256) {
+  std::vector<depot_entry> entries;
 
   std::istringstream stream{ std::string{ text } };
   std::string line;
@@ -92,16 +153,18 @@ std::unordered_map<std::string, depot_entry> parse_manifest_text(std::string_vie
       url_part = std::string_view{ line }.substr(66);
     }
 
-    auto stem{ stem_from_url(url_part, line) };
-    if (!stem) { continue; }
-
     if (require_sha256 && !sha256_hash) {
       tui::warn("depot: skipping line without SHA256: %s", line.c_str());
       continue;
     }
 
-    entries.try_emplace(std::move(*stem),
-                        depot_entry{ std::string(url_part), std::move(sha256_hash) });
+    auto const attrs_pos{ url_part.find("  ") };
+    depot_entry entry{ std::string(url_part.substr(0, attrs_pos)),
+                       std::move(sha256_hash) };
+    if (attrs_pos != std::string_view::npos) {
+      parse_manifest_attributes(url_part.substr(attrs_pos + 2), entry);
+    }
+    entries.push_back(std::move(entry));
   }
 
   return entries;
@@ -211,7 +274,10 @@ package_depot_index package_depot_index::build_from_contents(
 package_depot_index package_depot_index::build_from_text(std::string_view text,
                                                          bool require_sha256) {
   package_depot_index index;
-  index.entries_ = parse_manifest_text(text, require_sha256);
+  for (auto &entry : parse_manifest_text(text, require_sha256)) {
+    std::string const context{ entry.url };
+    index.add(std::move(entry), context);
+  }
   return index;
 }
 
@@ -232,11 +298,7 @@ package_depot_index package_depot_index::build_from_entries(
       sha256_hash = lowercase_hex(*entry.sha256);
     }
 
-    auto stem{ stem_from_url(entry.url, entry.url) };
-    if (!stem) { continue; }
-
-    index.entries_.try_emplace(std::move(*stem),
-                               depot_entry{ entry.url, std::move(sha256_hash) });
+    index.add(depot_entry{ entry.url, std::move(sha256_hash) }, entry.url);
   }
 
   return index;
@@ -257,13 +319,8 @@ package_depot_index package_depot_index::build_from_directory(
   for (auto const &e : fs::directory_iterator(dir)) {
     if (!e.is_regular_file()) { continue; }
     auto const &p{ e.path() };
-    if (p.extension() != ".zst") { continue; }
-    auto stem_path{ p.stem() };  // strips .zst
-    if (stem_path.extension() != ".tar") { continue; }
-    std::string const stem{ stem_path.stem().string() };
-
-    if (!util_parse_archive_filename(stem)) {
-      tui::warn("depot: skipping unrecognized file %s", p.filename().string().c_str());
+    bool const archive{ p.extension() == ".zst" && p.stem().extension() == ".tar" };
+    if (!archive && p.extension() != kChunkIndexSuffix && p.extension() != kDeltaSuffix) {
       continue;
     }
 
@@ -272,14 +329,32 @@ package_depot_index package_depot_index::build_from_directory(
     std::optional<std::string> sha256_hash;
     if (it != checksums.end()) { sha256_hash = it->second; }
 
-    index.entries_.try_emplace(
-        stem,
-        depot_entry{ fs::absolute(p).string(), std::move(sha256_hash) });
+    index.add(depot_entry{ fs::absolute(p).string(), std::move(sha256_hash) }, filename);
   }
 
   return index;
 }
 
+void package_depot_index::add(depot_entry entry, std::string_view context) {
+  if (entry.url.ends_with(kDeltaSuffix)) {
+    auto stems{ delta_stems_from_url(entry.url, context) };
+    if (!stems) { return; }
+    auto &deltas{ deltas_[stems->target] };
+    bool const known{ std::ranges::any_of(deltas, [&](depot_delta_entry const &d) {
+      return d.base_key == stems->base;
+    }) };
+    if (!known) {
+      deltas.push_back(depot_delta_entry{ .entry = std::move(entry),
+                                          .base_key = std::move(stems->base) });
+    }
+    return;
+  }
+
+  auto stem{ stem_from_url(entry.url, context) };
+  if (!stem) { return; }
+  entries_.try_emplace(std::move(*stem), std::move(entry));
+}
+
 void package_depot_index::merge(package_depot_index other) {
   for (auto &[stem, entry] : other.entries_) {
     auto const [it, inserted]{ entries_.try_emplace(stem, std::move(entry)) };
@@ -288,6 +363,17 @@ void package_depot_index::merge(package_depot_index other) {
                 stem.c_str());
     }
   }
+
+  // Deltas from a base already indexed for the same target keep this index's entry.
+  for (auto &[stem, others] : other.deltas_) {
+    auto &deltas{ deltas_[stem] };
+    for (auto &d : others) {
+      bool const known{ std::ranges::any_of(deltas, [&](depot_delta_entry const &mine) {
+        return mine.base_key == d.base_key;
+      }) };
+      if (!known) { deltas.push_back(std::move(d)); }
+    }
+  }
 }
 
 std::optional<depot_entry> package_depot_index::find(std::string_view identity,
@@ -298,6 +384,19 @@ std::optional<depot_entry> package_depot_index::find(std::string_view identity,
   return it != entries_.end() ? std::optional{ it->second } : std::nullopt;
 }
 
-bool package_depot_index::empty() const { return entries_.empty(); }
+std::vector<depot_delta_entry> package_depot_index::find_deltas(
+    std::string_view identity,
+    std::string_view platform,
+    std::string_view arch,
+    std::string_view hash_prefix) const {
+  auto const it{ deltas_.find(cache::key(identity, platform, arch, hash_prefix)) };
+  return it != deltas_.end() ? it->second : std::vector<depot_delta_entry>{};
+}
+
+bool package_depot_index::empty() const { return entries_.empty() && deltas_.empty(); }
+
+bool depot_url_is_chunk_index(std::string_view url) {
+  return url.ends_with(kChunkIndexSuffix);
+}
 
 }  // namespace envy
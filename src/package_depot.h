@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
 #include <optional>
 #include <string>
@@ -12,8 +13,21 @@ namespace envy {
 struct depot_entry {
   std::string url;
   std::optional<std::string> sha256;  // lowercase 64-char hex, or nullopt
+  std::optional<std::uint32_t> dict_id;  // zstd dictionary (see depot_dict.h), or nullopt
+  std::optional<std::string> dict_sha256;  // The dictionary's lowercase hex SHA256
 };
 
+// A delta artifact (<target stem>~<base stem>.delta, see depot_delta.h): usable only by
+// a consumer that already has the base package installed.
+struct depot_delta_entry {
+  depot_entry entry;
+  std::string base_key;  // cache::key of the base package
+};
+
+// True if url names a chunk index (<stem>.chunks, see depot_chunks.h) rather than a
+// monolithic .tar.zst archive.
+bool depot_url_is_chunk_index(std::string_view url);
+
 // Index of pre-built package archives available from remote depots.
 // All depot sources merge into one flat map: package-option-hash uniqueness
 // means a cache key denotes the same artifact in any depot, so source order is
@@ -39,8 +53,8 @@ class package_depot_index {
   // filenames are warned and skipped (parity with text parsing).
   static package_depot_index build_from_entries(std::vector<depot_entry> const &entries);
 
-  // Build index from a local directory of .tar.zst archives.
-  // Scans dir for .tar.zst files, maps filename stems → absolute file paths.
+  // Build index from a local directory of .tar.zst archives, .chunks indexes and
+  // .delta files. Maps filename stems → absolute file paths.
   static package_depot_index build_from_directory(std::filesystem::path const &dir);
 
   // Build from directory with accompanying checksums (filename → sha256 hex).
@@ -58,11 +72,23 @@ class package_depot_index {
                                   std::string_view arch,
                                   std::string_view hash_prefix) const;
 
+  // Deltas that reconstruct the given package from some other installed version.
+  std::vector<depot_delta_entry> find_deltas(std::string_view identity,
+                                             std::string_view platform,
+                                             std::string_view arch,
+                                             std::string_view hash_prefix) const;
+
   bool empty() const;
 
  private:
+  // Index a .tar.zst, .chunks or .delta URL; warns and skips anything else.
+  void add(depot_entry entry, std::string_view context);
+
   // Filename stem → depot entry (URL + optional SHA256)
   std::unordered_map<std::string, depot_entry> entries_;
+
+  // Target stem → deltas from distinct bases
+  std::unordered_map<std::string, std::vector<depot_delta_entry>> deltas_;
 };
 
 }  // namespace envy
@@ -249,6 +249,95 @@ TEST_CASE("package_depot_index: lines without .tar.zst extension skipped") {
   CHECK(index.find("pkg@v1", "darwin", "arm64", "bbbb").has_value());
 }
 
+TEST_CASE("package_depot_index: chunk index entries keyed like archives") {
+  auto index{ package_depot_index::build_from_contents(
+      { "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa  "
+        "file:///srv/depot/arm.gcc@r2-darwin-arm64-blake3-aaaa.chunks\n" }) };
+
+  auto result{ index.find("arm.gcc@r2", "darwin", "arm64", "aaaa") };
+  REQUIRE(result.has_value());
+  CHECK(depot_url_is_chunk_index(result->url));
+  CHECK_FALSE(depot_url_is_chunk_index(
+      "https://cdn/arm.gcc@r2-darwin-arm64-blake3-aaaa.tar.zst"));
+}
+
+TEST_CASE("package_depot_index: build_from_directory finds chunk indexes") {
+  namespace fs = std::filesystem;
+  auto const tmp{ fs::temp_directory_path() / "envy-depot-dir-chunks-test" };
+  std::error_code ec;
+  fs::create_directories(tmp, ec);
+  { std::ofstream f{ tmp / "arm.gcc@r2-darwin-arm64-blake3-aaaa.chunks" }; }
+  { std::ofstream f{ tmp / "notes.txt" }; }
+
+  auto index{ package_depot_index::build_from_directory(tmp) };
+  fs::remove_all(tmp, ec);
+
+  auto result{ index.find("arm.gcc@r2", "darwin", "arm64", "aaaa") };
+  REQUIRE(result.has_value());
+  CHECK(depot_url_is_chunk_index(result->url));
+}
+
+TEST_CASE("package_depot_index: delta entries indexed by target with base key") {
+  auto index{ package_depot_index::build_from_contents(
+      { std::string(kHashA) +
+        "  https://cdn/gcc@r3-darwin-arm64-blake3-cccc~gcc@r2-darwin-arm64-blake3-aaaa"
+        ".delta\n" +
+        kHashB +
+        "  https://cdn/gcc@r3-darwin-arm64-blake3-cccc~gcc@r1-darwin-arm64-blake3-bbbb"
+        ".delta\n" }) };
+
+  CHECK_FALSE(index.empty());
+  CHECK_FALSE(index.find("gcc@r3", "darwin", "arm64", "cccc").has_value());
+
+  auto const deltas{ index.find_deltas("gcc@r3", "darwin", "arm64", "cccc") };
+  REQUIRE(deltas.size() == 2);
+  CHECK(deltas[0].base_key == "gcc@r2-darwin-arm64-blake3-aaaa");
+  CHECK(deltas[0].entry.sha256 == std::optional<std::string>{ kHashA });
+  CHECK(deltas[1].base_key == "gcc@r1-darwin-arm64-blake3-bbbb");
+  CHECK(index.find_deltas("gcc@r2", "darwin", "arm64", "aaaa").empty());
+}
+
+TEST_CASE("package_depot_index: malformed delta names are skipped") {
+  auto index{ package_depot_index::build_from_contents(
+      { std::string(kHashA) + "  https://cdn/gcc@r3-darwin-arm64-blake3-cccc.delta\n" +
+        kHashB + "  https://cdn/gcc@r3-darwin-arm64-blake3-cccc~not-a-key.delta\n" }) };
+
+  CHECK(index.empty());
+}
+
+TEST_CASE("package_depot_index: merge keeps first delta per base") {
+  std::string const url{
+    "https://cdn/gcc@r3-darwin-arm64-blake3-cccc~gcc@r2-darwin-arm64-blake3-aaaa.delta\n"
+  };
+  auto index{ package_depot_index::build_from_text(std::string(kHashA) + "  " + url,
+                                                   true) };
+  index.merge(
+      package_depot_index::build_from_text(std::string(kHashB) + "  " + url, true));
+
+  auto const deltas{ index.find_deltas("gcc@r3", "darwin", "arm64", "cccc") };
+  REQUIRE(deltas.size() == 1);
+  CHECK(deltas[0].entry.sha256 == std::optional<std::string>{ kHashA });
+}
+
+TEST_CASE("package_depot_index: build_from_directory finds deltas") {
+  namespace fs = std::filesystem;
+  auto const tmp{ fs::temp_directory_path() / "envy-depot-dir-delta-test" };
+  std::error_code ec;
+  fs::create_directories(tmp, ec);
+  std::string const name{
+    "gcc@r3-darwin-arm64-blake3-cccc~gcc@r2-darwin-arm64-blake3-aaaa.delta"
+  };
+  { std::ofstream f{ tmp / name }; }
+
+  auto index{ package_depot_index::build_from_directory(tmp) };
+  fs::remove_all(tmp, ec);
+
+  auto const deltas{ index.find_deltas("gcc@r3", "darwin", "arm64", "cccc") };
+  REQUIRE(deltas.size() == 1);
+  CHECK(fs::path{ deltas[0].entry.url }.is_absolute());
+  CHECK_FALSE(deltas[0].entry.sha256.has_value());
+}
+
 TEST_CASE("package_depot_index: find with empty identity returns nullopt") {
   auto index{ package_depot_index::build_from_contents(
       { "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa  "
@@ -352,6 +441,37 @@ TEST_CASE("package_depot_index: SHA256 line parsed correctly") {
   CHECK(*result->sha256 == kHash1);
 }
 
+TEST_CASE("package_depot_index: dict attribute parsed from manifest line") {
+  auto index{ package_depot_index::build_from_contents(
+      { std::string(kHash1) + "  https://cdn/arm.gcc@r2-darwin-arm64-blake3-aaaa.tar.zst" +
+            "  dict=305419896  dict_sha256=" + kHash2 + "\n" + kHash2 +
+            "  https://cdn/cmake@r1-darwin-arm64-blake3-bbbb.tar.zst\n" }) };
+
+  auto with_dict{ index.find("arm.gcc@r2", "darwin", "arm64", "aaaa") };
+  REQUIRE(with_dict.has_value());
+  CHECK(with_dict->url == "https://cdn/arm.gcc@r2-darwin-arm64-blake3-aaaa.tar.zst");
+  REQUIRE(with_dict->dict_id.has_value());
+  CHECK(*with_dict->dict_id == 305419896u);
+  CHECK(with_dict->dict_sha256 == std::optional<std::string>{ kHash2 });
+
+  auto without{ index.find("cmake@r1", "darwin", "arm64", "bbbb") };
+  REQUIRE(without.has_value());
+  CHECK_FALSE(without->dict_id.has_value());
+  CHECK_FALSE(without->dict_sha256.has_value());
+}
+
+TEST_CASE("package_depot_index: unknown and malformed attributes ignored") {
+  auto index{ package_depot_index::build_from_contents(
+      { std::string(kHash1) + "  https://cdn/arm.gcc@r2-darwin-arm64-blake3-aaaa.tar.zst" +
+            "  future=1  dict=nope  dict_sha256=abc\n" }) };
+
+  auto result{ index.find("arm.gcc@r2", "darwin", "arm64", "aaaa") };
+  REQUIRE(result.has_value());
+  CHECK(result->url == "https://cdn/arm.gcc@r2-darwin-arm64-blake3-aaaa.tar.zst");
+  CHECK_FALSE(result->dict_id.has_value());
+  CHECK_FALSE(result->dict_sha256.has_value());
+}
+
 TEST_CASE("package_depot_index: SHA256 uppercase hex normalized to lowercase") {
   auto index{ package_depot_index::build_from_contents(
       { "A1B2C3D4E5F6A1B2C3D4E5F6A1B2C3D4E5F6A1B2C3D4E5F6A1B2C3D4E5F6A1B2  "
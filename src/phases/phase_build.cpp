@@ -27,14 +27,16 @@ void execute_build_script(std::string_view script,
                           std::string const &identity,
                           resolved_shell shell,
                           tui::section_handle tui_section,
-                          std::filesystem::path const &cache_root) {
+                          std::filesystem::path const &cache_root,
+                          shell_stats &stats) {
   tui_actions::run_phase_shell_script(script,
-                                      "Build",
+                                      pkg_phase::pkg_build,
                                       cwd,
                                       identity,
                                       std::move(shell),
                                       tui_section,
-                                      cache_root);
+                                      cache_root,
+                                      stats);
 }
 
 void run_programmatic_build(sol::protected_function build_func,
@@ -74,7 +76,8 @@ void run_programmatic_build(sol::protected_function build_func,
                            identity,
                            shell_resolve_default(p->default_shell_ptr),
                            p->tui_section,
-                           eng.cache_root());
+                           eng.cache_root(),
+                           eng.shell_usage());
     }
   }
 }
@@ -84,14 +87,16 @@ void run_shell_build(std::string_view script,
                      std::string const &identity,
                      pkg *p,
                      tui::section_handle tui_section,
-                     std::filesystem::path const &cache_root) {
+                     std::filesystem::path const &cache_root,
+                     shell_stats &stats) {
   tui::debug("build: shell script");
   execute_build_script(script,
                        stage_dir,
                        identity,
                        shell_resolve_default(p->default_shell_ptr),
                        tui_section,
-                       cache_root);
+                       cache_root,
+                       stats);
 }
 
 }  // namespace
@@ -115,7 +120,8 @@ void run_build_phase(pkg *p, engine &eng) {
                     p->cfg->identity,
                     p,
                     p->tui_section,
-                    eng.cache_root());
+                    eng.cache_root(),
+                    eng.shell_usage());
   } else if (build_obj.is<sol::protected_function>()) {
     run_programmatic_build(build_obj.as<sol::protected_function>(),
                            p->lock->install_dir(),
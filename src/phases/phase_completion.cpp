@@ -1,6 +1,7 @@
 #include "phase_completion.h"
 
 #include "engine.h"
+#include "lua_state_pool.h"
 #include "pkg.h"
 #include "trace.h"
 #include "tui.h"
@@ -27,6 +28,11 @@ void run_completion_phase(pkg *p, engine &eng) {
                                        pkg_phase::completion,
                                        std::chrono::steady_clock::now() };
 
+  // This package's phases are done, and so are the spec_fetch phases of its
+  // dependencies (this step waits on every edge), whose custom fetch functions run in
+  // this state. Nothing uses the spec state again, so later spec loads may reuse it.
+  lua_state_pool::shared().release(p->lua.take());
+
   p->result_hash =
       p->type == pkg_type::CACHE_MANAGED ? p->canonical_identity_hash : "user-managed";
 
@@ -1,5 +1,8 @@
 #include "phase_export.h"
 
+#include "depot_chunks.h"
+#include "depot_delta.h"
+#include "depot_dict.h"
 #include "engine.h"
 #include "extract.h"
 #include "pkg.h"
@@ -9,13 +12,120 @@
 #include "util.h"
 
 #include <algorithm>
+#include <array>
 #include <chrono>
 #include <filesystem>
+#include <optional>
 #include <sstream>
-#include <utility>
+#include <string>
+#include <vector>
 
 namespace envy {
 
+namespace {
+
+// Package name without revision: deltas pair versions of the same package.
+std::string_view identity_name(std::string_view identity) {
+  return identity.substr(0, identity.find('@'));
+}
+
+// Dictionary an earlier export in ecfg.delta_from was compressed with: this run's own,
+// or the one that export published in its dicts/. Empty for a plain archive.
+std::vector<unsigned char> base_dictionary(export_phase_config const &ecfg,
+                                           std::filesystem::path const &base_path) {
+  auto const id{ depot_dict_id_of_archive(base_path) };
+  if (!id) { return {}; }
+  if (!ecfg.zstd_dictionary.empty() && depot_dict_id(ecfg.zstd_dictionary) == *id) {
+    return ecfg.zstd_dictionary;
+  }
+  return depot_dict_load(*ecfg.delta_from / "dicts" / depot_dict_filename(*id), id);
+}
+
+// Write <target>~<base>.delta beside the full artifact for every earlier full export of
+// the same package (same name, platform and arch) in ecfg.delta_from. Returns their
+// manifest lines. A delta that cannot be made is warned and skipped: the full artifact
+// already covers the package.
+std::string export_deltas(export_phase_config const &ecfg,
+                          std::string const &target_stem,
+                          std::filesystem::path const &source_dir,
+                          std::optional<std::uint64_t> full_size) {
+  namespace fs = std::filesystem;
+
+  auto const target_parsed{ util_parse_archive_filename(target_stem) };
+  if (!target_parsed) { return {}; }
+
+  // The serialized trees are spilled beside the output and removed on every exit.
+  fs::path const target_tar{ ecfg.output_dir / ("." + target_stem + ".delta-target.tar") };
+  fs::path const base_tar{ ecfg.output_dir / ("." + target_stem + ".delta-base.tar") };
+  struct tar_remover {
+    std::array<fs::path const *, 2> paths;
+    ~tar_remover() {
+      std::error_code ec;
+      for (auto const *path : paths) { fs::remove(*path, ec); }
+    }
+  } const remove_tars{ { &target_tar, &base_tar } };
+
+  std::optional<depot_delta_tree> target;
+  std::string lines;
+
+  for (auto const &e : fs::directory_iterator(*ecfg.delta_from)) {
+    auto const &base_path{ e.path() };
+    if (!e.is_regular_file() || base_path.extension() != ".zst" ||
+        base_path.stem().extension() != ".tar") {
+      continue;
+    }
+    std::string const base_stem{ base_path.stem().stem().string() };
+    auto const base_parsed{ util_parse_archive_filename(base_stem) };
+    if (!base_parsed || base_stem == target_stem ||
+        identity_name(base_parsed->identity) != identity_name(target_parsed->identity) ||
+        base_parsed->platform != target_parsed->platform ||
+        base_parsed->arch != target_parsed->arch) {
+      continue;
+    }
+
+    std::string const filename{ depot_delta_filename(target_stem, base_stem) };
+    fs::path const delta_path{ ecfg.output_dir / filename };
+
+    try {
+      auto const start{ std::chrono::steady_clock::now() };
+      // Plain serialization, no content dedupe: the importer rebuilds each base from its
+      // installed tree the same way.
+      if (!target) { target = depot_delta_serialize_tree(source_dir, "pkg", target_tar); }
+      auto const base{
+        depot_delta_load_tar_zst(base_path, base_tar, base_dictionary(ecfg, base_path))
+      };
+      auto const delta_size{ depot_delta_create(delta_path, base, *target) };
+      auto const ms{ std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count() };
+
+      std::string const saved{
+        full_size && *full_size > delta_size
+            ? ", " + util_format_bytes(*full_size - delta_size) + " smaller than full"
+            : ""
+      };
+      tui::info("export: %s (%s%s, %lld ms)",
+                filename.c_str(),
+                util_format_bytes(delta_size).c_str(),
+                saved.c_str(),
+                static_cast<long long>(ms));
+
+      auto const sha{ sha256(delta_path) };
+      std::string const path_part{ ecfg.depot_prefix ? (*ecfg.depot_prefix + filename)
+                                                     : delta_path.string() };
+      lines += util_bytes_to_hex(sha.data(), sha.size()) + "  " + path_part + "\n";
+    } catch (std::exception const &ex) {
+      std::error_code ec;
+      fs::remove(delta_path, ec);
+      tui::warn("export: failed to write delta %s: %s", filename.c_str(), ex.what());
+    }
+  }
+
+  return lines;
+}
+
+}  // namespace
+
 void run_export_phase(pkg *p, engine &eng) {
   phase_trace_scope const phase_scope{ p->cfg->identity,
                                        pkg_phase::pkg_export,
@@ -55,87 +165,94 @@ void run_export_phase(pkg *p, engine &eng) {
     }
   }
 
-  std::string const filename{ std::string(p->key.identity()) + "-" +
-                              entry_dir.filename().string() + ".tar.zst" };
+  std::string const stem{ std::string(p->key.identity()) + "-" +
+                          entry_dir.filename().string() };
+  std::string const filename{ stem + (ecfg->chunked ? ".chunks" : ".tar.zst") };
   std::filesystem::path const output_path{ ecfg->output_dir / filename };
 
   std::string const label{ "[" + std::string(p->key.identity()) + "]" };
 
-  // Scan source to compute totals
-  if (p->tui_section) {
-    tui::section_set_content(
-        p->tui_section,
-        tui::section_frame{ .label = label,
-                            .content = tui::spinner_data{
-                                .text = "scanning...",
-                                .start_time = std::chrono::steady_clock::now() } });
-  }
+  try {
+    // One walk of source_dir feeds the archive; totals arrive with the first callback
+    // and the digests are computed from the compressed bytes as they are written.
+    archive_create_options const opts{
+      .progress = [&](extract_progress const &ep) -> bool {
+        if (!p->tui_section) { return true; }
 
-  auto const [total_bytes, total_files]{ [&] {
-    std::uint64_t bytes{ 0 }, files{ 0 };
-    for (auto const &e : std::filesystem::recursive_directory_iterator(source_dir)) {
-      if (e.is_regular_file()) {
-        bytes += e.file_size();
-        ++files;
-      }
-    }
-    return std::pair{ bytes, files };
-  }() };
+        std::uint64_t const total_bytes{ ep.total_bytes.value_or(0) };
+        std::uint64_t const total_files{ ep.total_files.value_or(0) };
 
-  try {
-    // Compress with progress
-    archive_create_tar_zst(
-        output_path,
-        source_dir,
-        prefix,
-        [&](extract_progress const &ep) -> bool {
-          if (!p->tui_section) { return true; }
-
-          double percent{ 0.0 };
-          if (total_bytes > 0) {
-            percent =
-                std::min(100.0,
-                         (ep.bytes_processed / static_cast<double>(total_bytes)) * 100.0);
-          } else if (total_files > 0) {
-            percent =
-                std::min(100.0,
-                         (ep.files_processed / static_cast<double>(total_files)) * 100.0);
-          }
-
-          std::ostringstream status;
-          status << ep.files_processed;
-          if (total_files > 0) { status << "/" << total_files; }
-          status << " files";
-          if (total_bytes > 0) {
-            status << " " << util_format_bytes(ep.bytes_processed) << "/"
-                   << util_format_bytes(total_bytes);
-          }
-
-          tui::section_set_content(p->tui_section,
-                                   tui::section_frame{ .label = label,
-                                                       .content = tui::progress_data{
-                                                           .percent = percent,
-                                                           .status = status.str() } });
-          return true;
-        });
-
-    // Hash the archive
-    if (p->tui_section) {
-      tui::section_set_content(
-          p->tui_section,
-          tui::section_frame{ .label = label,
-                              .content = tui::spinner_data{
-                                  .text = "hashing...",
-                                  .start_time = std::chrono::steady_clock::now() } });
-    }
+        double percent{ 0.0 };
+        if (total_bytes > 0) {
+          percent = ep.bytes_processed / static_cast<double>(total_bytes) * 100.0;
+        } else if (total_files > 0) {
+          percent = ep.files_processed / static_cast<double>(total_files) * 100.0;
+        }
+        percent = std::min(100.0, percent);
+
+        std::ostringstream status;
+        status << ep.files_processed;
+        if (total_files > 0) { status << "/" << total_files; }
+        status << " files";
+        if (total_bytes > 0) {
+          status << " " << util_format_bytes(ep.bytes_processed) << "/"
+                 << util_format_bytes(total_bytes);
+        }
 
-    auto const hash{ sha256(output_path) };
-    auto const hex{ util_bytes_to_hex(hash.data(), hash.size()) };
+        tui::section_set_content(p->tui_section,
+                                 tui::section_frame{ .label = label,
+                                                     .content = tui::progress_data{
+                                                         .percent = percent,
+                                                         .status = status.str() } });
+        return true;
+      },
+      .dedupe_content = ecfg->dedupe_content,
+      .zstd_dictionary = ecfg->zstd_dictionary,
+    };
+
+    std::string hex;
+    if (ecfg->chunked) {
+      // Chunks land in the shared chunks/ beside the index, so exporting several versions
+      // to one directory stores each distinct chunk once. The manifest SHA256 covers the
+      // index, which in turn pins every chunk by BLAKE3.
+      auto const result{ depot_export_chunked(output_path, source_dir, prefix, opts) };
+      auto const index_sha{ sha256(output_path) };
+      hex = util_bytes_to_hex(index_sha.data(), index_sha.size());
+      tui::debug("export: %s (%llu chunks, %llu new, %s new)",
+                 output_path.string().c_str(),
+                 static_cast<unsigned long long>(result.chunks),
+                 static_cast<unsigned long long>(result.new_chunks),
+                 util_format_bytes(result.new_chunk_bytes).c_str());
+    } else {
+      auto const result{ archive_create_tar_zst(output_path, source_dir, prefix, opts) };
+      hex = util_bytes_to_hex(result.sha256.data(), result.sha256.size());
+      tui::debug("export: %s (%llu files, %llu hardlinked, %s, blake3 %s)",
+                 output_path.string().c_str(),
+                 static_cast<unsigned long long>(result.files),
+                 static_cast<unsigned long long>(result.hardlinks),
+                 util_format_bytes(result.bytes).c_str(),
+                 util_bytes_to_hex(result.blake3.data(), result.blake3.size()).c_str());
+    }
 
     std::string const path_part{ ecfg->depot_prefix ? (*ecfg->depot_prefix + filename)
                                                     : output_path.string() };
 
-    eng.record_export_result(p->key, hex + "  " + path_part + "\n");
+    std::string lines{ hex + "  " + path_part };
+    if (!ecfg->chunked && !ecfg->zstd_dictionary.empty()) {
+      lines += "  dict=" + std::to_string(depot_dict_id(ecfg->zstd_dictionary)) +
+               "  dict_sha256=" + depot_dict_sha256(ecfg->zstd_dictionary);
+    }
+    lines += "\n";
+
+    // Deltas are rebuilt on import from an installed pkg/ tree, so fetch-only exports
+    // get none.
+    if (ecfg->delta_from && prefix == "pkg") {
+      std::optional<std::uint64_t> full_size;
+      if (!ecfg->chunked) { full_size = std::filesystem::file_size(output_path); }
+      lines += export_deltas(*ecfg, stem, source_dir, full_size);
+    }
+
+    eng.record_export_result(p->key, lines);
   } catch (...) {
     std::error_code ec;
     std::filesystem::remove(output_path, ec);
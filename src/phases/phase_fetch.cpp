@@ -14,6 +14,7 @@
 #include "tui_actions.h"
 #include "uri.h"
 #include "util.h"
+#include "verified_hash_db.h"
 
 #include <algorithm>
 #include <chrono>
@@ -107,11 +108,13 @@ std::vector<fetch_spec> parse_fetch_field(sol::object const &fetch_obj,
                                           std::filesystem::path const &stage_dir,
                                           std::string const &key);
 std::vector<size_t> determine_downloads_needed(std::vector<fetch_spec> const &specs,
-                                               std::string const &identity);
+                                               std::string const &identity,
+                                               verified_hash_db &hashes);
 void execute_downloads(std::vector<fetch_spec> const &specs,
                        std::vector<size_t> const &to_download_indices,
                        std::string const &key,
-                       tui::section_handle section);
+                       tui::section_handle section,
+                       verified_hash_db &hashes);
 
 bool run_programmatic_fetch(sol::protected_function fetch_func,
                             cache::scoped_entry_lock *lock,
@@ -146,8 +149,9 @@ bool run_programmatic_fetch(sol::protected_function fetch_func,
     };
 
     if (!fetch_specs.empty()) {
-      auto const to_download{ determine_downloads_needed(fetch_specs, identity) };
-      execute_downloads(fetch_specs, to_download, identity, p->tui_section);
+      verified_hash_db hashes{ lock->fetch_hashes_path(), lock->fetch_dir() };
+      auto const to_download{ determine_downloads_needed(fetch_specs, identity, hashes) };
+      execute_downloads(fetch_specs, to_download, identity, p->tui_section, hashes);
 
       bool const has_git_repos =
           std::any_of(fetch_specs.begin(), fetch_specs.end(), [](auto const &spec) {
@@ -344,7 +348,8 @@ std::vector<fetch_spec> parse_fetch_field(sol::object const &fetch_obj,
 
 // Check cache and determine which files need downloading.
 std::vector<size_t> determine_downloads_needed(std::vector<fetch_spec> const &specs,
-                                               std::string const &identity) {
+                                               std::string const &identity,
+                                               verified_hash_db &hashes) {
   std::vector<size_t> to_download;
 
   for (size_t i = 0; i < specs.size(); ++i) {
@@ -364,9 +369,9 @@ std::vector<size_t> determine_downloads_needed(std::vector<fetch_spec> const &sp
       continue;
     }
 
-    // File exists with SHA256 - verify cached version
+    // File exists with SHA256 - verify cached version (unchanged files skip the rehash)
     try {
-      sha256_verify(spec.sha256, sha256(dest));
+      sha256_verify(spec.sha256, hashes.sha256(dest));
       tui::debug("fetch: %s cached (sha ok)", dest.filename().string().c_str());
       ENVY_TRACE(download_skipped,
                  identity,
@@ -380,6 +385,7 @@ std::vector<size_t> determine_downloads_needed(std::vector<fetch_spec> const &sp
     }
   }
 
+  hashes.save();
   return to_download;
 }
 
@@ -391,7 +397,8 @@ std::string fetch_item_label(fetch_request const &req) {
 void execute_downloads(std::vector<fetch_spec> const &specs,
                        std::vector<size_t> const &to_download_indices,
                        std::string const &key,
-                       tui::section_handle section) {
+                       tui::section_handle section,
+                       verified_hash_db &hashes) {
   if (to_download_indices.empty()) { return; }
 
   tui::debug("fetch: downloading %zu file(s)", to_download_indices.size());
@@ -427,7 +434,8 @@ void execute_downloads(std::vector<fetch_spec> const &specs,
         try {
           auto const *result{ std::get_if<fetch_result>(&results[i]) };
           if (!result) { throw std::runtime_error("Unexpected result type"); }
-          sha256_verify(specs[spec_idx].sha256, sha256(result->resolved_destination));
+          sha256_verify(specs[spec_idx].sha256,
+                        hashes.sha256(result->resolved_destination));
           tui::debug("fetch: %s sha256 verified",
                      result->resolved_destination.filename().string().c_str());
         } catch (std::exception const &e) {
@@ -437,6 +445,8 @@ void execute_downloads(std::vector<fetch_spec> const &specs,
     }
   }
 
+  hashes.save();  // Keep what verified even if another download failed
+
   if (!errors.empty()) {
     // Update TUI to show failure before throwing
     std::string status_text{ "fetch failed: " + errors.front() };
@@ -473,10 +483,12 @@ bool run_declarative_fetch(sol::object const &fetch_obj,
   };
   if (fetch_specs.empty()) { return true; }  // No specs = cacheable (nothing to do)
 
+  verified_hash_db hashes{ lock->fetch_hashes_path(), lock->fetch_dir() };
   execute_downloads(fetch_specs,
-                    determine_downloads_needed(fetch_specs, identity),
+                    determine_downloads_needed(fetch_specs, identity, hashes),
                     identity,
-                    p->tui_section);
+                    p->tui_section,
+                    hashes);
 
   // Check if git repos - if so, don't mark fetch complete (git clones are not cacheable)
   bool const has_git_repos{ std::any_of(fetch_specs.begin(),
@@ -1,12 +1,16 @@
 #include "phase_import.h"
 
 #include "cache.h"
+#include "depot_chunks.h"
+#include "depot_delta.h"
+#include "depot_dict.h"
 #include "engine.h"
 #include "extract.h"
 #include "fetch.h"
 #include "package_depot.h"
 #include "pkg.h"
 #include "pkg_cfg.h"
+#include "platform.h"
 #include "sha256.h"
 #include "trace.h"
 #include "tui.h"
@@ -16,7 +20,10 @@
 #include <algorithm>
 #include <chrono>
 #include <filesystem>
+#include <optional>
+#include <set>
 #include <string>
+#include <vector>
 
 namespace envy {
 
@@ -28,6 +35,283 @@ bool directory_has_entries(std::filesystem::path const &dir) {
   return !ec && it != std::filesystem::directory_iterator{};
 }
 
+// fetch() runs one thread per request; chunk downloads go out in bounded waves.
+constexpr std::size_t kChunkFetchBatch{ 16 };
+
+// Bring every chunk named by the index into the shared store under the cache root,
+// downloading only those not already present (from any earlier import), then reassemble
+// the tar stream into the package's tmp dir. Returns nullopt if a download failed.
+std::optional<std::filesystem::path> materialize_chunked_archive(
+    pkg *p,
+    engine &eng,
+    std::string const &index_url,
+    std::filesystem::path const &index_path,
+    bool index_is_local,
+    std::string const &label) {
+  namespace fs = std::filesystem;
+
+  auto const index{ [&] {
+    auto const bytes{ util_load_file(index_path) };
+    return depot_chunk_index_parse(std::string(bytes.begin(), bytes.end()));
+  }() };
+  depot_chunk_store store{ eng.cache_root() / "chunks" };
+
+  std::vector<depot_chunk_ref> missing;
+  std::set<blake3_t> queued;
+  std::uint64_t missing_bytes{ 0 };
+  for (auto const &ref : index.chunks) {
+    if (store.contains(ref.hash) || !queued.insert(ref.hash).second) { continue; }
+    missing.push_back(ref);
+    missing_bytes += ref.size;
+  }
+
+  tui::debug("import: %zu of %zu chunks missing locally (%s of %s)",
+             missing.size(),
+             index.chunks.size(),
+             util_format_bytes(missing_bytes).c_str(),
+             util_format_bytes(index.archive_size).c_str());
+
+  fs::path const chunk_fetch_dir{ p->lock->tmp_dir() / "depot-chunks" };
+  fs::create_directories(chunk_fetch_dir);
+
+  for (std::size_t begin{ 0 }; begin < missing.size(); begin += kChunkFetchBatch) {
+    std::size_t const end{ std::min(missing.size(), begin + kChunkFetchBatch) };
+
+    tui::section_set_content(
+        p->tui_section,
+        tui::section_frame{ .label = label,
+                            .content = tui::spinner_data{
+                                .text = "fetching chunks " + std::to_string(begin) + "/" +
+                                        std::to_string(missing.size()) + "...",
+                                .start_time = std::chrono::steady_clock::now() } });
+
+    // A local index has its chunks beside it on disk; store them straight from there.
+    if (index_is_local) {
+      for (std::size_t i{ begin }; i < end; ++i) {
+        store.put_compressed(missing[i], depot_chunk_url(index_url, missing[i].hash));
+      }
+      continue;
+    }
+
+    std::vector<fetch_request> requests;
+    std::vector<fs::path> destinations;
+    for (std::size_t i{ begin }; i < end; ++i) {
+      auto const url{ depot_chunk_url(index_url, missing[i].hash) };
+      destinations.push_back(chunk_fetch_dir / fs::path{ url }.filename());
+      requests.push_back(fetch_request_from_url(url, destinations.back()));
+    }
+
+    auto const results{ fetch(requests, p->cfg->identity) };
+    for (std::size_t i{ 0 }; i < results.size(); ++i) {
+      if (auto const *error{ std::get_if<std::string>(&results[i]) }) {
+        tui::warn("depot: failed to download chunk %s: %s",
+                  destinations[i].filename().string().c_str(),
+                  error->c_str());
+        return std::nullopt;
+      }
+      store.put_compressed(missing[begin + i], destinations[i]);
+      std::error_code ec;
+      fs::remove(destinations[i], ec);
+    }
+  }
+
+  tui::section_set_content(
+      p->tui_section,
+      tui::section_frame{ .label = label,
+                          .content = tui::spinner_data{
+                              .text = "assembling archive...",
+                              .start_time = std::chrono::steady_clock::now() } });
+
+  fs::path const archive_path{ chunk_fetch_dir / "depot-archive.tar" };
+  depot_reassemble_chunks(index, store, archive_path);
+  return archive_path;
+}
+
+void set_spinner(pkg *p, std::string const &label, std::string text) {
+  tui::section_set_content(
+      p->tui_section,
+      tui::section_frame{ .label = label,
+                          .content = tui::spinner_data{
+                              .text = std::move(text),
+                              .start_time = std::chrono::steady_clock::now() } });
+}
+
+// Download url to dest with progress. Returns false (warned) on failure.
+bool download_depot_file(pkg *p,
+                         std::string const &url,
+                         std::filesystem::path const &dest) {
+  std::vector<fetch_request> requests;
+  requests.push_back(fetch_request_from_url(url, dest));
+
+  tui_actions::fetch_progress_tracker tracker{ p->tui_section, p->cfg->identity, url };
+  std::visit([&](auto &r) { r.progress = tracker; }, requests[0]);
+
+  auto const results{ fetch(requests, p->cfg->identity) };
+  if (results.empty() || !std::holds_alternative<fetch_result>(results[0])) {
+    auto const *error{ results.empty() ? nullptr : std::get_if<std::string>(&results[0]) };
+    tui::warn("depot: failed to download archive %s: %s",
+              url.c_str(),
+              error ? error->c_str() : "unknown error");
+    return false;
+  }
+  return true;
+}
+
+// Local file: use directly; remote URL: download into the package's tmp dir as
+// dest_name. SHA256 is verified when present (text manifests always supply it; only
+// build_from_directory without checksums omits it). Returns nullopt (warned) on failure.
+std::optional<std::filesystem::path> obtain_depot_file(pkg *p,
+                                                       depot_entry const &entry,
+                                                       std::string const &dest_name,
+                                                       std::string const &hash_prefix,
+                                                       std::string const &label) {
+  namespace fs = std::filesystem;
+
+  fs::path path;
+  if (fs::exists(fs::path{ entry.url })) {
+    path = fs::absolute(fs::path{ entry.url });
+  } else {
+    fs::path const depot_fetch_dir{ p->lock->tmp_dir() / "depot-fetch" };
+    fs::create_directories(depot_fetch_dir);
+    path = depot_fetch_dir / dest_name;
+    if (!download_depot_file(p, entry.url, path)) { return std::nullopt; }
+  }
+
+  if (entry.sha256) {
+    set_spinner(p, label, "verifying SHA256...");
+
+    auto const actual{ sha256(path) };
+    auto const actual_hex{ util_bytes_to_hex(actual.data(), actual.size()) };
+    if (actual_hex != *entry.sha256) {
+      ENVY_TRACE(depot_check,
+                 p->cfg->identity,
+                 .sha = hash_prefix,
+                 .result = "sha_mismatch");
+      tui::warn("depot: SHA256 mismatch for %s (expected %s, got %s)",
+                entry.url.c_str(),
+                entry.sha256->c_str(),
+                actual_hex.c_str());
+      return std::nullopt;
+    }
+  }
+
+  return path;
+}
+
+// Dictionary a full archive was compressed with (see depot_dict.h), named by its
+// manifest line or, for directory depots, by the archive's first frame header. Kept under
+// <cache>/dicts/ so archives sharing one download it once. When the manifest line pins
+// the dictionary's SHA256, both the cached and a fetched copy must match it. Empty for a
+// plain archive; nullopt (warned) if the dictionary cannot be obtained.
+std::optional<std::vector<unsigned char>> obtain_depot_dictionary(
+    pkg *p,
+    engine &eng,
+    depot_entry const &entry,
+    std::filesystem::path const &archive_path,
+    std::string const &label) {
+  namespace fs = std::filesystem;
+
+  auto const id{ entry.dict_id ? entry.dict_id : depot_dict_id_of_archive(archive_path) };
+  if (!id) { return std::vector<unsigned char>{}; }
+
+  std::string const filename{ depot_dict_filename(*id) };
+  fs::path const cached{ eng.cache_root() / "dicts" / filename };
+  std::string const url{ depot_dict_url(entry.url, *id) };
+
+  try {
+    if (fs::exists(cached)) {
+      try {
+        return depot_dict_load(cached, *id, entry.dict_sha256);
+      } catch (std::exception const &e) {  // Another dictionary with this ID: refetch
+        tui::debug("depot: cached dictionary not used: %s", e.what());
+      }
+    }
+
+    fs::path const fetch_dir{ p->lock->tmp_dir() / "depot-fetch" };
+    fs::create_directories(fetch_dir);
+    fs::path const staged{ fetch_dir / filename };
+    if (fs::exists(fs::path{ url })) {
+      fs::copy_file(fs::path{ url }, staged, fs::copy_options::overwrite_existing);
+    } else {
+      set_spinner(p, label, "fetching dictionary...");
+      if (!download_depot_file(p, url, staged)) { return std::nullopt; }
+    }
+
+    // Manifests from before dict_sha256= only name the ID. Then each frame's checksum
+    // is what catches a wrong dictionary with the same ID.
+    auto dict{ depot_dict_load(staged, *id, entry.dict_sha256) };
+    fs::create_directories(cached.parent_path());
+    platform::atomic_rename(staged, cached);
+    return dict;
+  } catch (std::exception const &e) {
+    tui::warn("depot: dictionary %s unavailable: %s", url.c_str(), e.what());
+    return std::nullopt;
+  }
+}
+
+struct delta_archive {
+  std::filesystem::path tar;
+  std::string url;  // The delta it was rebuilt from
+};
+
+// Rebuild the package's tar from a delta against another version already installed in
+// this cache. The base tar is re-serialized from that version's pkg/ tree; a tree that
+// no longer serializes to the delta's base (local edits, reflinked duplicates) fails the
+// header check and the next delta, then the full artifact, is tried.
+std::optional<delta_archive> materialize_delta_archive(
+    pkg *p,
+    engine &eng,
+    std::vector<depot_delta_entry> const &deltas,
+    std::string const &hash_prefix,
+    std::string const &label) {
+  namespace fs = std::filesystem;
+
+  for (auto const &delta : deltas) {
+    auto const base{ util_parse_archive_filename(delta.base_key) };
+    if (!base || !util_is_safe_path_component(base->identity)) { continue; }
+
+    fs::path const base_pkg{ eng.get_cache().compute_pkg_path(base->identity,
+                                                              base->platform,
+                                                              base->arch,
+                                                              base->hash_prefix) };
+    if (!cache::is_entry_complete(base_pkg.parent_path()) ||
+        !directory_has_entries(base_pkg)) {
+      continue;
+    }
+
+    try {
+      auto const start{ std::chrono::steady_clock::now() };
+      auto const delta_path{
+        obtain_depot_file(p, delta.entry, "depot-archive.delta", hash_prefix, label)
+      };
+      if (!delta_path) { continue; }
+
+      set_spinner(p, label, "applying delta from " + base->identity + "...");
+      fs::path const delta_dir{ p->lock->tmp_dir() / "depot-fetch" };
+      fs::create_directories(delta_dir);
+      fs::path const base_tar{ delta_dir / "depot-delta-base.tar" };
+      auto const base_tree{ depot_delta_serialize_tree(base_pkg, "pkg", base_tar) };
+      fs::path const archive_path{ delta_dir / "depot-delta.tar" };
+      depot_delta_apply(*delta_path, base_tree, archive_path);
+      fs::remove(base_tar);
+
+      tui::debug("import: rebuilt from %s via %s delta (%s archive) in %lld ms",
+                 delta.base_key.c_str(),
+                 util_format_bytes(fs::file_size(*delta_path)).c_str(),
+                 util_format_bytes(fs::file_size(archive_path)).c_str(),
+                 static_cast<long long>(
+                     std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count()));
+      return delta_archive{ .tar = archive_path, .url = delta.entry.url };
+    } catch (std::exception const &e) {
+      tui::debug("import: delta %s not applied: %s", delta.entry.url.c_str(), e.what());
+    }
+  }
+
+  return std::nullopt;
+}
+
 }  // namespace
 
 void run_import_phase(pkg *p, engine &eng) {
@@ -51,7 +335,8 @@ void run_import_phase(pkg *p, engine &eng) {
   std::string const hash_prefix{ p->canonical_identity_hash.substr(0, 16) };
 
   auto const location{ depot->find(p->cfg->identity, platform, arch, hash_prefix) };
-  if (!location) {
+  auto const deltas{ depot->find_deltas(p->cfg->identity, platform, arch, hash_prefix) };
+  if (!location && deltas.empty()) {
     ENVY_TRACE(depot_check, p->cfg->identity, .sha = hash_prefix, .result = "miss");
     return;  // Depot miss — fall through to fetch
   }
@@ -59,63 +344,49 @@ void run_import_phase(pkg *p, engine &eng) {
 
   namespace fs = std::filesystem;
 
-  tui::debug("import: depot hit — importing %s", location->url.c_str());
-
   std::string const label{ "[" + p->cfg->identity + "]" };
+  std::string source_url{ location ? location->url : deltas.front().entry.url };
 
   try {
-    fs::path archive_path;
-
-    // Local file: use directly; remote URL: download to temp dir
-    if (fs::path const local_path{ location->url }; fs::exists(local_path)) {
-      archive_path = fs::absolute(local_path);
-    } else {
-      fs::path const tmp_dir{ p->lock->tmp_dir() };
-      fs::path const depot_fetch_dir{ tmp_dir / "depot-fetch" };
-      fs::create_directory(depot_fetch_dir);
-      archive_path = depot_fetch_dir / "depot-archive.tar.zst";
-
-      std::vector<fetch_request> requests;
-      requests.push_back(fetch_request_from_url(location->url, archive_path));
-
-      tui_actions::fetch_progress_tracker tracker{ p->tui_section,
-                                                   p->cfg->identity,
-                                                   location->url };
-      std::visit([&](auto &r) { r.progress = tracker; }, requests[0]);
-
-      auto const results{ fetch(requests, p->cfg->identity) };
-      if (results.empty() || !std::holds_alternative<fetch_result>(results[0])) {
-        auto const *error{ results.empty() ? nullptr
-                                           : std::get_if<std::string>(&results[0]) };
-        tui::warn("depot: failed to download archive %s: %s",
-                  location->url.c_str(),
-                  error ? error->c_str() : "unknown error");
-        return;  // Fall through to fetch phase
+    std::optional<fs::path> archive_path;
+    std::vector<unsigned char> dictionary;
+
+    // A delta against an installed version is usually a fraction of the full artifact.
+    if (!deltas.empty()) {
+      if (auto rebuilt{ materialize_delta_archive(p, eng, deltas, hash_prefix, label) }) {
+        archive_path = std::move(rebuilt->tar);
+        source_url = std::move(rebuilt->url);
       }
     }
 
-    // SHA256 verification when present (text manifests always supply it;
-    // only build_from_directory without checksums omits it).
-    if (location->sha256) {
-      tui::section_set_content(
-          p->tui_section,
-          tui::section_frame{ .label = label,
-                              .content = tui::spinner_data{
-                                  .text = "verifying SHA256...",
-                                  .start_time = std::chrono::steady_clock::now() } });
-
-      auto const actual{ sha256(archive_path) };
-      auto const actual_hex{ util_bytes_to_hex(actual.data(), actual.size()) };
-      if (actual_hex != *location->sha256) {
-        ENVY_TRACE(depot_check,
-                   p->cfg->identity,
-                   .sha = hash_prefix,
-                   .result = "sha_mismatch");
-        tui::warn("depot: SHA256 mismatch for %s (expected %s, got %s)",
-                  location->url.c_str(),
-                  location->sha256->c_str(),
-                  actual_hex.c_str());
-        return;  // Fall through to fetch/build
+    if (!archive_path) {
+      if (!location) { return; }  // No usable delta and no full artifact
+      source_url = location->url;
+      tui::debug("import: depot hit — importing %s", location->url.c_str());
+
+      bool const chunked{ depot_url_is_chunk_index(location->url) };
+      archive_path = obtain_depot_file(p,
+                                       *location,
+                                       chunked ? "depot-archive.chunks"
+                                               : "depot-archive.tar.zst",
+                                       hash_prefix,
+                                       label);
+      if (!archive_path) { return; }  // Fall through to fetch/build
+
+      // The verified index pins every chunk by BLAKE3; chunks are checked as they are
+      // stored and read back.
+      if (chunked) {
+        archive_path = materialize_chunked_archive(p,
+                                                   eng,
+                                                   location->url,
+                                                   *archive_path,
+                                                   fs::exists(fs::path{ location->url }),
+                                                   label);
+        if (!archive_path) { return; }  // Fall through to fetch/build
+      } else {
+        auto dict{ obtain_depot_dictionary(p, eng, *location, *archive_path, label) };
+        if (!dict) { return; }  // Fall through to fetch/build
+        dictionary = std::move(*dict);
       }
     }
 
@@ -130,7 +401,7 @@ void run_import_phase(pkg *p, engine &eng) {
                                 .text = "analyzing archive...",
                                 .start_time = std::chrono::steady_clock::now() } });
 
-    auto const totals{ compute_archive_totals(archive_path) };
+    auto const totals{ compute_archive_totals(*archive_path, dictionary) };
 
     std::uint64_t files_done{ 0 };
     std::uint64_t bytes_done{ 0 };
@@ -174,8 +445,10 @@ void run_import_phase(pkg *p, engine &eng) {
               .content = tui::progress_data{ .percent = percent, .status = status } });
       return true;
     } };
+    opts.clone_hardlinks = true;  // Deduplicated entries become reflinks where possible
+    opts.zstd_dictionary = dictionary;
 
-    extract(archive_path, entry_path, opts);
+    extract(*archive_path, entry_path, opts);
 
     bool const has_install{ directory_has_entries(p->lock->install_dir()) };
     bool const has_fetch{ directory_has_entries(p->lock->fetch_dir()) };
@@ -199,10 +472,10 @@ void run_import_phase(pkg *p, engine &eng) {
       tui::debug("import: depot fetch-only import — build phases continue");
     } else {
       tui::warn("depot: archive %s did not populate pkg/ or fetch/ directories",
-                location->url.c_str());
+                source_url.c_str());
     }
   } catch (std::exception const &e) {
-    tui::warn("depot: failed to import archive %s: %s", location->url.c_str(), e.what());
+    tui::warn("depot: failed to import archive %s: %s", source_url.c_str(), e.what());
   }
 }
 
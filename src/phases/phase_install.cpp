@@ -44,15 +44,17 @@ bool run_shell_install(std::string_view script,
                        std::string const &identity,
                        resolved_shell shell,
                        tui::section_handle tui_section,
-                       std::filesystem::path const &cache_root) {
+                       std::filesystem::path const &cache_root,
+                       shell_stats &stats) {
   tui::debug("install: shell script");
   tui_actions::run_phase_shell_script(script,
-                                      "Install",
+                                      pkg_phase::pkg_install,
                                       install_dir,
                                       identity,
                                       std::move(shell),
                                       tui_section,
-                                      cache_root);
+                                      cache_root,
+                                      stats);
 
   if (lock) {
     lock->mark_install_complete();
@@ -104,7 +106,8 @@ bool run_programmatic_install(sol::protected_function install_func,
                              identity,
                              shell_resolve_default(p->default_shell_ptr),
                              p->tui_section,
-                             eng.cache_root());
+                             eng.cache_root(),
+                             eng.shell_usage());
   }
 
   // Function returned nil/none successfully - mark complete
@@ -167,7 +170,8 @@ void run_install_phase(pkg *p, engine &eng) {
                                         p->cfg->identity,
                                         shell_resolve_default(p->default_shell_ptr),
                                         p->tui_section,
-                                        eng.cache_root());
+                                        eng.cache_root(),
+                                        eng.shell_usage());
   } else if (install_obj.is<sol::protected_function>()) {
     marked_complete = run_programmatic_install(install_obj.as<sol::protected_function>(),
                                                lock.get(),
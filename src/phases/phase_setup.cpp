@@ -37,14 +37,19 @@ sol::object make_pkg_dir_arg(sol::state_view lua, pkg *p) {
 
 // Run a pair CHECK shell command; exit 0 = satisfied. Non-zero is normal flow
 // (work needed), not an error.
-bool run_pair_check_command(pkg *p, std::string_view cmd, std::string const &context) {
+bool run_pair_check_command(pkg *p,
+                            shell_stats &stats,
+                            std::string_view cmd,
+                            std::string const &context) {
   shell_run_cfg cfg;
   cfg.env = shell_getenv();
   cfg.on_stdout_line = [](std::string_view) {};
   cfg.on_stderr_line = [](std::string_view) {};
   cfg.cwd = pkg_cfg::compute_project_root(p->cfg);
   cfg.shell = shell_resolve_default(p->default_shell_ptr);
+  cfg.max_line_length = shell_run_cfg::kLoggedLineLength;
 
+  auto const start{ std::chrono::steady_clock::now() };
   shell_result const result{ [&] {
     try {
       return shell_run(cmd, cfg);
@@ -53,6 +58,10 @@ bool run_pair_check_command(pkg *p, std::string_view cmd, std::string const &con
                                e.what());
     }
   }() };
+  stats.record(p->cfg->identity,
+               pkg_phase::pkg_setup,
+               result,
+               std::chrono::steady_clock::now() - start);
 
   tui::debug("setup: %s check exit=%d (%s)",
              context.c_str(),
@@ -104,7 +113,7 @@ bool run_pair_check(pkg *p, engine &eng, std::string const &name) {
     }
   }
 
-  return verdict ? *verdict : run_pair_check_command(p, *cmd, context);
+  return verdict ? *verdict : run_pair_check_command(p, eng.shell_usage(), *cmd, context);
 }
 
 // Run a pair's INSTALL verb against the host (cwd = project_root). Shell output
@@ -153,12 +162,13 @@ void run_pair_install(pkg *p,
 
   if (script) {
     tui_actions::run_phase_shell_script(*script,
-                                        "Setup",
+                                        pkg_phase::pkg_setup,
                                         project_root,
                                         log_identity,
                                         shell_resolve_default(p->default_shell_ptr),
                                         section,
-                                        eng.cache_root());
+                                        eng.cache_root(),
+                                        eng.shell_usage());
   }
 }
 
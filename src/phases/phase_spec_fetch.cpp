@@ -8,6 +8,9 @@
 #include "lua_ctx/lua_phase_context.h"
 #include "lua_envy.h"
 #include "lua_error_formatter.h"
+#include "lua_memory.h"
+#include "lua_profiler.h"
+#include "lua_state_pool.h"
 #include "manifest.h"
 #include "pkg.h"
 #include "sha256.h"
@@ -246,11 +249,8 @@ std::map<std::string, pkg::setup_pair_decl> parse_setup_table(
   return pairs;
 }
 
-sol_state_ptr create_lua_state() {
-  auto lua{ sol_util_make_lua_state() };
-  lua_envy_install(*lua);
-  return lua;
-}
+// The package hands its state back to the pool when it is destroyed (see pkg::~pkg).
+sol_state_ptr create_lua_state() { return lua_state_pool::shared().acquire(); }
 
 int load_spec_script(sol::state &lua,
                      std::filesystem::path const &spec_path,
@@ -363,7 +363,7 @@ std::filesystem::path fetch_bundle_and_resolve_spec(pkg_cfg const &cfg,
         throw std::runtime_error("Bundle identity mismatch: expected '" + bundle_id +
                                  "' but manifest declares '" + parsed.identity + "'");
       }
-      parsed.validate();
+      parsed.validate(&eng.spec_metadata());
 
       bundle *b{
         eng.register_bundle(bundle_id, std::move(parsed.specs), local_src->file_path)
@@ -458,7 +458,7 @@ std::filesystem::path fetch_bundle_and_resolve_spec(pkg_cfg const &cfg,
                              "' but manifest declares '" + parsed.identity + "'");
   }
 
-  parsed.validate();
+  parsed.validate(&eng.spec_metadata());
 
   bundle *b{
     eng.register_bundle(bundle_id, std::move(parsed.specs), cache_result.pkg_path)
@@ -1221,7 +1221,7 @@ void fetch_bundle_only(pkg_cfg const &cfg, pkg *p, engine &eng) {
         throw std::runtime_error("Bundle identity mismatch: expected '" + bundle_id +
                                  "' but manifest declares '" + parsed.identity + "'");
       }
-      parsed.validate();
+      parsed.validate(&eng.spec_metadata());
       eng.register_bundle(bundle_id, std::move(parsed.specs), local_src->file_path);
       return;
     }
@@ -1376,7 +1376,7 @@ void fetch_bundle_only(pkg_cfg const &cfg, pkg *p, engine &eng) {
                              "' but manifest declares '" + parsed.identity + "'");
   }
 
-  parsed.validate();
+  parsed.validate(&eng.spec_metadata());
 
   // Register the bundle for envy.loadenv_spec() access
   eng.register_bundle(bundle_id, std::move(parsed.specs), cache_result.pkg_path);
@@ -1429,6 +1429,8 @@ void run_spec_fetch_phase(pkg *p, engine &eng) {
 
   // Load and validate spec script
   auto lua{ create_lua_state() };
+  lua_set_gc_mode(lua->lua_state(), lua_gc_mode_for_phase(pkg_phase::spec_fetch));
+  lua_profiler_attach(lua->lua_state());
 
   // For specs from bundles, configure package.path for require() calls
   if (cfg.bundle_identity.has_value()) {
@@ -1521,6 +1523,7 @@ void run_spec_fetch_phase(pkg *p, engine &eng) {
     }
   }
 
+  lua_memory_trace(cfg.identity, pkg_phase::spec_fetch, lua->lua_state());
   p->lua.set(std::move(lua));
 
   wire_dependency_graph(p, eng);
@@ -99,15 +99,17 @@ void run_shell_stage(std::string_view script,
                      std::string const &identity,
                      resolved_shell shell,
                      tui::section_handle tui_section,
-                     std::filesystem::path const &cache_root) {
+                     std::filesystem::path const &cache_root,
+                     shell_stats &stats) {
   tui::debug("stage: shell script");
   tui_actions::run_phase_shell_script(script,
-                                      "Stage",
+                                      pkg_phase::pkg_stage,
                                       dest_dir,
                                       identity,
                                       std::move(shell),
                                       tui_section,
-                                      cache_root);
+                                      cache_root,
+                                      stats);
 }
 
 }  // namespace
@@ -140,7 +142,8 @@ void run_stage_phase(pkg *p, engine &eng) {
                     identity,
                     shell_resolve_default(p->default_shell_ptr),
                     p->tui_section,
-                    eng.cache_root());
+                    eng.cache_root(),
+                    eng.shell_usage());
   } else if (stage_obj.is<sol::protected_function>()) {
     run_programmatic_stage(stage_obj.as<sol::protected_function>(),
                            lock->fetch_dir(),
@@ -7,6 +7,7 @@
 #include <functional>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -62,6 +63,40 @@ std::filesystem::path create_unique_temp_dir(std::string_view prefix);
 void flush_directory(std::filesystem::path const &dir);
 bool file_exists(std::filesystem::path const &path);
 
+// Identity of the file a path names, without following symlinks: (st_dev, st_ino) on
+// POSIX, (volume serial, file index) on Windows. Paths with equal device/inode are hard
+// links to one file. Size and last-write time let callers notice content changes.
+struct file_identity {
+  std::uint64_t device{ 0 };
+  std::uint64_t inode{ 0 };
+  std::uint64_t link_count{ 0 };
+  std::uint64_t size{ 0 };
+  std::int64_t mtime_ns{ 0 };  // Last write, nanoseconds since the Unix epoch
+};
+
+// Nullopt if the path cannot be opened or stat'ed.
+std::optional<file_identity> get_file_identity(std::filesystem::path const &path);
+
+// Copy-on-write clone of regular file `from` to the new path `to` (FICLONE on Linux,
+// clonefile on macOS). Returns false, leaving nothing at `to`, when the platform or
+// filesystem cannot clone (Windows, ext4, cross-device); callers fall back to a copy
+// or hard link.
+bool clone_file(std::filesystem::path const &from, std::filesystem::path const &to);
+
+// Read-only mapping of a whole file. Throws std::runtime_error if it cannot be opened or
+// mapped; an empty file maps to an empty span.
+class mapped_file : unmovable {
+ public:
+  explicit mapped_file(std::filesystem::path const &path);
+  ~mapped_file();
+
+  std::span<unsigned char const> bytes() const;
+
+ private:
+  struct impl;
+  std::unique_ptr<impl> impl_;
+};
+
 // One immediate child of a directory, as reported by the platform's native
 // enumeration (POSIX d_type, Windows file attributes).
 struct dir_entry {
@@ -2,12 +2,19 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <wordexp.h>
 
 #ifdef __APPLE__
 #include <mach-o/dyld.h>
+#include <sys/clonefile.h>
+#endif
+
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #endif
 
 #include <cerrno>
@@ -16,6 +23,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <mutex>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <system_error>
@@ -231,6 +239,95 @@ bool file_exists(std::filesystem::path const &path) {
   return std::filesystem::exists(path);
 }
 
+std::optional<file_identity> get_file_identity(std::filesystem::path const &path) {
+  struct stat st{};
+  if (::lstat(path.c_str(), &st) != 0) { return std::nullopt; }
+#ifdef __APPLE__
+  auto const &mtime{ st.st_mtimespec };
+#else
+  auto const &mtime{ st.st_mtim };
+#endif
+  return file_identity{
+    .device = static_cast<std::uint64_t>(st.st_dev),
+    .inode = static_cast<std::uint64_t>(st.st_ino),
+    .link_count = static_cast<std::uint64_t>(st.st_nlink),
+    .size = static_cast<std::uint64_t>(st.st_size),
+    .mtime_ns = static_cast<std::int64_t>(mtime.tv_sec) * 1'000'000'000 + mtime.tv_nsec
+  };
+}
+
+bool clone_file(std::filesystem::path const &from, std::filesystem::path const &to) {
+#if defined(__APPLE__)
+  return ::clonefile(from.c_str(), to.c_str(), CLONE_NOFOLLOW) == 0;
+#elif defined(__linux__) && defined(FICLONE)
+  int const src{ ::open(from.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW) };
+  if (src == -1) { return false; }
+
+  struct stat st{};
+  if (::fstat(src, &st) != 0 || !S_ISREG(st.st_mode)) {
+    ::close(src);
+    return false;
+  }
+
+  int const dst{ ::open(to.c_str(),
+                        O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                        st.st_mode & 07777) };
+  if (dst == -1) {
+    ::close(src);
+    return false;
+  }
+
+  bool const cloned{ ::ioctl(dst, FICLONE, src) == 0 };
+  ::close(dst);
+  ::close(src);
+  if (!cloned) { ::unlink(to.c_str()); }
+  return cloned;
+#else
+  (void)from;
+  (void)to;
+  return false;
+#endif
+}
+
+struct mapped_file::impl {
+  void *data{ nullptr };
+  std::size_t size{ 0 };
+};
+
+mapped_file::mapped_file(std::filesystem::path const &path)
+    : impl_{ std::make_unique<impl>() } {
+  int const fd{ ::open(path.c_str(), O_RDONLY | O_CLOEXEC) };
+  if (fd == -1) {
+    throw std::system_error(errno, std::generic_category(), "open " + path.string());
+  }
+  struct stat st{};
+  if (::fstat(fd, &st) != 0) {
+    int const err{ errno };
+    ::close(fd);
+    throw std::system_error(err, std::generic_category(), "fstat " + path.string());
+  }
+  impl_->size = static_cast<std::size_t>(st.st_size);
+  if (impl_->size > 0) {
+    void *const data{ ::mmap(nullptr, impl_->size, PROT_READ, MAP_PRIVATE, fd, 0) };
+    if (data == MAP_FAILED) {
+      int const err{ errno };
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), "mmap " + path.string());
+    }
+    ::posix_madvise(data, impl_->size, POSIX_MADV_WILLNEED);
+    impl_->data = data;
+  }
+  ::close(fd);  // The mapping keeps the file referenced
+}
+
+mapped_file::~mapped_file() {
+  if (impl_->data) { ::munmap(impl_->data, impl_->size); }
+}
+
+std::span<unsigned char const> mapped_file::bytes() const {
+  return { static_cast<unsigned char const *>(impl_->data), impl_->size };
+}
+
 namespace {
 
 dir_scan_string dir_join(dir_scan_string const &dir, char const *name) {
@@ -232,6 +232,107 @@ bool file_exists(std::filesystem::path const &path) {
 
 namespace {
 
+// FILETIME counts 100ns intervals since 1601-01-01.
+std::int64_t filetime_to_unix_ns(FILETIME const &ft) {
+  constexpr std::int64_t kUnixEpochTicks{ 116444736000000000 };
+  auto const ticks{ static_cast<std::int64_t>(
+      (static_cast<std::uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime) };
+  return (ticks - kUnixEpochTicks) * 100;
+}
+
+}  // namespace
+
+std::optional<file_identity> get_file_identity(std::filesystem::path const &path) {
+  HANDLE const h{ ::CreateFileW(path.c_str(),
+                                0,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr,
+                                OPEN_EXISTING,
+                                FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT,
+                                nullptr) };
+  if (h == INVALID_HANDLE_VALUE) { return std::nullopt; }
+
+  BY_HANDLE_FILE_INFORMATION info{};
+  BOOL const ok{ ::GetFileInformationByHandle(h, &info) };
+  ::CloseHandle(h);
+  if (!ok) { return std::nullopt; }
+
+  return file_identity{
+    .device = info.dwVolumeSerialNumber,
+    .inode = (static_cast<std::uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow,
+    .link_count = info.nNumberOfLinks,
+    .size = (static_cast<std::uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow,
+    .mtime_ns = filetime_to_unix_ns(info.ftLastWriteTime)
+  };
+}
+
+bool clone_file(std::filesystem::path const &, std::filesystem::path const &) {
+  // ReFS block cloning (FSCTL_DUPLICATE_EXTENTS_TO_FILE) is not worth the complexity
+  // for the volumes envy caches live on; callers fall back.
+  return false;
+}
+
+struct mapped_file::impl {
+  void const *data{ nullptr };
+  std::size_t size{ 0 };
+};
+
+mapped_file::mapped_file(std::filesystem::path const &path)
+    : impl_{ std::make_unique<impl>() } {
+  HANDLE const file{ ::CreateFileW(path.c_str(),
+                                   GENERIC_READ,
+                                   FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                   nullptr,
+                                   OPEN_EXISTING,
+                                   FILE_FLAG_SEQUENTIAL_SCAN,
+                                   nullptr) };
+  if (file == INVALID_HANDLE_VALUE) {
+    throw std::system_error(::GetLastError(),
+                            std::system_category(),
+                            "CreateFileW " + path.string());
+  }
+  LARGE_INTEGER size{};
+  if (!::GetFileSizeEx(file, &size)) {
+    DWORD const err{ ::GetLastError() };
+    ::CloseHandle(file);
+    throw std::system_error(err, std::system_category(), "GetFileSizeEx " + path.string());
+  }
+  impl_->size = static_cast<std::size_t>(size.QuadPart);
+  if (impl_->size == 0) {  // Zero-length files cannot be mapped
+    ::CloseHandle(file);
+    return;
+  }
+
+  HANDLE const mapping{
+    ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr)
+  };
+  DWORD const err{ ::GetLastError() };
+  ::CloseHandle(file);
+  if (!mapping) {
+    throw std::system_error(err,
+                            std::system_category(),
+                            "CreateFileMappingW " + path.string());
+  }
+  impl_->data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  DWORD const view_err{ ::GetLastError() };
+  ::CloseHandle(mapping);  // The view keeps the mapping alive
+  if (!impl_->data) {
+    throw std::system_error(view_err,
+                            std::system_category(),
+                            "MapViewOfFile " + path.string());
+  }
+}
+
+mapped_file::~mapped_file() {
+  if (impl_->data) { ::UnmapViewOfFile(impl_->data); }
+}
+
+std::span<unsigned char const> mapped_file::bytes() const {
+  return { static_cast<unsigned char const *>(impl_->data), impl_->size };
+}
+
+namespace {
+
 constexpr wchar_t kLongPrefix[]{ LR"(\\?\)" };
 constexpr wchar_t kLongPrefixUnc[]{ LR"(\\?\UNC\)" };
 
@@ -1,7 +1,11 @@
 #pragma once
 
+#include "util.h"
+
 #include <array>
+#include <cstddef>
 #include <filesystem>
+#include <memory>
 #include <string>
 
 namespace envy {
@@ -10,6 +14,25 @@ using sha256_t = std::array<unsigned char, 32>;
 
 sha256_t sha256(std::filesystem::path const &file_path);
 
+// Incremental SHA256 for data that is produced rather than read back from disk (e.g.
+// archive bytes hashed as they are written). finalize() may be called once.
+class sha256_hasher : unmovable {
+ public:
+  sha256_hasher();
+  ~sha256_hasher();
+
+  void update(void const *data, size_t length);
+  sha256_t finalize();
+
+ private:
+  struct impl;
+  std::unique_ptr<impl> impl_;
+};
+
+// Implementation sha256() and sha256_hasher use on this machine: a hardware backend
+// ("sha-ni", "armv8-sha2") when the CPU has one, else "mbedtls" ("bcrypt" on Windows).
+char const *sha256_backend_name();
+
 // Verify SHA256 hash matches expected hex string (case-insensitive)
 // Throws std::runtime_error with detailed message if mismatch
 void sha256_verify(std::string const &expected_hex, sha256_t const &actual_hash);
@@ -0,0 +1,285 @@
+#include "sha256_accel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define ENVY_SHA256_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define ENVY_SHA256_ARM 1
+#include <arm_neon.h>
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#elif defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+#endif
+
+namespace envy {
+
+namespace {
+
+constexpr std::array<std::uint32_t, 8> kInitialState{ 0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                                      0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                                      0x1f83d9ab, 0x5be0cd19 };
+
+[[maybe_unused]] alignas(16) constexpr std::uint32_t kRoundConstants[64]{
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4,
+  0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe,
+  0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f,
+  0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+  0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+  0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+  0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116,
+  0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7,
+  0xc67178f2
+};
+
+#if defined(ENVY_SHA256_X86)
+
+#define ENVY_SHA_NI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+
+// Four rounds: the SHA-NI instruction does two, taking W+K for both in its low half.
+ENVY_SHA_NI_TARGET inline void shani_rounds(__m128i &abef,
+                                            __m128i &cdgh,
+                                            __m128i msg,
+                                            int group) {
+  msg = _mm_add_epi32(
+      msg,
+      _mm_load_si128(reinterpret_cast<__m128i const *>(&kRoundConstants[group * 4])));
+  cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+  abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+}
+
+// Next four schedule words into w0 (which holds W[t-16..t-13] on entry).
+ENVY_SHA_NI_TARGET inline void shani_schedule(__m128i &w0,
+                                              __m128i w1,
+                                              __m128i w2,
+                                              __m128i w3) {
+  w0 = _mm_add_epi32(_mm_sha256msg1_epu32(w0, w1), _mm_alignr_epi8(w3, w2, 4));
+  w0 = _mm_sha256msg2_epu32(w0, w3);
+}
+
+ENVY_SHA_NI_TARGET void sha256_blocks_shani(std::uint32_t *state,
+                                            unsigned char const *data,
+                                            std::size_t blocks) {
+  __m128i const byte_swap{ _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL) };
+
+  // The instructions keep the state as {a,b,e,f} and {c,d,g,h}.
+  __m128i const dcba{ _mm_shuffle_epi32(
+      _mm_loadu_si128(reinterpret_cast<__m128i const *>(&state[0])),
+      0xB1) };
+  __m128i const hgfe{ _mm_shuffle_epi32(
+      _mm_loadu_si128(reinterpret_cast<__m128i const *>(&state[4])),
+      0x1B) };
+  __m128i abef{ _mm_alignr_epi8(dcba, hgfe, 8) };
+  __m128i cdgh{ _mm_blend_epi16(hgfe, dcba, 0xF0) };
+
+  for (; blocks > 0; --blocks, data += 64) {
+    __m128i const abef_in{ abef };
+    __m128i const cdgh_in{ cdgh };
+
+    __m128i w0{ _mm_shuffle_epi8(
+        _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0)), byte_swap) };
+    __m128i w1{ _mm_shuffle_epi8(
+        _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 16)), byte_swap) };
+    __m128i w2{ _mm_shuffle_epi8(
+        _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 32)), byte_swap) };
+    __m128i w3{ _mm_shuffle_epi8(
+        _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 48)), byte_swap) };
+
+    shani_rounds(abef, cdgh, w0, 0);
+    shani_rounds(abef, cdgh, w1, 1);
+    shani_rounds(abef, cdgh, w2, 2);
+    shani_rounds(abef, cdgh, w3, 3);
+    for (int group{ 4 }; group < 16; group += 4) {
+      shani_schedule(w0, w1, w2, w3);
+      shani_rounds(abef, cdgh, w0, group);
+      shani_schedule(w1, w2, w3, w0);
+      shani_rounds(abef, cdgh, w1, group + 1);
+      shani_schedule(w2, w3, w0, w1);
+      shani_rounds(abef, cdgh, w2, group + 2);
+      shani_schedule(w3, w0, w1, w2);
+      shani_rounds(abef, cdgh, w3, group + 3);
+    }
+
+    abef = _mm_add_epi32(abef, abef_in);
+    cdgh = _mm_add_epi32(cdgh, cdgh_in);
+  }
+
+  __m128i const feba{ _mm_shuffle_epi32(abef, 0x1B) };
+  __m128i const dchg{ _mm_shuffle_epi32(cdgh, 0xB1) };
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[0]),
+                   _mm_blend_epi16(feba, dchg, 0xF0));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[4]),
+                   _mm_alignr_epi8(dchg, feba, 8));
+}
+
+bool cpu_has_sha_ni() {
+  unsigned eax{ 0 }, ebx{ 0 }, ecx{ 0 }, edx{ 0 };
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) { return false; }
+  bool const sse41{ (ecx & bit_SSE4_1) != 0 };
+  bool const ssse3{ (ecx & bit_SSSE3) != 0 };
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) { return false; }
+  return sse41 && ssse3 && (ebx & bit_SHA) != 0;
+}
+
+#elif defined(ENVY_SHA256_ARM)
+
+#if defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO)
+#define ENVY_ARMV8_SHA2_TARGET
+#elif defined(__clang__)
+#define ENVY_ARMV8_SHA2_TARGET __attribute__((target("sha2")))
+#else
+#define ENVY_ARMV8_SHA2_TARGET __attribute__((target("+crypto")))
+#endif
+
+ENVY_ARMV8_SHA2_TARGET inline void armv8_rounds(uint32x4_t &abcd,
+                                                uint32x4_t &efgh,
+                                                uint32x4_t msg,
+                                                int group) {
+  uint32x4_t const wk{ vaddq_u32(msg, vld1q_u32(&kRoundConstants[group * 4])) };
+  uint32x4_t const abcd_in{ abcd };
+  abcd = vsha256hq_u32(abcd, efgh, wk);
+  efgh = vsha256h2q_u32(efgh, abcd_in, wk);
+}
+
+ENVY_ARMV8_SHA2_TARGET void sha256_blocks_armv8(std::uint32_t *state,
+                                                unsigned char const *data,
+                                                std::size_t blocks) {
+  uint32x4_t abcd{ vld1q_u32(&state[0]) };
+  uint32x4_t efgh{ vld1q_u32(&state[4]) };
+
+  for (; blocks > 0; --blocks, data += 64) {
+    uint32x4_t const abcd_in{ abcd };
+    uint32x4_t const efgh_in{ efgh };
+
+    uint32x4_t w0{ vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 0))) };
+    uint32x4_t w1{ vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16))) };
+    uint32x4_t w2{ vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 32))) };
+    uint32x4_t w3{ vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 48))) };
+
+    armv8_rounds(abcd, efgh, w0, 0);
+    armv8_rounds(abcd, efgh, w1, 1);
+    armv8_rounds(abcd, efgh, w2, 2);
+    armv8_rounds(abcd, efgh, w3, 3);
+    for (int group{ 4 }; group < 16; group += 4) {
+      w0 = vsha256su1q_u32(vsha256su0q_u32(w0, w1), w2, w3);
+      armv8_rounds(abcd, efgh, w0, group);
+      w1 = vsha256su1q_u32(vsha256su0q_u32(w1, w2), w3, w0);
+      armv8_rounds(abcd, efgh, w1, group + 1);
+      w2 = vsha256su1q_u32(vsha256su0q_u32(w2, w3), w0, w1);
+      armv8_rounds(abcd, efgh, w2, group + 2);
+      w3 = vsha256su1q_u32(vsha256su0q_u32(w3, w0), w1, w2);
+      armv8_rounds(abcd, efgh, w3, group + 3);
+    }
+
+    abcd = vaddq_u32(abcd, abcd_in);
+    efgh = vaddq_u32(efgh, efgh_in);
+  }
+
+  vst1q_u32(&state[0], abcd);
+  vst1q_u32(&state[4], efgh);
+}
+
+bool cpu_has_armv8_sha2() {
+#if defined(__APPLE__)
+  int value{ 0 };
+  std::size_t size{ sizeof(value) };
+  if (sysctlbyname("hw.optional.arm.FEAT_SHA256", &value, &size, nullptr, 0) == 0) {
+    return value != 0;
+  }
+  return true;  // Every Apple arm64 CPU implements it; older kernels lack the key
+#elif defined(__linux__)
+  return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+#else
+  return false;
+#endif
+}
+
+#endif
+
+std::vector<sha256_accel_backend> probe_backends() {
+  std::vector<sha256_accel_backend> backends;
+#if defined(ENVY_SHA256_X86)
+  if (cpu_has_sha_ni()) { backends.push_back({ "sha-ni", &sha256_blocks_shani }); }
+#elif defined(ENVY_SHA256_ARM)
+  if (cpu_has_armv8_sha2()) {
+    backends.push_back({ "armv8-sha2", &sha256_blocks_armv8 });
+  }
+#endif
+  return backends;
+}
+
+void store_be32(unsigned char *out, std::uint32_t v) {
+  out[0] = static_cast<unsigned char>(v >> 24);
+  out[1] = static_cast<unsigned char>(v >> 16);
+  out[2] = static_cast<unsigned char>(v >> 8);
+  out[3] = static_cast<unsigned char>(v);
+}
+
+}  // namespace
+
+std::span<sha256_accel_backend const> sha256_accel_backends() {
+  static std::vector<sha256_accel_backend> const backends{ probe_backends() };
+  return backends;
+}
+
+sha256_accel_state::sha256_accel_state(sha256_accel_backend const &backend)
+    : blocks_{ backend.blocks }, state_{ kInitialState } {}
+
+void sha256_accel_state::update(void const *data, std::size_t length) {
+  auto const *bytes{ static_cast<unsigned char const *>(data) };
+  total_ += length;
+
+  if (buffered_ > 0) {
+    std::size_t const n{ std::min(length, buffer_.size() - buffered_) };
+    std::memcpy(buffer_.data() + buffered_, bytes, n);
+    buffered_ += n;
+    bytes += n;
+    length -= n;
+    if (buffered_ < buffer_.size()) { return; }
+    blocks_(state_.data(), buffer_.data(), 1);
+    buffered_ = 0;
+  }
+
+  if (std::size_t const whole{ length / 64 }) {
+    blocks_(state_.data(), bytes, whole);
+    bytes += whole * 64;
+    length -= whole * 64;
+  }
+
+  std::memcpy(buffer_.data(), bytes, length);
+  buffered_ = length;
+}
+
+sha256_t sha256_accel_state::finalize() {
+  std::uint64_t const bit_length{ total_ * 8 };
+
+  buffer_[buffered_++] = 0x80;
+  if (buffered_ > 56) {
+    std::fill(buffer_.begin() + static_cast<std::ptrdiff_t>(buffered_), buffer_.end(), 0);
+    blocks_(state_.data(), buffer_.data(), 1);
+    buffered_ = 0;
+  }
+  std::fill(buffer_.begin() + static_cast<std::ptrdiff_t>(buffered_),
+            buffer_.begin() + 56,
+            0);
+  for (int i{ 0 }; i < 8; ++i) {
+    buffer_[56 + i] = static_cast<unsigned char>(bit_length >> (56 - 8 * i));
+  }
+  blocks_(state_.data(), buffer_.data(), 1);
+
+  sha256_t digest{};
+  for (std::size_t i{ 0 }; i < state_.size(); ++i) {
+    store_be32(digest.data() + i * 4, state_[i]);
+  }
+  return digest;
+}
+
+}  // namespace envy
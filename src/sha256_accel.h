@@ -0,0 +1,45 @@
+#pragma once
+
+#include "sha256.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace envy {
+
+// Hardware SHA-256 block functions for sha256_mbedtls.cpp: SHA-NI on x86-64 and the
+// ARMv8 SHA2 extensions on aarch64. Support is probed from the CPU at runtime, so one
+// binary runs everywhere; when no backend is usable sha256_hasher stays on mbedtls.
+
+// Compress `blocks` consecutive 64-byte blocks into state (a..h, host word order).
+using sha256_blocks_fn = void (*)(std::uint32_t *state,
+                                  unsigned char const *data,
+                                  std::size_t blocks);
+
+struct sha256_accel_backend {
+  char const *name;
+  sha256_blocks_fn blocks;
+};
+
+// Backends this CPU supports, fastest first; empty when none are.
+std::span<sha256_accel_backend const> sha256_accel_backends();
+
+// Streaming SHA-256 over one backend: buffering and padding around its block function.
+class sha256_accel_state {
+ public:
+  explicit sha256_accel_state(sha256_accel_backend const &backend);
+
+  void update(void const *data, std::size_t length);
+  sha256_t finalize();
+
+ private:
+  sha256_blocks_fn blocks_;
+  std::array<std::uint32_t, 8> state_;
+  std::array<unsigned char, 64> buffer_{};
+  std::size_t buffered_{ 0 };
+  std::uint64_t total_{ 0 };
+};
+
+}  // namespace envy
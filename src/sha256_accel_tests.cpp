@@ -0,0 +1,81 @@
+#include "sha256_accel.h"
+
+#include "mbedtls/sha256.h"
+
+#include "doctest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+envy::sha256_t mbedtls_digest(std::vector<unsigned char> const &data) {
+  envy::sha256_t digest{};
+  mbedtls_sha256_context ctx;
+  mbedtls_sha256_init(&ctx);
+  mbedtls_sha256_starts(&ctx, 0);
+  mbedtls_sha256_update(&ctx, data.data(), data.size());
+  mbedtls_sha256_finish(&ctx, digest.data());
+  mbedtls_sha256_free(&ctx);
+  return digest;
+}
+
+}  // namespace
+
+TEST_CASE("sha256_accel backends match mbedtls on random input and splits") {
+  std::mt19937_64 rng{ 20260515 };
+  for (auto const &backend : envy::sha256_accel_backends()) {
+    CAPTURE(backend.name);
+    for (int round{ 0 }; round < 500; ++round) {
+      std::vector<unsigned char> data(rng() % 4096);
+      for (auto &b : data) { b = static_cast<unsigned char>(rng()); }
+
+      // Feed in random pieces so every buffered_/block boundary case is crossed.
+      envy::sha256_accel_state state{ backend };
+      std::size_t pos{ 0 };
+      while (pos < data.size()) {
+        std::size_t const n{ std::min<std::size_t>(data.size() - pos, rng() % 200) };
+        state.update(data.data() + pos, n);
+        pos += n;
+      }
+      CHECK(state.finalize() == mbedtls_digest(data));
+    }
+  }
+}
+
+TEST_CASE("sha256_accel padding boundaries match mbedtls") {
+  for (auto const &backend : envy::sha256_accel_backends()) {
+    CAPTURE(backend.name);
+    for (std::size_t len : { 0, 1, 55, 56, 57, 63, 64, 65, 119, 120, 128 }) {
+      CAPTURE(len);
+      std::vector<unsigned char> const data(len, 0x5a);
+      envy::sha256_accel_state state{ backend };
+      state.update(data.data(), data.size());
+      CHECK(state.finalize() == mbedtls_digest(data));
+    }
+  }
+}
+
+TEST_CASE("sha256 backend throughput" * doctest::skip()) {
+  std::vector<unsigned char> const data(64 * 1024 * 1024, 0xa5);
+  auto const mb_per_s{ [&](auto &&hash) {
+    auto const start{ std::chrono::steady_clock::now() };
+    hash();
+    std::chrono::duration<double> const elapsed{ std::chrono::steady_clock::now() -
+                                                 start };
+    return static_cast<double>(data.size()) / (1024.0 * 1024.0) / elapsed.count();
+  } };
+
+  MESSAGE("mbedtls: " << mb_per_s([&] { (void)mbedtls_digest(data); }) << " MB/s");
+  for (auto const &backend : envy::sha256_accel_backends()) {
+    MESSAGE(backend.name << ": " << mb_per_s([&] {
+              envy::sha256_accel_state state{ backend };
+              state.update(data.data(), data.size());
+              (void)state.finalize();
+            }) << " MB/s");
+  }
+}
@@ -1,5 +1,6 @@
 #include "sha256.h"
 
+#include "sha256_accel.h"
 #include "util.h"
 
 #include "mbedtls/sha256.h"
@@ -7,27 +8,67 @@
 #include <cstdio>
 #include <cstring>
 #include <memory>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
 namespace envy {
 
-sha256_t sha256(std::filesystem::path const &file_path) {
-  if (!std::filesystem::exists(file_path)) {
-    throw std::runtime_error("sha256: file does not exist: " + file_path.string());
-  }
+// mbedtls's SHA-256 is portable C; a hardware backend, when the CPU has one, replaces it.
+struct sha256_hasher::impl {
+  impl() { mbedtls_sha256_init(&ctx); }
+  ~impl() { mbedtls_sha256_free(&ctx); }
 
+  std::optional<sha256_accel_state> accel;
   mbedtls_sha256_context ctx;
-  mbedtls_sha256_init(&ctx);
+  bool finalized{ false };
+};
 
-  std::unique_ptr<decltype(ctx), decltype(&mbedtls_sha256_free)> ctx_scope(
-      &ctx,
-      &mbedtls_sha256_free);
-
-  if (mbedtls_sha256_starts(&ctx, 0)) {
+sha256_hasher::sha256_hasher() : impl_{ std::make_unique<impl>() } {
+  if (auto const backends{ sha256_accel_backends() }; !backends.empty()) {
+    impl_->accel.emplace(backends.front());
+    return;
+  }
+  if (mbedtls_sha256_starts(&impl_->ctx, 0)) {
     throw std::runtime_error("sha256: mbedtls_sha256_starts failed");
   }
+}
+
+sha256_hasher::~sha256_hasher() = default;
+
+void sha256_hasher::update(void const *data, size_t length) {
+  if (impl_->finalized) { throw std::logic_error("sha256: update after finalize"); }
+  if (length == 0) { return; }
+  if (impl_->accel) {
+    impl_->accel->update(data, length);
+    return;
+  }
+  if (mbedtls_sha256_update(&impl_->ctx,
+                            static_cast<unsigned char const *>(data),
+                            length)) {
+    throw std::runtime_error("sha256: mbedtls_sha256_update failed");
+  }
+}
+
+sha256_t sha256_hasher::finalize() {
+  if (impl_->finalized) { throw std::logic_error("sha256: finalize called twice"); }
+  impl_->finalized = true;
+  if (impl_->accel) { return impl_->accel->finalize(); }
+
+  sha256_t digest{};
+  if (mbedtls_sha256_finish(&impl_->ctx, digest.data())) {
+    throw std::runtime_error("sha256: mbedtls_sha256_finish failed");
+  }
+  return digest;
+}
+
+sha256_t sha256(std::filesystem::path const &file_path) {
+  if (!std::filesystem::exists(file_path)) {
+    throw std::runtime_error("sha256: file does not exist: " + file_path.string());
+  }
+
+  sha256_hasher hasher;
 
   file_ptr_t file{ util_open_file(file_path, "rb") };
   if (!file) {
@@ -40,11 +81,7 @@ sha256_t sha256(std::filesystem::path const &file_path) {
       std::fread(buffer.data(), sizeof(unsigned char), buffer.size(), file.get())
     };
 
-    if (read_bytes > 0) {
-      if (mbedtls_sha256_update(&ctx, buffer.data(), read_bytes)) {
-        throw std::runtime_error("sha256: mbedtls_sha256_update failed");
-      }
-    }
+    if (read_bytes > 0) { hasher.update(buffer.data(), read_bytes); }
 
     if (read_bytes < buffer.size()) {
       if (std::ferror(file.get())) { throw std::runtime_error("sha256: fread failed"); }
@@ -52,12 +89,12 @@ sha256_t sha256(std::filesystem::path const &file_path) {
     }
   }
 
-  sha256_t digest{};
-  if (mbedtls_sha256_finish(&ctx, digest.data())) {
-    throw std::runtime_error("sha256: mbedtls_sha256_finish failed");
-  }
+  return hasher.finalize();
+}
 
-  return digest;
+char const *sha256_backend_name() {
+  auto const backends{ sha256_accel_backends() };
+  return backends.empty() ? "mbedtls" : backends.front().name;
 }
 
 void sha256_verify(std::string const &expected_hex, sha256_t const &actual_hash) {
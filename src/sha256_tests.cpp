@@ -1,9 +1,13 @@
 #include "sha256.h"
 
+#include "util.h"
+
 #include "doctest.h"
 
 #include <array>
 #include <filesystem>
+#include <stdexcept>
+#include <string>
 
 namespace fs = std::filesystem;
 
@@ -30,6 +34,46 @@ TEST_CASE("sha256 throws for missing file") {
   CHECK_THROWS(envy::sha256(missing));
 }
 
+TEST_CASE("sha256_hasher matches one-shot file hash across split updates") {
+  envy::sha256_hasher hasher;
+  hasher.update("a", 1);
+  hasher.update("", 0);
+  hasher.update("bc", 2);
+  CHECK(hasher.finalize() == kExpectedSha256Abc);
+}
+
+TEST_CASE("sha256_hasher matches NIST FIPS 180-2 vectors") {
+  auto const digest_hex{ [](std::string const &message, std::size_t repeat = 1) {
+    envy::sha256_hasher hasher;
+    for (std::size_t i{ 0 }; i < repeat; ++i) {
+      hasher.update(message.data(), message.size());
+    }
+    auto const digest{ hasher.finalize() };
+    return envy::util_bytes_to_hex(digest.data(), digest.size());
+  } };
+
+  CAPTURE(envy::sha256_backend_name());
+  CHECK(digest_hex("") ==
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  CHECK(digest_hex("abc") ==
+        "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+  CHECK(digest_hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+  CHECK(digest_hex("abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmno"
+                   "ijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu") ==
+        "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1");
+  CHECK(digest_hex(std::string(1000, 'a'), 1000) ==
+        "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+TEST_CASE("sha256_hasher rejects reuse after finalize") {
+  envy::sha256_hasher hasher;
+  hasher.update("abc", 3);
+  hasher.finalize();
+  CHECK_THROWS_AS(hasher.update("x", 1), std::logic_error);
+  CHECK_THROWS_AS(hasher.finalize(), std::logic_error);
+}
+
 TEST_CASE("sha256_verify succeeds with correct lowercase hex") {
   std::string const expected_hex =
       "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
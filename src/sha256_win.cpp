@@ -3,6 +3,7 @@
 #include "platform.h"
 #include "util.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <memory>
@@ -14,30 +15,75 @@
 
 namespace envy {
 
-sha256_t sha256(std::filesystem::path const &file_path) {
-  if (!std::filesystem::exists(file_path)) {
-    throw std::runtime_error("sha256: file does not exist: " + file_path.string());
+struct sha256_hasher::impl {
+  ~impl() {
+    if (hash_handle) { BCryptDestroyHash(hash_handle); }
+    if (alg_handle) { BCryptCloseAlgorithmProvider(alg_handle, 0); }
   }
 
   BCRYPT_ALG_HANDLE alg_handle{ nullptr };
-  NTSTATUS status{
-    BCryptOpenAlgorithmProvider(&alg_handle, BCRYPT_SHA256_ALGORITHM, nullptr, 0)
-  };
-  if (!BCRYPT_SUCCESS(status)) {
+  BCRYPT_HASH_HANDLE hash_handle{ nullptr };
+  bool finalized{ false };
+};
+
+sha256_hasher::sha256_hasher() : impl_{ std::make_unique<impl>() } {
+  if (!BCRYPT_SUCCESS(BCryptOpenAlgorithmProvider(&impl_->alg_handle,
+                                                  BCRYPT_SHA256_ALGORITHM,
+                                                  nullptr,
+                                                  0))) {
     throw std::runtime_error("sha256: BCryptOpenAlgorithmProvider failed");
   }
+  if (!BCRYPT_SUCCESS(BCryptCreateHash(impl_->alg_handle,
+                                       &impl_->hash_handle,
+                                       nullptr,
+                                       0,
+                                       nullptr,
+                                       0,
+                                       0))) {
+    throw std::runtime_error("sha256: BCryptCreateHash failed");
+  }
+}
 
-  auto alg_deleter = [](BCRYPT_ALG_HANDLE h) { BCryptCloseAlgorithmProvider(h, 0); };
-  std::unique_ptr<void, decltype(alg_deleter)> alg_scope(alg_handle, alg_deleter);
+sha256_hasher::~sha256_hasher() = default;
 
-  BCRYPT_HASH_HANDLE hash_handle{ nullptr };
-  status = BCryptCreateHash(alg_handle, &hash_handle, nullptr, 0, nullptr, 0, 0);
-  if (!BCRYPT_SUCCESS(status)) {
-    throw std::runtime_error("sha256: BCryptCreateHash failed");
+void sha256_hasher::update(void const *data, size_t length) {
+  if (impl_->finalized) { throw std::logic_error("sha256: update after finalize"); }
+
+  // BCryptHashData takes a ULONG length; feed oversized buffers in slices.
+  auto const *p{ static_cast<unsigned char const *>(data) };
+  while (length > 0) {
+    ULONG const slice{ static_cast<ULONG>(std::min<size_t>(length, 0x40000000u)) };
+    if (!BCRYPT_SUCCESS(BCryptHashData(impl_->hash_handle,
+                                       const_cast<PUCHAR>(p),
+                                       slice,
+                                       0))) {
+      throw std::runtime_error("sha256: BCryptHashData failed");
+    }
+    p += slice;
+    length -= slice;
   }
+}
 
-  auto hash_deleter = [](BCRYPT_HASH_HANDLE h) { BCryptDestroyHash(h); };
-  std::unique_ptr<void, decltype(hash_deleter)> hash_scope(hash_handle, hash_deleter);
+sha256_t sha256_hasher::finalize() {
+  if (impl_->finalized) { throw std::logic_error("sha256: finalize called twice"); }
+  impl_->finalized = true;
+
+  sha256_t digest{};
+  if (!BCRYPT_SUCCESS(BCryptFinishHash(impl_->hash_handle,
+                                       digest.data(),
+                                       static_cast<ULONG>(digest.size()),
+                                       0))) {
+    throw std::runtime_error("sha256: BCryptFinishHash failed");
+  }
+  return digest;
+}
+
+sha256_t sha256(std::filesystem::path const &file_path) {
+  if (!std::filesystem::exists(file_path)) {
+    throw std::runtime_error("sha256: file does not exist: " + file_path.string());
+  }
+
+  sha256_hasher hasher;
 
   file_ptr_t file{ util_open_file(file_path, "rb") };
   if (!file) {
@@ -50,13 +96,7 @@ sha256_t sha256(std::filesystem::path const &file_path) {
       std::fread(buffer.data(), sizeof(unsigned char), buffer.size(), file.get())
     };
 
-    if (read_bytes > 0) {
-      status =
-          BCryptHashData(hash_handle, buffer.data(), static_cast<ULONG>(read_bytes), 0);
-      if (!BCRYPT_SUCCESS(status)) {
-        throw std::runtime_error("sha256: BCryptHashData failed");
-      }
-    }
+    if (read_bytes > 0) { hasher.update(buffer.data(), read_bytes); }
 
     if (read_bytes < buffer.size()) {
       if (std::ferror(file.get())) { throw std::runtime_error("sha256: fread failed"); }
@@ -64,16 +104,12 @@ sha256_t sha256(std::filesystem::path const &file_path) {
     }
   }
 
-  sha256_t digest{};
-  status =
-      BCryptFinishHash(hash_handle, digest.data(), static_cast<ULONG>(digest.size()), 0);
-  if (!BCRYPT_SUCCESS(status)) {
-    throw std::runtime_error("sha256: BCryptFinishHash failed");
-  }
-
-  return digest;
+  return hasher.finalize();
 }
 
+// CNG picks the CPU's SHA instructions itself.
+char const *sha256_backend_name() { return "bcrypt"; }
+
 void sha256_verify(std::string const &expected_hex, sha256_t const &actual_hash) {
   if (expected_hex.size() != 64) {
     throw std::runtime_error(
@@ -2,8 +2,11 @@
 
 #include "sol/forward.hpp"
 
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <functional>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -15,9 +18,28 @@ namespace envy {
 
 using shell_env_t = std::unordered_map<std::string, std::string>;
 
+// Resources used by a finished command: on POSIX its shell plus every descendant the shell
+// waited for, on Windows the shell process alone. Context switches are POSIX only (0
+// elsewhere). read/write_bytes count bytes moved by read- and write-like calls; disk_*
+// count bytes fetched from or sent to storage (Linux only). Counters the platform does
+// not expose are nullopt.
+struct shell_usage {
+  std::int64_t user_cpu_us{ 0 };
+  std::int64_t sys_cpu_us{ 0 };
+  std::int64_t max_rss_kb{ 0 };
+  std::int64_t voluntary_ctx_switches{ 0 };
+  std::int64_t involuntary_ctx_switches{ 0 };
+  std::optional<std::int64_t> read_bytes;
+  std::optional<std::int64_t> write_bytes;
+  std::optional<std::int64_t> disk_read_bytes;
+  std::optional<std::int64_t> disk_write_bytes;
+};
+
 struct shell_result {
   int exit_code;
   std::optional<int> signal;
+  // nullopt when no process of its own was reaped (launch failure, shell_session scripts)
+  std::optional<shell_usage> usage{};
 };
 
 enum class shell_stream { std_out, std_err };
@@ -57,6 +79,12 @@ struct shell_run_cfg {
   shell_env_t env;
   resolved_shell shell{ shell_resolve_default(nullptr) };
   bool check{ true };
+  // Longer lines reach the callbacks in pieces of this many bytes; 0 means unlimited.
+  // Callers that only log or discard output set kLoggedLineLength so unterminated output
+  // keeps memory bounded; captures keep the default so no line is cut.
+  std::size_t max_line_length{ 0 };
+
+  static constexpr std::size_t kLoggedLineLength{ 1024 * 1024 };
 };
 
 shell_choice shell_parse_choice(std::optional<std::string_view> value);
@@ -73,4 +101,26 @@ void shell_init();
 shell_env_t shell_getenv();
 shell_result shell_run(std::string_view script, shell_run_cfg const &cfg);
 
+// Long-lived shell that runs many scripts without paying process creation and shell
+// startup for each. Every script runs in a fresh subshell of the coprocess, so variables,
+// working directory, options and traps do not carry over, with cfg's environment and cwd
+// applied and fail-fast enabled as in shell_run. Scripts read stdin from /dev/null. The
+// coprocess restarts if a script kills it. Configurations a session cannot host (custom
+// shells, Windows, environment names that are not shell identifiers) go through
+// shell_run. Not thread-safe.
+class shell_session {
+ public:
+  shell_session();
+  ~shell_session();
+
+  shell_session(shell_session const &) = delete;
+  shell_session &operator=(shell_session const &) = delete;
+
+  shell_result run(std::string_view script, shell_run_cfg const &cfg);
+
+ private:
+  struct impl;
+  std::unique_ptr<impl> m;
+};
+
 }  // namespace envy
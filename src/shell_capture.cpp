@@ -0,0 +1,103 @@
+#include "shell_capture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+namespace envy {
+
+namespace {
+
+std::filesystem::path unique_spill_path(std::filesystem::path const &dir) {
+  static thread_local std::mt19937_64 rng{ std::random_device{}() };
+  for (;;) {
+    char name[48];
+    std::snprintf(name,
+                  sizeof(name),
+                  "envy-capture-%016llx.log",
+                  static_cast<unsigned long long>(rng()));
+    auto path{ dir / name };
+    if (!std::filesystem::exists(path)) { return path; }
+  }
+}
+
+}  // namespace
+
+shell_capture::shell_capture(options opts) : opts_{ std::move(opts) } {}
+
+void shell_capture::append_line(std::string_view line) {
+  size_ += line.size() + 1;
+
+  if (!overflowed_) {
+    head_.append(line);
+    head_.push_back('\n');
+    if (head_.size() > opts_.memory_limit) { overflow(); }
+    return;
+  }
+
+  if (spill_.is_open()) {
+    spill_.write(line.data(), static_cast<std::streamsize>(line.size()));
+    spill_.put('\n');
+    if (!spill_) {
+      throw std::runtime_error("shell_capture: failed to write " + spill_path_->string());
+    }
+  }
+
+  // Let the tail grow to twice its size before trimming, so each byte moves O(1) times.
+  tail_.append(line);
+  tail_.push_back('\n');
+  if (tail_.size() > 2 * opts_.excerpt_bytes) {
+    tail_.erase(0, tail_.size() - opts_.excerpt_bytes);
+  }
+}
+
+void shell_capture::overflow() {
+  overflowed_ = true;
+
+  if (opts_.spill_dir) {
+    std::filesystem::create_directories(*opts_.spill_dir);
+    spill_path_ = unique_spill_path(*opts_.spill_dir);
+    spill_.open(*spill_path_, std::ios::binary | std::ios::trunc);
+    spill_.write(head_.data(), static_cast<std::streamsize>(head_.size()));
+    if (!spill_) {
+      throw std::runtime_error("shell_capture: failed to write " + spill_path_->string());
+    }
+  }
+
+  // Head and tail excerpts never overlap, even when memory_limit < 2 * excerpt_bytes.
+  std::size_t const head_keep{ std::min(opts_.excerpt_bytes, head_.size()) };
+  std::size_t const tail_from{ std::max(head_keep,
+                                        head_.size() > opts_.excerpt_bytes
+                                            ? head_.size() - opts_.excerpt_bytes
+                                            : std::size_t{ 0 }) };
+  tail_.assign(head_, tail_from);
+  head_.resize(head_keep);
+  head_.shrink_to_fit();
+}
+
+void shell_capture::finish() {
+  if (!spill_.is_open()) { return; }
+  spill_.close();
+  if (!spill_) {
+    throw std::runtime_error("shell_capture: failed to write " + spill_path_->string());
+  }
+}
+
+std::string shell_capture::excerpt() const {
+  if (!overflowed_) { return head_; }
+
+  std::size_t const tail_keep{ std::min(opts_.excerpt_bytes, tail_.size()) };
+  std::size_t const omitted{ size_ - head_.size() - tail_keep };
+  std::string result{ head_ };
+  if (omitted > 0) {
+    result += "[... " + std::to_string(omitted) + " bytes omitted";
+    if (spill_path_) { result += "; full output in " + spill_path_->string(); }
+    result += " ...]\n";
+  }
+  result.append(tail_, tail_.size() - tail_keep, tail_keep);
+  return result;
+}
+
+}  // namespace envy
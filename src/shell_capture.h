@@ -0,0 +1,62 @@
+#pragma once
+
+#include "util.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace envy {
+
+// Collects one output stream of a shell command with bounded memory. The stream is kept in
+// memory until it exceeds memory_limit; past that the whole stream continues in a spill
+// file under spill_dir (or, with no spill_dir, the middle is dropped), and only the first
+// and last excerpt_bytes stay in memory for error messages.
+class shell_capture : unmovable {
+ public:
+  static constexpr std::size_t kDefaultMemoryLimit{ 16 * 1024 * 1024 };
+  static constexpr std::size_t kDefaultExcerptBytes{ 64 * 1024 };
+
+  struct options {
+    std::size_t memory_limit{ kDefaultMemoryLimit };
+    std::size_t excerpt_bytes{ kDefaultExcerptBytes };
+    std::optional<std::filesystem::path> spill_dir;
+  };
+
+  explicit shell_capture(options opts);
+
+  // Append line plus '\n'. Throws std::runtime_error if the spill file cannot be written.
+  void append_line(std::string_view line);
+
+  // Flush and close the spill file, if any. Call before reading spill_path().
+  void finish();
+
+  std::size_t size() const { return size_; }
+  bool complete_in_memory() const { return !overflowed_; }
+  bool spilled() const { return spill_path_.has_value(); }
+
+  // Entire stream; only valid while complete_in_memory().
+  std::string const &str() const { return head_; }
+
+  // File holding the entire stream once spilled().
+  std::filesystem::path const &spill_path() const { return *spill_path_; }
+
+  // Whole stream if it fit in memory, else head and tail around an omission marker.
+  std::string excerpt() const;
+
+ private:
+  void overflow();
+
+  options opts_;
+  std::string head_;  // Entire stream until overflow, then its first excerpt_bytes
+  std::string tail_;  // Most recent bytes after overflow; trimmed to excerpt_bytes lazily
+  std::size_t size_{ 0 };
+  bool overflowed_{ false };
+  std::optional<std::filesystem::path> spill_path_;
+  std::ofstream spill_;
+};
+
+}  // namespace envy
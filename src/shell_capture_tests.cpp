@@ -0,0 +1,97 @@
+#include "shell_capture.h"
+
+#include "doctest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+
+namespace {
+
+std::filesystem::path make_temp_dir() {
+  static std::mt19937_64 rng{ std::random_device{}() };
+  auto dir{ std::filesystem::temp_directory_path() /
+            ("envy-shell-capture-test-" + std::to_string(rng())) };
+  std::filesystem::create_directories(dir);
+  return dir;
+}
+
+std::string read_file(std::filesystem::path const &path) {
+  std::ifstream in{ path, std::ios::binary };
+  return { std::istreambuf_iterator<char>{ in }, {} };
+}
+
+}  // namespace
+
+TEST_CASE("shell_capture keeps small streams in memory") {
+  envy::shell_capture capture{ { .memory_limit = 64, .excerpt_bytes = 8 } };
+  capture.append_line("one");
+  capture.append_line("");
+  capture.append_line("three");
+  capture.finish();
+  CHECK(capture.complete_in_memory());
+  CHECK_FALSE(capture.spilled());
+  CHECK(capture.str() == "one\n\nthree\n");
+  CHECK(capture.excerpt() == "one\n\nthree\n");
+  CHECK(capture.size() == 11);
+}
+
+TEST_CASE("shell_capture spills the whole stream past the memory limit") {
+  auto const dir{ make_temp_dir() };
+  std::string expected;
+  {
+    envy::shell_capture capture{
+      { .memory_limit = 100, .excerpt_bytes = 16, .spill_dir = dir }
+    };
+    for (int i{ 0 }; i < 1000; ++i) {
+      std::string const line{ "line " + std::to_string(i) };
+      capture.append_line(line);
+      expected += line + '\n';
+    }
+    capture.finish();
+
+    REQUIRE(capture.spilled());
+    CHECK_FALSE(capture.complete_in_memory());
+    CHECK(capture.size() == expected.size());
+    CHECK(capture.spill_path().parent_path() == dir);
+    CHECK(read_file(capture.spill_path()) == expected);
+
+    auto const excerpt{ capture.excerpt() };
+    CHECK(excerpt.starts_with(expected.substr(0, 16)));
+    CHECK(excerpt.ends_with(expected.substr(expected.size() - 16)));
+    CHECK(excerpt.find("bytes omitted; full output in " + capture.spill_path().string()) !=
+          std::string::npos);
+  }
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("shell_capture without a spill dir keeps only head and tail") {
+  envy::shell_capture capture{ { .memory_limit = 10, .excerpt_bytes = 8 } };
+  std::string expected;
+  for (int i{ 0 }; i < 100; ++i) {
+    std::string const line(5, static_cast<char>('a' + i % 26));
+    capture.append_line(line);
+    expected += line + '\n';
+  }
+  capture.finish();
+
+  CHECK_FALSE(capture.spilled());
+  CHECK_FALSE(capture.complete_in_memory());
+  auto const excerpt{ capture.excerpt() };
+  CHECK(excerpt.starts_with(expected.substr(0, 8)));
+  CHECK(excerpt.ends_with(expected.substr(expected.size() - 8)));
+  auto const omitted{ std::to_string(expected.size() - 16) };
+  auto const marker{ "[... " + omitted + " bytes omitted ...]" };
+  CHECK(excerpt.find(marker) != std::string::npos);
+}
+
+TEST_CASE("shell_capture excerpt does not repeat bytes when limits overlap") {
+  // Overflow at 12 bytes with 8-byte excerpts: head and tail must not share bytes.
+  envy::shell_capture capture{ { .memory_limit = 10, .excerpt_bytes = 8 } };
+  capture.append_line("abcdefghijk");  // 12 bytes with '\n'
+  CHECK(capture.excerpt() == "abcdefghijk\n");
+  capture.append_line("z");
+  CHECK(capture.excerpt() == "abcdefghijk\nz\n");
+}
@@ -0,0 +1,68 @@
+#include "shell_line_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace envy {
+
+shell_line_buffer::shell_line_buffer(std::size_t max_line_length)
+    : max_line_{ max_line_length ? max_line_length
+                                 : std::numeric_limits<std::size_t>::max() } {}
+
+std::span<char> shell_line_buffer::prepare() {
+  if (begin_ == end_) { begin_ = scan_ = end_ = 0; }
+
+  if (buf_.size() - end_ < read_size_) {
+    if (begin_ > 0) {  // Slide the partial line to the front
+      std::memmove(buf_.data(), buf_.data() + begin_, end_ - begin_);
+      scan_ -= begin_;
+      end_ -= begin_;
+      begin_ = 0;
+    }
+    if (buf_.size() - end_ < read_size_) { buf_.resize(end_ + read_size_); }
+  }
+
+  last_prepared_ = buf_.size() - end_;
+  return { buf_.data() + end_, last_prepared_ };
+}
+
+void shell_line_buffer::commit(std::size_t n) {
+  end_ += n;
+  if (n == last_prepared_) { read_size_ = std::min(read_size_ * 2, kMaxRead); }
+}
+
+std::optional<std::string_view> shell_line_buffer::next_line() {
+  std::size_t const avail{ end_ - begin_ };
+  if (avail == 0) { return std::nullopt; }
+
+  // A line of exactly max_line_ bytes may still be followed by its newline.
+  bool const overflow{ avail > max_line_ };
+  std::size_t const limit{ overflow ? begin_ + max_line_ + 1 : end_ };
+  if (scan_ < limit) {
+    auto const *const nl{
+      static_cast<char const *>(std::memchr(buf_.data() + scan_, '\n', limit - scan_))
+    };
+    if (nl) {
+      std::size_t const pos{ static_cast<std::size_t>(nl - buf_.data()) };
+      std::string_view const line{ buf_.data() + begin_, pos - begin_ };
+      begin_ = scan_ = pos + 1;
+      return line;
+    }
+    scan_ = limit;
+  }
+
+  if (!overflow) { return std::nullopt; }
+  std::string_view const piece{ buf_.data() + begin_, max_line_ };
+  begin_ = scan_ = begin_ + max_line_;
+  return piece;
+}
+
+std::optional<std::string_view> shell_line_buffer::take_rest() {
+  if (begin_ == end_) { return std::nullopt; }
+  std::string_view const rest{ buf_.data() + begin_, end_ - begin_ };
+  begin_ = scan_ = end_;
+  return rest;
+}
+
+}  // namespace envy
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace envy {
+
+// Splits a child's output stream into lines in a single pass. Reads land directly in
+// the buffer's free tail, each byte is scanned once, and lines are handed out as views
+// into the buffer; the unfinished tail moves to the front only when free space runs out.
+// A line that reaches max_line_length without a newline is delivered in pieces of that
+// length, so unterminated output (progress bars, minified files) keeps memory bounded.
+class shell_line_buffer {
+ public:
+  static constexpr std::size_t kMinRead{ 64 * 1024 };
+  static constexpr std::size_t kMaxRead{ 1024 * 1024 };
+
+  // 0 disables the limit.
+  explicit shell_line_buffer(std::size_t max_line_length);
+
+  // Free space for the next read. Grows toward kMaxRead while reads keep filling it.
+  std::span<char> prepare();
+
+  // Account for n bytes written into the span returned by prepare().
+  void commit(std::size_t n);
+
+  // Next complete line (without '\n'), or the next max_line_length piece of an overlong
+  // one. Views stay valid until the next prepare().
+  std::optional<std::string_view> next_line();
+
+  // Whatever is left after the last newline, once the stream has ended.
+  std::optional<std::string_view> take_rest();
+
+ private:
+  std::vector<char> buf_;
+  std::size_t begin_{ 0 };  // First undelivered byte
+  std::size_t scan_{ 0 };   // First byte not yet searched for '\n'
+  std::size_t end_{ 0 };    // End of data
+  std::size_t max_line_;
+  std::size_t read_size_{ kMinRead };
+  std::size_t last_prepared_{ 0 };
+};
+
+}  // namespace envy
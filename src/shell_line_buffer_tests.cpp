@@ -0,0 +1,84 @@
+#include "shell_line_buffer.h"
+
+#include "doctest.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// Feed `input` in reads of at most `read_size` bytes; collect every delivered line.
+std::vector<std::string> split(std::string_view input,
+                               std::size_t max_line_length,
+                               std::size_t read_size) {
+  envy::shell_line_buffer buffer{ max_line_length };
+  std::vector<std::string> lines;
+  while (!input.empty()) {
+    auto const space{ buffer.prepare() };
+    std::size_t const n{ std::min({ space.size(), read_size, input.size() }) };
+    std::memcpy(space.data(), input.data(), n);
+    input.remove_prefix(n);
+    buffer.commit(n);
+    while (auto const line{ buffer.next_line() }) { lines.emplace_back(*line); }
+  }
+  if (auto const rest{ buffer.take_rest() }) { lines.emplace_back(*rest); }
+  return lines;
+}
+
+}  // namespace
+
+TEST_CASE("shell_line_buffer splits lines regardless of read boundaries") {
+  std::string const input{ "alpha\n\nbeta\r\ngamma" };
+  std::vector<std::string> const expected{ "alpha", "", "beta\r", "gamma" };
+  for (std::size_t read_size : { 1, 2, 3, 7, 4096 }) {
+    CAPTURE(read_size);
+    CHECK(split(input, 0, read_size) == expected);
+  }
+}
+
+TEST_CASE("shell_line_buffer delivers overlong lines in max_line_length pieces") {
+  CHECK(split("abcdefghij\nxy\n", 4, 3) ==
+        std::vector<std::string>{ "abcd", "efgh", "ij", "xy" });
+
+  // Exactly max_line_length bytes followed by the newline is one line, not two.
+  CHECK(split("abcd\nefgh", 4, 1) == std::vector<std::string>{ "abcd", "efgh" });
+  CHECK(split("abcd\nefgh", 4, 100) == std::vector<std::string>{ "abcd", "efgh" });
+}
+
+TEST_CASE("shell_line_buffer memory stays bounded for unterminated output") {
+  envy::shell_line_buffer buffer{ 1024 };
+  std::size_t delivered{ 0 };
+  std::size_t largest_read{ 0 };
+  for (int i{ 0 }; i < 4096; ++i) {
+    auto const space{ buffer.prepare() };
+    largest_read = std::max(largest_read, space.size());
+    std::memset(space.data(), 'x', space.size());
+    buffer.commit(space.size());
+    while (auto const piece{ buffer.next_line() }) {
+      CHECK(piece->size() == 1024);
+      delivered += piece->size();
+    }
+  }
+  CHECK(delivered > 0);
+  CHECK(largest_read <= envy::shell_line_buffer::kMaxRead + 1024);
+}
+
+TEST_CASE("shell_line_buffer grows reads while they keep filling the buffer") {
+  envy::shell_line_buffer buffer{ 0 };
+  auto space{ buffer.prepare() };
+  CHECK(space.size() == envy::shell_line_buffer::kMinRead);
+  buffer.commit(space.size());
+  buffer.take_rest();
+  space = buffer.prepare();
+  CHECK(space.size() >= 2 * envy::shell_line_buffer::kMinRead);
+
+  for (int i{ 0 }; i < 10; ++i) {
+    buffer.commit(space.size());
+    buffer.take_rest();
+    space = buffer.prepare();
+  }
+  CHECK(space.size() == envy::shell_line_buffer::kMaxRead);
+}
@@ -4,17 +4,23 @@
 
 #include "shell.h"
 
+#include "shell_line_buffer.h"
 #include "util.h"
 
+#include <algorithm>
 #include <array>
+#include <cctype>
 #include <cerrno>
+#include <charconv>
 #include <csignal>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <memory>
 #include <optional>
+#include <random>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -24,11 +30,24 @@
 
 #include <fcntl.h>
 #include <poll.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+// posix_spawn_file_actions_addchdir_np: glibc 2.29+, macOS 10.15+. Elsewhere runs with a
+// working directory fall back to fork.
+#if defined(__APPLE__) || \
+    (defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29)))
+#define ENVY_SPAWN_ADDCHDIR 1
+#endif
+
 extern char **environ;
 
 namespace envy {
@@ -104,7 +123,62 @@ void write_all(int fd, char const *data, size_t size) {
   }
 }
 
-std::string create_temp_script(std::string_view script) {
+// Close-on-exec so children spawned concurrently by other threads do not inherit the
+// write ends and hold the pipe open past this child's exit.
+std::pair<fd_cleanup, fd_cleanup> make_pipe() {
+  int fds[2];
+#if defined(__linux__)
+  if (::pipe2(fds, O_CLOEXEC) == -1) {
+    throw std::system_error(errno, std::generic_category(), "pipe failed");
+  }
+#else
+  if (::pipe(fds) == -1) {
+    throw std::system_error(errno, std::generic_category(), "pipe failed");
+  }
+  ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+#if defined(F_SETPIPE_SZ)
+  // Best effort: a bigger pipe lets chatty children write ahead of the reader. Capped by
+  // /proc/sys/fs/pipe-max-size, 1 MiB by default.
+  ::fcntl(fds[0], F_SETPIPE_SZ, static_cast<int>(shell_line_buffer::kMaxRead));
+#endif
+  return { fd_cleanup{ fds[0] }, fd_cleanup{ fds[1] } };
+}
+
+// Where the child reads its script from. On Linux, built-in shells read an anonymous
+// memfd through the parent's /proc entry, so a command creates, syncs and unlinks no file.
+// Everything else gets a temp file. Neither is fsynced: the script is discarded when the
+// command ends, so a per-command journal commit bought nothing.
+struct script_file {
+  std::string path;
+  fd_cleanup memfd{ -1 };  // Must stay open until the child exits
+  std::unique_ptr<scoped_path_cleanup> cleanup;
+};
+
+std::string script_content(std::string_view script) {
+  std::string content{ script };
+  if (!content.empty() && content.back() != '\n') { content.push_back('\n'); }
+  return content;
+}
+
+std::optional<script_file> create_memfd_script(std::string_view script) {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+  int const fd{ ::memfd_create("envy-shell", MFD_CLOEXEC) };
+  if (fd == -1) { return std::nullopt; }  // ENOSYS or filtered: use a temp file
+  script_file result{ .path = "/proc/" + std::to_string(::getpid()) + "/fd/" +
+                              std::to_string(fd),
+                      .memfd = fd_cleanup{ fd } };
+  auto const content{ script_content(script) };
+  write_all(fd, content.data(), content.size());
+  return result;
+#else
+  (void)script;
+  return std::nullopt;
+#endif
+}
+
+script_file create_temp_script(std::string_view script) {
   auto tmp_dir{ std::filesystem::temp_directory_path() };
   std::string pattern{ (tmp_dir / "envy-shell-XXXXXX").string() };
 
@@ -116,60 +190,120 @@ std::string create_temp_script(std::string_view script) {
     throw std::system_error(errno, std::generic_category(), "mkstemp failed");
   }
   fd_cleanup fd_guard{ fd };
+  script_file result{ .path = path_buffer.data() };
+  result.cleanup =
+      std::make_unique<scoped_path_cleanup>(std::filesystem::path{ result.path });
 
-  std::string content{ script };
-  if (!content.empty() && content.back() != '\n') { content.push_back('\n'); }
-
+  auto const content{ script_content(script) };
   write_all(fd_guard.get(), content.data(), content.size());
 
   if (::fchmod(fd_guard.get(), S_IRUSR | S_IWUSR | S_IXUSR) == -1) {
     throw std::system_error(errno, std::generic_category(), "fchmod failed");
   }
-
-  if (::fsync(fd_guard.get()) == -1) {
-    throw std::system_error(errno, std::generic_category(), "fsync failed");
-  }
-
-  return std::string{ path_buffer.data() };
+  return result;
 }
 
 struct pipe_state {
   fd_cleanup read_fd;
   shell_stream stream;
-  std::string pending;
+  shell_line_buffer lines;
   bool closed;
 };
 
-void stream_pipes(std::array<pipe_state, 2> &pipes, shell_run_cfg const &cfg) {
-  std::array<pollfd, 2> poll_fds{};
-  std::string chunk(4096, '\0');
-  size_t closed_count{ 0 };
-
-  for (size_t i{ 0 }; i < pipes.size(); ++i) {
-    poll_fds[i].fd = pipes[i].closed ? -1 : pipes[i].read_fd.get();
-    poll_fds[i].events = pipes[i].closed ? 0 : POLLIN;
-    poll_fds[i].revents = 0;
+void deliver_line(std::string_view line, shell_stream stream, shell_run_cfg const &cfg) {
+  if (stream == shell_stream::std_out) {
+    if (cfg.on_stdout_line) { cfg.on_stdout_line(line); }
+  } else {
+    if (cfg.on_stderr_line) { cfg.on_stderr_line(line); }
   }
+  if (cfg.on_output_line) { cfg.on_output_line(line); }
+}
 
-  while (closed_count < pipes.size()) {
-    int const poll_result{ ::poll(poll_fds.data(), poll_fds.size(), -1) };
-    if (poll_result == -1) {
-      if (errno == EINTR) { continue; }
-      throw std::system_error(errno, std::generic_category(), "poll failed");
+// Waits for either output pipe to become readable: epoll on Linux, poll elsewhere.
+class pipe_waiter : unmovable {
+ public:
+  explicit pipe_waiter(std::array<pipe_state, 2> const &pipes) {
+#if defined(__linux__)
+    epoll_fd_ = fd_cleanup{ ::epoll_create1(EPOLL_CLOEXEC) };
+    if (epoll_fd_.get() == -1) {
+      throw std::system_error(errno, std::generic_category(), "epoll_create1 failed");
     }
-
+    for (std::uint32_t i{ 0 }; i < pipes.size(); ++i) {
+      epoll_event ev{ .events = EPOLLIN, .data = { .u32 = i } };
+      if (::epoll_ctl(epoll_fd_.get(), EPOLL_CTL_ADD, pipes[i].read_fd.get(), &ev) == -1) {
+        throw std::system_error(errno, std::generic_category(), "epoll_ctl failed");
+      }
+    }
+#else
     for (size_t i{ 0 }; i < pipes.size(); ++i) {
-      if (pipes[i].closed) { continue; }
+      poll_fds_[i] = { .fd = pipes[i].read_fd.get(), .events = POLLIN, .revents = 0 };
+    }
+#endif
+  }
 
-      short const revents{ poll_fds[i].revents };
-      if (revents == 0) { continue; }
-      if (revents & (POLLERR | POLLNVAL)) {
+  // Indices of readable (or hung-up) pipes.
+  std::array<bool, 2> wait() {
+    std::array<bool, 2> ready{};
+#if defined(__linux__)
+    std::array<epoll_event, 2> events{};
+    int n{ -1 };
+    while ((n = ::epoll_wait(epoll_fd_.get(), events.data(), events.size(), -1)) == -1) {
+      if (errno != EINTR) {
+        throw std::system_error(errno, std::generic_category(), "epoll_wait failed");
+      }
+    }
+    for (int i{ 0 }; i < n; ++i) {
+      if ((events[i].events & (EPOLLERR | EPOLLHUP | EPOLLIN)) == EPOLLERR) {
+        throw std::runtime_error("epoll failed on child pipe");
+      }
+      ready[events[i].data.u32] = true;
+    }
+#else
+    while (::poll(poll_fds_.data(), poll_fds_.size(), -1) == -1) {
+      if (errno != EINTR) {
+        throw std::system_error(errno, std::generic_category(), "poll failed");
+      }
+    }
+    for (size_t i{ 0 }; i < poll_fds_.size(); ++i) {
+      if (poll_fds_[i].revents & (POLLERR | POLLNVAL)) {
         throw std::runtime_error("poll failed on child pipe");
       }
+      ready[i] = poll_fds_[i].revents != 0;
+    }
+#endif
+    return ready;
+  }
+
+  void remove(std::array<pipe_state, 2> const &pipes, size_t i) {
+#if defined(__linux__)
+    ::epoll_ctl(epoll_fd_.get(), EPOLL_CTL_DEL, pipes[i].read_fd.get(), nullptr);
+#else
+    (void)pipes;
+    poll_fds_[i] = { .fd = -1, .events = 0, .revents = 0 };
+#endif
+  }
+
+ private:
+#if defined(__linux__)
+  fd_cleanup epoll_fd_{ -1 };
+#else
+  std::array<pollfd, 2> poll_fds_{};
+#endif
+};
+
+void stream_pipes(std::array<pipe_state, 2> &pipes, shell_run_cfg const &cfg) {
+  pipe_waiter waiter{ pipes };
+  size_t closed_count{ 0 };
 
-      ssize_t const read_bytes{
-        ::read(pipes[i].read_fd.get(), chunk.data(), chunk.size())
-      };
+  while (closed_count < pipes.size()) {
+    auto const ready{ waiter.wait() };
+
+    for (size_t i{ 0 }; i < pipes.size(); ++i) {
+      auto &pipe{ pipes[i] };
+      if (pipe.closed || !ready[i]) { continue; }
+
+      auto const space{ pipe.lines.prepare() };
+      ssize_t const read_bytes{ ::read(pipe.read_fd.get(), space.data(), space.size()) };
 
       if (read_bytes == -1) {
         if (errno == EINTR) { continue; }
@@ -177,118 +311,268 @@ void stream_pipes(std::array<pipe_state, 2> &pipes, shell_run_cfg const &cfg) {
       }
 
       if (read_bytes == 0) {
-        if (!pipes[i].pending.empty()) {
-          if (pipes[i].stream == shell_stream::std_out) {
-            if (cfg.on_stdout_line) { cfg.on_stdout_line(pipes[i].pending); }
-          } else {
-            if (cfg.on_stderr_line) { cfg.on_stderr_line(pipes[i].pending); }
-          }
-          if (cfg.on_output_line) { cfg.on_output_line(pipes[i].pending); }
-          pipes[i].pending.clear();
+        if (auto const rest{ pipe.lines.take_rest() }) {
+          deliver_line(*rest, pipe.stream, cfg);
         }
-
-        pipes[i].closed = true;
+        pipe.closed = true;
         ++closed_count;
-
-        poll_fds[i].fd = -1;
-        poll_fds[i].events = 0;
-        poll_fds[i].revents = 0;
+        waiter.remove(pipes, i);
         continue;
       }
 
-      pipes[i].pending.append(chunk.data(), static_cast<size_t>(read_bytes));
-
-      size_t newline{ 0 };
-      while ((newline = pipes[i].pending.find('\n')) != std::string::npos) {
-        std::string line{ pipes[i].pending.substr(0, newline) };
-        if (pipes[i].stream == shell_stream::std_out) {
-          if (cfg.on_stdout_line) { cfg.on_stdout_line(line); }
-        } else {
-          if (cfg.on_stderr_line) { cfg.on_stderr_line(line); }
-        }
-        if (cfg.on_output_line) { cfg.on_output_line(line); }
-        pipes[i].pending.erase(0, newline + 1);
+      pipe.lines.commit(static_cast<size_t>(read_bytes));
+      while (auto const line{ pipe.lines.next_line() }) {
+        deliver_line(*line, pipe.stream, cfg);
       }
     }
   }
 }
 
+#if defined(__linux__)
+// Counters of an exited child that has not been reaped yet. By then the kernel has
+// folded in the counters of every descendant the child itself reaped. Leaves usage
+// untouched where procfs is missing or denies access.
+void read_proc_io(pid_t pid, shell_usage &usage) {
+  char path[32];
+  std::snprintf(path, sizeof(path), "/proc/%d/io", static_cast<int>(pid));
+  fd_cleanup const fd{ ::open(path, O_RDONLY | O_CLOEXEC) };
+  if (fd.get() == -1) { return; }
+
+  char buf[512];
+  ssize_t n{ -1 };
+  while ((n = ::read(fd.get(), buf, sizeof(buf))) == -1 && errno == EINTR) {}
+  if (n <= 0) { return; }
+
+  std::string_view text{ buf, static_cast<size_t>(n) };
+  while (!text.empty()) {
+    auto const eol{ std::min(text.find('\n'), text.size()) };
+    auto const line{ text.substr(0, eol) };
+    text.remove_prefix(std::min(eol + 1, text.size()));
+
+    auto const colon{ line.find(": ") };
+    if (colon == std::string_view::npos) { continue; }
+    auto const key{ line.substr(0, colon) };
+    auto const digits{ line.substr(colon + 2) };
+    std::int64_t value{ 0 };
+    if (std::from_chars(digits.data(), digits.data() + digits.size(), value).ec !=
+        std::errc{}) {
+      continue;
+    }
+
+    if (key == "rchar") {
+      usage.read_bytes = value;
+    } else if (key == "wchar") {
+      usage.write_bytes = value;
+    } else if (key == "read_bytes") {
+      usage.disk_read_bytes = value;
+    } else if (key == "write_bytes") {
+      usage.disk_write_bytes = value;
+    }
+  }
+}
+#endif
+
+std::int64_t timeval_us(timeval const &tv) {
+  return static_cast<std::int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+// Reap child and collect what it and the descendants it waited for consumed.
 shell_result wait_for_child(pid_t child) {
+  shell_usage usage;
+
+#if defined(__linux__)
+  // Wait without reaping first: /proc/<pid>/io disappears with the zombie.
+  siginfo_t info{};
+  while (::waitid(P_PID, static_cast<id_t>(child), &info, WEXITED | WNOWAIT) == -1) {
+    if (errno != EINTR) {
+      throw std::system_error(errno, std::generic_category(), "waitid failed");
+    }
+  }
+  read_proc_io(child, usage);
+#endif
+
   int status{ 0 };
+  rusage ru{};
   while (true) {
-    pid_t const result = ::waitpid(child, &status, 0);
+    pid_t const result = ::wait4(child, &status, 0, &ru);
     if (result == -1 && errno == EINTR) { continue; }
     if (result == -1) {
-      throw std::system_error(errno, std::generic_category(), "waitpid failed");
+      throw std::system_error(errno, std::generic_category(), "wait4 failed");
     }
     break;
   }
 
+  usage.user_cpu_us = timeval_us(ru.ru_utime);
+  usage.sys_cpu_us = timeval_us(ru.ru_stime);
+#if defined(__APPLE__)
+  usage.max_rss_kb = static_cast<std::int64_t>(ru.ru_maxrss) / 1024;  // bytes on macOS
+#else
+  usage.max_rss_kb = static_cast<std::int64_t>(ru.ru_maxrss);
+#endif
+  usage.voluntary_ctx_switches = static_cast<std::int64_t>(ru.ru_nvcsw);
+  usage.involuntary_ctx_switches = static_cast<std::int64_t>(ru.ru_nivcsw);
+
   if (WIFEXITED(status)) {
-    return { .exit_code = WEXITSTATUS(status), .signal = std::nullopt };
+    return { .exit_code = WEXITSTATUS(status), .signal = std::nullopt, .usage = usage };
   }
 
   if (WIFSIGNALED(status)) {
     int const sig{ WTERMSIG(status) };
-    return { .exit_code = kSignalExitBase + sig, .signal = sig };
+    return { .exit_code = kSignalExitBase + sig, .signal = sig, .usage = usage };
   }
 
-  return { .exit_code = status, .signal = std::nullopt };
+  return { .exit_code = status, .signal = std::nullopt, .usage = usage };
+}
+
+std::vector<char *> make_argv(std::vector<std::string> const &argv_strings) {
+  std::vector<char *> argv;
+  argv.reserve(argv_strings.size() + 1);
+  for (auto const &arg : argv_strings) { argv.push_back(const_cast<char *>(arg.c_str())); }
+  argv.push_back(nullptr);
+  return argv;
 }
 
-[[noreturn]] void exec_child_process(fd_cleanup &stdout_read,
-                                     fd_cleanup &stdout_write,
-                                     fd_cleanup &stderr_read,
-                                     fd_cleanup &stderr_write,
-                                     std::optional<std::filesystem::path> const &cwd,
-                                     std::vector<std::string> const &argv_strings,
-                                     std::vector<char *> const &envp) {
-  stdout_read.release();
-  stderr_read.release();
-
-  int const null_fd{ ::open("/dev/null", O_RDONLY) };
-  std::array<std::pair<int, int>, 3> const fd_mappings{
-    std::pair{ null_fd, STDIN_FILENO },
-    std::pair{ stdout_write.get(), STDOUT_FILENO },
-    std::pair{ stderr_write.get(), STDERR_FILENO },
-  };
-
-  if (null_fd == -1) {
-    std::perror("open /dev/null");
+#if !defined(ENVY_SPAWN_ADDCHDIR)
+// Only reached between fork and exec: async-signal-safe calls only.
+[[noreturn]] void exec_child_process(int stdin_read,
+                                     int stdout_write,
+                                     int stderr_write,
+                                     char const *cwd,
+                                     char *const *argv,
+                                     char *const *envp) {
+  int const in_fd{ stdin_read != -1 ? stdin_read : ::open("/dev/null", O_RDONLY) };
+  if (in_fd == -1 || ::dup2(in_fd, STDIN_FILENO) == -1 ||
+      ::dup2(stdout_write, STDOUT_FILENO) == -1 ||
+      ::dup2(stderr_write, STDERR_FILENO) == -1) {
     _exit(kChildErrorExit);
   }
+  if (cwd && ::chdir(cwd) == -1) { _exit(kChildErrorExit); }
+  for (int const sig : { SIGPIPE, SIGINT, SIGTERM }) { ::signal(sig, SIG_DFL); }
+  sigset_t none;
+  sigemptyset(&none);
+  ::sigprocmask(SIG_SETMASK, &none, nullptr);
+  ::execve(argv[0], argv, envp);
+  _exit(kChildErrorExit);
+}
+#endif
 
-  for (auto const &[src, dst] : fd_mappings) {
-    if (::dup2(src, dst) == -1) {
-      std::perror("dup2");
-      _exit(kChildErrorExit);
+class spawn_file_actions : unmovable {
+ public:
+  spawn_file_actions() { check(::posix_spawn_file_actions_init(&actions_), "init"); }
+  ~spawn_file_actions() { ::posix_spawn_file_actions_destroy(&actions_); }
+
+  static void check(int rc, char const *what) {
+    if (rc != 0) {
+      throw std::system_error(rc,
+                              std::generic_category(),
+                              std::string{ "posix_spawn_file_actions_" } + what);
     }
   }
 
-  if (null_fd != STDIN_FILENO) { ::close(null_fd); }
-  stdout_write.release();
-  stderr_write.release();
+  posix_spawn_file_actions_t actions_;
+};
 
-  if (cwd) {
-    if (::chdir(cwd->c_str()) == -1) {
-      std::perror("chdir");
-      _exit(kChildErrorExit);
+class spawn_attributes : unmovable {
+ public:
+  spawn_attributes() { check(::posix_spawnattr_init(&attr_), "init"); }
+  ~spawn_attributes() { ::posix_spawnattr_destroy(&attr_); }
+
+  static void check(int rc, char const *what) {
+    if (rc != 0) {
+      throw std::system_error(rc,
+                              std::generic_category(),
+                              std::string{ "posix_spawnattr_" } + what);
     }
   }
 
+  posix_spawnattr_t attr_;
+};
+
+struct spawn_result {
+  pid_t pid;
+  int error;  // errno when the child could not be started (bad cwd, missing executable)
+};
+
+// Start argv with stdout/stderr on the pipes and stdin on stdin_read, or /dev/null when
+// it is -1.
+//
+// posix_spawn runs the child on the parent's address space until exec (CLONE_VFORK on
+// glibc, a kernel spawn on macOS), so launch cost does not grow with the parent's
+// mappings and page tables the way fork's does, and no user code runs in the child.
+spawn_result spawn_child(std::vector<std::string> const &argv_strings,
+                         std::vector<char *> const &envp,
+                         std::optional<std::filesystem::path> const &cwd,
+                         int stdout_write,
+                         int stderr_write,
+                         int stdin_read = -1) {
   if (argv_strings.empty()) {
-    std::fprintf(stderr, "exec_child_process: argv must be non-empty\n");
-    _exit(kChildErrorExit);
+    throw std::invalid_argument("shell_run: argv must be non-empty");
   }
+  auto const argv{ make_argv(argv_strings) };
+  auto *const envp_ptr{ const_cast<char *const *>(envp.data()) };
 
-  std::vector<char *> argv;
-  argv.reserve(argv_strings.size() + 1);
-  for (auto const &arg : argv_strings) { argv.push_back(const_cast<char *>(arg.c_str())); }
-  argv.push_back(nullptr);
-
-  ::execve(argv_strings[0].c_str(), argv.data(), const_cast<char **>(envp.data()));
-  std::perror("execve");
-  _exit(kChildErrorExit);
+#if !defined(ENVY_SPAWN_ADDCHDIR)
+  if (cwd) {
+    std::string const cwd_str{ cwd->string() };
+    if (::access(cwd_str.c_str(), X_OK) == -1) { return { .pid = -1, .error = errno }; }
+    pid_t const child{ ::fork() };
+    if (child == -1) {
+      throw std::system_error(errno, std::generic_category(), "fork failed");
+    }
+    if (child == 0) {
+      exec_child_process(stdin_read,
+                         stdout_write,
+                         stderr_write,
+                         cwd_str.c_str(),
+                         argv.data(),
+                         envp_ptr);
+    }
+    return { .pid = child, .error = 0 };
+  }
+#endif
+
+  spawn_file_actions actions;
+  auto *const fa{ &actions.actions_ };
+  if (stdin_read != -1) {
+    spawn_file_actions::check(
+        ::posix_spawn_file_actions_adddup2(fa, stdin_read, STDIN_FILENO),
+        "adddup2");
+  } else {
+    spawn_file_actions::check(
+        ::posix_spawn_file_actions_addopen(fa, STDIN_FILENO, "/dev/null", O_RDONLY, 0),
+        "addopen");
+  }
+  spawn_file_actions::check(
+      ::posix_spawn_file_actions_adddup2(fa, stdout_write, STDOUT_FILENO),
+      "adddup2");
+  spawn_file_actions::check(
+      ::posix_spawn_file_actions_adddup2(fa, stderr_write, STDERR_FILENO),
+      "adddup2");
+#if defined(ENVY_SPAWN_ADDCHDIR)
+  if (cwd) {
+    spawn_file_actions::check(
+        ::posix_spawn_file_actions_addchdir_np(fa, cwd->c_str()),
+        "addchdir_np");
+  }
+#endif
+
+  // envy ignores SIGPIPE and handles SIGINT/SIGTERM; the child starts from defaults with
+  // nothing blocked, as it would from a login shell.
+  spawn_attributes attributes;
+  auto *const attr{ &attributes.attr_ };
+  sigset_t all;
+  sigset_t none;
+  sigfillset(&all);
+  sigemptyset(&none);
+  spawn_attributes::check(::posix_spawnattr_setsigdefault(attr, &all), "setsigdefault");
+  spawn_attributes::check(::posix_spawnattr_setsigmask(attr, &none), "setsigmask");
+  spawn_attributes::check(
+      ::posix_spawnattr_setflags(attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK),
+      "setflags");
+
+  pid_t child{ -1 };
+  int const rc{ ::posix_spawn(&child, argv[0], fa, attr, argv.data(), envp_ptr) };
+  return { .pid = rc == 0 ? child : -1, .error = rc };
 }
 
 }  // namespace
@@ -317,13 +601,15 @@ shell_result shell_run(std::string_view script, shell_run_cfg const &cfg) {
   // Determine if we need a script file or pass inline
   bool const is_inline{ std::holds_alternative<custom_shell_inline>(cfg.shell) };
 
-  std::string script_path{};
-  std::unique_ptr<scoped_path_cleanup> cleanup;
-
+  // Custom file-mode interpreters may expect a real path on disk; built-in shells do not.
+  script_file script_source;
   if (!is_inline) {
-    script_path = create_temp_script(script);
-    cleanup = std::make_unique<scoped_path_cleanup>(std::filesystem::path{ script_path });
+    auto memfd{ std::holds_alternative<shell_choice>(cfg.shell)
+                    ? create_memfd_script(script)
+                    : std::nullopt };
+    script_source = memfd ? std::move(*memfd) : create_temp_script(script);
   }
+  std::string const &script_path{ script_source.path };
 
   // Build argv based on shell type
   std::vector<std::string> argv_strings{ std::visit(
@@ -361,35 +647,25 @@ shell_result shell_run(std::string_view script, shell_run_cfg const &cfg) {
     return std::pair{ std::move(strings), std::move(pointers) };
   }() };
 
-  int stdout_pipefd[2];
-  if (::pipe(stdout_pipefd) == -1) {
-    throw std::system_error(errno, std::generic_category(), "pipe failed");
-  }
-
-  int stderr_pipefd[2];
-  if (::pipe(stderr_pipefd) == -1) {
-    throw std::system_error(errno, std::generic_category(), "pipe failed");
-  }
-
-  fd_cleanup stdout_read_end{ stdout_pipefd[0] };
-  fd_cleanup stdout_write_end{ stdout_pipefd[1] };
-  fd_cleanup stderr_read_end{ stderr_pipefd[0] };
-  fd_cleanup stderr_write_end{ stderr_pipefd[1] };
-
-  pid_t const child{ ::fork() };
-  if (child == -1) {
-    throw std::system_error(errno, std::generic_category(), "fork failed");
-  }
-
-  if (child == 0) {  // child process exits in exec_child_process
-    exec_child_process(stdout_read_end,
-                       stdout_write_end,
-                       stderr_read_end,
-                       stderr_write_end,
-                       cfg.cwd,
-                       argv_strings,
-                       envp);
+  auto [stdout_read_end, stdout_write_end]{ make_pipe() };
+  auto [stderr_read_end, stderr_write_end]{ make_pipe() };
+
+  auto const spawned{ spawn_child(argv_strings,
+                                  envp,
+                                  cfg.cwd,
+                                  stdout_write_end.get(),
+                                  stderr_write_end.get()) };
+  if (spawned.error != 0) {
+    // Report like a shell that could not start the command: message on stderr, 127.
+    std::string line{ argv_strings[0] };
+    if (cfg.cwd) { line += " (in " + cfg.cwd->string() + ")"; }
+    line += ": ";
+    line += std::strerror(spawned.error);
+    if (cfg.on_stderr_line) { cfg.on_stderr_line(line); }
+    if (cfg.on_output_line) { cfg.on_output_line(line); }
+    return { .exit_code = kChildErrorExit, .signal = std::nullopt };
   }
+  pid_t const child{ spawned.pid };
 
   stdout_write_end.release();  // Parent: close write ends and stream output
   stderr_write_end.release();
@@ -397,8 +673,14 @@ shell_result shell_run(std::string_view script, shell_run_cfg const &cfg) {
   shell_result result;
   try {
     std::array<pipe_state, 2> pipes{
-      pipe_state{ std::move(stdout_read_end), shell_stream::std_out, {}, false },
-      pipe_state{ std::move(stderr_read_end), shell_stream::std_err, {}, false },
+      pipe_state{ std::move(stdout_read_end),
+                  shell_stream::std_out,
+                  shell_line_buffer{ cfg.max_line_length },
+                  false },
+      pipe_state{ std::move(stderr_read_end),
+                  shell_stream::std_err,
+                  shell_line_buffer{ cfg.max_line_length },
+                  false },
     };
 
     stream_pipes(pipes, cfg);
@@ -412,6 +694,244 @@ shell_result shell_run(std::string_view script, shell_run_cfg const &cfg) {
   return result;
 }
 
+namespace {
+
+bool is_shell_identifier(std::string_view name) {
+  if (name.empty() || std::isdigit(static_cast<unsigned char>(name.front()))) {
+    return false;
+  }
+  return std::all_of(name.begin(), name.end(), [](char c) {
+    return c == '_' || std::isalnum(static_cast<unsigned char>(c));
+  });
+}
+
+std::string shell_quote(std::string_view value) {
+  std::string quoted{ "'" };
+  for (char const c : value) {
+    if (c == '\'') {
+      quoted += "'\\''";
+    } else {
+      quoted.push_back(c);
+    }
+  }
+  quoted.push_back('\'');
+  return quoted;
+}
+
+std::string make_sentinel() {
+  std::random_device rd;
+  std::string sentinel{ "__envy_session_" };
+  for (int i{ 0 }; i < 4; ++i) {
+    char hex[9];
+    std::snprintf(hex, sizeof(hex), "%08x", static_cast<unsigned>(rd()));
+    sentinel += hex;
+  }
+  return sentinel;
+}
+
+}  // namespace
+
+struct shell_session::impl {
+  pid_t pid{ -1 };
+  shell_choice shell{ shell_choice::bash };
+  shell_env_t env;  // Environment the coprocess started with
+  std::string sentinel;
+  fd_cleanup control{ -1 };
+  std::optional<std::array<pipe_state, 2>> pipes;
+
+  bool running() const { return pid != -1; }
+
+  void start(shell_choice choice, shell_run_cfg const &cfg) {
+    auto [control_read, control_write]{ make_pipe() };
+    auto [stdout_read, stdout_write]{ make_pipe() };
+    auto [stderr_read, stderr_write]{ make_pipe() };
+
+    auto argv_strings{ get_shell_argv(choice) };
+    argv_strings.pop_back();  // No -e: fail-fast is set per script, inside its subshell
+
+    std::vector<std::string> env_strings;
+    std::vector<char *> envp;
+    for (auto const &[key, value] : cfg.env) { env_strings.push_back(key + "=" + value); }
+    for (auto &entry : env_strings) { envp.push_back(entry.data()); }
+    envp.push_back(nullptr);
+
+    auto const spawned{ spawn_child(argv_strings,
+                                    envp,
+                                    std::nullopt,
+                                    stdout_write.get(),
+                                    stderr_write.get(),
+                                    control_read.get()) };
+    if (spawned.error != 0) {
+      throw std::system_error(spawned.error,
+                              std::generic_category(),
+                              "shell_session: failed to start " + argv_strings[0]);
+    }
+
+    pid = spawned.pid;
+    shell = choice;
+    env = cfg.env;
+    sentinel = make_sentinel();
+    control = std::move(control_write);
+    // Unlimited buffers: a sentinel glued to unterminated output must never be cut in
+    // two. stream_until_sentinel applies cfg.max_line_length when delivering instead.
+    pipes.emplace(std::array<pipe_state, 2>{
+        pipe_state{ std::move(stdout_read),
+                    shell_stream::std_out,
+                    shell_line_buffer{ 0 },
+                    false },
+        pipe_state{ std::move(stderr_read),
+                    shell_stream::std_err,
+                    shell_line_buffer{ 0 },
+                    false },
+    });
+  }
+
+  // Closing the control pipe ends the shell at its next read; the kill covers a shell
+  // that is stuck writing output nobody will read any more.
+  shell_result stop(bool force) {
+    control.release();
+    pipes.reset();
+    if (force) { ::kill(pid, SIGKILL); }
+    auto const result{ wait_for_child(pid) };
+    pid = -1;
+    return result;
+  }
+
+  // The script runs from a file in a subshell, so `exit`, `cd` and exports stay local to
+  // it. Only the differences from the coprocess's own environment are applied.
+  std::string frame(std::string const &script_path, shell_run_cfg const &cfg) const {
+    std::string text{ "(\n" };
+    for (auto const &[key, value] : env) {
+      if (!cfg.env.contains(key)) { text += "unset -v " + key + " 2>/dev/null\n"; }
+    }
+    for (auto const &[key, value] : cfg.env) {
+      auto const it{ env.find(key) };
+      if (it == env.end() || it->second != value) {
+        text += "export " + key + "=" + shell_quote(value) + "\n";
+      }
+    }
+    if (cfg.cwd) { text += "cd -- " + shell_quote(cfg.cwd->string()) + " || exit 127\n"; }
+    text += "set -e\n. " + shell_quote(script_path) + "\n) </dev/null\n";
+    text += "printf '%s %d\\n' " + sentinel + " \"$?\"\n";
+    text += "printf '%s\\n' " + sentinel + " >&2\n";
+    return text;
+  }
+
+  // Stream both pipes until each carries the sentinel. The sentinel is printed without a
+  // leading newline, so a final unterminated line arrives glued to it.
+  std::optional<int> stream_until_sentinel(shell_run_cfg const &cfg) {
+    auto &streams{ *pipes };
+    pipe_waiter waiter{ streams };
+    std::optional<int> exit_code;
+    bool stderr_done{ false };
+
+    // Cut overlong lines into the same pieces shell_run delivers.
+    auto const deliver{ [&](std::string_view text, shell_stream stream) {
+      std::size_t const piece{ cfg.max_line_length ? cfg.max_line_length : text.size() };
+      do {
+        deliver_line(text.substr(0, piece), stream, cfg);
+        text.remove_prefix(std::min(piece, text.size()));
+      } while (!text.empty());
+    } };
+
+    auto const on_line{ [&](std::string_view line, shell_stream stream) {
+      auto const pos{ line.find(sentinel) };
+      if (pos == std::string_view::npos) {
+        deliver(line, stream);
+        return;
+      }
+      if (pos > 0) { deliver(line.substr(0, pos), stream); }
+      if (stream == shell_stream::std_err) {
+        stderr_done = true;
+        return;
+      }
+      auto code{ line.substr(pos + sentinel.size()) };
+      if (code.starts_with(' ')) { code.remove_prefix(1); }
+      int value{ 0 };
+      std::from_chars(code.data(), code.data() + code.size(), value);
+      exit_code = value;
+    } };
+
+    while (!exit_code || !stderr_done) {
+      auto const ready{ waiter.wait() };
+      for (size_t i{ 0 }; i < streams.size(); ++i) {
+        auto &pipe{ streams[i] };
+        if (!ready[i]) { continue; }
+
+        auto const space{ pipe.lines.prepare() };
+        ssize_t const n{ ::read(pipe.read_fd.get(), space.data(), space.size()) };
+        if (n == -1) {
+          if (errno == EINTR) { continue; }
+          throw std::system_error(errno, std::generic_category(), "read failed");
+        }
+        if (n == 0) {  // The coprocess itself exited mid-script
+          for (auto &p : streams) {
+            if (auto const rest{ p.lines.take_rest() }) { on_line(*rest, p.stream); }
+          }
+          return std::nullopt;
+        }
+
+        pipe.lines.commit(static_cast<size_t>(n));
+        while (auto const line{ pipe.lines.next_line() }) { on_line(*line, pipe.stream); }
+      }
+    }
+    return exit_code;
+  }
+};
+
+shell_session::shell_session() : m{ std::make_unique<impl>() } {}
+
+shell_session::~shell_session() {
+  if (!m->running()) { return; }
+  try {
+    m->stop(true);
+  } catch (...) {}
+}
+
+shell_result shell_session::run(std::string_view script, shell_run_cfg const &cfg) {
+  auto const *choice{ std::get_if<shell_choice>(&cfg.shell) };
+  bool const hostable{ choice &&
+                       (*choice == shell_choice::bash || *choice == shell_choice::sh) &&
+                       std::all_of(cfg.env.begin(), cfg.env.end(), [](auto const &kv) {
+                         return is_shell_identifier(kv.first);
+                       }) };
+  if (!hostable) { return shell_run(script, cfg); }
+
+  if (m->running() && m->shell != *choice) { m->stop(true); }
+
+  auto script_source{ create_memfd_script(script) };
+  if (!script_source) { script_source = create_temp_script(script); }
+
+  for (int attempt{ 0 };; ++attempt) {
+    if (!m->running()) { m->start(*choice, cfg); }
+    auto const text{ m->frame(script_source->path, cfg) };
+    try {
+      write_all(m->control.get(), text.data(), text.size());
+      break;
+    } catch (std::system_error const &e) {
+      // The coprocess died between scripts; start a fresh one once.
+      if (e.code() != std::errc::broken_pipe || attempt > 0) { throw; }
+      m->stop(true);
+    }
+  }
+
+  std::optional<int> exit_code;
+  try {
+    exit_code = m->stream_until_sentinel(cfg);
+  } catch (...) {
+    m->stop(true);
+    throw;
+  }
+
+  // Usage accrues to the coprocess as a whole, so session scripts report none.
+  if (!exit_code) {  // e.g. the script ran `kill $$`
+    auto result{ m->stop(false) };
+    result.usage.reset();
+    return result;
+  }
+  return { .exit_code = *exit_code, .signal = std::nullopt, .usage = std::nullopt };
+}
+
 }  // namespace envy
 
 #endif  // POSIX implementation
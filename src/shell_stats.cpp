@@ -0,0 +1,161 @@
+#include "shell_stats.h"
+
+#include "trace.h"
+#include "tui.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <optional>
+
+namespace envy {
+
+namespace {
+
+std::int64_t to_ms(std::chrono::steady_clock::duration d) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+}
+
+std::int64_t or_unmeasured(std::optional<std::int64_t> const &value) {
+  return value.value_or(-1);
+}
+
+void add_counter(std::optional<std::int64_t> &sum, std::optional<std::int64_t> value) {
+  if (value) { sum = sum.value_or(0) + *value; }
+}
+
+std::string format_seconds(std::int64_t us) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.2fs", static_cast<double>(us) / 1e6);
+  return buf;
+}
+
+std::string format_counter(std::optional<std::int64_t> const &bytes) {
+  return bytes ? util_format_bytes(static_cast<std::uint64_t>(*bytes)) : "-";
+}
+
+}  // namespace
+
+void shell_stats::record(std::string const &pkg_identity,
+                         pkg_phase phase,
+                         shell_result const &result,
+                         std::chrono::steady_clock::duration wall) {
+  bool const failed{ result.exit_code != 0 || result.signal.has_value() };
+
+  if (auto const &u{ result.usage }) {
+    ENVY_TRACE(shell_command_usage,
+               pkg_identity,
+               .phase = phase,
+               .exit_code = result.exit_code,
+               .wall_ms = to_ms(wall),
+               .user_cpu_ms = u->user_cpu_us / 1000,
+               .sys_cpu_ms = u->sys_cpu_us / 1000,
+               .max_rss_kb = u->max_rss_kb,
+               .voluntary_ctx_switches = u->voluntary_ctx_switches,
+               .involuntary_ctx_switches = u->involuntary_ctx_switches,
+               .read_bytes = or_unmeasured(u->read_bytes),
+               .write_bytes = or_unmeasured(u->write_bytes),
+               .disk_read_bytes = or_unmeasured(u->disk_read_bytes),
+               .disk_write_bytes = or_unmeasured(u->disk_write_bytes));
+  } else {
+    ENVY_TRACE(shell_command_usage,
+               pkg_identity,
+               .phase = phase,
+               .exit_code = result.exit_code,
+               .wall_ms = to_ms(wall),
+               .user_cpu_ms = -1,
+               .sys_cpu_ms = -1,
+               .max_rss_kb = -1,
+               .voluntary_ctx_switches = -1,
+               .involuntary_ctx_switches = -1,
+               .read_bytes = -1,
+               .write_bytes = -1,
+               .disk_read_bytes = -1,
+               .disk_write_bytes = -1);
+  }
+
+  std::lock_guard const lock{ mutex_ };
+  auto &t{ totals_[{ pkg_identity, phase }] };
+  if (t.commands == 0) {
+    t.pkg_identity = pkg_identity;
+    t.phase = phase;
+  }
+  ++t.commands;
+  if (failed) { ++t.failed; }
+  t.wall_ms += to_ms(wall);
+
+  if (!result.usage) { return; }
+  auto const &u{ *result.usage };
+  ++t.measured;
+  t.usage.user_cpu_us += u.user_cpu_us;
+  t.usage.sys_cpu_us += u.sys_cpu_us;
+  t.usage.max_rss_kb = std::max(t.usage.max_rss_kb, u.max_rss_kb);
+  t.usage.voluntary_ctx_switches += u.voluntary_ctx_switches;
+  t.usage.involuntary_ctx_switches += u.involuntary_ctx_switches;
+  add_counter(t.usage.read_bytes, u.read_bytes);
+  add_counter(t.usage.write_bytes, u.write_bytes);
+  add_counter(t.usage.disk_read_bytes, u.disk_read_bytes);
+  add_counter(t.usage.disk_write_bytes, u.disk_write_bytes);
+}
+
+std::vector<shell_stats::totals> shell_stats::snapshot() const {
+  std::lock_guard const lock{ mutex_ };
+  std::vector<totals> out;
+  out.reserve(totals_.size());
+  for (auto const &[key, t] : totals_) { out.push_back(t); }
+  return out;
+}
+
+void shell_stats::report() const {
+  auto const all{ snapshot() };
+  if (all.empty()) { return; }
+
+  for (auto const &t : all) {
+    bool const measured{ t.measured > 0 };
+    auto const sum{ [&](std::int64_t value) { return measured ? value : -1; } };
+    ENVY_TRACE(shell_phase_usage,
+               t.pkg_identity,
+               .phase = t.phase,
+               .commands = t.commands,
+               .failed = t.failed,
+               .wall_ms = t.wall_ms,
+               .user_cpu_ms = sum(t.usage.user_cpu_us / 1000),
+               .sys_cpu_ms = sum(t.usage.sys_cpu_us / 1000),
+               .max_rss_kb = sum(t.usage.max_rss_kb),
+               .voluntary_ctx_switches = sum(t.usage.voluntary_ctx_switches),
+               .involuntary_ctx_switches = sum(t.usage.involuntary_ctx_switches),
+               .read_bytes = or_unmeasured(t.usage.read_bytes),
+               .write_bytes = or_unmeasured(t.usage.write_bytes),
+               .disk_read_bytes = or_unmeasured(t.usage.disk_read_bytes),
+               .disk_write_bytes = or_unmeasured(t.usage.disk_write_bytes));
+  }
+
+  tui::debug("%s", shell_stats_format(all).c_str());
+}
+
+std::string shell_stats_format(std::vector<shell_stats::totals> const &totals) {
+  std::string out{ "shell usage by package and phase:" };
+  for (auto const &t : totals) {
+    out += "\n  " + t.pkg_identity + " " + std::string{ pkg_phase_name(t.phase) } + ": " +
+           std::to_string(t.commands) + (t.commands == 1 ? " command" : " commands");
+    if (t.failed > 0) { out += " (" + std::to_string(t.failed) + " failed)"; }
+    out += ", wall " + format_seconds(t.wall_ms * 1000);
+
+    if (t.measured == 0) {
+      out += ", usage not measured";
+      continue;
+    }
+    out += ", cpu " + format_seconds(t.usage.user_cpu_us) + " user " +
+           format_seconds(t.usage.sys_cpu_us) + " sys";
+    out += ", peak rss " +
+           util_format_bytes(static_cast<std::uint64_t>(t.usage.max_rss_kb) * 1024);
+    out += ", ctx switches " + std::to_string(t.usage.voluntary_ctx_switches) + "/" +
+           std::to_string(t.usage.involuntary_ctx_switches);
+    out += ", read " + format_counter(t.usage.read_bytes) + " (disk " +
+           format_counter(t.usage.disk_read_bytes) + ")";
+    out += ", write " + format_counter(t.usage.write_bytes) + " (disk " +
+           format_counter(t.usage.disk_write_bytes) + ")";
+  }
+  return out;
+}
+
+}  // namespace envy
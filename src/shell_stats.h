@@ -0,0 +1,52 @@
+#pragma once
+
+#include "pkg_phase.h"
+#include "shell.h"
+#include "util.h"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace envy {
+
+// Resource usage of package shell commands, summed per package and phase. Each recorded
+// command is also emitted as a shell_command_usage trace event. Thread-safe; the engine
+// owns one per run and reports it on shutdown.
+class shell_stats : unmovable {
+ public:
+  struct totals {
+    std::string pkg_identity;
+    pkg_phase phase{ pkg_phase::none };
+    std::int64_t commands{ 0 };
+    std::int64_t failed{ 0 };    // Nonzero exit or signal
+    std::int64_t measured{ 0 };  // Commands that reported usage
+    std::int64_t wall_ms{ 0 };
+    shell_usage usage;  // Sums over measured commands; max_rss_kb is the largest one
+  };
+
+  void record(std::string const &pkg_identity,
+              pkg_phase phase,
+              shell_result const &result,
+              std::chrono::steady_clock::duration wall);
+
+  // Ordered by package identity, then phase.
+  std::vector<totals> snapshot() const;
+
+  // One shell_phase_usage trace event per package and phase, plus the table from
+  // shell_stats_format at debug level. Nothing when no command was recorded.
+  void report() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::map<std::pair<std::string, pkg_phase>, totals> totals_;
+};
+
+// Human-readable table, one line per package and phase.
+std::string shell_stats_format(std::vector<shell_stats::totals> const &totals);
+
+}  // namespace envy
@@ -0,0 +1,87 @@
+#include "shell_stats.h"
+
+#include "doctest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace {
+
+envy::shell_result measured(int exit_code,
+                            std::int64_t user_cpu_us,
+                            std::int64_t max_rss_kb,
+                            std::optional<std::int64_t> write_bytes) {
+  return { .exit_code = exit_code,
+           .signal = std::nullopt,
+           .usage = envy::shell_usage{ .user_cpu_us = user_cpu_us,
+                                       .sys_cpu_us = 1000,
+                                       .max_rss_kb = max_rss_kb,
+                                       .voluntary_ctx_switches = 2,
+                                       .involuntary_ctx_switches = 1,
+                                       .read_bytes = 10,
+                                       .write_bytes = write_bytes } };
+}
+
+}  // namespace
+
+TEST_CASE("shell_stats sums usage per package and phase") {
+  using namespace std::chrono_literals;
+  envy::shell_stats stats;
+  stats.record("b.pkg@v1", envy::pkg_phase::pkg_build, measured(0, 5000, 300, 40), 20ms);
+  stats.record("b.pkg@v1", envy::pkg_phase::pkg_build, measured(2, 7000, 900, 2), 30ms);
+  stats.record("b.pkg@v1", envy::pkg_phase::pkg_stage, measured(0, 1000, 100, 0), 5ms);
+  stats.record("a.pkg@v1",
+               envy::pkg_phase::pkg_install,
+               { .exit_code = 0, .signal = std::nullopt, .usage = std::nullopt },
+               7ms);
+
+  auto const all{ stats.snapshot() };
+  REQUIRE(all.size() == 3);
+  CHECK(all[0].pkg_identity == "a.pkg@v1");  // Ordered by package, then phase
+  CHECK(all[1].phase == envy::pkg_phase::pkg_stage);
+  CHECK(all[2].phase == envy::pkg_phase::pkg_build);
+
+  auto const &build{ all[2] };
+  CHECK(build.commands == 2);
+  CHECK(build.failed == 1);
+  CHECK(build.measured == 2);
+  CHECK(build.wall_ms == 50);
+  CHECK(build.usage.user_cpu_us == 12000);
+  CHECK(build.usage.sys_cpu_us == 2000);
+  CHECK(build.usage.max_rss_kb == 900);  // Peak, not sum
+  CHECK(build.usage.voluntary_ctx_switches == 4);
+  CHECK(build.usage.involuntary_ctx_switches == 2);
+  CHECK(build.usage.read_bytes == 20);
+  CHECK(build.usage.write_bytes == 42);
+  CHECK_FALSE(build.usage.disk_read_bytes.has_value());
+
+  auto const &install{ all[0] };
+  CHECK(install.commands == 1);
+  CHECK(install.measured == 0);
+  CHECK(install.wall_ms == 7);
+  CHECK_FALSE(install.usage.read_bytes.has_value());
+}
+
+TEST_CASE("shell_stats_format lists every package and phase") {
+  using namespace std::chrono_literals;
+  envy::shell_stats stats;
+  stats.record("a.pkg@v1",
+               envy::pkg_phase::pkg_build,
+               measured(1, 1'500'000, 2048, std::nullopt),
+               2s);
+  stats.record("a.pkg@v1",
+               envy::pkg_phase::pkg_install,
+               { .exit_code = 0, .signal = std::nullopt, .usage = std::nullopt },
+               10ms);
+
+  auto const text{ envy::shell_stats_format(stats.snapshot()) };
+  CHECK(text.find("a.pkg@v1 build: 1 command (1 failed), wall 2.00s") !=
+        std::string::npos);
+  CHECK(text.find("cpu 1.50s user 0.00s sys") != std::string::npos);
+  CHECK(text.find("peak rss 2.00MB") != std::string::npos);
+  CHECK(text.find("write - (disk -)") != std::string::npos);
+  CHECK(text.find("a.pkg@v1 install: 1 command, wall 0.01s, usage not measured") !=
+        std::string::npos);
+}
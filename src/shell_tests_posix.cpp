@@ -3,16 +3,27 @@
 #endif
 
 #include "shell.h"
+#include "shell_capture.h"
 
 #include "doctest.h"
 
 #include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
 namespace fs = std::filesystem;
 
 static std::vector<std::string> run_collect(std::string_view script,
@@ -114,6 +125,87 @@ TEST_CASE("shell_run handles invalid working directory") {
   CHECK(result.exit_code == 127);
 }
 
+TEST_CASE("shell_run delivers scripts to each interpreter kind") {
+  // Longer than a pipe buffer, so a delivery that cannot be re-read would truncate it.
+  std::string script{ "n=0\n" };
+  for (int i{ 0 }; i < 4096; ++i) { script += "n=$((n + 1))\n"; }
+  script += "printf '%s\\n' \"$n\"\nexit 3\necho unreachable";
+
+  std::vector<std::pair<char const *, envy::resolved_shell>> const shells{
+    { "bash", envy::shell_choice::bash },
+    { "sh", envy::shell_choice::sh },
+    { "custom file", envy::custom_shell_file{ .argv = { "/bin/sh" }, .ext = ".sh" } },
+  };
+  for (auto const &[name, shell] : shells) {
+    CAPTURE(name);
+    std::vector<std::string> lines;
+    envy::shell_run_cfg inv{ .on_output_line =
+                                 [&](std::string_view line) { lines.emplace_back(line); },
+                             .env = envy::shell_getenv(),
+                             .shell = shell };
+    auto const result{ envy::shell_run(script, inv) };
+    CHECK(result.exit_code == 3);
+    REQUIRE(lines.size() == 1);
+    CHECK(lines[0] == "4096");
+  }
+}
+
+TEST_CASE("shell_run custom file interpreters read a script on disk") {
+  std::vector<std::string> lines;
+  envy::shell_run_cfg inv{
+    .on_output_line = [&](std::string_view line) { lines.emplace_back(line); },
+    .env = envy::shell_getenv(),
+    .shell = envy::custom_shell_file{ .argv = { "/bin/sh" }, .ext = ".sh" }
+  };
+  REQUIRE(envy::shell_run("test -f \"$0\" && echo on-disk", inv).exit_code == 0);
+  REQUIRE(lines.size() == 1);
+  CHECK(lines[0] == "on-disk");
+}
+
+TEST_CASE("shell_run reports a missing interpreter as exit 127") {
+  std::vector<std::string> stderr_lines;
+  envy::shell_run_cfg inv{ .on_stderr_line =
+                               [&](std::string_view line) {
+                                 stderr_lines.emplace_back(line);
+                               },
+                           .env = envy::shell_getenv(),
+                           .shell = envy::custom_shell_inline{
+                               .argv = { "/nonexistent/envy-shell", "-c" } } };
+  auto const result{ envy::shell_run("echo hi", inv) };
+  CHECK(result.exit_code == 127);
+  CHECK(!result.signal.has_value());
+  REQUIRE(stderr_lines.size() == 1);
+  CHECK(stderr_lines[0].find("/nonexistent/envy-shell") != std::string::npos);
+}
+
+TEST_CASE("shell_run reports termination by signal") {
+  envy::shell_run_cfg inv{ .on_output_line = [](std::string_view) {},
+                           .env = envy::shell_getenv(),
+                           .shell = envy::shell_choice::bash };
+  auto const result{ envy::shell_run("kill -TERM $$", inv) };
+  REQUIRE(result.signal.has_value());
+  CHECK(*result.signal == SIGTERM);
+  CHECK(result.exit_code == 128 + SIGTERM);
+}
+
+TEST_CASE("shell_run children start with default signal dispositions") {
+  // The parent ignores SIGPIPE (as envy does); the child must not inherit that.
+  auto *const previous{ std::signal(SIGPIPE, SIG_IGN) };
+  auto lines{ run_collect("trap -p PIPE; echo done") };
+  std::signal(SIGPIPE, previous);
+  REQUIRE(lines.size() == 1);
+  CHECK(lines[0] == "done");
+}
+
+TEST_CASE("shell_run does not leak pipe descriptors into children") {
+  auto lines{ run_collect("ls /proc/self/fd 2>/dev/null | wc -l") };
+  REQUIRE(lines.size() == 1);
+  if (fs::exists("/proc/self/fd")) {
+    // stdin, stdout, stderr, ls's directory handle; nothing inherited from the parent.
+    CHECK(std::stoi(lines[0]) <= 4);
+  }
+}
+
 TEST_CASE("shell_run delivers split stdout/stderr callbacks") {
   std::vector<std::string> stdout_lines;
   std::vector<std::string> stderr_lines;
@@ -147,6 +239,78 @@ TEST_CASE("shell_run delivers split stdout/stderr callbacks") {
   CHECK(find_index("err1") < find_index("err2"));
 }
 
+TEST_CASE("shell_run splits very long lines at max_line_length") {
+  std::vector<std::string> lines;
+  envy::shell_run_cfg inv{ .on_output_line =
+                               [&](std::string_view line) { lines.emplace_back(line); },
+                           .env = envy::shell_getenv(),
+                           .shell = envy::shell_choice::bash,
+                           .max_line_length = 1 << 20 };
+  // 3 MiB + 5 bytes with no newline, then a short line.
+  auto const result{ envy::shell_run(
+      "head -c 3145733 /dev/zero | tr '\\0' x; printf '\\nend\\n'", inv) };
+  REQUIRE(result.exit_code == 0);
+  REQUIRE(lines.size() == 5);
+  for (int i{ 0 }; i < 3; ++i) {
+    CHECK(lines[i].size() == std::size_t{ 1 } << 20);
+    CHECK(lines[i].find_first_not_of('x') == std::string::npos);
+  }
+  CHECK(lines[3] == "xxxxx");
+  CHECK(lines[4] == "end");
+}
+
+TEST_CASE("shell_run keeps very long lines whole when unlimited") {
+  std::vector<std::size_t> sizes;
+  envy::shell_run_cfg inv{ .on_output_line = [&](std::string_view line) {
+                             sizes.push_back(line.size());
+                           },
+                           .env = envy::shell_getenv(),
+                           .shell = envy::shell_choice::bash,
+                           .max_line_length = 0 };
+  REQUIRE(envy::shell_run("head -c 5000000 /dev/zero | tr '\\0' x; echo", inv).exit_code ==
+          0);
+  CHECK(sizes == std::vector<std::size_t>{ 5000000 });
+}
+
+TEST_CASE("shell_run captures a line longer than 1 MiB byte for byte by default") {
+  envy::shell_capture capture{ {} };
+  envy::shell_run_cfg inv{ .on_stdout_line =
+                               [&](std::string_view line) { capture.append_line(line); },
+                           .env = envy::shell_getenv(),
+                           .shell = envy::shell_choice::bash };
+  auto const result{ envy::shell_run(
+      "head -c 3145733 /dev/zero | tr '\\0' x; printf '\\nend\\n'", inv) };
+  REQUIRE(result.exit_code == 0);
+  capture.finish();
+  REQUIRE(capture.complete_in_memory());
+  CHECK(capture.str() == std::string(3145733, 'x') + "\nend\n");
+}
+
+TEST_CASE("shell_run keeps per-stream order for interleaved stdout and stderr") {
+  std::vector<std::string> out;
+  std::vector<std::string> err;
+  std::size_t combined{ 0 };
+  envy::shell_run_cfg inv{
+    .on_output_line = [&](std::string_view) { ++combined; },
+    .on_stdout_line = [&](std::string_view line) { out.emplace_back(line); },
+    .on_stderr_line = [&](std::string_view line) { err.emplace_back(line); },
+    .env = envy::shell_getenv(),
+    .shell = envy::shell_choice::bash,
+  };
+  auto const result{ envy::shell_run(
+      "for i in $(seq 1 20000); do echo \"out $i\"; echo \"err $i\" >&2; done", inv) };
+  REQUIRE(result.exit_code == 0);
+  REQUIRE(out.size() == 20000);
+  REQUIRE(err.size() == 20000);
+  CHECK(combined == 40000);
+  for (std::size_t i{ 0 }; i < out.size(); ++i) {
+    if (out[i] != "out " + std::to_string(i + 1) ||
+        err[i] != "err " + std::to_string(i + 1)) {
+      FAIL("out of order at line " << i);
+    }
+  }
+}
+
 TEST_CASE("shell_run handles large output") {
   std::vector<std::string> lines;
   envy::shell_run_cfg inv{ .on_output_line =
@@ -226,3 +390,385 @@ TEST_CASE("shell_run bash fails on exit 1 mid-script") {
   REQUIRE(lines.size() == 1);
   CHECK(lines[0] == "line1");
 }
+
+TEST_CASE("shell_run reports resource usage of a CPU-bound command") {
+  envy::shell_run_cfg inv{ .env = envy::shell_getenv(),
+                           .shell = envy::shell_choice::bash };
+  auto const start{ std::chrono::steady_clock::now() };
+  auto const result{ envy::shell_run(
+      "i=0; while [ $i -lt 200000 ]; do i=$((i + 1)); done", inv) };
+  auto const wall_us{ std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count() };
+
+  CHECK(result.exit_code == 0);
+  REQUIRE(result.usage.has_value());
+  auto const &usage{ *result.usage };
+  CHECK(usage.user_cpu_us >= 50'000);
+  CHECK(usage.user_cpu_us + usage.sys_cpu_us <= wall_us + 50'000);  // One thread
+  CHECK(usage.max_rss_kb > 0);
+  CHECK(usage.max_rss_kb < 1024 * 1024);
+  CHECK(usage.voluntary_ctx_switches >= 0);
+  CHECK(usage.involuntary_ctx_switches >= 0);
+#if defined(__linux__)
+  if (usage.write_bytes) { CHECK(*usage.write_bytes < 1024 * 1024); }
+#endif
+}
+
+TEST_CASE("shell_run reports resource usage of an I/O-bound command") {
+  auto const file{ fs::temp_directory_path() /
+                   ("envy-shell-usage-" + std::to_string(::getpid()) + ".bin") };
+  auto env{ envy::shell_getenv() };
+  env["USAGE_FILE"] = file.string();
+  envy::shell_run_cfg inv{ .env = std::move(env), .shell = envy::shell_choice::bash };
+
+  // dd and cat are descendants the shell reaps; their I/O is folded into the shell's.
+  auto const result{ envy::shell_run(
+      "dd if=/dev/zero of=\"$USAGE_FILE\" bs=1048576 count=16 2>/dev/null\n"
+      "cat \"$USAGE_FILE\" >/dev/null\n"
+      "rm -f \"$USAGE_FILE\"",
+      inv) };
+  fs::remove(file);
+
+  CHECK(result.exit_code == 0);
+  REQUIRE(result.usage.has_value());
+  auto const &usage{ *result.usage };
+  CHECK(usage.max_rss_kb > 0);
+#if defined(__linux__)
+  if (!usage.write_bytes) {
+    MESSAGE("/proc/<pid>/io unavailable; I/O counters not checked");
+    return;
+  }
+  constexpr std::int64_t kMiB{ 1024 * 1024 };
+  // dd writes the file and cat copies it to /dev/null; dd reads /dev/zero, cat the file
+  CHECK(*usage.write_bytes >= 32 * kMiB);
+  CHECK(*usage.write_bytes < 64 * kMiB);
+  REQUIRE(usage.read_bytes.has_value());
+  CHECK(*usage.read_bytes >= 32 * kMiB);
+  CHECK(*usage.read_bytes < 64 * kMiB);
+  REQUIRE(usage.disk_read_bytes.has_value());
+  REQUIRE(usage.disk_write_bytes.has_value());
+  CHECK(*usage.disk_write_bytes >= 0);
+#endif
+}
+
+TEST_CASE("shell_run reports no usage when the shell cannot start") {
+  envy::shell_run_cfg inv{ .env = envy::shell_getenv(),
+                           .shell = envy::custom_shell_file{
+                               .argv = { "/nonexistent/envy-shell" },
+                               .ext = ".sh" } };
+  auto const result{ envy::shell_run("true", inv) };
+  CHECK(result.exit_code == 127);
+  CHECK_FALSE(result.usage.has_value());
+}
+
+TEST_CASE("shell_run launch latency with a large resident parent" * doctest::skip()) {
+  // fork copies page tables proportional to the parent's resident set; posix_spawn does
+  // not. Compare against a bare fork+exec of the same program.
+  constexpr std::size_t kResident{ std::size_t{ 4 } << 30 };
+  constexpr int kRuns{ 50 };
+  std::vector<char> ballast(kResident);
+  for (std::size_t i{ 0 }; i < ballast.size(); i += 4096) { ballast[i] = 1; }
+
+  envy::shell_run_cfg inv{ .on_output_line = [](std::string_view) {},
+                           .env = envy::shell_env_t{},
+                           .shell = envy::custom_shell_inline{ .argv = { "/bin/true" } } };
+  auto start{ std::chrono::steady_clock::now() };
+  for (int i{ 0 }; i < kRuns; ++i) { REQUIRE(envy::shell_run("", inv).exit_code == 0); }
+  std::chrono::duration<double, std::milli> const spawn{ std::chrono::steady_clock::now() -
+                                                         start };
+
+  start = std::chrono::steady_clock::now();
+  for (int i{ 0 }; i < kRuns; ++i) {
+    pid_t const child{ ::fork() };
+    REQUIRE(child != -1);
+    if (child == 0) {
+      ::execl("/bin/true", "/bin/true", static_cast<char *>(nullptr));
+      _exit(127);
+    }
+    int status{ 0 };
+    ::waitpid(child, &status, 0);
+  }
+  std::chrono::duration<double, std::milli> const fork{ std::chrono::steady_clock::now() -
+                                                        start };
+
+  MESSAGE("4 GiB resident parent: shell_run " << spawn.count() / kRuns
+                                              << " ms/launch, fork+exec "
+                                              << fork.count() / kRuns << " ms/launch");
+  CHECK(ballast[0] == 1);
+}
+
+TEST_CASE("shell_run 1000 trivial commands" * doctest::skip()) {
+  constexpr int kRuns{ 1000 };
+  std::vector<std::pair<char const *, envy::resolved_shell>> const shells{
+    { "bash", envy::shell_choice::bash },
+    { "sh", envy::shell_choice::sh },
+    { "custom file", envy::custom_shell_file{ .argv = { "/bin/sh" }, .ext = ".sh" } },
+  };
+  for (auto const &[name, shell] : shells) {
+    envy::shell_run_cfg inv{ .on_output_line = [](std::string_view) {},
+                             .env = envy::shell_getenv(),
+                             .shell = shell };
+    auto const start{ std::chrono::steady_clock::now() };
+    for (int i{ 0 }; i < kRuns; ++i) {
+      REQUIRE(envy::shell_run("true", inv).exit_code == 0);
+    }
+    std::chrono::duration<double, std::milli> const elapsed{
+      std::chrono::steady_clock::now() - start
+    };
+    MESSAGE(name << ": " << elapsed.count() << " ms for " << kRuns << " commands");
+  }
+}
+
+TEST_CASE("shell_run output throughput" * doctest::skip()) {
+  // 1 GiB each of 100-byte lines and of 2-byte lines, plus unterminated output.
+  std::vector<std::pair<char const *, char const *>> const cases{
+    { "100-byte lines", "yes \"$(printf '%099d' 0)\" | head -c 1073741824" },
+    { "2-byte lines", "yes | head -c 1073741824" },
+    { "no newlines", "head -c 1073741824 /dev/zero" },
+  };
+  for (auto const &[name, script] : cases) {
+    std::size_t bytes{ 0 };
+    envy::shell_run_cfg inv{ .on_output_line = [&](std::string_view line) {
+                               bytes += line.size() + 1;
+                             },
+                             .env = envy::shell_getenv(),
+                             .shell = envy::shell_choice::bash };
+    auto const start{ std::chrono::steady_clock::now() };
+    REQUIRE(envy::shell_run(script, inv).exit_code == 0);
+    std::chrono::duration<double> const elapsed{ std::chrono::steady_clock::now() -
+                                                 start };
+    MESSAGE(name << ": " << static_cast<double>(bytes) / (1 << 20) / elapsed.count()
+                 << " MB/s");
+  }
+}
+
+TEST_CASE("shell_run capture memory and time" * doctest::skip()) {
+  auto const peak_rss_mb{ [] {
+    rusage usage{};
+    ::getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_maxrss) / 1024.0;  // KiB on Linux
+  } };
+  auto const spill_dir{ fs::temp_directory_path() / "envy-capture-bench" };
+
+  // 10 MB stays in memory; 2 GB spills. Peak RSS is process-wide, so run small first.
+  for (auto const &[name, lines] : { std::pair{ "10 MB", 163840 },
+                                     std::pair{ "2 GB", 33554432 } }) {
+    envy::shell_capture out{ { .spill_dir = spill_dir } };
+    envy::shell_run_cfg inv{
+      .on_stdout_line = [&](std::string_view line) { out.append_line(line); },
+      .env = envy::shell_getenv(),
+      .shell = envy::shell_choice::bash,
+    };
+    auto const start{ std::chrono::steady_clock::now() };
+    std::string const script{ "yes \"$(printf '%063d' 0)\" | head -n " +
+                              std::to_string(lines) };
+    REQUIRE(envy::shell_run(script, inv).exit_code == 0);
+    out.finish();
+    std::chrono::duration<double, std::milli> const elapsed{
+      std::chrono::steady_clock::now() - start
+    };
+    MESSAGE(name << ": " << elapsed.count() << " ms, peak RSS " << peak_rss_mb()
+                 << " MB, spilled=" << out.spilled());
+  }
+  fs::remove_all(spill_dir);
+}
+
+namespace {
+
+struct session_output {
+  std::vector<std::string> out;
+  std::vector<std::string> err;
+};
+
+envy::shell_run_cfg session_cfg(session_output &output,
+                                envy::shell_env_t env = envy::shell_getenv()) {
+  return { .on_stdout_line = [&](std::string_view line) { output.out.emplace_back(line); },
+           .on_stderr_line = [&](std::string_view line) { output.err.emplace_back(line); },
+           .env = std::move(env),
+           .shell = envy::shell_choice::bash };
+}
+
+}  // namespace
+
+TEST_CASE("shell_session reports each script's exit code and output") {
+  envy::shell_session session;
+  for (auto const shell : { envy::shell_choice::bash, envy::shell_choice::sh }) {
+    session_output output;
+    auto cfg{ session_cfg(output) };
+    cfg.shell = shell;
+
+    auto result{ session.run("echo one; echo two >&2; exit 3", cfg) };
+    CHECK(result.exit_code == 3);
+    CHECK(!result.signal.has_value());
+    CHECK_FALSE(result.usage.has_value());  // Accrues to the coprocess, not the script
+    CHECK(output.out == std::vector<std::string>{ "one" });
+    CHECK(output.err == std::vector<std::string>{ "two" });
+
+    output = {};
+    result = session.run("echo before\nfalse\necho after", cfg);  // Fail-fast
+    CHECK(result.exit_code == 1);
+    CHECK(output.out == std::vector<std::string>{ "before" });
+
+    output = {};
+    result = session.run("printf 'no-newline'; printf 'err-partial' >&2", cfg);
+    CHECK(result.exit_code == 0);
+    CHECK(output.out == std::vector<std::string>{ "no-newline" });
+    CHECK(output.err == std::vector<std::string>{ "err-partial" });
+  }
+}
+
+TEST_CASE("shell_session isolates environment and working directory between scripts") {
+  envy::shell_session session;
+  session_output output;
+  auto env{ envy::shell_getenv() };
+  env["ENVY_SESSION_BASE"] = "base";
+  auto cfg{ session_cfg(output, env) };
+
+  REQUIRE(session.run("export LEAK=1; SHELL_VAR=2; cd /; set -u", cfg).exit_code == 0);
+  auto const probe{
+    "echo \"${LEAK:-unset} ${SHELL_VAR:-unset} $ENVY_SESSION_BASE\"; pwd"
+  };
+  REQUIRE(session.run(probe, cfg).exit_code == 0);
+  REQUIRE(output.out.size() == 2);
+  CHECK(output.out[0] == "unset unset base");
+  CHECK(fs::weakly_canonical(output.out[1]) == fs::weakly_canonical(fs::current_path()));
+
+  output = {};
+  auto changed_env{ env };
+  changed_env.erase("ENVY_SESSION_BASE");
+  changed_env["ENVY_SESSION_NEW"] = "it's \"quoted\" $HOME";
+  auto changed{ session_cfg(output, changed_env) };
+  changed.cwd = "/tmp";
+  auto const changed_probe{
+    "echo \"${ENVY_SESSION_BASE:-gone}\"; echo \"$ENVY_SESSION_NEW\"; pwd"
+  };
+  REQUIRE(session.run(changed_probe, changed).exit_code == 0);
+  REQUIRE(output.out.size() == 3);
+  CHECK(output.out[0] == "gone");
+  CHECK(output.out[1] == "it's \"quoted\" $HOME");
+  CHECK(fs::weakly_canonical(output.out[2]) == fs::weakly_canonical("/tmp"));
+
+  output = {};
+  REQUIRE(session.run("echo \"$ENVY_SESSION_BASE\"", cfg).exit_code == 0);
+  CHECK(output.out == std::vector<std::string>{ "base" });
+}
+
+TEST_CASE("shell_session scripts do not read the control pipe") {
+  envy::shell_session session;
+  session_output output;
+  auto cfg{ session_cfg(output) };
+  REQUIRE(session.run("cat; read -r line || echo eof", cfg).exit_code == 0);
+  CHECK(output.out == std::vector<std::string>{ "eof" });
+  REQUIRE(session.run("echo still-alive", cfg).exit_code == 0);
+  CHECK(output.out.back() == "still-alive");
+}
+
+TEST_CASE("shell_session restarts after a script kills the coprocess") {
+  envy::shell_session session;
+  session_output output;
+  auto cfg{ session_cfg(output) };
+  auto const killed{ session.run("echo dying; kill -TERM $$", cfg) };
+  CHECK(killed.signal == std::optional<int>{ SIGTERM });
+  CHECK(killed.exit_code == 128 + SIGTERM);
+  CHECK(output.out == std::vector<std::string>{ "dying" });
+
+  output = {};
+  REQUIRE(session.run("echo revived", cfg).exit_code == 0);
+  CHECK(output.out == std::vector<std::string>{ "revived" });
+}
+
+TEST_CASE("shell_session recovers from callback exceptions") {
+  envy::shell_session session;
+  envy::shell_run_cfg throwing{
+    .on_output_line = [](std::string_view) { throw std::runtime_error("boom"); },
+    .env = envy::shell_getenv(),
+    .shell = envy::shell_choice::bash,
+  };
+  CHECK_THROWS_AS(session.run("echo hi", throwing), std::runtime_error);
+
+  session_output output;
+  REQUIRE(session.run("echo ok", session_cfg(output)).exit_code == 0);
+  CHECK(output.out == std::vector<std::string>{ "ok" });
+}
+
+TEST_CASE("shell_session finds the sentinel after unterminated output of any length") {
+  envy::shell_session session;
+  session_output output;
+  auto cfg{ session_cfg(output) };
+  cfg.max_line_length = 64;
+
+  // The 47-byte sentinel ends a 64-byte piece (17), straddles one (50), or follows
+  // several whole pieces (150).
+  for (int const n : { 17, 50, 150 }) {
+    CAPTURE(n);
+    output = {};
+    auto const script{ "head -c " + std::to_string(n) + " /dev/zero | tr '\\0' x; " +
+                       "head -c " + std::to_string(n) + " /dev/zero | tr '\\0' y >&2" };
+    REQUIRE(session.run(script, cfg).exit_code == 0);
+
+    std::vector<std::string> expected_out, expected_err;
+    for (int done{ 0 }; done < n; done += 64) {
+      expected_out.emplace_back(std::min(64, n - done), 'x');
+      expected_err.emplace_back(std::min(64, n - done), 'y');
+    }
+    CHECK(output.out == expected_out);
+    CHECK(output.err == expected_err);
+  }
+
+  output = {};
+  REQUIRE(session.run("echo still-alive", cfg).exit_code == 0);
+  CHECK(output.out == std::vector<std::string>{ "still-alive" });
+}
+
+TEST_CASE("shell_session falls back to shell_run for custom shells and odd env names") {
+  envy::shell_session session;
+  session_output output;
+  auto cfg{ session_cfg(output) };
+  cfg.shell = envy::custom_shell_inline{ .argv = { "/bin/sh", "-c" } };
+  REQUIRE(session.run("echo inline", cfg).exit_code == 0);
+
+  auto odd{ session_cfg(output) };
+  odd.env["NOT-AN-IDENTIFIER"] = "x";
+  REQUIRE(session.run("env | grep -c '^NOT-AN-IDENTIFIER=x$'", odd).exit_code == 0);
+  CHECK(output.out == std::vector<std::string>{ "inline", "1" });
+}
+
+TEST_CASE("shell_session 500 small commands vs per-call shell_run" * doctest::skip()) {
+  constexpr int kRuns{ 500 };
+  // Second pass emulates a heavy profile: bash sources BASH_ENV at every startup.
+  auto const profile{ fs::temp_directory_path() / "envy-session-bench-profile.sh" };
+  {
+    std::ofstream out{ profile };
+    out << "for __i in $(seq 1 2000); do :; done; alias ll='ls -l'\n";
+  }
+
+  for (bool const heavy : { false, true }) {
+    envy::shell_run_cfg cfg{ .on_output_line = [](std::string_view) {},
+                             .env = envy::shell_getenv(),
+                             .shell = envy::shell_choice::bash };
+    if (heavy) { cfg.env["BASH_ENV"] = profile.string(); }
+
+    auto start{ std::chrono::steady_clock::now() };
+    for (int i{ 0 }; i < kRuns; ++i) {
+      REQUIRE(envy::shell_run("echo " + std::to_string(i), cfg).exit_code == 0);
+    }
+    std::chrono::duration<double, std::milli> const per_call{
+      std::chrono::steady_clock::now() - start
+    };
+
+    envy::shell_session session;
+    start = std::chrono::steady_clock::now();
+    for (int i{ 0 }; i < kRuns; ++i) {
+      REQUIRE(session.run("echo " + std::to_string(i), cfg).exit_code == 0);
+    }
+    std::chrono::duration<double, std::milli> const persistent{
+      std::chrono::steady_clock::now() - start
+    };
+
+    MESSAGE(kRuns << " commands" << (heavy ? " with BASH_ENV profile" : "")
+                  << ": per-call " << per_call.count() << " ms, session "
+                  << persistent.count() << " ms");
+  }
+  fs::remove(profile);
+}
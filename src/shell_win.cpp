@@ -5,10 +5,12 @@
 #include "shell.h"
 
 #include "platform.h"
+#include "shell_line_buffer.h"
 #include "util.h"
 
 #include <algorithm>
 #include <array>
+#include <cstdint>
 #include <cwchar>
 #include <filesystem>
 #include <memory>
@@ -22,11 +24,13 @@
 #include <variant>
 #include <vector>
 
+#include <psapi.h>
+
 namespace envy {
 namespace {
 
-constexpr DWORD kPipeBufferSize{ 4096 };
-constexpr size_t kLinePendingReserve{ 256 };
+// Pipe buffer size hint; matches the largest read the line buffer issues.
+constexpr DWORD kPipeBufferSize{ static_cast<DWORD>(shell_line_buffer::kMaxRead) };
 
 HANDLE g_job_object{ NULL };
 
@@ -498,16 +502,16 @@ void stream_pipe_lines(HANDLE pipe,
                        shell_stream stream,
                        shell_run_cfg const &cfg,
                        std::mutex &callback_mutex) {
-  std::string pending{};
-  pending.reserve(kLinePendingReserve);
-  std::array<char, kPipeBufferSize> buffer{};
-  size_t offset{ 0 };
+  shell_line_buffer lines{ cfg.max_line_length };
 
   while (true) {
+    auto const space{ lines.prepare() };
     DWORD read_bytes{ 0 };
-    BOOL const success{
-      ::ReadFile(pipe, buffer.data(), buffer.size(), &read_bytes, nullptr)
-    };
+    BOOL const success{ ::ReadFile(pipe,
+                                   space.data(),
+                                   static_cast<DWORD>(space.size()),
+                                   &read_bytes,
+                                   nullptr) };
     if (!success) {
       DWORD const err = ::GetLastError();
       if (err == ERROR_BROKEN_PIPE) { break; }
@@ -516,30 +520,50 @@ void stream_pipe_lines(HANDLE pipe,
     }
     if (read_bytes == 0) { break; }
 
-    pending.append(buffer.data(), read_bytes);
-
-    size_t newline{ 0 };
-    while ((newline = pending.find('\n', offset)) != std::string::npos) {
-      dispatch_line({ pending.data() + offset, newline - offset },
-                    stream,
-                    cfg,
-                    callback_mutex);
-      offset = newline + 1;
+    lines.commit(read_bytes);
+    while (auto const line{ lines.next_line() }) {
+      dispatch_line(*line, stream, cfg, callback_mutex);
     }
+  }
 
-    // Compact buffer when offset grows large
-    if (offset > kPipeBufferSize) {
-      pending.erase(0, offset);
-      offset = 0;
-    }
+  if (auto const rest{ lines.take_rest() }) {
+    dispatch_line(*rest, stream, cfg, callback_mutex);
+  }
+}
+
+std::int64_t filetime_us(FILETIME const &ft) {
+  ULARGE_INTEGER value{};
+  value.LowPart = ft.dwLowDateTime;
+  value.HighPart = ft.dwHighDateTime;
+  return static_cast<std::int64_t>(value.QuadPart / 10);  // 100 ns units
+}
+
+// Counters of the shell process itself. The shared job object spans every command, so
+// descendants the shell started are not included; failed queries leave fields unset.
+shell_usage process_usage(HANDLE process) {
+  shell_usage usage;
+
+  FILETIME created{};
+  FILETIME exited{};
+  FILETIME kernel{};
+  FILETIME user{};
+  if (::GetProcessTimes(process, &created, &exited, &kernel, &user)) {
+    usage.user_cpu_us = filetime_us(user);
+    usage.sys_cpu_us = filetime_us(kernel);
   }
 
-  if (offset < pending.size()) {
-    dispatch_line({ pending.data() + offset, pending.size() - offset },
-                  stream,
-                  cfg,
-                  callback_mutex);
+  PROCESS_MEMORY_COUNTERS memory{};
+  if (::K32GetProcessMemoryInfo(process, &memory, sizeof(memory))) {
+    usage.max_rss_kb = static_cast<std::int64_t>(memory.PeakWorkingSetSize / 1024);
   }
+
+  IO_COUNTERS io{};
+  if (::GetProcessIoCounters(process, &io)) {
+    usage.read_bytes = static_cast<std::int64_t>(io.ReadTransferCount);
+    usage.write_bytes = static_cast<std::int64_t>(io.WriteTransferCount);
+  }
+
+  return usage;
 }
 
 shell_result wait_for_child(HANDLE process) {
@@ -557,7 +581,9 @@ shell_result wait_for_child(HANDLE process) {
                             "GetExitCodeProcess failed");
   }
 
-  return { .exit_code = static_cast<int>(exit_code), .signal = std::nullopt };
+  return { .exit_code = static_cast<int>(exit_code),
+           .signal = std::nullopt,
+           .usage = process_usage(process) };
 }
 
 std::wstring quote_arg(std::wstring_view arg) {
@@ -698,7 +724,7 @@ shell_result shell_run(std::string_view script, shell_run_cfg const &cfg) {
 
   HANDLE stdout_read{ nullptr };
   HANDLE stdout_write{ nullptr };
-  if (!::CreatePipe(&stdout_read, &stdout_write, &sa, 0)) {
+  if (!::CreatePipe(&stdout_read, &stdout_write, &sa, kPipeBufferSize)) {
     throw std::system_error(::GetLastError(), std::system_category(), "CreatePipe failed");
   }
 
@@ -712,7 +738,7 @@ shell_result shell_run(std::string_view script, shell_run_cfg const &cfg) {
 
   HANDLE stderr_read{ nullptr };
   HANDLE stderr_write{ nullptr };
-  if (!::CreatePipe(&stderr_read, &stderr_write, &sa, 0)) {
+  if (!::CreatePipe(&stderr_read, &stderr_write, &sa, kPipeBufferSize)) {
     throw std::system_error(::GetLastError(), std::system_category(), "CreatePipe failed");
   }
 
@@ -847,6 +873,16 @@ shell_result shell_run(std::string_view script, shell_run_cfg const &cfg) {
   return result;
 }
 
+// Windows has no coprocess mode yet; every script gets its own process.
+struct shell_session::impl {};
+
+shell_session::shell_session() = default;
+shell_session::~shell_session() = default;
+
+shell_result shell_session::run(std::string_view script, shell_run_cfg const &cfg) {
+  return shell_run(script, cfg);
+}
+
 }  // namespace envy
 
 #endif  // _WIN32
@@ -1,9 +1,23 @@
 #include "sol_util.h"
 
+#include "lua_memory.h"
+
 namespace envy {
 
+void sol_state_deleter::operator()(sol::state *state) const {
+  if (!state) { return; }
+  void *ud{ nullptr };
+  bool const owns_arena{ lua_getallocf(state->lua_state(), &ud) == &lua_arena::alloc };
+  delete state;  // lua_close frees every block before the arena goes away
+  if (owns_arena) { delete static_cast<lua_arena *>(ud); }
+}
+
 sol_state_ptr sol_util_make_lua_state() {
-  auto lua{ std::make_unique<sol::state>() };
+  auto arena{ std::make_unique<lua_arena>() };
+  sol_state_ptr lua{
+    new sol::state(sol::default_at_panic, &lua_arena::alloc, arena.get())
+  };
+  arena.release();  // Owned by the state from here; see sol_state_deleter
   lua->open_libraries(sol::lib::base,
                       sol::lib::package,
                       sol::lib::coroutine,
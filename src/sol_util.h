@@ -11,8 +11,13 @@
 
 namespace envy {
 
-using sol_state_ptr = std::unique_ptr<sol::state>;
-sol_state_ptr sol_util_make_lua_state();  // with std libs
+// Closes the state, then frees the lua_arena it allocated from (if any).
+struct sol_state_deleter {
+  void operator()(sol::state *state) const;
+};
+
+using sol_state_ptr = std::unique_ptr<sol::state, sol_state_deleter>;
+sol_state_ptr sol_util_make_lua_state();  // with std libs, allocating from a lua_arena
 
 // Owns a Lua state plus the mutex serializing access to it. lock() is the only path
 // to the state, so unsynchronized cross-thread access is structurally impossible.
@@ -44,6 +49,11 @@ class sol_state_guard {
     state_ = std::move(state);
   }
 
+  sol_state_ptr take() {
+    std::lock_guard const l{ mutex_ };
+    return std::move(state_);
+  }
+
  private:
   mutable std::mutex mutex_;
   sol_state_ptr state_;
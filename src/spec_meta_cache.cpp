@@ -0,0 +1,188 @@
+#include "spec_meta_cache.h"
+
+#include "platform.h"
+#include "tui.h"
+
+#include "sol/sol.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#ifndef ENVY_VERSION_STR
+#error "ENVY_VERSION_STR must be defined by the build system"
+#endif
+
+namespace envy {
+
+namespace {
+
+constexpr std::string_view kHeader{ "envy-spec-meta 2" };
+constexpr char kPruneMarker[]{ ".last-prune" };
+constexpr std::chrono::hours kPruneInterval{ 24 };
+
+// The hook spec_meta_execute replaced, called through for the events it asked for so a
+// profiler attached to the state keeps sampling.
+struct call_detector {
+  lua_Hook prev_hook{ nullptr };
+  int prev_mask{ 0 };
+  int prev_count{ 0 };
+  bool called_function{ false };
+};
+
+thread_local call_detector t_detector;
+
+int event_mask(int event) {
+  switch (event) {
+    case LUA_HOOKCALL:
+    case LUA_HOOKTAILCALL: return LUA_MASKCALL;
+    case LUA_HOOKRET: return LUA_MASKRET;
+    case LUA_HOOKLINE: return LUA_MASKLINE;
+    case LUA_HOOKCOUNT: return LUA_MASKCOUNT;
+    default: return 0;
+  }
+}
+
+void detect_calls_hook(lua_State *L, lua_Debug *ar) {
+  if (t_detector.prev_hook && (t_detector.prev_mask & event_mask(ar->event))) {
+    t_detector.prev_hook(L, ar);
+  }
+  if (ar->event != LUA_HOOKCALL && ar->event != LUA_HOOKTAILCALL) { return; }
+  if (lua_getinfo(L, "S", ar) && std::strcmp(ar->what, "main") == 0) { return; }
+  t_detector.called_function = true;
+}
+
+}  // namespace
+
+spec_execution spec_meta_execute(sol::state &lua,
+                                 std::string_view script,
+                                 std::string const &chunk_name) {
+  lua_State *L{ lua.lua_state() };
+
+  struct hook_guard {
+    lua_State *L;
+    call_detector const saved{ t_detector };
+    ~hook_guard() {
+      lua_sethook(L, t_detector.prev_hook, t_detector.prev_mask, t_detector.prev_count);
+      t_detector = saved;
+    }
+  } const guard{ L };
+
+  t_detector = { .prev_hook = lua_gethook(L),
+                 .prev_mask = lua_gethookmask(L),
+                 .prev_count = lua_gethookcount(L),
+                 .called_function = false };
+  lua_sethook(L,
+              detect_calls_hook,
+              t_detector.prev_mask | LUA_MASKCALL,
+              t_detector.prev_count);
+
+  sol::protected_function_result result{
+    lua.safe_script(script, sol::script_pass_on_error, chunk_name)
+  };
+  if (!result.valid()) {
+    sol::error err = result;
+    return { .error = std::string{ err.what() }, .pure = false };
+  }
+  return { .error = std::nullopt, .pure = !t_detector.called_function };
+}
+
+spec_meta_cache::spec_meta_cache(std::filesystem::path dir) : dir_{ std::move(dir) } {}
+
+blake3_t spec_meta_cache::key(std::string_view spec_bytes,
+                              std::string_view package_path_root) {
+  blake3_hasher hasher;
+  for (std::string_view const part : { kHeader,
+                                       std::string_view{ ENVY_VERSION_STR },
+                                       platform::os_name(),
+                                       platform::arch_name(),
+                                       package_path_root }) {
+    hasher.update(part.data(), part.size());
+    hasher.update("\0", 1);
+  }
+  hasher.update(spec_bytes.data(), spec_bytes.size());
+  return hasher.finalize();
+}
+
+std::filesystem::path spec_meta_cache::entry_path(blake3_t const &key) const {
+  return dir_ / util_bytes_to_hex(key.data(), key.size());
+}
+
+std::optional<std::string> spec_meta_cache::find(blake3_t const &key) const {
+  auto const path{ entry_path(key) };
+  std::ifstream in{ path, std::ios::binary };
+  if (!in) { return std::nullopt; }
+
+  constexpr std::string_view kIdentityTag{ "identity " };
+  std::string header, identity, end;
+  if (!std::getline(in, header) || header != kHeader || !std::getline(in, identity) ||
+      identity.size() <= kIdentityTag.size() || !identity.starts_with(kIdentityTag) ||
+      !std::getline(in, end) || end != "end") {
+    return std::nullopt;
+  }
+
+  std::error_code ec;
+  auto const now{ std::filesystem::file_time_type::clock::now() };
+  std::filesystem::last_write_time(path, now, ec);
+  return identity.substr(kIdentityTag.size());
+}
+
+void spec_meta_cache::store(blake3_t const &key, std::string_view identity) const {
+  // Entry lines are newline-delimited, so an identity containing one cannot be stored.
+  if (identity.find('\n') != std::string_view::npos) { return; }
+
+  auto const path{ entry_path(key) };
+  auto tmp{ path };
+  tmp += ".tmp-" + std::to_string(platform::get_process_id()) + "-" +
+         std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+  try {
+    std::filesystem::create_directories(dir_);
+    {
+      std::ofstream out{ tmp, std::ios::binary | std::ios::trunc };
+      out << kHeader << '\n' << "identity " << identity << '\n' << "end\n";
+      if (!out.flush()) {
+        throw std::runtime_error("spec_meta_cache: failed to write " + tmp.string());
+      }
+    }
+    platform::atomic_rename(tmp, path);
+  } catch (std::exception const &e) {
+    tui::debug("spec_meta_cache: not caching %s: %s", path.string().c_str(), e.what());
+    std::error_code ec;
+    std::filesystem::remove(tmp, ec);
+  }
+}
+
+void spec_meta_cache::prune(std::chrono::days max_age) const {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  auto const now{ fs::file_time_type::clock::now() };
+  auto const marker{ dir_ / kPruneMarker };
+
+  if (!fs::is_directory(dir_, ec)) { return; }
+  if (auto const last{ fs::last_write_time(marker, ec) };
+      !ec && now - last < kPruneInterval) {
+    return;
+  }
+
+  // Claim this round before scanning so concurrent processes skip it.
+  std::ofstream{ marker, std::ios::binary | std::ios::trunc };
+  fs::last_write_time(marker, now, ec);
+
+  std::size_t removed{ 0 };
+  for (fs::directory_iterator it{ dir_, ec }, end; !ec && it != end; it.increment(ec)) {
+    if (it->path().filename() == kPruneMarker) { continue; }
+    std::error_code entry_ec;
+    auto const written{ it->last_write_time(entry_ec) };
+    if (entry_ec || now - written < max_age) { continue; }
+    if (fs::remove(it->path(), entry_ec)) { ++removed; }
+  }
+  tui::debug("spec_meta_cache: pruned %zu entries from %s",
+             removed,
+             dir_.string().c_str());
+}
+
+}  // namespace envy
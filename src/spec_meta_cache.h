@@ -0,0 +1,63 @@
+#pragma once
+
+#include "blake3_util.h"
+#include "util.h"
+
+#include "sol/forward.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace envy {
+
+struct spec_execution {
+  std::optional<std::string> error;  // Lua error message, if the chunk failed
+  bool pure{ false };  // No function was called while the chunk ran
+};
+
+// Runs a spec's bytes as a chunk in `lua` with a call hook chained in front of any hook
+// already installed. A pure chunk only assigns literals, table constructors, function
+// definitions and reads of preinstalled globals, so its IDENTITY follows from the spec
+// bytes and envy's platform constants.
+spec_execution spec_meta_execute(sol::state &lua,
+                                 std::string_view script,
+                                 std::string const &chunk_name);
+
+// On-disk map from spec content to IDENTITY, one file per entry under `dir`
+// ($CACHE/spec-meta). Only pure specs are stored; everything else is evaluated every
+// time. Entries are written atomically and unreadable ones count as misses, so
+// concurrent envy processes may share the directory.
+class spec_meta_cache : unmovable {
+ public:
+  explicit spec_meta_cache(std::filesystem::path dir);
+
+  static constexpr std::chrono::days kDefaultMaxAge{ 30 };
+
+  // BLAKE3 over the entry format version, the envy version, envy.PLATFORM_ARCH, the
+  // bundle root extract_spec_identity prepends to package.path (a pure spec may read it)
+  // and the spec bytes.
+  static blake3_t key(std::string_view spec_bytes,
+                      std::string_view package_path_root = {});
+
+  // A hit refreshes the entry's modification time, which prune() goes by.
+  std::optional<std::string> find(blake3_t const &key) const;
+
+  // Best effort: a write failure is logged at debug level and otherwise ignored.
+  void store(blake3_t const &key, std::string_view identity) const;
+
+  // Removes entries (and stray temp files) unused for max_age. Runs at most once a day
+  // per cache directory; later calls return at once. Best effort, never throws.
+  void prune(std::chrono::days max_age = kDefaultMaxAge) const;
+
+  std::filesystem::path const &dir() const { return dir_; }
+
+ private:
+  std::filesystem::path entry_path(blake3_t const &key) const;
+
+  std::filesystem::path dir_;
+};
+
+}  // namespace envy
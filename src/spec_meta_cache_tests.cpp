@@ -0,0 +1,294 @@
+#include "spec_meta_cache.h"
+
+#include "bundle.h"
+#include "lua_state_pool.h"
+#include "spec_util.h"
+
+#include "doctest.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct temp_dir {
+  fs::path path;
+  explicit temp_dir(char const *name) : path{ fs::temp_directory_path() / name } {
+    fs::remove_all(path);
+    fs::create_directories(path);
+  }
+  ~temp_dir() {
+    std::error_code ec;
+    fs::remove_all(path, ec);
+  }
+};
+
+void write_file(fs::path const &path, std::string const &content) {
+  fs::create_directories(path.parent_path());
+  std::ofstream{ path, std::ios::binary } << content;
+}
+
+envy::spec_execution execute(sol::state &lua, std::string const &script) {
+  return envy::spec_meta_execute(lua, script, "=spec");
+}
+
+std::size_t entry_count(fs::path const &dir) {
+  if (!fs::exists(dir)) { return 0; }
+  return static_cast<std::size_t>(
+      std::distance(fs::directory_iterator{ dir }, fs::directory_iterator{}));
+}
+
+constexpr char kPureSpec[]{ R"lua(
+IDENTITY = "acme.tool@v1"
+DEPENDENCIES = {
+  "acme.base@v1",
+  { spec = "acme.lib@v2", source = "lib.lua" },
+  { bundle = "acme.helpers@v1", source = "https://example.com/helpers.zip" },
+  42,
+}
+PRODUCTS = { tool = "bin/tool", ["tool-config"] = "bin/tool-config" }
+FETCH = { source = "https://example.com/tool-" .. envy.PLATFORM .. ".tar.gz" }
+BUILD = "make"
+INSTALL = function(install_dir) end
+)lua" };
+
+}  // namespace
+
+TEST_CASE("spec_meta_execute reports a literal-only spec as pure") {
+  envy::lua_state_pool::lease const lua;
+  auto const run{ execute(*lua, kPureSpec) };
+  CHECK_FALSE(run.error);
+  CHECK(run.pure);
+}
+
+TEST_CASE("spec_meta_execute reports function calls as dynamic") {
+  char const *const scripts[]{
+    R"lua(IDENTITY = "acme.tool@v1"; SHA = string.rep("a", 64))lua",
+    R"lua(IDENTITY = ("acme.tool@v1"):lower())lua",
+    R"lua(IDENTITY = "acme.tool@v" .. math.floor(1.5))lua",
+    R"lua(local function id() return "acme.tool@v1" end; IDENTITY = id())lua",
+    R"lua(IDENTITY = setmetatable({}, { __tostring = function() return "x" end }))lua",
+  };
+  for (auto const *script : scripts) {
+    CAPTURE(script);
+    envy::lua_state_pool::lease const lua;
+    auto const run{ execute(*lua, script) };
+    CHECK_FALSE(run.error);
+    CHECK_FALSE(run.pure);
+  }
+}
+
+TEST_CASE("spec_meta_execute returns Lua errors") {
+  envy::lua_state_pool::lease const lua;
+  auto const run{ execute(*lua, "IDENTITY = ") };
+  REQUIRE(run.error);
+  CHECK_FALSE(run.pure);
+}
+
+TEST_CASE("spec_meta_execute chains and restores an installed hook") {
+  static int counted{ 0 };
+  counted = 0;
+  lua_Hook const count_hook{ [](lua_State *, lua_Debug *) { ++counted; } };
+
+  envy::lua_state_pool::lease const lua;
+  lua_State *L{ lua->lua_state() };
+  lua_sethook(L, count_hook, LUA_MASKCOUNT, 1);
+
+  auto const run{ execute(*lua, R"lua(IDENTITY = ("acme.tool@v1"):lower())lua") };
+  CHECK_FALSE(run.error);
+  CHECK_FALSE(run.pure);
+  CHECK(counted > 0);
+  CHECK(lua_gethook(L) == count_hook);
+  CHECK(lua_gethookmask(L) == LUA_MASKCOUNT);
+  CHECK(lua_gethookcount(L) == 1);
+  lua_sethook(L, nullptr, 0, 0);
+}
+
+TEST_CASE("spec_meta_cache round-trips entries") {
+  temp_dir const dir{ "envy-spec-meta-roundtrip" };
+  envy::spec_meta_cache const cache{ dir.path / "spec-meta" };
+  auto const key{ envy::spec_meta_cache::key("spec a") };
+
+  CHECK_FALSE(cache.find(key));
+  cache.store(key, "acme.tool@v1");
+  CHECK(cache.find(key) == "acme.tool@v1");
+
+  cache.store(envy::spec_meta_cache::key("spec b"), "bad\nidentity");
+  CHECK(entry_count(cache.dir()) == 1);
+}
+
+TEST_CASE("spec_meta_cache treats corrupt and truncated entries as misses") {
+  temp_dir const dir{ "envy-spec-meta-corrupt" };
+  envy::spec_meta_cache const cache{ dir.path };
+  auto const key{ envy::spec_meta_cache::key("spec") };
+  cache.store(key, "acme.tool@v1");
+
+  fs::path const entry{ *fs::directory_iterator{ dir.path } };
+  std::string content;
+  {
+    std::ifstream in{ entry, std::ios::binary };
+    content.assign(std::istreambuf_iterator<char>{ in }, {});
+  }
+
+  SUBCASE("truncated") { write_file(entry, content.substr(0, content.find("end"))); }
+  SUBCASE("foreign header") { write_file(entry, "envy-spec-meta 1\nidentity x\nend\n"); }
+  SUBCASE("unknown tag") { write_file(entry, "envy-spec-meta 2\nmystery x\nend\n"); }
+  SUBCASE("empty identity") { write_file(entry, "envy-spec-meta 2\nidentity \nend\n"); }
+
+  CHECK_FALSE(cache.find(key));
+}
+
+TEST_CASE("spec_meta_cache prunes entries unused for max_age") {
+  temp_dir const dir{ "envy-spec-meta-prune" };
+  envy::spec_meta_cache const cache{ dir.path };
+  auto const fresh{ envy::spec_meta_cache::key("fresh") };
+  auto const stale{ envy::spec_meta_cache::key("stale") };
+  auto const used{ envy::spec_meta_cache::key("used") };
+  cache.store(fresh, "acme.fresh@v1");
+  cache.store(stale, "acme.stale@v1");
+  cache.store(used, "acme.used@v1");
+
+  auto const age_all{ [&] {
+    auto const long_ago{ fs::file_time_type::clock::now() - std::chrono::days{ 60 } };
+    for (auto const &e : fs::directory_iterator{ dir.path }) {
+      if (e.path().filename() == ".last-prune") { continue; }
+      fs::last_write_time(e.path(), long_ago);
+    }
+  } };
+
+  age_all();
+  cache.store(fresh, "acme.fresh@v1");
+  CHECK(cache.find(used));  // A hit counts as a use
+
+  cache.prune();
+  CHECK(cache.find(fresh));
+  CHECK(cache.find(used));
+  CHECK_FALSE(cache.find(stale));
+  CHECK(entry_count(dir.path) == 3);  // fresh, used and the prune marker
+
+  // A second prune within a day does nothing.
+  age_all();
+  cache.prune();
+  CHECK(entry_count(dir.path) == 3);
+}
+
+TEST_CASE("spec_meta_cache key depends on the spec bytes") {
+  CHECK(envy::spec_meta_cache::key("IDENTITY = 'a'") ==
+        envy::spec_meta_cache::key("IDENTITY = 'a'"));
+  CHECK(envy::spec_meta_cache::key("IDENTITY = 'a'") !=
+        envy::spec_meta_cache::key("IDENTITY = 'a' "));
+  CHECK(envy::spec_meta_cache::key("IDENTITY = 'a'", "/bundles/a") !=
+        envy::spec_meta_cache::key("IDENTITY = 'a'", "/bundles/b"));
+}
+
+TEST_CASE("extract_spec_identity answers pure specs from the cache") {
+  temp_dir const dir{ "envy-spec-meta-extract" };
+  envy::spec_meta_cache const cache{ dir.path / "spec-meta" };
+  fs::path const spec{ dir.path / "tool.lua" };
+  write_file(spec, "IDENTITY = \"acme.tool@v1\"\n");
+
+  CHECK(envy::extract_spec_identity(spec, {}, &cache) == "acme.tool@v1");
+  CHECK(entry_count(cache.dir()) == 1);
+
+  // Overwrite the stored entry: a cache hit must return it without running the spec.
+  cache.store(envy::spec_meta_cache::key("IDENTITY = \"acme.tool@v1\"\n"),
+              "from.cache@v1");
+  CHECK(envy::extract_spec_identity(spec, {}, &cache) == "from.cache@v1");
+
+  SUBCASE("editing the spec invalidates its entry") {
+    write_file(spec, "IDENTITY = \"acme.tool@v2\"\n");
+    CHECK(envy::extract_spec_identity(spec, {}, &cache) == "acme.tool@v2");
+    CHECK(entry_count(cache.dir()) == 2);
+  }
+
+  SUBCASE("without a cache the spec is run") {
+    CHECK(envy::extract_spec_identity(spec) == "acme.tool@v1");
+  }
+}
+
+TEST_CASE("extract_spec_identity keeps the same spec in different bundles apart") {
+  temp_dir const dir{ "envy-spec-meta-roots" };
+  envy::spec_meta_cache const cache{ dir.path / "spec-meta" };
+  // Pure, but its IDENTITY depends on the bundle root put on package.path.
+  std::string const content{ "IDENTITY = \"acme.tool\" .. #package.path .. \"@v1\"\n" };
+  fs::path const short_root{ dir.path / "a" };
+  fs::path const long_root{ dir.path / "bundle-b" };
+  write_file(short_root / "tool.lua", content);
+  write_file(long_root / "tool.lua", content);
+
+  auto const short_id{
+    envy::extract_spec_identity(short_root / "tool.lua", short_root, &cache)
+  };
+  auto const long_id{
+    envy::extract_spec_identity(long_root / "tool.lua", long_root, &cache)
+  };
+  CHECK(short_id != long_id);
+  CHECK(long_id == envy::extract_spec_identity(long_root / "tool.lua", long_root));
+  CHECK(entry_count(cache.dir()) == 2);
+}
+
+TEST_CASE("extract_spec_identity evaluates dynamic specs every time") {
+  temp_dir const dir{ "envy-spec-meta-dynamic" };
+  envy::spec_meta_cache const cache{ dir.path / "spec-meta" };
+  fs::path const spec{ dir.path / "tool.lua" };
+  write_file(spec, "IDENTITY = string.format(\"acme.%s@v1\", \"tool\")\n");
+
+  CHECK(envy::extract_spec_identity(spec, {}, &cache) == "acme.tool@v1");
+  CHECK(envy::extract_spec_identity(spec, {}, &cache) == "acme.tool@v1");
+  CHECK(entry_count(cache.dir()) == 0);
+}
+
+TEST_CASE("extract_spec_identity does not cache failing specs") {
+  temp_dir const dir{ "envy-spec-meta-failing" };
+  envy::spec_meta_cache const cache{ dir.path / "spec-meta" };
+  fs::path const spec{ dir.path / "tool.lua" };
+  write_file(spec, "IDENTITY = \"\"\n");
+
+  CHECK_THROWS_WITH_AS(envy::extract_spec_identity(spec, {}, &cache),
+                       doctest::Contains("IDENTITY cannot be empty"),
+                       std::runtime_error);
+  CHECK(entry_count(cache.dir()) == 0);
+}
+
+TEST_CASE("bundle::validate of 500 specs, cold vs warm spec-meta cache" *
+          doctest::skip()) {
+  constexpr int kSpecs{ 500 };
+  temp_dir const dir{ "envy-spec-meta-bench" };
+  fs::path const bundle_dir{ dir.path / "bundle" };
+
+  std::string specs_table;
+  for (int i{ 0 }; i < kSpecs; ++i) {
+    std::string const id{ "acme.tool" + std::to_string(i) + "@v1" };
+    std::string const file{ "specs/tool" + std::to_string(i) + ".lua" };
+    specs_table += "  [\"" + id + "\"] = \"" + file + "\",\n";
+    write_file(bundle_dir / file,
+               "IDENTITY = \"" + id + "\"\n" +
+                   "DEPENDENCIES = { \"acme.base@v1\" }\n" +
+                   "FETCH = { source = \"https://example.com/" + id + ".tar.gz\" }\n" +
+                   "INSTALL = function(install_dir) end\n");
+  }
+  write_file(bundle_dir / "envy-bundle.lua",
+             "BUNDLE = \"acme.tools@v1\"\nSPECS = {\n" + specs_table + "}\n");
+
+  auto const b{ envy::bundle::from_path(bundle_dir) };
+  envy::spec_meta_cache const cache{ dir.path / "spec-meta" };
+
+  auto const time_ms{ [&](envy::spec_meta_cache const *c) {
+    auto const start{ std::chrono::steady_clock::now() };
+    b.validate(c);
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                     start)
+        .count();
+  } };
+
+  double const uncached_ms{ time_ms(nullptr) };
+  double const cold_ms{ time_ms(&cache) };
+  double const warm_ms{ time_ms(&cache) };
+  MESSAGE(kSpecs << "-spec bundle validate: no cache " << uncached_ms << " ms, cold "
+                 << cold_ms << " ms, warm " << warm_ms << " ms");
+}
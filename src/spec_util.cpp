@@ -1,20 +1,34 @@
 #include "spec_util.h"
 
-#include "lua_envy.h"
-#include "sol_util.h"
+#include "lua_state_pool.h"
+#include "spec_meta_cache.h"
+#include "util.h"
 
+#include <optional>
 #include <stdexcept>
+#include <string_view>
+#include <utility>
 
 namespace envy {
 
 std::string extract_spec_identity(std::filesystem::path const &spec_path,
-                                  std::filesystem::path const &package_path_root) {
+                                  std::filesystem::path const &package_path_root,
+                                  spec_meta_cache const *meta_cache) {
   if (!std::filesystem::exists(spec_path)) {
     throw std::runtime_error("spec file not found: " + spec_path.string());
   }
 
-  auto lua{ sol_util_make_lua_state() };
-  lua_envy_install(*lua);
+  auto const content{ util_load_file(spec_path) };
+  std::string_view const script{ reinterpret_cast<char const *>(content.data()),
+                                 content.size() };
+
+  std::optional<blake3_t> cache_key;
+  if (meta_cache) {
+    cache_key = spec_meta_cache::key(script, package_path_root.string());
+    if (auto hit{ meta_cache->find(*cache_key) }) { return std::move(*hit); }
+  }
+
+  lua_state_pool::lease const lua;
 
   // Configure package.path for bundle-local requires if root provided
   if (!package_path_root.empty()) {
@@ -25,14 +39,10 @@ std::string extract_spec_identity(std::filesystem::path const &spec_path,
   }
 
   // Execute spec file
-  sol::protected_function_result result{
-    lua->safe_script_file(spec_path.string(), sol::script_pass_on_error)
-  };
-
-  if (!result.valid()) {
-    sol::error err = result;
+  auto const run{ spec_meta_execute(*lua, script, "@" + spec_path.string()) };
+  if (run.error) {
     throw std::runtime_error("failed to execute spec '" + spec_path.string() +
-                             "': " + err.what());
+                             "': " + *run.error);
   }
 
   // Extract IDENTITY
@@ -55,6 +65,8 @@ std::string extract_spec_identity(std::filesystem::path const &spec_path,
                              "': IDENTITY cannot be empty");
   }
 
+  if (cache_key && run.pure) { meta_cache->store(*cache_key, identity); }
+
   return identity;
 }
 
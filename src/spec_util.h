@@ -5,6 +5,8 @@
 
 namespace envy {
 
+class spec_meta_cache;
+
 // Extract the IDENTITY field from a spec file by executing it in a temporary Lua state.
 // Returns the IDENTITY string or throws std::runtime_error on:
 // - File not found
@@ -14,7 +16,12 @@ namespace envy {
 //
 // If package_path_root is non-empty, configures Lua's package.path to enable
 // bundle-local requires (e.g., for specs that use require("lib.helpers")).
+//
+// With a meta_cache, a spec whose bytes were seen before as a pure spec (see
+// spec_meta_execute) is answered from the cache without running it; a pure spec that
+// has to run is stored for next time.
 std::string extract_spec_identity(std::filesystem::path const &spec_path,
-                                  std::filesystem::path const &package_path_root = {});
+                                  std::filesystem::path const &package_path_root = {},
+                                  spec_meta_cache const *meta_cache = nullptr);
 
 }  // namespace envy
@@ -3,12 +3,18 @@
 #include "pkg_phase.h"
 #include "util.h"
 
+#include "picojson.h"
+
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
 #include <ctime>
+#include <fstream>
+#include <stdexcept>
 #include <string>
 #include <type_traits>
+#include <unordered_map>
 
 namespace envy {
 
@@ -68,6 +74,41 @@ void append_json_kv(std::string &out, std::string_view key, bool value) {
   out.append(value ? "true" : "false");
 }
 
+// Inverse of format_timestamp: "2025-01-15T10:30:00.123Z".
+std::chrono::system_clock::time_point parse_timestamp(std::string const &text) {
+  int y{}, mo{}, d{}, h{}, mi{}, sec{}, ms{};
+  if (std::sscanf(text.c_str(),
+                  "%d-%d-%dT%d:%d:%d.%dZ",
+                  &y,
+                  &mo,
+                  &d,
+                  &h,
+                  &mi,
+                  &sec,
+                  &ms) != 7) {
+    throw std::runtime_error("trace: invalid timestamp: " + text);
+  }
+  std::chrono::year_month_day const date{ std::chrono::year{ y },
+                                          std::chrono::month{ static_cast<unsigned>(mo) },
+                                          std::chrono::day{ static_cast<unsigned>(d) } };
+  if (!date.ok()) { throw std::runtime_error("trace: invalid timestamp: " + text); }
+  return std::chrono::sys_days{ date } + std::chrono::hours{ h } +
+         std::chrono::minutes{ mi } + std::chrono::seconds{ sec } +
+         std::chrono::milliseconds{ ms };
+}
+
+trace_event_t make_trace_event(std::string const &name) {
+  static std::unordered_map<std::string, trace_event_t (*)()> const factories{
+#define ENVY_TRACE_EVENT(name, fields) \
+  { #name, [] { return trace_event_t{ trace_events::name{} }; } },
+#include "trace_events.def"
+#undef ENVY_TRACE_EVENT
+  };
+  auto const it{ factories.find(name) };
+  if (it == factories.end()) { throw std::runtime_error("trace: unknown event: " + name); }
+  return it->second();
+}
+
 }  // namespace
 
 phase_trace_scope::phase_trace_scope(std::string pkg_identity,
@@ -157,6 +198,90 @@ std::string trace_record_to_json(trace_record const &rec) {
   return out;
 }
 
+trace_record trace_record_from_json(std::string_view line) {
+  picojson::value root;
+  std::string const err{ picojson::parse(root, std::string{ line }) };
+  if (!err.empty() || !root.is<picojson::object>()) {
+    throw std::runtime_error("trace: invalid JSON record: " + std::string{ line });
+  }
+  auto const &obj{ root.get<picojson::object>() };
+
+  auto const member{ [&](char const *key) -> picojson::value const * {
+    auto const it{ obj.find(key) };
+    return it == obj.end() ? nullptr : &it->second;
+  } };
+  auto const required{ [&](char const *key, bool number) -> picojson::value const & {
+    auto const *value{ member(key) };
+    if (!value || (number ? !value->is<double>() : !value->is<std::string>())) {
+      throw std::runtime_error(std::string{ "trace: record lacks '" } + key +
+                               "': " + std::string{ line });
+    }
+    return *value;
+  } };
+
+  trace_record rec{
+    .seq = static_cast<std::uint64_t>(required("seq", true).get<double>()),
+    .ts = parse_timestamp(required("ts", false).get<std::string>()),
+    .tid = static_cast<std::uint32_t>(required("tid", true).get<double>()),
+    .spec = {},
+    .event = make_trace_event(required("event", false).get<std::string>()),
+  };
+  if (auto const *spec{ member("spec") }; spec && spec->is<std::string>()) {
+    rec.spec = spec->get<std::string>();
+  }
+
+  std::visit(
+      [&](auto &e) {
+        trace_event_for_each_field(e, [&](std::string_view key, auto &value) {
+          auto const *field{ member(std::string{ key }.c_str()) };
+          if (!field) { return; }
+          using T = std::remove_cvref_t<decltype(value)>;
+          if constexpr (std::is_same_v<T, pkg_phase>) {
+            auto const phase{ field->is<std::string>()
+                                  ? pkg_phase_parse(field->get<std::string>())
+                                  : std::nullopt };
+            if (!phase) {
+              throw std::runtime_error("trace: invalid phase in: " + std::string{ line });
+            }
+            value = *phase;
+          } else {
+            using json_t = std::conditional_t<std::is_same_v<T, std::int64_t>, double, T>;
+            if (!field->is<json_t>()) {
+              throw std::runtime_error("trace: wrong type for '" + std::string{ key } +
+                                       "': " + std::string{ line });
+            }
+            value = static_cast<T>(field->get<json_t>());
+          }
+        });
+      },
+      rec.event);
+
+  return rec;
+}
+
+std::vector<trace_record> trace_read_jsonl(std::filesystem::path const &path) {
+  std::ifstream in{ path, std::ios::binary };
+  if (!in) { throw std::runtime_error("trace: cannot open " + path.string()); }
+
+  std::vector<trace_record> records;
+  std::string line;
+  for (std::size_t line_no{ 1 }; std::getline(in, line); ++line_no) {
+    if (!line.empty() && line.back() == '\r') { line.pop_back(); }
+    if (line.empty()) { continue; }
+    try {
+      records.push_back(trace_record_from_json(line));
+    } catch (std::exception const &e) {
+      throw std::runtime_error(path.string() + ":" + std::to_string(line_no) + ": " +
+                               e.what());
+    }
+  }
+
+  std::stable_sort(records.begin(), records.end(), [](auto const &a, auto const &b) {
+    return a.seq < b.seq;
+  });
+  return records;
+}
+
 std::vector<trace_event_schema> trace_schema() {
   std::vector<trace_event_schema> out;
   out.reserve(kTraceEventCount);
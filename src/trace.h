@@ -3,6 +3,7 @@
 #include "pkg_phase.h"
 
 #include <chrono>
+#include <filesystem>
 #include <cstdint>
 #include <string>
 #include <string_view>
@@ -37,6 +38,7 @@ namespace trace_events {
 }  // namespace trace_events
 
 using trace_event_t = std::variant<trace_events::trace_start,
+                                   trace_events::trace_dropped,
                                    trace_events::spec_registered,
                                    trace_events::dependency_added,
                                    trace_events::phase_start,
@@ -52,6 +54,7 @@ using trace_event_t = std::variant<trace_events::trace_start,
                                    trace_events::lua_ctx_package_access,
                                    trace_events::lua_ctx_product_access,
                                    trace_events::lua_ctx_loadenv_spec_access,
+                                   trace_events::lua_memory,
                                    trace_events::depot_check,
                                    trace_events::product_resolved,
                                    trace_events::deploy_script,
@@ -62,7 +65,9 @@ using trace_event_t = std::variant<trace_events::trace_start,
                                    trace_events::download_skipped,
                                    trace_events::git_resolve,
                                    trace_events::extract_start,
-                                   trace_events::extract_complete>;
+                                   trace_events::extract_complete,
+                                   trace_events::shell_command_usage,
+                                   trace_events::shell_phase_usage>;
 
 inline constexpr std::size_t kTraceEventCount{ 0
 #define ENVY_TRACE_EVENT(name, fields) +1
@@ -74,7 +79,8 @@ static_assert(std::variant_size_v<trace_event_t> == kTraceEventCount,
               "trace_events.def and trace_event_t are out of sync");
 
 // Per-event name + field visitor, generated from trace_events.def. The JSON and
-// human serializers both consume trace_event_for_each_field so they cannot drift.
+// human serializers both consume trace_event_for_each_field so they cannot drift;
+// the non-const overload lets the JSON reader fill fields by the same names.
 #define ENVY_TRACE_FIELD_STR(f) fn(#f, e.f);
 #define ENVY_TRACE_FIELD_I64(f) fn(#f, e.f);
 #define ENVY_TRACE_FIELD_BOOL(f) fn(#f, e.f);
@@ -86,6 +92,10 @@ static_assert(std::variant_size_v<trace_event_t> == kTraceEventCount,
   template <typename Fn> \
   void trace_event_for_each_field(trace_events::name const &e, Fn &&fn) { \
     fields \
+  } \
+  template <typename Fn> \
+  void trace_event_for_each_field(trace_events::name &e, Fn &&fn) { \
+    fields \
   }
 #include "trace_events.def"
 #undef ENVY_TRACE_EVENT
@@ -109,6 +119,14 @@ std::string_view trace_event_name(trace_event_t const &event);
 std::string trace_record_to_string(trace_record const &rec);  // human key=value
 std::string trace_record_to_json(trace_record const &rec);    // JSONL
 
+// Reads back one line written by trace_record_to_json (timestamps keep their ms
+// precision). Fields missing from the line keep their defaults so older traces still
+// load; throws std::runtime_error on malformed JSON or an unknown event.
+trace_record trace_record_from_json(std::string_view line);
+
+// Every record of a JSONL trace file, in seq order. Errors name the offending line.
+std::vector<trace_record> trace_read_jsonl(std::filesystem::path const &path);
+
 // Schema registry (for the trace-schema dump + registry-sync tests).
 struct trace_event_schema {
   std::string_view name;
@@ -0,0 +1,481 @@
+#include "trace_analyze.h"
+
+#include "pkg_phase.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <map>
+#include <optional>
+#include <set>
+#include <utility>
+
+namespace envy {
+
+namespace {
+
+struct interval {
+  std::int64_t start;
+  std::int64_t end;
+};
+
+// A phase the package ran, or a dependency wait that held it up.
+struct item {
+  interval span;
+  std::optional<pkg_phase> phase;  // Empty for a wait
+  std::string dependency;          // Waits only
+};
+
+struct pkg_state {
+  std::vector<item> items;
+  std::vector<std::pair<trace_activity, interval>> activities;
+  std::vector<std::pair<std::string, pkg_phase>> dependencies;  // Dependency, needed_by
+  std::optional<std::pair<std::string, std::int64_t>> added_by;  // First parent, when
+  std::optional<std::pair<pkg_phase, std::int64_t>> open_phase;
+  std::map<std::string, std::pair<std::int64_t, std::uint64_t>> open_waits;
+  std::map<std::string, std::int64_t> open_downloads;  // By url
+  std::map<std::string, std::int64_t> open_extracts;   // By archive
+  std::uint64_t phases_done{ 0 };
+  std::string outcome;
+};
+
+std::int64_t duration(interval const &i) {
+  return std::max<std::int64_t>(i.end - i.start, 0);
+}
+
+// Splits `span` by the activities overlapping it; uncovered time is `rest`.
+trace_analysis::breakdown split(
+    std::vector<std::pair<trace_activity, interval>> const &activities,
+    interval span,
+    trace_activity rest) {
+  std::vector<std::int64_t> cuts{ span.start, span.end };
+  for (auto const &[a, i] : activities) {
+    if (i.start > span.start && i.start < span.end) { cuts.push_back(i.start); }
+    if (i.end > span.start && i.end < span.end) { cuts.push_back(i.end); }
+  }
+  std::sort(cuts.begin(), cuts.end());
+  cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+
+  trace_analysis::breakdown out{};
+  for (std::size_t k{ 1 }; k < cuts.size(); ++k) {
+    trace_activity best{ rest };
+    for (auto const &[a, i] : activities) {
+      if (i.start <= cuts[k - 1] && i.end >= cuts[k] && a < best) { best = a; }
+    }
+    out[static_cast<int>(best)] += cuts[k] - cuts[k - 1];
+  }
+  return out;
+}
+
+void add_to(trace_analysis::breakdown &into, trace_analysis::breakdown const &from) {
+  for (int k{ 0 }; k < kTraceActivityCount; ++k) { into[k] += from[k]; }
+}
+
+// Package identities and descriptions have no length limit, so size the text first.
+void appendf(std::string &out, char const *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  va_list measure;
+  va_copy(measure, args);
+  int const n{ std::vsnprintf(nullptr, 0, fmt, measure) };
+  va_end(measure);
+  if (n > 0) {
+    auto const start{ out.size() };
+    out.resize(start + static_cast<std::size_t>(n) + 1);  // vsnprintf writes the NUL
+    std::vsnprintf(out.data() + start, static_cast<std::size_t>(n) + 1, fmt, args);
+    out.resize(start + static_cast<std::size_t>(n));
+  }
+  va_end(args);
+}
+
+std::string seconds(std::int64_t ms) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.3fs", static_cast<double>(ms) / 1e3);
+  return buf;
+}
+
+class analyzer {
+ public:
+  explicit analyzer(std::vector<trace_record> const &records) {
+    for (auto const &rec : records) { add(rec); }
+    for (auto &[spec, p] : pkgs_) {
+      if (p.open_phase) {  // Never completed: ends with the run
+        p.items.push_back({ .span = { p.open_phase->second, last_ms_ },
+                            .phase = p.open_phase->first });
+      }
+      std::sort(p.items.begin(), p.items.end(), [](item const &a, item const &b) {
+        return a.span.start < b.span.start;
+      });
+    }
+  }
+
+  trace_analysis run() {
+    out_.wall_ms = last_ms_;
+    walk_critical_path();
+    summarize_packages();
+    find_opportunities();
+    return std::move(out_);
+  }
+
+ private:
+  void add(trace_record const &rec) {
+    namespace ev = trace_events;
+
+    if (!origin_) { origin_ = rec.ts; }
+    std::int64_t const ts{ std::max<std::int64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(rec.ts - *origin_).count(),
+        0) };
+    last_ms_ = std::max(last_ms_, ts);
+    if (rec.spec.empty()) { return; }
+    auto &p{ pkgs_[rec.spec] };
+    auto const activity{ [&](trace_activity a, std::int64_t start) {
+      p.activities.emplace_back(a, interval{ std::max<std::int64_t>(start, 0), ts });
+    } };
+
+    if (auto const *e{ std::get_if<ev::phase_start>(&rec.event) }) {
+      if (p.open_phase) {
+        p.items.push_back({ .span = { p.open_phase->second, ts },
+                            .phase = p.open_phase->first });
+      }
+      p.open_phase.emplace(e->phase, ts);
+    } else if (auto const *e{ std::get_if<ev::phase_complete>(&rec.event) }) {
+      std::int64_t const start{ p.open_phase && p.open_phase->first == e->phase
+                                    ? p.open_phase->second
+                                    : std::max<std::int64_t>(ts - e->duration_ms, 0) };
+      p.open_phase.reset();
+      p.items.push_back({ .span = { start, ts }, .phase = e->phase });
+      ++p.phases_done;
+    } else if (auto const *e{ std::get_if<ev::phase_blocked>(&rec.event) }) {
+      p.open_waits.insert_or_assign(e->waiting_for,
+                                    std::pair{ ts, pkgs_[e->waiting_for].phases_done });
+    } else if (auto const *e{ std::get_if<ev::phase_unblocked>(&rec.event) }) {
+      // The engine re-checks every edge before each step; only a wait during which the
+      // dependency finished a phase actually held the package up.
+      auto const it{ p.open_waits.find(e->dependency) };
+      if (it == p.open_waits.end()) { return; }
+      auto const [start, done_before]{ it->second };
+      p.open_waits.erase(it);
+      if (pkgs_[e->dependency].phases_done != done_before) {
+        p.items.push_back({ .span = { start, ts }, .dependency = e->dependency });
+      }
+    } else if (auto const *e{ std::get_if<ev::dependency_added>(&rec.event) }) {
+      p.dependencies.emplace_back(e->dependency, e->needed_by);
+      auto &dep{ pkgs_[e->dependency] };
+      if (!dep.added_by) { dep.added_by.emplace(rec.spec, ts); }
+    } else if (auto const *e{ std::get_if<ev::lock_acquired>(&rec.event) }) {
+      activity(trace_activity::lock, ts - e->wait_duration_ms);
+    } else if (auto const *e{ std::get_if<ev::download_start>(&rec.event) }) {
+      p.open_downloads[e->url] = ts;
+    } else if (auto const *e{ std::get_if<ev::download_complete>(&rec.event) }) {
+      auto const it{ p.open_downloads.find(e->url) };
+      activity(trace_activity::network,
+               it != p.open_downloads.end() ? it->second : ts - e->duration_ms);
+      if (it != p.open_downloads.end()) { p.open_downloads.erase(it); }
+    } else if (auto const *e{ std::get_if<ev::download_failed>(&rec.event) }) {
+      if (auto const it{ p.open_downloads.find(e->url) }; it != p.open_downloads.end()) {
+        activity(trace_activity::network, it->second);
+        p.open_downloads.erase(it);
+      }
+    } else if (auto const *e{ std::get_if<ev::extract_start>(&rec.event) }) {
+      p.open_extracts[e->archive] = ts;
+    } else if (auto const *e{ std::get_if<ev::extract_complete>(&rec.event) }) {
+      auto const it{ p.open_extracts.find(e->archive) };
+      activity(trace_activity::extract,
+               it != p.open_extracts.end() ? it->second : ts - e->duration_ms);
+      if (it != p.open_extracts.end()) { p.open_extracts.erase(it); }
+    } else if (auto const *e{ std::get_if<ev::shell_command_usage>(&rec.event) }) {
+      activity(trace_activity::shell, ts - e->wall_ms);  // Reported when it exits
+    } else if (auto const *e{ std::get_if<ev::pkg_outcome>(&rec.event) }) {
+      p.outcome = e->outcome;
+    }
+  }
+
+  void push_step(std::string const &spec, std::string what, interval span) {
+    if (span.end <= span.start) { return; }
+    trace_analysis::step s{ .spec = spec,
+                            .what = std::move(what),
+                            .start_ms = span.start,
+                            .end_ms = span.end };
+    if (s.what == "idle") {
+      s.time_ms[static_cast<int>(trace_activity::idle)] = duration(span);
+    } else if (spec.empty()) {
+      s.time_ms[static_cast<int>(trace_activity::other)] = duration(span);
+    } else {
+      s.time_ms = split(pkgs_[spec].activities, span, trace_activity::other);
+    }
+    out_.critical_path.push_back(std::move(s));
+  }
+
+  // Walks back from the package that finished last. Inside a package the path runs
+  // through its phases; a wait hands it to the dependency that released the wait, and a
+  // package's start hands it to the parent that discovered it.
+  void walk_critical_path() {
+    std::string spec;
+    std::int64_t t{ 0 };
+    for (auto const &[s, p] : pkgs_) {
+      if (!p.items.empty() && (spec.empty() || end_of(p) > t)) {
+        spec = s;
+        t = end_of(p);
+      }
+    }
+    if (spec.empty()) {
+      push_step("", "startup", { 0, last_ms_ });
+      return;
+    }
+
+    std::set<std::pair<std::string, std::int64_t>> seen;  // Guards against cycles
+    while (seen.emplace(spec, t).second) {
+      auto &p{ pkgs_[spec] };
+      item const *prev{ nullptr };
+      for (auto const &i : p.items) {
+        if (i.span.start < t && (!prev || i.span.start > prev->span.start ||
+                                 (i.span.start == prev->span.start &&
+                                  i.span.end > prev->span.end))) {
+          prev = &i;
+        }
+      }
+
+      if (!prev) {
+        if (p.added_by && p.added_by->second <= t) {
+          push_step(spec, "idle", { p.added_by->second, t });
+          t = p.added_by->second;
+          spec = p.added_by->first;
+          continue;
+        }
+        push_step("", "startup", { 0, t });
+        break;
+      }
+
+      std::int64_t const end{ std::min(prev->span.end, t) };
+      push_step(spec, "idle", { end, t });
+      t = end;
+      if (!prev->phase) {
+        waits_.push_back({ spec, prev->dependency, { prev->span.start, end } });
+        spec = prev->dependency;
+        continue;
+      }
+      push_step(spec,
+                std::string{ pkg_phase_name(*prev->phase) },
+                { prev->span.start, t });
+      t = prev->span.start;
+    }
+
+    auto &path{ out_.critical_path };
+    std::reverse(path.begin(), path.end());
+    std::vector<trace_analysis::step> merged;
+    for (auto &s : path) {
+      auto *last{ merged.empty() ? nullptr : &merged.back() };
+      if (last && last->spec == s.spec && last->what == s.what &&
+          last->end_ms == s.start_ms) {
+        last->end_ms = s.end_ms;
+        add_to(last->time_ms, s.time_ms);
+      } else {
+        merged.push_back(std::move(s));
+      }
+    }
+    path = std::move(merged);
+    for (auto const &s : path) { add_to(out_.critical_ms, s.time_ms); }
+  }
+
+  // Slack: a dependency may end as late as its consumers start the phase that needs it,
+  // plus their own slack; a package nothing depends on may end as late as the run does.
+  std::int64_t slack(std::string const &spec, std::set<std::string> &visiting) {
+    if (auto const it{ slack_.find(spec) }; it != slack_.end()) { return it->second; }
+    auto const &p{ pkgs_.at(spec) };
+    if (p.items.empty() || !visiting.insert(spec).second) { return 0; }
+
+    std::int64_t const end{ end_of(p) };
+    std::int64_t latest{ last_ms_ };
+    for (auto const &[consumer_spec, consumer] : pkgs_) {
+      for (auto const &[dep, needed_by] : consumer.dependencies) {
+        if (dep != spec || consumer.items.empty()) { continue; }
+        std::int64_t needed_at{ end_of(consumer) };
+        for (auto const &i : consumer.items) {
+          if (i.phase && *i.phase >= needed_by) {
+            needed_at = std::min(needed_at, i.span.start);
+          }
+        }
+        latest = std::min(latest, needed_at + slack(consumer_spec, visiting));
+      }
+    }
+    visiting.erase(spec);
+    return slack_[spec] = std::max<std::int64_t>(latest - end, 0);
+  }
+
+  static std::int64_t end_of(pkg_state const &p) {
+    std::int64_t end{ 0 };
+    for (auto const &i : p.items) { end = std::max(end, i.span.end); }
+    return end;
+  }
+
+  void summarize_packages() {
+    for (auto const &[spec, p] : pkgs_) {
+      if (p.items.empty()) { continue; }
+      trace_analysis::package out{ .spec = spec,
+                                   .outcome = p.outcome,
+                                   .start_ms = p.items.front().span.start,
+                                   .end_ms = end_of(p) };
+      std::set<std::string> visiting;
+      out.slack_ms = slack(spec, visiting);
+      std::int64_t covered{ 0 };
+      for (auto const &i : p.items) {
+        if (i.phase) {
+          add_to(out.time_ms, split(p.activities, i.span, trace_activity::other));
+          out_.busy_ms += duration(i.span);
+        } else {
+          out.time_ms[static_cast<int>(trace_activity::dependency)] += duration(i.span);
+        }
+        covered += duration(i.span);
+      }
+      out.time_ms[static_cast<int>(trace_activity::idle)] =
+          std::max<std::int64_t>(out.end_ms - out.start_ms - covered, 0);
+      for (auto const &s : out_.critical_path) {
+        if (s.spec == spec) { out.critical_ms += s.end_ms - s.start_ms; }
+      }
+      out_.packages.push_back(std::move(out));
+    }
+    std::stable_sort(out_.packages.begin(),
+                     out_.packages.end(),
+                     [](auto const &a, auto const &b) { return a.start_ms < b.start_ms; });
+  }
+
+  void find_opportunities() {
+    auto &ops{ out_.opportunities };
+    std::map<std::string, std::pair<std::int64_t, std::int64_t>> by_spec;  // Build, lock
+    std::int64_t idle{ 0 };
+    for (auto const &s : out_.critical_path) {
+      if (s.what == "idle") { idle += s.end_ms - s.start_ms; }
+      if (s.spec.empty()) { continue; }
+      auto const phase{ pkg_phase_parse(s.what) };
+      if (phase && *phase >= pkg_phase::pkg_fetch && *phase <= pkg_phase::pkg_install) {
+        by_spec[s.spec].first += s.end_ms - s.start_ms;
+      }
+      by_spec[s.spec].second += s.time_ms[static_cast<int>(trace_activity::lock)];
+    }
+
+    for (auto const &[spec, saving] : by_spec) {
+      auto const &outcome{ pkgs_.at(spec).outcome };
+      if (saving.first > 0 && outcome != "cache_hit" && outcome != "imported") {
+        ops.push_back({ "depot hit for " + spec + " (skips fetch, stage, build, install)",
+                        saving.first });
+      }
+      if (saving.second > 0) {
+        ops.push_back({ "no lock contention on " + spec + "'s cache entry",
+                        saving.second });
+      }
+    }
+
+    // A wait on the path overlapped the dependency's work. Needing the dependency one
+    // phase later lets the consumer run its blocked phases meanwhile.
+    for (auto const &w : waits_) {
+      std::int64_t later_work{ 0 };
+      for (auto const &i : pkgs_.at(w.consumer).items) {
+        if (i.phase && i.span.start >= w.span.end) { later_work += duration(i.span); }
+      }
+      std::int64_t const saving{ std::min(duration(w.span), later_work) };
+      if (saving > 0) {
+        ops.push_back({ w.consumer + " needing " + w.dependency + " at a later phase",
+                        saving });
+      }
+    }
+
+    if (idle > 0) {
+      ops.push_back(
+          { "more parallelism: the critical path sat idle between steps", idle });
+    }
+
+    std::stable_sort(ops.begin(), ops.end(), [](auto const &a, auto const &b) {
+      return a.saving_ms > b.saving_ms;
+    });
+  }
+
+  struct path_wait {
+    std::string consumer;
+    std::string dependency;
+    interval span;
+  };
+
+  std::optional<std::chrono::system_clock::time_point> origin_;
+  std::int64_t last_ms_{ 0 };
+  std::map<std::string, pkg_state> pkgs_;
+  std::map<std::string, std::int64_t> slack_;
+  std::vector<path_wait> waits_;
+  trace_analysis out_;
+};
+
+}  // namespace
+
+std::string_view trace_activity_name(trace_activity a) {
+  switch (a) {
+    case trace_activity::lock: return "lock";
+    case trace_activity::network: return "network";
+    case trace_activity::extract: return "extract";
+    case trace_activity::shell: return "shell";
+    case trace_activity::other: return "other";
+    case trace_activity::dependency: return "dependency";
+    case trace_activity::idle: return "idle";
+  }
+  return "unknown";
+}
+
+trace_analysis trace_analyze(std::vector<trace_record> const &records) {
+  return analyzer{ records }.run();
+}
+
+std::string trace_analysis_format(trace_analysis const &analysis, std::size_t top) {
+  auto const breakdown_text{ [](trace_analysis::breakdown const &b) {
+    std::string out;
+    for (int k{ 0 }; k < kTraceActivityCount; ++k) {
+      if (b[k] == 0) { continue; }
+      if (!out.empty()) { out += ", "; }
+      out += std::string{ trace_activity_name(static_cast<trace_activity>(k)) } + " " +
+             seconds(b[k]);
+    }
+    return out.empty() ? std::string{ "-" } : out;
+  } };
+
+  std::size_t width{ 8 };  // "(engine)"
+  for (auto const &p : analysis.packages) { width = std::max(width, p.spec.size()); }
+  int const w{ static_cast<int>(width) };
+  std::string out;
+  appendf(out,
+          "wall %s, %zu packages, average parallelism %.1f\n",
+          seconds(analysis.wall_ms).c_str(),
+          analysis.packages.size(),
+          analysis.wall_ms > 0 ? static_cast<double>(analysis.busy_ms) / analysis.wall_ms
+                               : 0.0);
+
+  out += "\ncritical path: " + breakdown_text(analysis.critical_ms) + "\n";
+  for (auto const &s : analysis.critical_path) {
+    appendf(out,
+            "  %9s %9s  %-*s  %-10s  %s\n",
+            seconds(s.start_ms).c_str(),
+            seconds(s.end_ms - s.start_ms).c_str(),
+            w,
+            s.spec.empty() ? "(engine)" : s.spec.c_str(),
+            s.what.c_str(),
+            breakdown_text(s.time_ms).c_str());
+  }
+
+  out += "\npackages (slack: how much later each could have finished):\n";
+  for (auto const &p : analysis.packages) {
+    appendf(out,
+            "  %-*s  slack %9s  on path %9s  %s\n",
+            w,
+            p.spec.c_str(),
+            seconds(p.slack_ms).c_str(),
+            seconds(p.critical_ms).c_str(),
+            breakdown_text(p.time_ms).c_str());
+  }
+
+  out += "\nopportunities (upper bound on wall time saved):\n";
+  if (analysis.opportunities.empty()) { out += "  (none)\n"; }
+  for (std::size_t k{ 0 }; k < std::min(top, analysis.opportunities.size()); ++k) {
+    auto const &o{ analysis.opportunities[k] };
+    appendf(out, "  %9s  %s\n", seconds(o.saving_ms).c_str(), o.description.c_str());
+  }
+  return out;
+}
+
+}  // namespace envy
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "trace.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace envy {
+
+// What a stretch of a package's time went to. Overlapping activities count once, for
+// the first of lock, network, extract, shell. Time inside a phase with none of them is
+// other (Lua, hashing, file copies).
+enum class trace_activity {
+  lock,        // Waiting for a cache entry lock
+  network,     // Downloads
+  extract,     // Archive extraction
+  shell,       // Package shell commands
+  other,       // Inside a phase, none of the above
+  dependency,  // Blocked on a dependency
+  idle,        // Between steps: neither running a phase nor blocked
+};
+
+constexpr int kTraceActivityCount = static_cast<int>(trace_activity::idle) + 1;
+
+std::string_view trace_activity_name(trace_activity a);
+
+// A run reconstructed from its trace: packages, their phase intervals, dependency
+// edges and the waits that held packages up. Times are ms since the first record.
+struct trace_analysis {
+  using breakdown = std::array<std::int64_t, kTraceActivityCount>;
+
+  // One stretch of the critical path, oldest first. what: phase name, "idle", or
+  // "startup" (spec empty) for the engine's work before the first package.
+  struct step {
+    std::string spec;
+    std::string what;
+    std::int64_t start_ms{ 0 };
+    std::int64_t end_ms{ 0 };
+    breakdown time_ms{};
+  };
+
+  struct package {
+    std::string spec;
+    std::string outcome;  // pkg_outcome; empty if the run ended first
+    std::int64_t start_ms{ 0 };
+    std::int64_t end_ms{ 0 };
+    std::int64_t slack_ms{ 0 };     // Could end this much later without delaying the run
+    std::int64_t critical_ms{ 0 };  // Time on the critical path
+    breakdown time_ms{};            // From its first phase start to its last phase end
+  };
+
+  struct opportunity {
+    std::string description;
+    std::int64_t saving_ms{ 0 };  // Upper bound on the wall time saved
+  };
+
+  std::int64_t wall_ms{ 0 };
+  std::int64_t busy_ms{ 0 };  // Phase time summed over packages
+  std::vector<step> critical_path;
+  breakdown critical_ms{};            // critical_path summed by activity
+  std::vector<package> packages;      // By start time
+  std::vector<opportunity> opportunities;  // Largest saving first
+};
+
+// Records must be in seq order (as trace_read_jsonl returns them).
+trace_analysis trace_analyze(std::vector<trace_record> const &records);
+
+// Human-readable report listing at most `top` opportunities.
+std::string trace_analysis_format(trace_analysis const &analysis, std::size_t top);
+
+}  // namespace envy
@@ -0,0 +1,253 @@
+#include "trace_analyze.h"
+
+#include "doctest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace envy {
+
+namespace {
+
+// Records in the order added, `at_ms` after the epoch.
+struct trace_builder {
+  std::vector<trace_record> records;
+
+  void add(std::string spec, trace_event_t event, std::int64_t at_ms) {
+    records.push_back(trace_record{
+        .seq = records.size(),
+        .ts = std::chrono::system_clock::time_point{ std::chrono::milliseconds{ at_ms } },
+        .tid = 0,
+        .spec = std::move(spec),
+        .event = std::move(event) });
+  }
+
+  void phase(std::string const &spec, pkg_phase p, std::int64_t start, std::int64_t end) {
+    add(spec, trace_events::phase_start{ .phase = p }, start);
+    add(spec, trace_events::phase_complete{ .phase = p, .duration_ms = end - start }, end);
+  }
+
+  void wait(std::string const &spec,
+            pkg_phase at,
+            std::string const &dependency,
+            std::int64_t start,
+            std::int64_t end) {
+    add(spec,
+        trace_events::phase_blocked{ .blocked_at_phase = at,
+                                     .waiting_for = dependency,
+                                     .target_phase = pkg_phase::completion },
+        start);
+    add(spec,
+        trace_events::phase_unblocked{ .unblocked_at_phase = at,
+                                       .dependency = dependency },
+        end);
+  }
+};
+
+// Records must be in seq order, so sort a hand-written scenario by time first.
+trace_analysis analyze(trace_builder b) {
+  std::stable_sort(b.records.begin(), b.records.end(), [](auto const &x, auto const &y) {
+    return x.ts < y.ts;
+  });
+  for (std::size_t i{ 0 }; i < b.records.size(); ++i) { b.records[i].seq = i; }
+  return trace_analyze(b.records);
+}
+
+std::vector<std::string> path_of(trace_analysis const &a) {
+  std::vector<std::string> out;
+  for (auto const &s : a.critical_path) {
+    out.push_back((s.spec.empty() ? "(engine)" : s.spec) + " " + s.what + " " +
+                  std::to_string(s.start_ms) + "-" + std::to_string(s.end_ms));
+  }
+  return out;
+}
+
+trace_analysis::package const &package_of(trace_analysis const &a,
+                                          std::string const &spec) {
+  auto const it{ std::find_if(a.packages.begin(), a.packages.end(), [&](auto const &p) {
+    return p.spec == spec;
+  }) };
+  REQUIRE(it != a.packages.end());
+  return *it;
+}
+
+std::int64_t time_in(trace_analysis::breakdown const &b, trace_activity a) {
+  return b[static_cast<int>(a)];
+}
+
+// app needs fast and slow at build. slow bounds the run; fast has slack until app's
+// build starts.
+trace_builder diamond() {
+  trace_builder b;
+  b.add("", trace_events::trace_start{ .schema = 2 }, 0);
+  b.phase("app@v1", pkg_phase::spec_fetch, 0, 2);
+  b.add("app@v1",
+        trace_events::dependency_added{ .dependency = "fast@v1",
+                                        .needed_by = pkg_phase::pkg_build },
+        1);
+  b.add("app@v1",
+        trace_events::dependency_added{ .dependency = "slow@v1",
+                                        .needed_by = pkg_phase::pkg_build },
+        1);
+  b.phase("fast@v1", pkg_phase::spec_fetch, 1, 2);
+  b.phase("fast@v1", pkg_phase::pkg_build, 2, 10);
+  b.phase("slow@v1", pkg_phase::spec_fetch, 1, 3);
+  b.phase("slow@v1", pkg_phase::pkg_build, 3, 50);
+  b.phase("app@v1", pkg_phase::pkg_fetch, 2, 5);
+  b.wait("app@v1", pkg_phase::pkg_build, "fast@v1", 5, 10);
+  b.wait("app@v1", pkg_phase::pkg_build, "slow@v1", 10, 51);
+  b.phase("app@v1", pkg_phase::pkg_build, 51, 60);
+  b.phase("app@v1", pkg_phase::pkg_install, 60, 62);
+  return b;
+}
+
+}  // namespace
+
+TEST_CASE("trace_analyze follows waits to the dependency that bounded the run") {
+  auto const a{ analyze(diamond()) };
+  CHECK(a.wall_ms == 62);
+  CHECK(path_of(a) == std::vector<std::string>{ "app@v1 spec_fetch 0-1",
+                                                "slow@v1 spec_fetch 1-3",
+                                                "slow@v1 build 3-50",
+                                                "slow@v1 idle 50-51",
+                                                "app@v1 build 51-60",
+                                                "app@v1 install 60-62" });
+
+  // The path covers the whole run.
+  std::int64_t total{ 0 };
+  for (auto const ms : a.critical_ms) { total += ms; }
+  CHECK(total == a.wall_ms);
+  CHECK(time_in(a.critical_ms, trace_activity::idle) == 1);
+
+  CHECK(package_of(a, "app@v1").slack_ms == 0);
+  CHECK(package_of(a, "slow@v1").slack_ms == 1);
+  CHECK(package_of(a, "fast@v1").slack_ms == 41);
+  CHECK(package_of(a, "fast@v1").critical_ms == 0);
+  CHECK(package_of(a, "slow@v1").critical_ms == 50);
+
+  auto const &app{ package_of(a, "app@v1") };
+  CHECK(time_in(app.time_ms, trace_activity::dependency) == 46);
+  CHECK(time_in(app.time_ms, trace_activity::other) == 16);
+}
+
+TEST_CASE("trace_analyze ranks what would shorten the run") {
+  auto const a{ analyze(diamond()) };
+  REQUIRE(a.opportunities.size() == 4);
+  CHECK(a.opportunities[0].description.find("depot hit for slow@v1") == 0);
+  CHECK(a.opportunities[0].saving_ms == 47);
+  // app's own build and install, or overlapping them with slow by needing it later.
+  CHECK(a.opportunities[1].saving_ms == 11);
+  CHECK(a.opportunities[2].saving_ms == 11);
+  CHECK(a.opportunities[2].description.find("app@v1 needing slow@v1") == 0);
+  CHECK(a.opportunities[3].saving_ms == 1);
+  CHECK(a.opportunities[3].description.find("more parallelism") == 0);
+
+  auto const report{ trace_analysis_format(a, 2) };
+  CHECK(report.find("critical path:") != std::string::npos);
+  CHECK(report.find("depot hit for slow@v1") != std::string::npos);
+  CHECK(report.find("more parallelism") == std::string::npos);  // Beyond the top 2
+}
+
+TEST_CASE("trace_analysis_format keeps long identities whole") {
+  std::string const spec{ "acme." + std::string(600, 'x') + "@v1" };
+  trace_builder b;
+  b.add("", trace_events::trace_start{ .schema = 2 }, 0);
+  b.phase(spec, pkg_phase::spec_fetch, 0, 5);
+  b.phase(spec, pkg_phase::pkg_build, 5, 20);
+
+  auto const report{ trace_analysis_format(analyze(b), 5) };
+  CHECK(report.find(spec + "  slack") != std::string::npos);
+  CHECK(report.find(spec + "  build") != std::string::npos);
+}
+
+TEST_CASE("trace_analyze splits phase time into lock, network, extract and shell") {
+  trace_builder b;
+  b.add("p@v1", trace_events::phase_start{ .phase = pkg_phase::pkg_fetch }, 0);
+  b.add("p@v1",
+        trace_events::lock_acquired{ .lock_path = "l", .wait_duration_ms = 10 },
+        20);
+  b.add("p@v1", trace_events::download_start{ .url = "u" }, 20);
+  b.add("p@v1", trace_events::extract_start{ .archive = "x" }, 40);
+  b.add("p@v1", trace_events::download_complete{ .url = "u", .duration_ms = 30 }, 50);
+  b.add("p@v1", trace_events::extract_complete{ .archive = "x", .duration_ms = 30 }, 70);
+  b.add("p@v1", trace_events::shell_command_usage{ .wall_ms = 30 }, 90);
+  b.add("p@v1",
+        trace_events::phase_complete{ .phase = pkg_phase::pkg_fetch, .duration_ms = 100 },
+        100);
+  b.add("p@v1", trace_events::pkg_outcome{ .outcome = "installed" }, 100);
+
+  auto const a{ analyze(b) };
+  REQUIRE(a.critical_path.size() == 1);
+  auto const &t{ a.critical_ms };
+  CHECK(time_in(t, trace_activity::lock) == 10);
+  CHECK(time_in(t, trace_activity::network) == 30);
+  CHECK(time_in(t, trace_activity::extract) == 20);  // Network wins the overlap
+  CHECK(time_in(t, trace_activity::shell) == 20);
+  CHECK(time_in(t, trace_activity::other) == 20);
+  CHECK(package_of(a, "p@v1").time_ms == t);
+
+  REQUIRE(a.opportunities.size() == 2);
+  CHECK(a.opportunities[0].saving_ms == 100);
+  CHECK(a.opportunities[1].description.find("lock contention") != std::string::npos);
+  CHECK(a.opportunities[1].saving_ms == 10);
+}
+
+TEST_CASE("trace_analyze ignores edge re-checks and cache hits") {
+  trace_builder b;
+  b.phase("dep@v1", pkg_phase::pkg_build, 0, 5);
+  b.phase("app@v1", pkg_phase::pkg_build, 0, 8);
+  b.wait("app@v1", pkg_phase::pkg_install, "dep@v1", 8, 8);  // dep finished long ago
+  b.phase("app@v1", pkg_phase::pkg_install, 9, 12);
+  b.add("app@v1", trace_events::pkg_outcome{ .outcome = "cache_hit" }, 12);
+
+  auto const a{ analyze(b) };
+  CHECK(path_of(a) == std::vector<std::string>{ "app@v1 build 0-8",
+                                                "app@v1 idle 8-9",
+                                                "app@v1 install 9-12" });
+  REQUIRE(a.opportunities.size() == 1);
+  CHECK(a.opportunities[0].description.find("more parallelism") == 0);
+}
+
+TEST_CASE("trace_analyze closes phases still open when the trace ends") {
+  trace_builder b;
+  b.add("", trace_events::trace_start{ .schema = 2 }, 0);
+  b.add("p@v1", trace_events::phase_start{ .phase = pkg_phase::pkg_build }, 3);
+  b.add("", trace_events::trace_dropped{ .thread = 1, .count = 1 }, 9);
+
+  auto const a{ analyze(b) };
+  CHECK(path_of(a) ==
+        std::vector<std::string>{ "(engine) startup 0-3", "p@v1 build 3-9" });
+  CHECK(trace_analyze({}).critical_path.empty());
+}
+
+TEST_CASE("trace_analyze finds the critical path of the recorded trace") {
+  auto const a{ trace_analyze(
+      trace_read_jsonl(std::filesystem::path{ "test_data/trace/phases.jsonl" })) };
+  CHECK(a.wall_ms == 155);
+  CHECK(path_of(a) == std::vector<std::string>{ "(engine) startup 0-2",
+                                                "local.zlib@v1 spec_fetch 2-7",
+                                                "local.zlib@v1 idle 7-8",
+                                                "local.zlib@v1 check 8-9",
+                                                "local.zlib@v1 idle 9-12",
+                                                "local.zlib@v1 fetch 12-41",
+                                                "local.zlib@v1 idle 41-42",
+                                                "local.zlib@v1 stage 42-56",
+                                                "local.zlib@v1 idle 56-58",
+                                                "local.zlib@v1 build 58-121",
+                                                "local.zlib@v1 idle 121-122",
+                                                "local.zlib@v1 install 122-125",
+                                                "local.zlib@v1 idle 125-127",
+                                                "local.app@v1 build 127-151",
+                                                "local.app@v1 idle 151-152",
+                                                "local.app@v1 install 152-154" });
+  CHECK(time_in(a.critical_ms, trace_activity::network) == 28);
+  CHECK(package_of(a, "local.zlib@v1").slack_ms == 3);
+  CHECK(a.opportunities.front().description.find("depot hit for local.zlib@v1") == 0);
+}
+
+}  // namespace envy
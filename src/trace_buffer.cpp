@@ -0,0 +1,257 @@
+#include "trace_buffer.h"
+
+#include <algorithm>
+#include <bit>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+namespace envy {
+
+// Single-producer, single-consumer ring. head_ is written only by the owning thread,
+// tail_ only by the consumer; each side reads the other's index to find free or
+// filled slots.
+// Slots live in segments the producer allocates the first time it reaches them; a
+// segment pointer is written before the head_ release that publishes its first record,
+// and never changes after, so the consumer reads it without further synchronization.
+class trace_ring : unmovable {
+ public:
+  explicit trace_ring(std::size_t capacity)
+      : capacity_{ capacity },
+        mask_{ capacity - 1 },
+        segment_records_{ std::min(capacity, trace_buffer::kSegmentRecords) },
+        segments_(capacity / segment_records_) {}
+
+  // Producer. Returns the number of records queued afterwards, or 0 if the ring is full
+  // (or its next segment cannot be allocated) and `rec` was left untouched.
+  std::size_t try_push(trace_record &rec, std::atomic<std::uint64_t> &next_seq) {
+    auto const head{ head_.load(std::memory_order_relaxed) };
+    auto const queued{ head - tail_.load(std::memory_order_acquire) };
+    if (queued >= capacity_) { return 0; }
+    auto &segment{ segments_[static_cast<std::size_t>(head & mask_) / segment_records_] };
+    if (!segment) {
+      try {
+        segment = std::make_unique<trace_record[]>(segment_records_);
+      } catch (std::bad_alloc const &) { return 0; }
+    }
+    rec.seq = next_seq.fetch_add(1, std::memory_order_relaxed);
+    slot(head) = std::move(rec);
+    head_.store(head + 1, std::memory_order_release);
+    return static_cast<std::size_t>(queued + 1);
+  }
+
+  // Producer
+  void count_drop(std::uint32_t tid) {
+    tid_.store(tid, std::memory_order_relaxed);
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Consumer. Moves every published record out, oldest first.
+  template <typename Fn>
+  void pop_all(Fn &&fn) {
+    auto tail{ tail_.load(std::memory_order_relaxed) };
+    auto const head{ head_.load(std::memory_order_acquire) };
+    for (; tail != head; ++tail) { fn(std::move(slot(tail))); }
+    tail_.store(tail, std::memory_order_release);
+  }
+
+  // Set by the producing thread as it exits; the ring is released once drained.
+  void mark_exited() { exited_.store(true, std::memory_order_release); }
+  bool exited() const { return exited_.load(std::memory_order_acquire); }
+
+  std::size_t allocated_slots() const {
+    std::size_t allocated{ 0 };
+    for (auto const &segment : segments_) { allocated += segment ? 1 : 0; }
+    return segment_records_ * allocated;
+  }
+
+  bool empty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_relaxed);
+  }
+
+  std::uint32_t tid() const { return tid_.load(std::memory_order_relaxed); }
+
+  // Consumer. Drops since the previous take_dropped().
+  std::uint64_t unreported_dropped() const {
+    return dropped_.load(std::memory_order_relaxed) - reported_dropped_;
+  }
+
+  std::uint64_t take_dropped() {
+    auto const total{ dropped_.load(std::memory_order_relaxed) };
+    auto const fresh{ total - reported_dropped_ };
+    reported_dropped_ = total;
+    return fresh;
+  }
+
+ private:
+  trace_record &slot(std::uint64_t index) {
+    auto const i{ static_cast<std::size_t>(index & mask_) };
+    return segments_[i / segment_records_][i % segment_records_];
+  }
+
+  std::size_t const capacity_;
+  std::size_t const mask_;
+  std::size_t const segment_records_;
+  std::vector<std::unique_ptr<trace_record[]>> segments_;
+  std::atomic<bool> exited_{ false };
+
+  // Producer-written, on their own cache line
+  alignas(64) std::atomic<std::uint64_t> head_{ 0 };  // Next slot to write
+  std::atomic<std::uint64_t> dropped_{ 0 };
+  std::atomic<std::uint32_t> tid_{ 0 };
+
+  // Consumer-written
+  alignas(64) std::atomic<std::uint64_t> tail_{ 0 };  // Next slot to read
+  std::uint64_t reported_dropped_{ 0 };
+};
+
+namespace {
+
+std::atomic<std::uint64_t> g_next_buffer_id{ 0 };
+
+// Rings this thread produces into, keyed by buffer id. The buffer owns them; `ring` is
+// only dereferenced by push() on its own, live buffer. Entries whose buffer is gone have
+// an expired `owner` and are pruned when the thread next creates a ring.
+struct local_rings {
+  struct entry {
+    std::uint64_t id;
+    trace_ring *ring;
+    std::weak_ptr<trace_ring> owner;
+  };
+  std::vector<entry> entries;
+
+  ~local_rings() {
+    for (auto const &e : entries) {
+      if (auto const ring{ e.owner.lock() }) { ring->mark_exited(); }
+    }
+  }
+};
+
+thread_local local_rings t_rings;
+
+}  // namespace
+
+trace_buffer::trace_buffer(std::size_t ring_capacity,
+                           std::function<void()> wake,
+                           std::size_t max_pending)
+    : id_{ g_next_buffer_id.fetch_add(1) },
+      ring_capacity_{ ring_capacity },
+      max_pending_{ max_pending },
+      wake_{ std::move(wake) } {
+  if (ring_capacity_ < 2 || !std::has_single_bit(ring_capacity_)) {
+    throw std::invalid_argument("trace_buffer: ring capacity must be a power of two");
+  }
+}
+
+trace_buffer::~trace_buffer() = default;
+
+trace_ring &trace_buffer::local_ring() {
+  for (auto const &e : t_rings.entries) {
+    if (e.id == id_) { return *e.ring; }
+  }
+  std::erase_if(t_rings.entries, [](auto const &e) { return e.owner.expired(); });
+
+  auto ring{ std::make_shared<trace_ring>(ring_capacity_) };
+  {
+    std::lock_guard const lock{ rings_mutex_ };
+    rings_.push_back(ring);
+  }
+  t_rings.entries.push_back({ .id = id_, .ring = ring.get(), .owner = ring });
+  return *ring;
+}
+
+bool trace_buffer::push(trace_record rec) {
+  trace_ring &ring{ local_ring() };
+  for (int attempt{ 0 }; attempt <= kFullRetries; ++attempt) {
+    if (auto const queued{ ring.try_push(rec, next_seq_) }) {
+      if (queued == ring_capacity_ / 2 && wake_) { wake_(); }
+      return true;
+    }
+    // Full: give the consumer a chance to run before giving up on the record.
+    if (wake_) { wake_(); }
+    std::this_thread::yield();
+  }
+  ring.count_drop(rec.tid);
+  return false;
+}
+
+void trace_buffer::drain(std::vector<trace_record> &out, bool flush) {
+  std::vector<std::shared_ptr<trace_ring>> rings;
+  {
+    std::lock_guard const lock{ rings_mutex_ };
+    std::erase_if(rings_, [](auto const &ring) {
+      return ring->exited() && ring->empty() && ring->unreported_dropped() == 0;
+    });
+    rings = rings_;
+  }
+
+  // Every record lands at its offset from next_out_; the filled prefix is ready.
+  for (auto const &ring : rings) {
+    ring->pop_all([&](trace_record &&rec) {
+      if (rec.seq < next_out_) {  // Its seq was given up on below
+        ++late_dropped_[rec.tid];
+        return;
+      }
+      auto const offset{ static_cast<std::size_t>(rec.seq - next_out_) };
+      if (offset >= pending_.size()) { pending_.resize(offset + 1); }
+      pending_[offset] = std::move(rec);
+    });
+  }
+
+  // Past max_pending, a seq still unpublished is skipped rather than waited for.
+  while (!pending_.empty() &&
+         (flush || pending_.front() || pending_.size() > max_pending_)) {
+    if (pending_.front()) { out.push_back(std::move(*pending_.front())); }
+    pending_.pop_front();
+    ++next_out_;
+  }
+}
+
+std::vector<std::pair<std::uint32_t, std::uint64_t>> trace_buffer::take_dropped() {
+  std::vector<std::pair<std::uint32_t, std::uint64_t>> result;
+  {
+    std::lock_guard const lock{ rings_mutex_ };
+    for (auto const &ring : rings_) {
+      if (auto const count{ ring->take_dropped() }) {
+        result.emplace_back(ring->tid(), count);
+      }
+    }
+  }
+  for (auto const &[tid, count] : late_dropped_) {
+    auto const it{ std::ranges::find(result, tid, &decltype(result)::value_type::first) };
+    if (it != result.end()) {
+      it->second += count;
+    } else {
+      result.emplace_back(tid, count);
+    }
+  }
+  late_dropped_.clear();
+  return result;
+}
+
+void trace_buffer::reset() {
+  {
+    std::lock_guard const lock{ rings_mutex_ };
+    for (auto const &ring : rings_) {
+      ring->pop_all([](trace_record &&) {});
+      ring->take_dropped();
+    }
+  }
+  pending_.clear();
+  late_dropped_.clear();
+  next_out_ = 0;
+  next_seq_.store(0);
+}
+
+#ifdef ENVY_UNIT_TEST
+std::size_t trace_buffer::allocated_slots() {
+  std::lock_guard const lock{ rings_mutex_ };
+  std::size_t total{ 0 };
+  for (auto const &ring : rings_) { total += ring->allocated_slots(); }
+  return total;
+}
+
+std::size_t trace_buffer::thread_ring_count() { return t_rings.entries.size(); }
+#endif
+
+}  // namespace envy
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "trace.h"
+#include "util.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace envy {
+
+class trace_ring;
+
+// Lock-free staging for trace records between emitting threads and one writer.
+// Every producing thread gets its own fixed-size single-producer ring, created on its
+// first push; its slots are allocated kSegmentRecords at a time as the ring first
+// reaches them, so a thread that emits little holds little. After that, push() takes no
+// lock: it reserves a slot, stamps the record's seq and publishes it. drain() is
+// consumer-only: it merges all rings and hands records out in exact seq order. `wake`
+// is called from push() when a ring reaches half full or is full, so the consumer can
+// drain early. A ring that stays full after kFullRetries yields rejects the record
+// before a seq is assigned, so drops leave no holes in seq; they are counted per thread
+// and reported by take_dropped(). The buffer owns the rings: they outlive their threads
+// until drained and are freed with the buffer.
+//
+// A thread that stalls between taking a seq and publishing holds back every later
+// record. Once max_pending records wait behind it, drain() stops waiting and moves on;
+// the stalled record is dropped when it arrives and counted like a full-ring drop.
+class trace_buffer : unmovable {
+ public:
+  static constexpr std::size_t kDefaultRingCapacity{ 4096 };  // Records per thread
+  static constexpr std::size_t kSegmentRecords{ 64 };
+  static constexpr std::size_t kDefaultMaxPending{ std::size_t{ 1 } << 16 };
+  static constexpr int kFullRetries{ 100 };
+
+  explicit trace_buffer(std::size_t ring_capacity = kDefaultRingCapacity,
+                        std::function<void()> wake = {},
+                        std::size_t max_pending = kDefaultMaxPending);
+  ~trace_buffer();
+
+  // Stamps rec.seq and queues it on the calling thread's ring. Returns false if the
+  // record was dropped.
+  bool push(trace_record rec);
+
+  // Appends records to `out` in seq order, stopping before a seq that is reserved but
+  // not yet published (it follows on a later call). With `flush`, pending records are
+  // released regardless; use once producers have stopped.
+  void drain(std::vector<trace_record> &out, bool flush = false);
+
+  // (tid, count) for every thread that dropped records since the previous call.
+  std::vector<std::pair<std::uint32_t, std::uint64_t>> take_dropped();
+
+  // Discards queued records and restarts seq at 0. Not safe while threads push.
+  void reset();
+
+#ifdef ENVY_UNIT_TEST
+  std::size_t allocated_slots();                  // Summed over rings; no concurrent push
+  std::uint64_t reserve_seq() { return next_seq_.fetch_add(1); }  // A stalled push
+  static std::size_t thread_ring_count();         // Calling thread's ring references
+#endif
+
+ private:
+  trace_ring &local_ring();
+
+  std::uint64_t const id_;
+  std::size_t const ring_capacity_;
+  std::size_t const max_pending_;
+  std::function<void()> const wake_;
+  std::atomic<std::uint64_t> next_seq_{ 0 };
+
+  std::mutex rings_mutex_;  // Guards rings_ membership; never held by push()
+  std::vector<std::shared_ptr<trace_ring>> rings_;
+
+  // Consumer state
+  std::deque<std::optional<trace_record>> pending_;  // Indexed by seq - next_out_
+  std::uint64_t next_out_{ 0 };  // Seq of pending_.front()
+  std::map<std::uint32_t, std::uint64_t> late_dropped_;  // By tid; arrived after skip
+};
+
+}  // namespace envy
@@ -0,0 +1,285 @@
+#include "trace_buffer.h"
+
+#include "doctest.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace envy {
+
+namespace {
+
+trace_record make_record(std::uint32_t tid, std::int64_t n) {
+  return trace_record{
+    .seq = 0,
+    .ts = std::chrono::system_clock::now(),
+    .tid = tid,
+    .spec = "pkg@v1",
+    .event = trace_events::phase_complete{ .phase = pkg_phase::pkg_build,
+                                           .duration_ms = n }
+  };
+}
+
+std::int64_t payload(trace_record const &rec) {
+  return std::get<trace_events::phase_complete>(rec.event).duration_ms;
+}
+
+std::uint64_t total_dropped(trace_buffer &buffer) {
+  std::uint64_t total{ 0 };
+  for (auto const &[tid, count] : buffer.take_dropped()) { total += count; }
+  return total;
+}
+
+}  // namespace
+
+TEST_CASE("trace_buffer drains records in push order with seq from zero") {
+  trace_buffer buffer{ 16 };
+  for (std::int64_t i{ 0 }; i < 5; ++i) { buffer.push(make_record(0, i)); }
+
+  std::vector<trace_record> out;
+  buffer.drain(out);
+  REQUIRE(out.size() == 5);
+  for (std::size_t i{ 0 }; i < out.size(); ++i) {
+    CHECK(out[i].seq == i);
+    CHECK(payload(out[i]) == static_cast<std::int64_t>(i));
+    CHECK(out[i].spec == "pkg@v1");
+  }
+
+  out.clear();
+  buffer.drain(out);
+  CHECK(out.empty());
+}
+
+TEST_CASE("trace_buffer merges concurrent producers into one gapless seq order") {
+  constexpr std::uint32_t kThreads{ 8 };
+  constexpr std::int64_t kPerThread{ 20000 };
+  // A preempted producer must be waited for here, however long: no max_pending skips.
+  trace_buffer buffer{ 256, {}, std::size_t{ 1 } << 30 };
+
+  std::atomic<std::uint32_t> running{ kThreads };
+  std::vector<std::thread> producers;
+  for (std::uint32_t t{ 0 }; t < kThreads; ++t) {
+    producers.emplace_back([&, t] {
+      for (std::int64_t i{ 0 }; i < kPerThread; ++i) { buffer.push(make_record(t, i)); }
+      --running;
+    });
+  }
+
+  std::vector<trace_record> out;
+  while (running > 0) {
+    buffer.drain(out);
+    std::this_thread::yield();
+  }
+  for (auto &p : producers) { p.join(); }
+  buffer.drain(out);
+
+  // Whatever did not fit was counted, not lost silently.
+  CHECK(out.size() + total_dropped(buffer) == kThreads * kPerThread);
+
+  std::map<std::uint32_t, std::int64_t> last_payload;
+  for (std::size_t i{ 0 }; i < out.size(); ++i) {
+    REQUIRE(out[i].seq == i);  // Gapless, strictly increasing
+    auto const [it, inserted]{ last_payload.try_emplace(out[i].tid, -1) };
+    REQUIRE(payload(out[i]) > it->second);  // Each thread's emit order preserved
+    it->second = payload(out[i]);
+  }
+}
+
+TEST_CASE("trace_buffer drops and counts records once a ring stays full") {
+  int wakes{ 0 };
+  trace_buffer buffer{ 8, [&] { ++wakes; } };
+  for (std::int64_t i{ 0 }; i < 3; ++i) { CHECK(buffer.push(make_record(7, i))); }
+  CHECK(wakes == 0);
+  CHECK(buffer.push(make_record(7, 3)));
+  CHECK(wakes == 1);  // Half full: time to drain
+  for (std::int64_t i{ 4 }; i < 8; ++i) { CHECK(buffer.push(make_record(7, i))); }
+  CHECK(wakes == 1);
+  for (std::int64_t i{ 8 }; i < 11; ++i) { CHECK_FALSE(buffer.push(make_record(7, i))); }
+  CHECK(wakes > 1);  // Full: woken on every retry
+
+  auto const dropped{ buffer.take_dropped() };
+  REQUIRE(dropped.size() == 1);
+  CHECK(dropped[0].first == 7);
+  CHECK(dropped[0].second == 3);
+  CHECK(buffer.take_dropped().empty());  // Reported once
+
+  std::vector<trace_record> out;
+  buffer.drain(out);
+  REQUIRE(out.size() == 8);
+  CHECK(out.back().seq == 7);
+  CHECK(payload(out.back()) == 7);
+
+  // Space is back after the drain, and seq continues without a hole for the drops.
+  buffer.push(make_record(7, 100));
+  out.clear();
+  buffer.drain(out);
+  REQUIRE(out.size() == 1);
+  CHECK(out[0].seq == 8);
+  CHECK(payload(out[0]) == 100);
+}
+
+TEST_CASE("trace_buffer keeps records from threads that have exited") {
+  trace_buffer buffer{ 16 };
+  std::thread{ [&] {
+    for (std::int64_t i{ 0 }; i < 3; ++i) { buffer.push(make_record(1, i)); }
+  } }.join();
+
+  std::vector<trace_record> out;
+  buffer.drain(out);
+  CHECK(out.size() == 3);
+
+  out.clear();
+  buffer.drain(out);  // The drained ring of the exited thread is released
+  CHECK(out.empty());
+}
+
+TEST_CASE("trace_buffer allocates ring slots as they are first used") {
+  trace_buffer buffer;
+  CHECK(buffer.allocated_slots() == 0);
+  buffer.push(make_record(0, 0));
+  CHECK(buffer.allocated_slots() == trace_buffer::kSegmentRecords);
+  for (std::int64_t i{ 1 }; i <= 64; ++i) { buffer.push(make_record(0, i)); }
+  CHECK(buffer.allocated_slots() == 2 * trace_buffer::kSegmentRecords);
+}
+
+TEST_CASE("trace_buffer rings go away with their buffer") {
+  auto const before{ trace_buffer::thread_ring_count() };
+  for (int i{ 0 }; i < 10; ++i) {
+    trace_buffer buffer{ 16 };
+    buffer.push(make_record(0, i));
+  }
+  // Each new ring prunes references to rings of destroyed buffers.
+  CHECK(trace_buffer::thread_ring_count() <= before + 1);
+}
+
+TEST_CASE("trace_buffer stops waiting for a stalled seq past max_pending") {
+  trace_buffer buffer{ 16, {}, 4 };
+  buffer.reserve_seq();  // Taken but never published, like a preempted push
+  for (std::int64_t i{ 1 }; i <= 3; ++i) { buffer.push(make_record(0, i)); }
+
+  std::vector<trace_record> out;
+  buffer.drain(out);
+  CHECK(out.empty());  // Still waiting for seq 0
+
+  for (std::int64_t i{ 4 }; i <= 5; ++i) { buffer.push(make_record(0, i)); }
+  buffer.drain(out);
+  REQUIRE(out.size() == 5);
+  CHECK(out.front().seq == 1);
+  CHECK(out.back().seq == 5);
+}
+
+TEST_CASE("trace_buffer reset discards queued records and restarts seq") {
+  trace_buffer buffer{ 4 };
+  for (std::int64_t i{ 0 }; i < 6; ++i) { buffer.push(make_record(0, i)); }
+  buffer.reset();
+  CHECK(buffer.take_dropped().empty());
+
+  buffer.push(make_record(0, 42));
+  std::vector<trace_record> out;
+  buffer.drain(out);
+  REQUIRE(out.size() == 1);
+  CHECK(out[0].seq == 0);
+  CHECK(payload(out[0]) == 42);
+}
+
+TEST_CASE("trace_buffer requires a power-of-two ring capacity") {
+  CHECK_THROWS_AS(trace_buffer{ 100 }, std::invalid_argument);
+  CHECK_THROWS_AS(trace_buffer{ 1 }, std::invalid_argument);
+  CHECK_NOTHROW(trace_buffer{ 128 });
+}
+
+TEST_CASE("trace emit overhead, 10^6 events" * doctest::skip()) {
+  constexpr std::int64_t kEvents{ 1000000 };
+  using ns = std::chrono::duration<double, std::nano>;
+
+  // Emitting threads run flat out while the calling thread drains, like the trace
+  // writer. Reports emit cost (producer wall time per event) and the drain cost.
+  auto const run{ [&](std::uint32_t threads, auto &&emit, auto &&drain, char const *name) {
+    std::int64_t const per_thread{ kEvents / threads };
+    std::atomic<std::uint32_t> running{ threads };
+    std::atomic<std::int64_t> emit_ns{ 0 };
+    std::vector<std::thread> producers;
+    for (std::uint32_t t{ 0 }; t < threads; ++t) {
+      producers.emplace_back([&, t] {
+        auto const start{ std::chrono::steady_clock::now() };
+        for (std::int64_t i{ 0 }; i < per_thread; ++i) { emit(make_record(t, i)); }
+        emit_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+        --running;
+      });
+    }
+    ns drain_time{ 0 };
+    std::size_t drained{ 0 };
+    auto const timed_drain{ [&] {
+      auto const start{ std::chrono::steady_clock::now() };
+      drained += drain();
+      drain_time += std::chrono::steady_clock::now() - start;
+    } };
+    while (running > 0) {
+      timed_drain();
+      std::this_thread::yield();
+    }
+    for (auto &p : producers) { p.join(); }
+    timed_drain();
+    MESSAGE(name << ", " << threads << " threads: emit "
+                 << static_cast<double>(emit_ns.load()) / kEvents << " ns/event, drain "
+                 << drain_time.count() / kEvents << " ns/event, " << drained
+                 << " drained");
+  } };
+
+  for (std::uint32_t const threads : { 1u, 8u }) {
+    {
+      trace_buffer buffer;
+      std::vector<trace_record> out;
+      run(
+          threads,
+          [&](trace_record rec) { buffer.push(std::move(rec)); },
+          [&] {
+            out.clear();
+            buffer.drain(out);
+            return out.size();
+          },
+          "per-thread rings");
+      MESSAGE("  dropped: " << total_dropped(buffer));
+    }
+
+    {
+      // The previous path: seq and enqueue under the shared queue mutex, then notify.
+      std::mutex mutex;
+      std::condition_variable cv;
+      std::queue<trace_record> queue;
+      std::uint64_t next_seq{ 0 };
+      run(
+          threads,
+          [&](trace_record rec) {
+            {
+              std::lock_guard const lock{ mutex };
+              rec.seq = next_seq++;
+              queue.push(std::move(rec));
+            }
+            cv.notify_one();
+          },
+          [&] {
+            std::queue<trace_record> taken;
+            {
+              std::lock_guard const lock{ mutex };
+              taken.swap(queue);
+            }
+            return taken.size();
+          },
+          "shared mutex queue");
+    }
+  }
+}
+
+}  // namespace envy
@@ -0,0 +1,278 @@
+#include "trace_chrome.h"
+
+#include "pkg_phase.h"
+#include "util.h"
+
+#include <algorithm>
+#include <string_view>
+#include <type_traits>
+
+namespace envy {
+
+namespace {
+
+constexpr char const *kCounterNames[]{ "downloads", "extractions", "shell commands" };
+
+void append_string(std::string &out, std::string_view value) {
+  out.push_back('"');
+  out.append(util_escape_json_string(value));
+  out.push_back('"');
+}
+
+// Opens one trace event; the caller appends any further members and the closing '}'.
+void begin_event(std::string &out,
+                 std::string_view name,
+                 std::string_view cat,
+                 char ph,
+                 int tid,
+                 std::int64_t ts_us) {
+  if (!out.empty()) { out.append(",\n"); }
+  out.append("{\"name\":");
+  append_string(out, name);
+  if (!cat.empty()) {
+    out.append(",\"cat\":");
+    append_string(out, cat);
+  }
+  out.append(",\"ph\":\"");
+  out.push_back(ph);
+  out.append("\",\"pid\":1,\"tid\":");
+  out.append(std::to_string(tid));
+  out.append(",\"ts\":");
+  out.append(std::to_string(ts_us));
+}
+
+void append_int(std::string &out, std::string_view key, std::int64_t value) {
+  out.append(",\"");
+  out.append(key);
+  out.append("\":");
+  out.append(std::to_string(value));
+}
+
+// Event fields as an "args" object, with the same names and encoding as the JSONL.
+void append_args(std::string &out, trace_event_t const &event) {
+  out.append(",\"args\":{");
+  bool first{ true };
+  std::visit(
+      [&](auto const &e) {
+        trace_event_for_each_field(e, [&](std::string_view key, auto const &value) {
+          if (!first) { out.push_back(','); }
+          first = false;
+          append_string(out, key);
+          out.push_back(':');
+          using T = std::remove_cvref_t<decltype(value)>;
+          if constexpr (std::is_same_v<T, std::string>) {
+            append_string(out, value);
+          } else if constexpr (std::is_same_v<T, bool>) {
+            out.append(value ? "true" : "false");
+          } else if constexpr (std::is_same_v<T, pkg_phase>) {
+            append_string(out, pkg_phase_name(value));
+          } else {
+            out.append(std::to_string(value));
+          }
+        });
+      },
+      event);
+  out.push_back('}');
+}
+
+}  // namespace
+
+std::int64_t trace_chrome_exporter::to_us(std::chrono::system_clock::time_point ts) {
+  if (!origin_) { origin_ = ts; }
+  auto const us{ std::chrono::duration_cast<std::chrono::microseconds>(ts - *origin_) };
+  std::int64_t const result{ std::max<std::int64_t>(us.count(), 0) };
+  last_us_ = std::max(last_us_, result);
+  return result;
+}
+
+int trace_chrome_exporter::track_id(std::string const &spec) {
+  if (tracks_.empty()) { tracks_.push_back(track{ .name = "engine" }); }
+  if (spec.empty()) { return 0; }
+  auto const [it, inserted]{ track_ids_.try_emplace(spec,
+                                                    static_cast<int>(tracks_.size())) };
+  if (inserted) { tracks_.push_back(track{ .name = spec }); }
+  return it->second;
+}
+
+void trace_chrome_exporter::add(trace_record const &rec) {
+  namespace ev = trace_events;
+
+  std::int64_t const ts{ to_us(rec.ts) };
+  int const tid{ track_id(rec.spec) };
+  auto const count{ [&](counter c, std::int64_t at, int delta) {
+    counters_[c].emplace_back(std::max<std::int64_t>(at, 0), delta);
+  } };
+
+  if (std::holds_alternative<ev::trace_start>(rec.event)) {
+    return;
+  } else if (auto const *start{ std::get_if<ev::phase_start>(&rec.event) }) {
+    auto &open{ tracks_[tid].open_phase };
+    if (open) { add_phase_slice(tid, open->first, open->second, ts, false); }
+    open.emplace(start->phase, ts);
+    return;
+  } else if (auto const *complete{ std::get_if<ev::phase_complete>(&rec.event) }) {
+    auto &t{ tracks_[tid] };
+    std::int64_t const begin{ t.open_phase && t.open_phase->first == complete->phase
+                                  ? t.open_phase->second
+                                  : std::max<std::int64_t>(
+                                        ts - complete->duration_ms * 1000, 0) };
+    t.open_phase.reset();
+    t.last_phase = slice{ .start_us = begin, .end_us = ts };
+    ++t.phases_done;
+    add_phase_slice(tid, complete->phase, begin, ts, true);
+    return;
+  } else if (auto const *blocked{ std::get_if<ev::phase_blocked>(&rec.event) }) {
+    int const dep{ track_id(blocked->waiting_for) };
+    tracks_[tid].waits.insert_or_assign(
+        blocked->waiting_for,
+        wait{ .at = blocked->blocked_at_phase,
+              .start_us = ts,
+              .dependency_phases_done = tracks_[dep].phases_done });
+    return;
+  } else if (auto const *unblocked{ std::get_if<ev::phase_unblocked>(&rec.event) }) {
+    end_wait(tid, unblocked->dependency, ts, true);
+    return;
+  } else if (std::holds_alternative<ev::download_start>(rec.event)) {
+    count(kDownloads, ts, 1);
+  } else if (std::holds_alternative<ev::download_complete>(rec.event) ||
+             std::holds_alternative<ev::download_failed>(rec.event)) {
+    count(kDownloads, ts, -1);
+  } else if (std::holds_alternative<ev::extract_start>(rec.event)) {
+    count(kExtractions, ts, 1);
+  } else if (std::holds_alternative<ev::extract_complete>(rec.event)) {
+    count(kExtractions, ts, -1);
+  } else if (auto const *shell{ std::get_if<ev::shell_command_usage>(&rec.event) }) {
+    // Reported when the command exits; it started wall_ms earlier.
+    count(kShells, ts - shell->wall_ms * 1000, 1);
+    count(kShells, ts, -1);
+  }
+
+  add_instant(tid, ts, rec);
+}
+
+void trace_chrome_exporter::add_phase_slice(int tid,
+                                            pkg_phase phase,
+                                            std::int64_t start_us,
+                                            std::int64_t end_us,
+                                            bool complete) {
+  begin_event(events_, pkg_phase_name(phase), "phase", 'X', tid, start_us);
+  append_int(events_, "dur", std::max<std::int64_t>(end_us - start_us, 0));
+  if (!complete) { events_.append(",\"args\":{\"incomplete\":true}"); }
+  events_.push_back('}');
+}
+
+// The task engine re-checks every dependency edge before each step, so most
+// blocked/unblocked pairs are instant. Only a wait during which the dependency finished
+// a phase becomes a slice. A flow arrow runs from the end of that phase to the end of
+// the wait.
+void trace_chrome_exporter::end_wait(int tid,
+                                     std::string const &dependency,
+                                     std::int64_t end_us,
+                                     bool done) {
+  auto &waits{ tracks_[tid].waits };
+  auto const it{ waits.find(dependency) };
+  if (it == waits.end()) { return; }
+  wait const w{ it->second };
+  waits.erase(it);
+
+  auto const dep_it{ track_ids_.find(dependency) };
+  if (dep_it == track_ids_.end()) { return; }
+  track const &dep{ tracks_[dep_it->second] };
+  if (done && dep.phases_done == w.dependency_phases_done) { return; }
+
+  begin_event(events_, "waiting for " + dependency, "wait", 'X', tid, w.start_us);
+  append_int(events_, "dur", std::max<std::int64_t>(end_us - w.start_us, 0));
+  events_.append(",\"args\":{\"phase\":");
+  append_string(events_, pkg_phase_name(w.at));
+  if (!done) { events_.append(",\"incomplete\":true"); }
+  events_.append("}}");
+
+  if (!done || !dep.last_phase) { return; }
+  std::uint64_t const id{ next_flow_id_++ };
+  std::int64_t const from{ std::max(dep.last_phase->start_us,
+                                    dep.last_phase->end_us - 1) };
+  begin_event(events_, "dependency", "wait", 's', dep_it->second, from);
+  append_int(events_, "id", static_cast<std::int64_t>(id));
+  events_.push_back('}');
+  begin_event(events_,
+              "dependency",
+              "wait",
+              'f',
+              tid,
+              std::max(w.start_us, end_us - 1));
+  append_int(events_, "id", static_cast<std::int64_t>(id));
+  events_.append(",\"bp\":\"e\"}");
+}
+
+void trace_chrome_exporter::add_instant(int tid,
+                                        std::int64_t ts_us,
+                                        trace_record const &rec) {
+  begin_event(events_, trace_event_name(rec.event), "event", 'i', tid, ts_us);
+  events_.append(",\"s\":\"t\"");
+  append_args(events_, rec.event);
+  events_.push_back('}');
+}
+
+std::string trace_chrome_exporter::finish() {
+  track_id("");  // The engine track exists even for an empty trace
+
+  for (int tid{ 0 }; tid < static_cast<int>(tracks_.size()); ++tid) {
+    if (auto const &open{ tracks_[tid].open_phase }) {
+      add_phase_slice(tid, open->first, open->second, last_us_, false);
+    }
+    while (!tracks_[tid].waits.empty()) {
+      end_wait(tid, tracks_[tid].waits.begin()->first, last_us_, false);
+    }
+  }
+
+  std::string meta;
+  begin_event(meta, "process_name", "", 'M', 0, 0);
+  meta.append(",\"args\":{\"name\":\"envy\"}}");
+  for (int tid{ 0 }; tid < static_cast<int>(tracks_.size()); ++tid) {
+    begin_event(meta, "thread_name", "", 'M', tid, 0);
+    meta.append(",\"args\":{\"name\":");
+    append_string(meta, tracks_[tid].name);
+    meta.append("}}");
+    begin_event(meta, "thread_sort_index", "", 'M', tid, 0);
+    meta.append(",\"args\":{\"sort_index\":");
+    meta.append(std::to_string(tid));
+    meta.append("}}");
+  }
+
+  // One sample per distinct timestamp, starting from zero so every track exists.
+  std::string counters;
+  for (int c{ 0 }; c < kCounterCount; ++c) {
+    auto &deltas{ counters_[c] };
+    std::stable_sort(deltas.begin(), deltas.end(), [](auto const &a, auto const &b) {
+      return a.first < b.first;
+    });
+    std::int64_t value{ 0 };
+    if (deltas.empty() || deltas.front().first > 0) {
+      begin_event(counters, kCounterNames[c], "", 'C', 0, 0);
+      counters.append(",\"args\":{\"active\":0}}");
+    }
+    for (std::size_t i{ 0 }; i < deltas.size();) {
+      std::int64_t const ts{ deltas[i].first };
+      for (; i < deltas.size() && deltas[i].first == ts; ++i) {
+        value += deltas[i].second;
+      }
+      begin_event(counters, kCounterNames[c], "", 'C', 0, ts);
+      counters.append(",\"args\":{\"active\":");
+      counters.append(std::to_string(std::max<std::int64_t>(value, 0)));
+      counters.append("}}");
+    }
+  }
+
+  std::string out{ "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" };
+  out.append(meta);
+  for (std::string const *part : { &events_, &counters }) {
+    if (!part->empty()) {
+      out.append(",\n");
+      out.append(*part);
+    }
+  }
+  out.append("\n]}\n");
+  return out;
+}
+
+}  // namespace envy
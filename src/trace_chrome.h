@@ -0,0 +1,72 @@
+#pragma once
+
+#include "trace.h"
+#include "util.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace envy {
+
+// Converts a trace stream into Chrome Trace Event JSON, which chrome://tracing and
+// ui.perfetto.dev open as a timeline. Every package gets its own track of phase slices.
+// A dependency wait is a slice on the waiting package, with a flow arrow from the
+// phase of the dependency that released it. Counter tracks follow concurrent
+// downloads, extractions and shell commands. Any other event becomes an instant on
+// its package's track (or the engine track). Records must arrive in seq order.
+class trace_chrome_exporter : unmovable {
+ public:
+  void add(trace_record const &rec);
+
+  // The complete JSON document. Phases and waits still open end at the last record.
+  std::string finish();
+
+ private:
+  struct slice {
+    std::int64_t start_us;
+    std::int64_t end_us;
+  };
+
+  struct wait {
+    pkg_phase at;
+    std::int64_t start_us;
+    std::uint64_t dependency_phases_done;  // To tell a real wait from an edge re-check
+  };
+
+  struct track {
+    std::string name;
+    std::optional<std::pair<pkg_phase, std::int64_t>> open_phase;  // Phase, start
+    std::optional<slice> last_phase;
+    std::uint64_t phases_done{ 0 };
+    std::map<std::string, wait> waits;  // By dependency
+  };
+
+  enum counter { kDownloads, kExtractions, kShells, kCounterCount };
+
+  std::int64_t to_us(std::chrono::system_clock::time_point ts);
+  int track_id(std::string const &spec);
+  void add_phase_slice(int tid,
+                       pkg_phase phase,
+                       std::int64_t start_us,
+                       std::int64_t end_us,
+                       bool complete);
+  void end_wait(int tid, std::string const &dependency, std::int64_t end_us, bool done);
+  void add_instant(int tid, std::int64_t ts_us, trace_record const &rec);
+
+  std::optional<std::chrono::system_clock::time_point> origin_;
+  std::int64_t last_us_{ 0 };
+  std::vector<track> tracks_;  // Index = tid; 0 is the engine
+  std::unordered_map<std::string, int> track_ids_;
+  std::array<std::vector<std::pair<std::int64_t, int>>, kCounterCount> counters_;
+  std::uint64_t next_flow_id_{ 1 };
+  std::string events_;  // Comma-separated trace events
+};
+
+}  // namespace envy
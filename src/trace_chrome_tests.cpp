@@ -0,0 +1,296 @@
+#include "trace_chrome.h"
+
+#include "doctest.h"
+#include "picojson.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace envy {
+
+namespace {
+
+std::filesystem::path const kGoldenDir{ "test_data/trace" };
+
+std::string read_file(std::filesystem::path const &path) {
+  std::ifstream in{ path, std::ios::binary };
+  REQUIRE(in);
+  return { std::istreambuf_iterator<char>{ in }, {} };
+}
+
+std::string export_records(std::vector<trace_record> const &records) {
+  trace_chrome_exporter exporter;
+  for (auto const &rec : records) { exporter.add(rec); }
+  return exporter.finish();
+}
+
+// Records in the order added, `at_ms` after the epoch.
+struct trace_builder {
+  std::vector<trace_record> records;
+
+  void add(std::string spec, trace_event_t event, std::int64_t at_ms) {
+    records.push_back(trace_record{
+        .seq = records.size(),
+        .ts = std::chrono::system_clock::time_point{ std::chrono::milliseconds{ at_ms } },
+        .tid = 0,
+        .spec = std::move(spec),
+        .event = std::move(event) });
+  }
+};
+
+struct parsed_event {
+  std::string name;
+  std::string cat;
+  std::string ph;
+  std::int64_t tid;
+  std::int64_t ts;
+  std::int64_t dur;
+  picojson::object obj;
+};
+
+std::int64_t number(picojson::object const &obj, char const *key) {
+  auto const it{ obj.find(key) };
+  REQUIRE_MESSAGE(it != obj.end(), key);
+  REQUIRE(it->second.is<double>());
+  return static_cast<std::int64_t>(it->second.get<double>());
+}
+
+// Checks the document against the Trace Event format as chrome://tracing and
+// Perfetto read it, then returns its events for scenario checks.
+std::vector<parsed_event> check_chrome_schema(std::string const &json) {
+  picojson::value root;
+  REQUIRE(picojson::parse(root, json).empty());
+  REQUIRE(root.is<picojson::object>());
+  auto const &doc{ root.get<picojson::object>() };
+  REQUIRE(doc.count("traceEvents") == 1);
+  REQUIRE(doc.at("traceEvents").is<picojson::array>());
+
+  std::vector<parsed_event> events;
+  for (auto const &value : doc.at("traceEvents").get<picojson::array>()) {
+    REQUIRE(value.is<picojson::object>());
+    auto const &obj{ value.get<picojson::object>() };
+    REQUIRE(obj.count("name") == 1);
+    REQUIRE(obj.at("name").is<std::string>());
+    REQUIRE(obj.count("ph") == 1);
+    REQUIRE(obj.at("ph").is<std::string>());
+    CHECK(number(obj, "pid") == 1);
+    parsed_event e{ .name = obj.at("name").get<std::string>(),
+                    .cat = obj.count("cat") ? obj.at("cat").get<std::string>() : "",
+                    .ph = obj.at("ph").get<std::string>(),
+                    .tid = number(obj, "tid"),
+                    .ts = number(obj, "ts"),
+                    .dur = 0,
+                    .obj = obj };
+    CHECK(e.ts >= 0);
+    CHECK(std::set<std::string>{ "M", "X", "i", "s", "f", "C" }.count(e.ph) == 1);
+    if (e.ph == "X") {
+      e.dur = number(obj, "dur");
+      CHECK(e.dur >= 0);
+    } else if (e.ph == "i") {
+      CHECK(obj.at("s").get<std::string>() == "t");
+    } else if (e.ph == "C" || e.ph == "M") {
+      REQUIRE(obj.count("args") == 1);
+      CHECK(obj.at("args").is<picojson::object>());
+    }
+    events.push_back(std::move(e));
+  }
+
+  // Slices on one track must nest, never partially overlap.
+  std::map<std::int64_t, std::vector<parsed_event const *>> slices;
+  for (auto const &e : events) {
+    if (e.ph == "X") { slices[e.tid].push_back(&e); }
+  }
+  for (auto &[tid, track] : slices) {
+    std::sort(track.begin(), track.end(), [](auto const *a, auto const *b) {
+      return a->ts != b->ts ? a->ts < b->ts : a->dur > b->dur;
+    });
+    for (std::size_t i{ 1 }; i < track.size(); ++i) {
+      auto const &prev{ *track[i - 1] };
+      auto const &cur{ *track[i] };
+      bool const after{ cur.ts >= prev.ts + prev.dur };
+      bool const inside{ cur.ts + cur.dur <= prev.ts + prev.dur };
+      CHECK_MESSAGE((after || inside), cur.name);
+    }
+  }
+
+  // Flow ends come in pairs and each sits inside a slice on its track.
+  std::map<std::int64_t, std::vector<parsed_event const *>> flows;
+  for (auto const &e : events) {
+    if (e.ph == "s" || e.ph == "f") { flows[number(e.obj, "id")].push_back(&e); }
+  }
+  for (auto const &[id, ends] : flows) {
+    REQUIRE(ends.size() == 2);
+    CHECK(ends[0]->ph == "s");
+    CHECK(ends[1]->ph == "f");
+    for (auto const *end : ends) {
+      auto const &track{ slices[end->tid] };
+      CHECK(std::any_of(track.begin(), track.end(), [&](auto const *s) {
+        return s->ts <= end->ts && end->ts <= s->ts + s->dur;
+      }));
+    }
+  }
+  return events;
+}
+
+std::vector<parsed_event> with_ph(std::vector<parsed_event> const &events,
+                                  std::string const &ph) {
+  std::vector<parsed_event> out;
+  std::copy_if(events.begin(), events.end(), std::back_inserter(out), [&](auto const &e) {
+    return e.ph == ph;
+  });
+  return out;
+}
+
+}  // namespace
+
+TEST_CASE("trace_chrome_exporter matches the golden timeline") {
+  auto const records{ trace_read_jsonl(kGoldenDir / "phases.jsonl") };
+  auto const json{ export_records(records) };
+  check_chrome_schema(json);
+  CHECK(json == read_file(kGoldenDir / "phases.chrome.json"));
+}
+
+TEST_CASE("trace_chrome_exporter gives each package a track of phase slices") {
+  trace_builder b;
+  b.add("", trace_events::trace_start{ .schema = 2 }, 0);
+  b.add("a@v1", trace_events::phase_start{ .phase = pkg_phase::pkg_fetch }, 1);
+  b.add("b@v1", trace_events::phase_start{ .phase = pkg_phase::pkg_fetch }, 2);
+  b.add("a@v1",
+        trace_events::phase_complete{ .phase = pkg_phase::pkg_fetch, .duration_ms = 4 },
+        5);
+  b.add("b@v1", trace_events::phase_start{ .phase = pkg_phase::pkg_build }, 6);
+
+  auto const events{ check_chrome_schema(export_records(b.records)) };
+  auto const slices{ with_ph(events, "X") };
+  REQUIRE(slices.size() == 3);
+
+  CHECK(slices[0].name == "fetch");
+  CHECK(slices[0].ts == 1000);
+  CHECK(slices[0].dur == 4000);
+
+  // b's fetch never completed: closed where build started, then build runs to the end.
+  CHECK(slices[1].name == "fetch");
+  CHECK(slices[1].tid != slices[0].tid);
+  CHECK(slices[1].obj.count("args") == 1);
+  CHECK(slices[2].name == "build");
+  CHECK(slices[2].ts + slices[2].dur == 6000);
+
+  std::map<std::int64_t, std::string> names;
+  for (auto const &m : with_ph(events, "M")) {
+    if (m.name == "thread_name") {
+      names[m.tid] =
+          m.obj.at("args").get<picojson::object>().at("name").get<std::string>();
+    }
+  }
+  CHECK(names[0] == "engine");
+  CHECK(names[slices[0].tid] == "a@v1");
+  CHECK(names[slices[1].tid] == "b@v1");
+}
+
+TEST_CASE("trace_chrome_exporter links real dependency waits with a flow") {
+  trace_builder b;
+  b.add("dep@v1", trace_events::phase_start{ .phase = pkg_phase::pkg_build }, 0);
+  b.add("app@v1",
+        trace_events::phase_blocked{ .blocked_at_phase = pkg_phase::pkg_build,
+                                     .waiting_for = "dep@v1",
+                                     .target_phase = pkg_phase::completion },
+        1);
+  b.add("dep@v1",
+        trace_events::phase_complete{ .phase = pkg_phase::pkg_build, .duration_ms = 10 },
+        10);
+  b.add("app@v1",
+        trace_events::phase_unblocked{ .unblocked_at_phase = pkg_phase::pkg_build,
+                                       .dependency = "dep@v1" },
+        11);
+
+  SUBCASE("a wait the dependency ended becomes a slice with a flow") {
+    auto const events{ check_chrome_schema(export_records(b.records)) };
+    auto const slices{ with_ph(events, "X") };
+    auto const wait{ std::find_if(slices.begin(), slices.end(), [](auto const &e) {
+      return e.cat == "wait";
+    }) };
+    REQUIRE(wait != slices.end());
+    CHECK(wait->name == "waiting for dep@v1");
+    CHECK(wait->ts == 1000);
+    CHECK(wait->dur == 10000);
+    CHECK(with_ph(events, "s").size() == 1);
+    CHECK(with_ph(events, "f").size() == 1);
+  }
+
+  SUBCASE("re-checking a satisfied edge leaves no trace") {
+    b.add("app@v1",
+          trace_events::phase_blocked{ .blocked_at_phase = pkg_phase::pkg_install,
+                                       .waiting_for = "dep@v1",
+                                       .target_phase = pkg_phase::completion },
+          12);
+    b.add("app@v1",
+          trace_events::phase_unblocked{ .unblocked_at_phase = pkg_phase::pkg_install,
+                                         .dependency = "dep@v1" },
+          13);
+    auto const events{ check_chrome_schema(export_records(b.records)) };
+    auto const slices{ with_ph(events, "X") };
+    CHECK(std::count_if(slices.begin(), slices.end(), [](auto const &e) {
+            return e.cat == "wait";
+          }) == 1);
+    CHECK(with_ph(events, "s").size() == 1);
+  }
+
+  SUBCASE("a wait still open at the end is marked incomplete") {
+    std::vector<trace_record> const unfinished{ b.records.begin(), b.records.begin() + 3 };
+    auto const events{ check_chrome_schema(export_records(unfinished)) };
+    auto const slices{ with_ph(events, "X") };
+    auto const wait{ std::find_if(slices.begin(), slices.end(), [](auto const &e) {
+      return e.cat == "wait";
+    }) };
+    REQUIRE(wait != slices.end());
+    CHECK(wait->obj.at("args").get<picojson::object>().count("incomplete") == 1);
+    CHECK(with_ph(events, "s").empty());
+  }
+}
+
+TEST_CASE("trace_chrome_exporter counts concurrent downloads and shell commands") {
+  trace_builder b;
+  b.add("a@v1", trace_events::download_start{ .url = "u1" }, 0);
+  b.add("b@v1", trace_events::download_start{ .url = "u2" }, 2);
+  b.add("a@v1", trace_events::download_complete{ .url = "u1" }, 5);
+  b.add("b@v1", trace_events::download_failed{ .url = "u2", .error = "404" }, 6);
+  b.add("a@v1",
+        trace_events::shell_command_usage{ .phase = pkg_phase::pkg_build, .wall_ms = 3 },
+        9);
+
+  auto const events{ check_chrome_schema(export_records(b.records)) };
+  std::map<std::string, std::vector<std::pair<std::int64_t, std::int64_t>>> series;
+  for (auto const &c : with_ph(events, "C")) {
+    series[c.name].emplace_back(c.ts, number(c.obj.at("args").get<picojson::object>(),
+                                             "active"));
+  }
+  using samples = std::vector<std::pair<std::int64_t, std::int64_t>>;
+  CHECK(series["downloads"] == samples{ { 0, 1 }, { 2000, 2 }, { 5000, 1 },
+                                        { 6000, 0 } });
+  CHECK(series["shell commands"] == samples{ { 0, 0 }, { 6000, 1 }, { 9000, 0 } });
+  CHECK(series["extractions"] == samples{ { 0, 0 } });
+
+  // The events themselves stay visible as instants with their fields.
+  auto const instants{ with_ph(events, "i") };
+  REQUIRE(instants.size() == 5);
+  CHECK(instants[3].name == "download_failed");
+  auto const &args{ instants[3].obj.at("args").get<picojson::object>() };
+  CHECK(args.at("error").get<std::string>() == "404");
+}
+
+TEST_CASE("trace_chrome_exporter writes a valid document for an empty trace") {
+  auto const events{ check_chrome_schema(trace_chrome_exporter{}.finish()) };
+  CHECK(with_ph(events, "X").empty());
+  CHECK(with_ph(events, "C").size() == 3);
+}
+
+}  // namespace envy
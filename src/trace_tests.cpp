@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <chrono>
 #include <cstddef>
+#include <stdexcept>
 #include <string>
 #include <utility>
 #include <variant>
@@ -58,7 +59,7 @@ void check_all(std::index_sequence<Is...>) {
 }  // namespace
 
 TEST_CASE("trace_record_to_json emits valid JSON for every event type") {
-  static_assert(envy::kTraceEventCount == 27,
+  static_assert(envy::kTraceEventCount == 31,
                 "trace_event_t changed: confirm the new/removed event serializes and "
                 "update this count");
   check_all(std::make_index_sequence<envy::kTraceEventCount>{});
@@ -150,3 +151,64 @@ TEST_CASE("phase fields serialize as names") {
   CHECK(json.find("\"phase\":\"fetch\"") != std::string::npos);
   CHECK(json.find("phase_num") == std::string::npos);
 }
+
+TEST_CASE("trace_record_from_json reads back every event type") {
+  auto round_trip{ [&]<std::size_t... Is>(std::index_sequence<Is...>) {
+    (
+        [&] {
+          using alternative = std::variant_alternative_t<Is, envy::trace_event_t>;
+          auto const rec{ make_record(
+              envy::trace_event_t{ std::in_place_index<Is>, alternative{} }) };
+          auto const json{ envy::trace_record_to_json(rec) };
+          CHECK(envy::trace_record_to_json(envy::trace_record_from_json(json)) == json);
+        }(),
+        ...);
+  } };
+  round_trip(std::make_index_sequence<envy::kTraceEventCount>{});
+}
+
+TEST_CASE("trace_record_from_json keeps field values and the ms timestamp") {
+  auto rec{ make_record(envy::trace_events::cache_hit{ .cache_key = "k \"q\"\n",
+                                                       .pkg_path = "/c/pkg",
+                                                       .fast_path = true }) };
+  rec.ts = std::chrono::sys_days{ std::chrono::year{ 2025 } / 1 / 15 } +
+           std::chrono::hours{ 10 } + std::chrono::minutes{ 30 } +
+           std::chrono::milliseconds{ 123 };
+  auto const back{ envy::trace_record_from_json(envy::trace_record_to_json(rec)) };
+  CHECK(back.seq == 7);
+  CHECK(back.tid == 3);
+  CHECK(back.spec == "ns.pkg@v1");
+  CHECK(back.ts == rec.ts);
+  auto const *hit{ std::get_if<envy::trace_events::cache_hit>(&back.event) };
+  REQUIRE(hit);
+  CHECK(hit->cache_key == "k \"q\"\n");
+  CHECK(hit->pkg_path == "/c/pkg");
+  CHECK(hit->fast_path);
+
+  auto const phase{ envy::trace_record_from_json(
+      R"({"seq":1,"ts":"2025-01-15T10:30:00.000Z","tid":0,"event":"phase_complete",)"
+      R"("phase":"build","duration_ms":42})") };
+  auto const *complete{ std::get_if<envy::trace_events::phase_complete>(&phase.event) };
+  REQUIRE(complete);
+  CHECK(complete->phase == envy::pkg_phase::pkg_build);
+  CHECK(complete->duration_ms == 42);
+  CHECK(phase.spec.empty());
+}
+
+TEST_CASE("trace_record_from_json rejects malformed records") {
+  CHECK_THROWS_AS(envy::trace_record_from_json("not json"), std::runtime_error);
+  CHECK_THROWS_AS(
+      envy::trace_record_from_json(R"({"seq":1,"ts":"2025-01-15T10:30:00.000Z","tid":0})"),
+      std::runtime_error);
+  CHECK_THROWS_AS(
+      envy::trace_record_from_json(
+          R"({"seq":1,"ts":"2025-01-15T10:30:00.000Z","tid":0,"event":"no_such"})"),
+      std::runtime_error);
+  CHECK_THROWS_AS(envy::trace_record_from_json(
+                      R"({"seq":1,"ts":"yesterday","tid":0,"event":"trace_start"})"),
+                  std::runtime_error);
+  CHECK_THROWS_AS(
+      envy::trace_record_from_json(R"({"seq":1,"ts":"2025-01-15T10:30:00.000Z","tid":0,)"
+                                   R"("event":"phase_start","phase":"nope"})"),
+      std::runtime_error);
+}
@@ -1,6 +1,8 @@
 #include "tui.h"
 
 #include "platform.h"
+#include "trace_buffer.h"
+#include "trace_chrome.h"
 #include "util.h"
 
 #include <algorithm>
@@ -15,6 +17,7 @@
 #include <filesystem>
 #include <iomanip>
 #include <limits>
+#include <memory>
 #include <mutex>
 #include <numeric>
 #include <queue>
@@ -33,7 +36,10 @@
 using envy::tui::level;
 
 constexpr std::size_t kSeverityLabelWidth{ 3 };
-constexpr std::chrono::milliseconds kRefreshIntervalMs{ 33 };  // 30fps
+constexpr std::chrono::milliseconds kRefreshIntervalMs{ 33 };      // 30fps
+constexpr std::chrono::milliseconds kMaxRefreshIntervalMs{ 1000 };  // Slowest sink pace
+constexpr int kMaxWriteDutyDivisor{ 10 };  // Painting may take 1/10 of wall time
+constexpr std::chrono::milliseconds kTraceDrainInterval{ 5 };
 
 constexpr char const *kAnsiClearToEol{ "\x1b[K" };    // Clear from cursor to end of line
 constexpr char const *kAnsiClearToEos{ "\x1b[0J" };   // Clear from cursor to end of screen
@@ -66,9 +72,21 @@ struct tui {
   bool decorated{ false };
   bool initialized{ false };
   bool trace_stderr{ false };
-  std::FILE *trace_file{ nullptr };
+  std::FILE *trace_file{ nullptr };  // Written only by the trace writer while running
+  std::FILE *trace_chrome_file{ nullptr };  // Written once, at shutdown
+  std::unique_ptr<envy::trace_chrome_exporter> trace_chrome;  // Fed by the trace writer
+
+  std::thread trace_writer;
+  std::mutex trace_mutex;  // protects trace_stop and trace_cv
+  std::condition_variable trace_cv;
+  bool trace_stop{ false };
+  std::atomic_bool trace_wake{ false };  // A ring is filling up; drain before the timeout
 } s_tui{};
 
+envy::trace_buffer s_trace_buffer{ envy::trace_buffer::kDefaultRingCapacity, [] {
+  if (!s_tui.trace_wake.exchange(true)) { s_tui.trace_cv.notify_one(); }
+} };
+
 struct section_state {
   unsigned handle;
   envy::tui::section_frame cached_frame;
@@ -82,7 +100,7 @@ struct section_state {
 struct tui_progress_state {
   std::vector<section_state> sections;
   unsigned next_handle{ 1 };
-  int last_line_count{ 0 };
+  std::vector<std::string> painted_lines;  // Progress area now on screen, top to bottom
   std::size_t max_label_width{ 0 };
   std::mutex interactive_mutex;
   bool interactive_paused{ false };
@@ -374,8 +392,26 @@ std::string render_static_text(envy::tui::static_text_data const &data,
   return oss.str();
 }
 
+// The frame with live content replaced by what its slot currently formats to.
+envy::tui::section_frame resolve_live_frame(envy::tui::section_frame const &frame,
+                                            envy::tui::live_progress_data const &data) {
+  envy::tui::section_frame resolved{ .label = frame.label,
+                                     .content = envy::tui::static_text_data{},
+                                     .children = frame.children,
+                                     .phase_label = frame.phase_label };
+  if (data.slot && data.format) {
+    std::visit([&](auto &&content) { resolved.content = std::move(content); },
+               data.format(data.slot->read()));
+  }
+  return resolved;
+}
+
 std::string render_section_frame_fallback(envy::tui::section_frame const &frame,
                                           std::chrono::steady_clock::time_point now) {
+  if (auto const *live{ std::get_if<envy::tui::live_progress_data>(&frame.content) }) {
+    return render_section_frame_fallback(resolve_live_frame(frame, *live), now);
+  }
+
   if (!frame.children.empty()) {
     std::string output;
     auto parent_copy{ frame };
@@ -452,6 +488,14 @@ std::string render_section_frame(envy::tui::section_frame const &frame,
                                  std::chrono::steady_clock::time_point now) {
   if (!ansi_mode) { return render_section_frame_fallback(frame, now); }
 
+  if (auto const *live{ std::get_if<envy::tui::live_progress_data>(&frame.content) }) {
+    return render_section_frame(resolve_live_frame(frame, *live),
+                                max_label_width,
+                                width,
+                                ansi_mode,
+                                now);
+  }
+
   if (!frame.children.empty()) {
     // Parent line (with optional phase suffix), then children indented by two spaces
     std::string output;
@@ -486,7 +530,8 @@ std::string render_section_frame(envy::tui::section_frame const &frame,
           },
           [&](envy::tui::static_text_data const &data) {
             return render_static_text(data, frame.label, max_label_width, width);
-          } },
+          },
+          [&](envy::tui::live_progress_data const &) { return std::string{}; } },
       frame.content);
 }
 
@@ -532,11 +577,60 @@ std::string truncate_lines_to_width(std::string const &text, int width_hint) {
   return out;
 }
 
-int render_progress_sections_ansi(std::vector<section_state> const &sections,
-                                  std::size_t max_label_width,
-                                  int last_line_count,
-                                  int width,
-                                  std::chrono::steady_clock::time_point now) {
+// Appends to `out` the bytes that turn the painted progress area into `next`, rewriting
+// only the rows that differ. The cursor sits on the last painted row before and after.
+// When the area shrinks, one cleared row stays below `next` as part of the area.
+void paint_lines_diff(std::vector<std::string> &painted,
+                      std::vector<std::string> next,
+                      std::string &out) {
+  bool const shrinking{ next.size() < painted.size() };
+  if (shrinking) { next.emplace_back(); }
+  if (next == painted) { return; }  // Skip the frame: nothing to write
+
+  std::size_t row{ painted.empty() ? 0 : painted.size() - 1 };
+  auto const move_to{ [&](std::size_t target) {
+    if (target < row) {
+      char buf[16];
+      std::snprintf(buf, sizeof(buf), kAnsiCursorUpFmt, static_cast<int>(row - target));
+      out += buf;
+    } else if (target == row) {
+      out += '\r';
+    } else {
+      out.append(target - row, '\n');
+    }
+    row = target;
+  } };
+
+  out += kAnsiDisableWrap;
+  for (std::size_t i{ 0 }; i < next.size(); ++i) {
+    if (i < painted.size() && painted[i] == next[i]) { continue; }
+    move_to(i);
+    out += next[i];
+    out += kAnsiClearToEol;
+  }
+  move_to(next.size() - 1);
+  if (shrinking) { out += kAnsiClearToEos; }
+  out += kAnsiEnableWrap;
+
+  painted = std::move(next);
+}
+
+// Next refresh delay given the average time one paint spent writing to the terminal.
+std::chrono::milliseconds refresh_interval(std::chrono::nanoseconds avg_write) {
+  auto const paced{
+    std::chrono::ceil<std::chrono::milliseconds>(avg_write * kMaxWriteDutyDivisor)
+  };
+  return std::clamp(paced, kRefreshIntervalMs, kMaxRefreshIntervalMs);
+}
+
+// Renders sections and repaints the rows of `painted` that changed. Returns the time
+// spent writing, or zero when the frame was identical and skipped.
+std::chrono::nanoseconds render_progress_sections_ansi(
+    std::vector<section_state> const &sections,
+    std::size_t max_label_width,
+    std::vector<std::string> &painted,
+    int width,
+    std::chrono::steady_clock::time_point now) {
   std::vector<std::string> rendered_lines;
 
   // Render each section and split into individual lines
@@ -554,32 +648,15 @@ int render_progress_sections_ansi(std::vector<section_state> const &sections,
     }
   }
 
-  std::fprintf(stderr, "%s", kAnsiDisableWrap);
-
-  // Ensure column 0, then move up to start position
-  std::fprintf(stderr, "\r");
-  if (last_line_count > 1) { std::fprintf(stderr, kAnsiCursorUpFmt, last_line_count - 1); }
-
-  // Render each line with per-line clear
-  int cur_frame_line_count{ 0 };
-  for (auto const &line : rendered_lines) {
-    if (cur_frame_line_count > 0) {  // Print \n before all lines except first
-      std::fprintf(stderr, "\n");
-    }
-    std::fprintf(stderr, "%s%s", line.c_str(), kAnsiClearToEol);
-    ++cur_frame_line_count;
-  }
-
-  // Clear remaining old lines if shrinking
-  if (cur_frame_line_count < last_line_count) {
-    std::fprintf(stderr, "\n%s", kAnsiClearToEos);
-    ++cur_frame_line_count;  // Account for the newline we just printed
-  }
+  std::string out;
+  paint_lines_diff(painted, std::move(rendered_lines), out);
+  if (out.empty()) { return {}; }
 
-  std::fprintf(stderr, "%s", kAnsiEnableWrap);
+  // One write per frame; its duration is how fast the sink drains.
+  auto const start{ std::chrono::steady_clock::now() };
+  std::fwrite(out.data(), 1, out.size(), stderr);
   std::fflush(stderr);
-
-  return cur_frame_line_count;
+  return std::chrono::steady_clock::now() - start;
 }
 
 void render_fallback_frame_unlocked(std::vector<section_state> const &sections,
@@ -742,17 +819,6 @@ void flush_messages(std::queue<log_entry> &pending,
           wrote_to_stderr = true;
         }
       }
-
-      if (s_tui.trace_file) {
-        auto const json{ envy::trace_record_to_json(*trace_ptr) + "\n" };
-        if (std::fwrite(json.data(), 1, json.size(), s_tui.trace_file) != json.size() ||
-            std::fflush(s_tui.trace_file) != 0) {
-          std::fflush(stderr);
-          std::fprintf(stderr, "Fatal: failed to write trace file\n");
-          std::fflush(stderr);
-          std::abort();
-        }
-      }
     }
   }
 
@@ -760,24 +826,26 @@ void flush_messages(std::queue<log_entry> &pending,
 }
 
 // Single render cycle: clear section area if needed, flush messages, render sections.
-// Returns the number of section lines rendered.
-int render_cycle(std::queue<log_entry> &pending,
-                 std::vector<section_state> const &sections,
-                 std::size_t max_label_width,
-                 int last_line_count) {
-  int rendered_line_count{ 0 };
+// `painted` is the progress area on screen and is updated to what this cycle left there.
+// Returns the time the progress repaint spent writing (zero if nothing was repainted).
+std::chrono::nanoseconds render_cycle(std::queue<log_entry> &pending,
+                                      std::vector<section_state> const &sections,
+                                      std::size_t max_label_width,
+                                      std::vector<std::string> &painted) {
+  std::chrono::nanoseconds write_time{ 0 };
   bool const ansi{ is_ansi_supported() };
   auto const now{ get_now() };
   bool const has_messages{ !pending.empty() };
 
-  if (ansi && has_messages && last_line_count > 0) {
+  if (ansi && has_messages && !painted.empty()) {
     std::fprintf(stderr, "\r");
-    if (last_line_count > 1) {
-      std::fprintf(stderr, kAnsiCursorUpFmt, last_line_count - 1);
+    if (painted.size() > 1) {
+      std::fprintf(stderr, kAnsiCursorUpFmt, static_cast<int>(painted.size() - 1));
     }
     std::fprintf(stderr, "%s", kAnsiClearToEos);
     std::fflush(stderr);
   }
+  if (has_messages) { painted.clear(); }  // Logs scroll the old area away
 
   flush_messages(pending, s_tui.output_handler);
 
@@ -785,22 +853,19 @@ int render_cycle(std::queue<log_entry> &pending,
     int const width{ get_terminal_width() };
 
     if (ansi) {
-      int const effective_last{ has_messages ? 0 : last_line_count };
-      rendered_line_count = render_progress_sections_ansi(sections,
-                                                          max_label_width,
-                                                          effective_last,
-                                                          width,
-                                                          now);
+      write_time =
+          render_progress_sections_ansi(sections, max_label_width, painted, width, now);
     } else {
       render_fallback_frame_unlocked(sections, now);
     }
   }
 
-  return rendered_line_count;
+  return write_time;
 }
 
 void worker_thread() {
   std::unique_lock<std::mutex> lock{ s_tui.mutex };
+  std::chrono::nanoseconds avg_write{ 0 };  // Moving average over repainted frames
 
   while (!s_tui.stop_requested) {
     try {
@@ -809,28 +874,37 @@ void worker_thread() {
 
       std::vector<section_state> sections_snapshot;
       std::size_t max_label_width{ 0 };
-      int last_line_count{ 0 };
+      std::vector<std::string> painted;
 
       if (s_progress.enabled && !s_progress.interactive_paused) {
         sections_snapshot = s_progress.sections;
         max_label_width = s_progress.max_label_width;
-        last_line_count = s_progress.last_line_count;
+        painted = s_progress.painted_lines;
       }
 
       lock.unlock();
 
-      int const rendered_line_count{
-        render_cycle(pending, sections_snapshot, max_label_width, last_line_count)
+      auto const write_time{
+        render_cycle(pending, sections_snapshot, max_label_width, painted)
       };
+      if (write_time.count() > 0) { avg_write += (write_time - avg_write) / 4; }
 
       lock.lock();
 
       if (is_ansi_supported() && s_progress.enabled && !s_progress.interactive_paused) {
-        s_progress.last_line_count = rendered_line_count;
+        s_progress.painted_lines = std::move(painted);
       }
-      s_tui.cv.wait_until(lock, std::chrono::steady_clock::now() + kRefreshIntervalMs, [] {
-        return s_tui.stop_requested.load();
-      });
+      // Every cycle that flushes logs repaints progress in full, so queued log lines end
+      // the paced wait early but never before the 30fps minimum interval.
+      auto const rendered{ std::chrono::steady_clock::now() };
+      s_tui.cv.wait_until(lock,
+                          rendered + kRefreshIntervalMs,
+                          [] { return s_tui.stop_requested.load(); });
+      s_tui.cv.wait_until(lock,
+                          rendered + refresh_interval(avg_write),
+                          [] {
+                            return s_tui.stop_requested.load() || !s_tui.messages.empty();
+                          });
     } catch (std::exception const &e) {
       if (!lock.owns_lock()) { lock.lock(); }
       std::fprintf(stderr, "[TUI worker thread exception: %s]\n", e.what());
@@ -849,21 +923,19 @@ void worker_thread() {
 
     std::vector<section_state> sections_snapshot;
     std::size_t max_label_width{ 0 };
-    int last_line_count{ 0 };
+    std::vector<std::string> painted;
 
     if (s_progress.enabled) {
       sections_snapshot = s_progress.sections;
       max_label_width = s_progress.max_label_width;
-      last_line_count = s_progress.last_line_count;
+      painted = s_progress.painted_lines;
     }
 
     lock.unlock();
 
-    int const rendered_line_count{
-      render_cycle(pending, sections_snapshot, max_label_width, last_line_count)
-    };
+    render_cycle(pending, sections_snapshot, max_label_width, painted);
 
-    if (rendered_line_count > 0) {
+    if (!painted.empty()) {
       std::fprintf(stderr, "\n");
       std::fflush(stderr);
     }
@@ -876,6 +948,81 @@ void worker_thread() {
   }
 }
 
+// Stamps tid and queues the record on this thread's trace ring.
+void queue_trace(std::string spec, envy::trace_event_t event) {
+  static std::atomic<std::uint32_t> s_next_tid{ 0 };
+  thread_local std::uint32_t const tid{ s_next_tid.fetch_add(1) };
+
+  s_trace_buffer.push(envy::trace_record{ .seq = 0,
+                                          .ts = std::chrono::system_clock::now(),
+                                          .tid = tid,
+                                          .spec = std::move(spec),
+                                          .event = std::move(event) });
+}
+
+// Moves queued trace records out in seq order: JSON goes to the trace file in one
+// write, and stderr records join the message queue so they interleave with logs.
+void write_trace_batch(bool flush) {
+  for (auto const &[tid, count] : s_trace_buffer.take_dropped()) {
+    queue_trace("",
+                envy::trace_events::trace_dropped{
+                    .thread = static_cast<std::int64_t>(tid),
+                    .count = static_cast<std::int64_t>(count) });
+  }
+
+  std::vector<envy::trace_record> batch;
+  s_trace_buffer.drain(batch, flush);
+  if (batch.empty()) { return; }
+
+  if (s_tui.trace_file) {
+    std::string json;
+    for (auto const &rec : batch) {
+      json += envy::trace_record_to_json(rec);
+      json += '\n';
+    }
+    if (std::fwrite(json.data(), 1, json.size(), s_tui.trace_file) != json.size() ||
+        std::fflush(s_tui.trace_file) != 0) {
+      std::fflush(stderr);
+      std::fprintf(stderr, "Fatal: failed to write trace file\n");
+      std::fflush(stderr);
+      std::abort();
+    }
+  }
+
+  if (s_tui.trace_chrome) {
+    for (auto const &rec : batch) { s_tui.trace_chrome->add(rec); }
+  }
+
+  if (s_tui.trace_stderr) {
+    {
+      std::lock_guard<std::mutex> lock{ s_tui.mutex };
+      for (auto &rec : batch) { s_tui.messages.push(log_entry{ std::move(rec) }); }
+    }
+    s_tui.cv.notify_one();
+  }
+}
+
+// Background half of tracing: emitting threads only fill their rings; this thread does
+// the merging, formatting and IO. The final pass after stop releases everything queued.
+void trace_writer_thread() {
+  std::unique_lock<std::mutex> lock{ s_tui.trace_mutex };
+  while (true) {
+    bool const stopping{ s_tui.trace_stop };
+    lock.unlock();
+    try {
+      write_trace_batch(stopping);
+    } catch (std::exception const &e) {
+      std::fprintf(stderr, "[TUI trace writer exception: %s]\n", e.what());
+      std::fflush(stderr);
+    }
+    lock.lock();
+    if (stopping) { break; }
+    s_tui.trace_cv.wait_for(lock, kTraceDrainInterval, [] {
+      return s_tui.trace_stop || s_tui.trace_wake.exchange(false);
+    });
+  }
+}
+
 thread_local std::string s_log_ctx;
 
 void log_formatted(level severity, char const *fmt, va_list args) {
@@ -943,13 +1090,19 @@ void configure_trace_outputs(std::vector<trace_output_spec> outputs) {
     throw std::logic_error{ "envy::tui::configure_trace_outputs called while running" };
   }
 
-  // Close previous file if any
+  // Close previous files if any
   if (s_tui.trace_file) {
     std::fclose(s_tui.trace_file);
     s_tui.trace_file = nullptr;
   }
+  if (s_tui.trace_chrome_file) {
+    std::fclose(s_tui.trace_chrome_file);
+    s_tui.trace_chrome_file = nullptr;
+  }
+  s_tui.trace_chrome.reset();
 
   s_tui.trace_stderr = false;
+  s_trace_buffer.reset();  // Records queued under the previous configuration never ran
 
   for (auto const &spec : outputs) {
     if (spec.type == trace_output_type::std_err) {
@@ -963,10 +1116,20 @@ void configure_trace_outputs(std::vector<trace_output_spec> outputs) {
       if (!s_tui.trace_file) {
         throw std::runtime_error("Failed to open trace file: " + spec.file_path->string());
       }
+    } else if (spec.type == trace_output_type::chrome && spec.file_path) {
+      if (s_tui.trace_chrome_file) {
+        throw std::logic_error{ "Only one chrome trace output supported" };
+      }
+      // Opened now so a bad path fails before the run rather than after it.
+      s_tui.trace_chrome_file = util_open_file(*spec.file_path, "wb").release();
+      if (!s_tui.trace_chrome_file) {
+        throw std::runtime_error("Failed to open trace file: " + spec.file_path->string());
+      }
+      s_tui.trace_chrome = std::make_unique<envy::trace_chrome_exporter>();
     }
   }
 
-  g_trace_enabled = s_tui.trace_stderr || s_tui.trace_file;
+  g_trace_enabled = s_tui.trace_stderr || s_tui.trace_file || s_tui.trace_chrome_file;
 
   // Header record: first line of every trace stream carries the schema version.
   ENVY_TRACE(trace_start, "", .schema = kTraceSchemaVersion);
@@ -985,6 +1148,10 @@ void run(std::optional<level> threshold, bool decorated_logging) {
   s_tui.decorated = decorated_logging;
   s_tui.stop_requested = false;
   s_tui.worker = std::thread{ worker_thread };
+  if (g_trace_enabled) {
+    s_tui.trace_stop = false;
+    s_tui.trace_writer = std::thread{ trace_writer_thread };
+  }
 }
 
 void shutdown() {
@@ -992,6 +1159,25 @@ void shutdown() {
     throw std::logic_error{ "envy::tui::shutdown called while not running" };
   }
 
+  // Trace writer first: its last batch may queue stderr records for the final render.
+  if (s_tui.trace_writer.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock{ s_tui.trace_mutex };
+      s_tui.trace_stop = true;
+    }
+    s_tui.trace_cv.notify_all();
+    s_tui.trace_writer.join();
+  }
+
+  // The timeline is one JSON document, complete only once every record is in.
+  if (s_tui.trace_chrome) {
+    auto const json{ s_tui.trace_chrome->finish() };
+    if (std::fwrite(json.data(), 1, json.size(), s_tui.trace_chrome_file) != json.size()) {
+      std::fprintf(stderr, "Failed to write chrome trace file\n");
+    }
+    s_tui.trace_chrome.reset();
+  }
+
   s_tui.stop_requested = true;
   s_tui.cv.notify_all();
   s_tui.worker.join();
@@ -1002,6 +1188,10 @@ void shutdown() {
     std::fclose(s_tui.trace_file);
     s_tui.trace_file = nullptr;
   }
+  if (s_tui.trace_chrome_file) {
+    std::fclose(s_tui.trace_chrome_file);
+    s_tui.trace_chrome_file = nullptr;
+  }
 }
 
 bool is_tty() { return platform::is_tty(); }
@@ -1009,22 +1199,8 @@ bool is_tty() { return platform::is_tty(); }
 void trace(std::string spec, trace_event_t event) {
   if (!g_trace_enabled) { return; }
 
-  static std::atomic<std::uint32_t> s_next_tid{ 0 };
-  thread_local std::uint32_t const tid{ s_next_tid.fetch_add(1) };
-
-  trace_record rec{ .seq = 0,
-                    .ts = std::chrono::system_clock::now(),
-                    .tid = tid,
-                    .spec = std::move(spec),
-                    .event = std::move(event) };
-  {
-    std::lock_guard<std::mutex> lock{ s_tui.mutex };
-    // seq assigned under the queue mutex: file order == seq order, strictly.
-    static std::uint64_t s_next_seq{ 0 };
-    rec.seq = s_next_seq++;
-    s_tui.messages.push(log_entry{ std::move(rec) });
-  }
-  s_tui.cv.notify_one();
+  // seq is stamped as the record enters its ring; the writer restores strict seq order.
+  queue_trace(std::move(spec), std::move(event));
 }
 
 void debug(char const *fmt, ...) {
@@ -1090,17 +1266,19 @@ void print_stdout(char const *fmt, ...) {
 
 void pause_rendering() {
   std::lock_guard lock{ s_tui.mutex };
-  if (is_ansi_supported() && s_progress.last_line_count > 0) {
-    std::fprintf(stderr, kAnsiCursorUpFmt, s_progress.last_line_count);
+  if (is_ansi_supported() && !s_progress.painted_lines.empty()) {
+    std::fprintf(stderr,
+                 kAnsiCursorUpFmt,
+                 static_cast<int>(s_progress.painted_lines.size()));
     std::fprintf(stderr, "%s%s%s", kAnsiClearToEos, kAnsiEnableWrap, kAnsiShowCursor);
-    s_progress.last_line_count = 0;
+    s_progress.painted_lines.clear();
     std::fflush(stderr);
   }
 }
 
 void resume_rendering() {
   // No mutex needed: only writes to stderr without accessing shared state
-  // pause_rendering() needs mutex because it reads/modifies s_progress.last_line_count
+  // pause_rendering() needs mutex because it reads/modifies s_progress.painted_lines
   if (is_ansi_supported()) {
     std::fprintf(stderr, "%s", kAnsiHideCursor);
     std::fflush(stderr);
@@ -1157,6 +1335,36 @@ void section_delete(section_handle h) {
   if (it != s_progress.sections.end()) { s_progress.sections.erase(it); }
 }
 
+void progress_slot::publish(std::uint32_t kind, values_t const &values) {
+  // Sequence lock, writer side: odd while the fields are being replaced.
+  auto const seq{ seq_.load(std::memory_order_relaxed) };
+  seq_.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  kind_.store(kind, std::memory_order_relaxed);
+  for (std::size_t i{ 0 }; i < kValues; ++i) {
+    values_[i].store(values[i], std::memory_order_relaxed);
+  }
+  seq_.store(seq + 2, std::memory_order_release);
+}
+
+progress_slot::snapshot progress_slot::read() const {
+  for (;;) {
+    auto const before{ seq_.load(std::memory_order_acquire) };
+    if (before & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    snapshot snap{ .version = before / 2,
+                   .kind = kind_.load(std::memory_order_relaxed),
+                   .values = {} };
+    for (std::size_t i{ 0 }; i < kValues; ++i) {
+      snap.values[i] = values_[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seq_.load(std::memory_order_relaxed) == before) { return snap; }
+  }
+}
+
 bool section_has_content(section_handle h) {
   if (h == 0 || !s_progress.enabled) { return false; }
 
@@ -1242,6 +1450,24 @@ std::string render_section_frame(section_frame const &frame) {
   return ::render_section_frame(frame, max_width, width, g_isatty, now);
 }
 
+std::string paint_progress_lines(std::vector<std::string> &painted,
+                                 std::vector<std::string> const &next) {
+  std::string out;
+  ::paint_lines_diff(painted, next, out);
+  return out;
+}
+
+std::chrono::milliseconds refresh_interval(std::chrono::nanoseconds avg_write) {
+  return ::refresh_interval(avg_write);
+}
+
+section_frame section_content(section_handle h) {
+  std::lock_guard lock{ s_tui.mutex };
+  auto it{ std::ranges::find_if(s_progress.sections,
+                                [h](auto const &sec) { return sec.handle == h; }) };
+  return it == s_progress.sections.end() ? section_frame{} : it->cached_frame;
+}
+
 int calculate_visible_length(std::string_view str) {
   return ::calculate_visible_length(str);
 }
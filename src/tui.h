@@ -2,9 +2,13 @@
 
 #include "trace.h"
 
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <functional>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -23,7 +27,7 @@ namespace envy::tui {
 // log level — they bypass this threshold entirely.
 enum class level { TUI_DEBUG, TUI_INFO, TUI_WARN, TUI_ERROR };
 
-enum class trace_output_type { std_err, file };
+enum class trace_output_type { std_err, file, chrome };  // chrome: Trace Event JSON
 
 struct trace_output_spec {
   trace_output_type type;
@@ -101,9 +105,51 @@ struct static_text_data {
   std::string text;
 };
 
+// Numeric progress for high-rate producers (download, clone and extraction callbacks).
+// publish() is a handful of atomic stores: no lock, no allocation. The renderer reads a
+// consistent copy through a sequence lock and formats it only when it draws. One thread
+// publishes to a slot at a time.
+class progress_slot {
+ public:
+  static constexpr std::size_t kValues{ 6 };
+  using values_t = std::array<std::uint64_t, kValues>;
+
+  struct snapshot {
+    std::uint64_t version;  // Publishes so far; 0 = nothing published yet
+    std::uint32_t kind;     // Producer-defined: says what `values` hold
+    values_t values;
+  };
+
+  progress_slot() = default;
+  progress_slot(progress_slot const &) = delete;
+  progress_slot &operator=(progress_slot const &) = delete;
+
+  void publish(std::uint32_t kind, values_t const &values);
+  snapshot read() const;
+
+ private:
+  std::atomic<std::uint64_t> seq_{ 0 };  // Odd while a publish is in progress
+  std::atomic<std::uint32_t> kind_{ 0 };
+  std::array<std::atomic<std::uint64_t>, kValues> values_{};
+};
+
+using live_content = std::variant<progress_data, spinner_data, static_text_data>;
+
+// Section content computed at draw time: the renderer reads `slot` and passes the
+// snapshot to `format`, which must not touch the producer's state.
+struct live_progress_data {
+  std::shared_ptr<progress_slot const> slot;
+  std::function<live_content(progress_slot::snapshot const &)> format;
+};
+
 struct section_frame {
   std::string label;
-  std::variant<progress_data, text_stream_data, spinner_data, static_text_data> content;
+  std::variant<progress_data,
+               text_stream_data,
+               spinner_data,
+               static_text_data,
+               live_progress_data>
+      content;
   std::vector<section_frame> children;  // Optional grouped children (indented render)
   std::string phase_label;              // Optional phase suffix for grouped parents
 };
@@ -134,6 +180,13 @@ extern bool g_isatty;
 extern std::chrono::steady_clock::time_point g_now;
 
 std::string render_section_frame(section_frame const &frame);
+section_frame section_content(section_handle h);  // Last frame set; empty if none
+
+// Differential progress painting: returns the bytes that turn `painted` into `next` and
+// updates `painted` to the rows now on screen.
+std::string paint_progress_lines(std::vector<std::string> &painted,
+                                 std::vector<std::string> const &next);
+std::chrono::milliseconds refresh_interval(std::chrono::nanoseconds avg_write);
 
 // Helper functions for testing ANSI-aware line padding and truncation
 int calculate_visible_length(std::string_view str);
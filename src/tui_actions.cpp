@@ -3,6 +3,8 @@
 #include "util.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 
@@ -48,52 +50,116 @@ void run_progress::on_output_line(std::string_view line) {
                                                    .header_text = header_text_ } });
 }
 
+// ==== progress slot encoding ====
+
+namespace {
+
+// What a tracker's progress_slot values hold, keyed by snapshot kind.
+enum progress_kind : std::uint32_t {
+  kNone = 0,  // Nothing published yet
+  kTransfer,  // transferred, total, has_total
+  kGit,       // received_objects, total_objects, received_bytes, percent x 100
+  kExtract,   // files, total_files, has_total_files, bytes, total_bytes, has_total_bytes
+};
+
+tui::progress_slot::values_t transfer_values(fetch_transfer_progress const &p) {
+  return { p.transferred, p.total.value_or(0), p.total.has_value(), 0, 0, 0 };
+}
+
+double percent_of(std::uint64_t done, std::uint64_t total) {
+  if (total == 0) { return 0.0; }
+  return std::min(100.0, (done / static_cast<double>(total)) * 100.0);
+}
+
+std::string transfer_status(tui::progress_slot::values_t const &v) {
+  std::string status{ util_format_bytes(v[0]) };
+  if (v[2]) { status += "/" + util_format_bytes(v[1]); }
+  return status;
+}
+
+// libgit2 can report a smaller total mid-fetch, or a larger one once the pack header
+// arrives; every counter and the percent shown stay at their largest value so far. `prev`
+// is the slot's last snapshot: each slot has a single writer, so that is this fetch's
+// own history.
+tui::progress_slot::values_t git_values(tui::progress_slot::snapshot const &prev,
+                                        fetch_git_progress const &p) {
+  auto const last{ prev.kind == kGit ? prev.values : tui::progress_slot::values_t{} };
+  auto const percent_x100{ static_cast<std::uint64_t>(
+      percent_of(p.received_objects, p.total_objects) * 100.0) };
+  return { std::max<std::uint64_t>(last[0], p.received_objects),
+           std::max<std::uint64_t>(last[1], p.total_objects),
+           std::max<std::uint64_t>(last[2], p.received_bytes),
+           std::max(last[3], percent_x100),
+           0,
+           0 };
+}
+
+double git_percent(tui::progress_slot::values_t const &v) { return v[3] / 100.0; }
+
+std::string git_status(tui::progress_slot::values_t const &v) {
+  std::string status{ std::to_string(v[0]) };
+  if (v[1] > 0) { status += "/" + std::to_string(v[1]); }
+  status += " objects";
+  if (v[2] > 0) { status += " " + util_format_bytes(v[2]); }
+  return status;
+}
+
+tui::section_frame live_frame(std::string label,
+                              std::shared_ptr<tui::progress_slot const> slot,
+                              decltype(tui::live_progress_data::format) format) {
+  return tui::section_frame{ .label = std::move(label),
+                             .content = tui::live_progress_data{
+                                 .slot = std::move(slot), .format = std::move(format) } };
+}
+
+}  // namespace
+
 // ==== extract_progress_tracker ====
 
 extract_progress_tracker::extract_progress_tracker(tui::section_handle section,
                                                    std::string const &pkg_identity,
                                                    std::string const &filename)
-    : section_{ section },
-      label_{ "[" + pkg_identity + "]" },
-      filename_{ filename },
-      start_time_{ std::chrono::steady_clock::now() } {
-  // Show initial spinner
+    : section_{ section }, slot_{ std::make_shared<tui::progress_slot>() } {
+  auto const start_time{ std::chrono::steady_clock::now() };
   tui::section_set_content(
       section_,
-      tui::section_frame{ .label = label_,
-                          .content = tui::spinner_data{ .text = "extracting " + filename_,
-                                                        .start_time = start_time_ } });
+      live_frame("[" + pkg_identity + "]",
+                 slot_,
+                 [filename, start_time](tui::progress_slot::snapshot const &s)
+                     -> tui::live_content {
+                   if (s.kind != kExtract) {  // Show initial spinner
+                     return tui::spinner_data{ .text = "extracting " + filename,
+                                               .start_time = start_time };
+                   }
+                   auto const &[files, total_files, has_total_files, bytes, total_bytes,
+                                has_total_bytes]{ s.values };
+
+                   double percent{ percent_of(files, total_files) };
+                   if (total_files == 0) { percent = percent_of(bytes, total_bytes); }
+
+                   std::string status{ std::to_string(files) };
+                   if (has_total_files) { status += "/" + std::to_string(total_files); }
+                   status += " files";
+                   if (has_total_bytes) {
+                     status += " " + util_format_bytes(bytes) + "/" +
+                               util_format_bytes(total_bytes);
+                   } else if (bytes > 0) {
+                     status += " " + util_format_bytes(bytes);
+                   }
+                   status += " " + filename;
+                   return tui::progress_data{ .percent = percent, .status = status };
+                 }));
 }
 
 bool extract_progress_tracker::operator()(extract_progress const &prog) {
   if (!section_) { return true; }
-
-  double percent{ 0.0 };
-  if (prog.total_files && *prog.total_files > 0) {
-    percent = (prog.files_processed / static_cast<double>(*prog.total_files)) * 100.0;
-  } else if (prog.total_bytes && *prog.total_bytes > 0) {
-    percent = (prog.bytes_processed / static_cast<double>(*prog.total_bytes)) * 100.0;
-  }
-  if (percent > 100.0) { percent = 100.0; }
-
-  std::ostringstream status;
-  status << prog.files_processed;
-  if (prog.total_files) { status << "/" << *prog.total_files; }
-  status << " files";
-  if (prog.total_bytes) {
-    status << " " << util_format_bytes(prog.bytes_processed) << "/"
-           << util_format_bytes(*prog.total_bytes);
-  } else if (prog.bytes_processed > 0) {
-    status << " " << util_format_bytes(prog.bytes_processed);
-  }
-  status << " " << filename_;
-
-  tui::section_set_content(
-      section_,
-      tui::section_frame{
-          .label = label_,
-          .content = tui::progress_data{ .percent = percent, .status = status.str() } });
-
+  slot_->publish(kExtract,
+                 { prog.files_processed,
+                   prog.total_files.value_or(0),
+                   prog.total_files.has_value(),
+                   prog.bytes_processed,
+                   prog.total_bytes.value_or(0),
+                   prog.total_bytes.has_value() });
   return true;
 }
 
@@ -102,65 +168,42 @@ bool extract_progress_tracker::operator()(extract_progress const &prog) {
 fetch_progress_tracker::fetch_progress_tracker(tui::section_handle section,
                                                std::string const &pkg_identity,
                                                std::string const &url)
-    : section_{ section },
-      label_{ "[" + pkg_identity + "]" },
-      url_{ url },
-      start_time_{ std::chrono::steady_clock::now() } {
-  // Show initial spinner
+    : section_{ section }, slot_{ std::make_shared<tui::progress_slot>() } {
+  auto const start_time{ std::chrono::steady_clock::now() };
   tui::section_set_content(
       section_,
-      tui::section_frame{ .label = label_,
-                          .content = tui::spinner_data{ .text = "fetching " + url_,
-                                                        .start_time = start_time_ } });
+      live_frame("[" + pkg_identity + "]",
+                 slot_,
+                 [url, start_time](tui::progress_slot::snapshot const &s)
+                     -> tui::live_content {
+                   switch (s.kind) {
+                     case kTransfer:
+                       return tui::progress_data{
+                         .percent = percent_of(s.values[0], s.values[1]),
+                         .status = transfer_status(s.values) + " " + url
+                       };
+                     case kGit:
+                       return tui::progress_data{
+                         .percent = git_percent(s.values),
+                         .status = git_status(s.values) + " " + url
+                       };
+                     default:  // Show initial spinner
+                       return tui::spinner_data{ .text = "fetching " + url,
+                                                 .start_time = start_time };
+                   }
+                 }));
 }
 
 bool fetch_progress_tracker::operator()(fetch_progress_t const &prog) {
   if (!section_) { return true; }
 
-  std::visit(
-      envy::match{
-          [&](fetch_transfer_progress const &p) {
-            double percent{ 0.0 };
-            if (p.total && *p.total > 0) {
-              percent = (p.transferred / static_cast<double>(*p.total)) * 100.0;
-            }
-            if (percent > 100.0) { percent = 100.0; }
-
-            std::ostringstream status;
-            status << util_format_bytes(p.transferred);
-            if (p.total) { status << "/" << util_format_bytes(*p.total); }
-            status << " " << url_;
-
-            tui::section_set_content(section_,
-                                     tui::section_frame{ .label = label_,
-                                                         .content = tui::progress_data{
-                                                             .percent = percent,
-                                                             .status = status.str() } });
-          },
-          [&](fetch_git_progress const &p) {
-            double percent{ 0.0 };
-            if (p.total_objects > 0) {
-              percent =
-                  (p.received_objects / static_cast<double>(p.total_objects)) * 100.0;
-            }
-            if (percent > 100.0) { percent = 100.0; }
-
-            std::ostringstream status;
-            status << p.received_objects;
-            if (p.total_objects > 0) { status << "/" << p.total_objects; }
-            status << " objects";
-            if (p.received_bytes > 0) {
-              status << " " << util_format_bytes(p.received_bytes);
-            }
-            status << " " << url_;
-
-            tui::section_set_content(section_,
-                                     tui::section_frame{ .label = label_,
-                                                         .content = tui::progress_data{
-                                                             .percent = percent,
-                                                             .status = status.str() } });
-          } },
-      prog);
+  std::visit(envy::match{ [&](fetch_transfer_progress const &p) {
+                           slot_->publish(kTransfer, transfer_values(p));
+                         },
+                          [&](fetch_git_progress const &p) {
+                            slot_->publish(kGit, git_values(slot_->read(), p));
+                          } },
+             prog);
 
   return true;
 }
@@ -171,33 +214,60 @@ fetch_all_progress_tracker::fetch_all_progress_tracker(
     tui::section_handle section,
     std::string const &pkg_identity,
     std::vector<std::string> const &labels,
-    std::string group_text)
-    : section_{ section },
-      label_{ "[" + pkg_identity + "]" },
-      group_text_{ std::move(group_text) },
-      mutex_{},
-      children_{},
-      git_states_(labels.size()),
-      grouped_{ labels.size() > 1 } {
-  children_.reserve(labels.size());
+    std::string group_text) {
+  bool const grouped{ labels.size() > 1 };
   auto const now{ std::chrono::steady_clock::now() };
+
+  std::vector<tui::section_frame> children;
+  children.reserve(labels.size());
+  slots_.reserve(labels.size());
   for (auto const &label : labels) {
-    children_.push_back(tui::section_frame{
-        .label = label,
-        .content = tui::spinner_data{ .text = label, .start_time = now } });
+    auto slot{ std::make_shared<tui::progress_slot>() };
+    children.push_back(live_frame(
+        label,
+        slot,
+        [label, grouped, now](tui::progress_slot::snapshot const &s)
+            -> tui::live_content {
+          std::string const suffix{ grouped ? "" : " " + label };
+          switch (s.kind) {
+            case kTransfer:
+              if (s.values[1] == 0) {
+                return tui::progress_data{ .percent = 0.0,
+                                           .status = util_format_bytes(s.values[0]) +
+                                                     suffix };
+              }
+              return tui::progress_data{ .percent = percent_of(s.values[0], s.values[1]),
+                                         .status = transfer_status(s.values) + suffix };
+            case kGit:
+              if (s.values[1] == 0) {
+                static auto const epoch{ std::chrono::steady_clock::time_point{} };
+                return tui::spinner_data{ .text = "starting..." + suffix,
+                                          .start_time = epoch };
+              }
+              if (s.values[0] >= s.values[1]) {
+                return tui::static_text_data{ .text = git_status(s.values) + suffix };
+              }
+              return tui::progress_data{ .percent = git_percent(s.values),
+                                         .status = git_status(s.values) + suffix };
+            default: return tui::spinner_data{ .text = label, .start_time = now };
+          }
+        }));
+    slots_.push_back(std::move(slot));
   }
 
-  // Render initial state so the TUI is visible during slow setup (e.g. AWS init).
-  if (grouped_) {
+  // The frame never changes after this: children render from their slots, so the TUI
+  // shows live progress without any further section_set_content calls. Rendering it now
+  // keeps the TUI visible during slow setup (e.g. AWS init).
+  std::string label{ "[" + pkg_identity + "]" };
+  if (grouped) {
     tui::section_set_content(
-        section_,
-        tui::section_frame{ .label = label_,
-                            .content = tui::static_text_data{ .text = group_text_ },
-                            .children = children_ });
-  } else if (!children_.empty()) {
-    tui::section_frame frame{ children_[0] };
-    frame.label = label_;
-    tui::section_set_content(section_, frame);
+        section,
+        tui::section_frame{ .label = std::move(label),
+                            .content = tui::static_text_data{ .text = group_text },
+                            .children = std::move(children) });
+  } else if (!children.empty()) {
+    children[0].label = std::move(label);
+    tui::section_set_content(section, children[0]);
   }
 }
 
@@ -213,104 +283,14 @@ fetch_progress_cb_t fetch_all_progress_tracker::make_callback(std::size_t slot)
 
 void fetch_all_progress_tracker::update_transfer(std::size_t slot,
                                                  fetch_transfer_progress const &prog) {
-  if (slot >= children_.size()) { return; }
-
-  std::string const &item_label = children_[slot].label;
-
-  if (!prog.total.has_value() || *prog.total == 0) {
-    std::ostringstream oss;
-    oss << util_format_bytes(prog.transferred);
-    if (!grouped_) { oss << " " << item_label; }
-    set_frame(slot,
-              tui::section_frame{
-                  .label = item_label,
-                  .content = tui::progress_data{ .percent = 0.0, .status = oss.str() } });
-    return;
-  }
-
-  double const percent{ (prog.transferred / static_cast<double>(*prog.total)) * 100.0 };
-  std::ostringstream oss;
-  oss << util_format_bytes(prog.transferred) << "/" << util_format_bytes(*prog.total);
-  if (!grouped_) { oss << " " << item_label; }
-  set_frame(slot,
-            tui::section_frame{ .label = item_label,
-                                .content = tui::progress_data{ .percent = percent,
-                                                               .status = oss.str() } });
+  if (slot >= slots_.size()) { return; }
+  slots_[slot]->publish(kTransfer, transfer_values(prog));
 }
 
 void fetch_all_progress_tracker::update_git(std::size_t slot,
                                             fetch_git_progress const &prog) {
-  if (slot >= children_.size() || slot >= git_states_.size()) { return; }
-
-  std::uint32_t snapshot_total{ 0 };
-  std::uint32_t snapshot_received{ 0 };
-  std::uint64_t snapshot_bytes{ 0 };
-  double snapshot_percent{ 0.0 };
-  std::string child_label;
-
-  {
-    std::lock_guard const lock{ mutex_ };
-    git_state &state = git_states_[slot];
-    state.max_total_objects = std::max(state.max_total_objects, prog.total_objects);
-    state.last_received_objects =
-        std::max(state.last_received_objects, prog.received_objects);
-    state.last_bytes = std::max(state.last_bytes, prog.received_bytes);
-
-    if (state.max_total_objects > 0) {
-      double const pct =
-          (state.last_received_objects / static_cast<double>(state.max_total_objects)) *
-          100.0;
-      state.last_percent = std::min(100.0, std::max(pct, state.last_percent));
-    }
-
-    snapshot_total = state.max_total_objects;
-    snapshot_received = state.last_received_objects;
-    snapshot_bytes = state.last_bytes;
-    snapshot_percent = state.last_percent;
-    child_label = children_[slot].label;
-  }
-
-  if (snapshot_total == 0) {
-    static auto const epoch{ std::chrono::steady_clock::time_point{} };
-    std::string const text{ grouped_ ? "starting..." : "starting... " + child_label };
-    set_frame(slot,
-              tui::section_frame{
-                  .label = child_label,
-                  .content = tui::spinner_data{ .text = text, .start_time = epoch } });
-    return;
-  }
-
-  std::ostringstream oss;
-  oss << snapshot_received << "/" << snapshot_total << " objects";
-  if (snapshot_bytes > 0) { oss << " " << util_format_bytes(snapshot_bytes); }
-  if (!grouped_) { oss << " " << child_label; }
-
-  tui::section_frame child_frame{
-    .label = child_label,
-    .content = tui::progress_data{ .percent = snapshot_percent, .status = oss.str() }
-  };
-  if (snapshot_received >= snapshot_total) {
-    child_frame.content = tui::static_text_data{ .text = oss.str() };
-  }
-
-  set_frame(slot, std::move(child_frame));
-}
-
-void fetch_all_progress_tracker::set_frame(std::size_t slot,
-                                           tui::section_frame child_frame) {
-  std::lock_guard const lock{ mutex_ };
-
-  if (grouped_) {
-    if (slot < children_.size()) { children_[slot] = std::move(child_frame); }
-    tui::section_frame parent{ .label = label_,
-                               .content = tui::static_text_data{ .text = group_text_ },
-                               .children = children_,
-                               .phase_label = {} };
-    tui::section_set_content(section_, parent);
-  } else {
-    child_frame.label = label_;
-    tui::section_set_content(section_, child_frame);
-  }
+  if (slot >= slots_.size()) { return; }
+  slots_[slot]->publish(kGit, git_values(slots_[slot]->read(), prog));
 }
 
 // ==== run_shell_with_progress ====
@@ -319,26 +299,32 @@ shell_result run_shell_with_progress(std::string_view script,
                                      tui::section_handle section,
                                      std::string const &pkg_identity,
                                      std::filesystem::path const &cache_root,
-                                     shell_run_cfg cfg) {
+                                     shell_run_cfg cfg,
+                                     shell_session *session) {
+  auto const run{ [&] {
+    return session ? session->run(script, cfg) : shell_run(script, cfg);
+  } };
+
   if (section) {
     run_progress progress{ section, pkg_identity, cache_root };
     progress.on_command_start(script);
     cfg.on_output_line = [&](std::string_view line) { progress.on_output_line(line); };
-    return shell_run(script, cfg);
+    return run();
   }
 
-  return shell_run(script, cfg);
+  return run();
 }
 
 // ==== run_phase_shell_script ====
 
 void run_phase_shell_script(std::string_view script,
-                            std::string_view phase_label,
+                            pkg_phase phase,
                             std::filesystem::path const &cwd,
                             std::string const &identity,
                             resolved_shell shell,
                             tui::section_handle section,
-                            std::filesystem::path const &cache_root) {
+                            std::filesystem::path const &cache_root,
+                            shell_stats &stats) {
   std::ostringstream stdout_capture;
   std::ostringstream stderr_capture;
 
@@ -348,12 +334,15 @@ void run_phase_shell_script(std::string_view script,
     .on_stderr_line = [&](std::string_view line) { stderr_capture << line << '\n'; },
     .cwd = cwd,
     .env = std::move(env),
-    .shell = std::move(shell)
+    .shell = std::move(shell),
+    .max_line_length = shell_run_cfg::kLoggedLineLength
   };
 
+  auto const start{ std::chrono::steady_clock::now() };
   shell_result const result{
     run_shell_with_progress(script, section, identity, cache_root, std::move(cfg))
   };
+  stats.record(identity, phase, result, std::chrono::steady_clock::now() - start);
   if (result.exit_code == 0) { return; }
 
   std::string const stdout_str{ stdout_capture.str() };
@@ -376,8 +365,11 @@ void run_phase_shell_script(std::string_view script,
     result.signal ? " (terminated by signal " + std::to_string(*result.signal) + ")"
                   : " (exit code " + std::to_string(result.exit_code) + ")"
   };
-  throw std::runtime_error(std::string{ phase_label } + " shell script failed for " +
-                           identity + suffix);
+  std::string phase_label{ pkg_phase_name(phase) };  // "build" -> "Build"
+  if (!phase_label.empty() && phase_label[0] >= 'a' && phase_label[0] <= 'z') {
+    phase_label[0] = static_cast<char>(phase_label[0] - 'a' + 'A');
+  }
+  throw std::runtime_error(phase_label + " shell script failed for " + identity + suffix);
 }
 
 }  // namespace envy::tui_actions
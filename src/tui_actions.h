@@ -2,13 +2,15 @@
 
 #include "extract.h"
 #include "fetch.h"
+#include "pkg_phase.h"
 #include "shell.h"
+#include "shell_stats.h"
 #include "tui.h"
 #include "util.h"
 
 #include <chrono>
 #include <filesystem>
-#include <mutex>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -37,6 +39,10 @@ class run_progress {
   std::string header_text_;
 };
 
+// The trackers below install their section content once, as tui::live_progress_data.
+// Callbacks only publish counters to a tui::progress_slot; status text is built by the
+// renderer at draw time.
+
 // Single-file extraction progress tracker
 // Lifetime: matches extract() blocking call
 class extract_progress_tracker {
@@ -49,9 +55,7 @@ class extract_progress_tracker {
 
  private:
   tui::section_handle section_;
-  std::string label_;
-  std::string filename_;
-  std::chrono::steady_clock::time_point start_time_;
+  std::shared_ptr<tui::progress_slot> slot_;
 };
 
 // Download progress tracker (single file)
@@ -66,9 +70,7 @@ class fetch_progress_tracker {
 
  private:
   tui::section_handle section_;
-  std::string label_;
-  std::string url_;
-  std::chrono::steady_clock::time_point start_time_;
+  std::shared_ptr<tui::progress_slot> slot_;
 };
 
 // Multi-file transfer progress tracker with sub-sections. group_text labels the parent
@@ -84,24 +86,10 @@ class fetch_all_progress_tracker {
   fetch_progress_cb_t make_callback(std::size_t slot);
 
  private:
-  struct git_state {
-    double last_percent{ 0.0 };
-    std::uint32_t max_total_objects{ 0 };
-    std::uint32_t last_received_objects{ 0 };
-    std::uint64_t last_bytes{ 0 };
-  };
-
   void update_transfer(std::size_t slot, fetch_transfer_progress const &prog);
   void update_git(std::size_t slot, fetch_git_progress const &prog);
-  void set_frame(std::size_t slot, tui::section_frame child_frame);
 
-  tui::section_handle section_;
-  std::string label_;
-  std::string group_text_;
-  std::mutex mutex_;
-  std::vector<tui::section_frame> children_;
-  std::vector<git_state> git_states_;
-  bool grouped_;
+  std::vector<std::shared_ptr<tui::progress_slot>> slots_;  // One writer per slot
 };
 
 // Unified shell execution with TUI progress tracking.
@@ -109,23 +97,26 @@ class fetch_all_progress_tracker {
 // controls how much output is displayed (e.g., limiting the visible output to 3 lines).
 // Callers set up on_stdout_line/on_stderr_line for capture; this function overwrites
 // on_output_line in cfg to route output through the progress tracker.
-// If section is invalid, runs without progress tracking.
+// If section is invalid, runs without progress tracking. With a session, the script runs
+// in its coprocess instead of a new shell.
 shell_result run_shell_with_progress(std::string_view script,
                                      tui::section_handle section,
                                      std::string const &pkg_identity,
                                      std::filesystem::path const &cache_root,
-                                     shell_run_cfg cfg);
+                                     shell_run_cfg cfg,
+                                     shell_session *session = nullptr);
 
-// Run a phase's shell script with stdout/stderr capture. On nonzero exit, prints
-// captured stdout and a truncated stderr tail via tui::error, then throws
-// "<phase_label> shell script failed for <identity> (exit code N)" (or the
-// terminated-by-signal variant).
+// Run a phase's shell script with stdout/stderr capture and record its resource usage in
+// stats. On nonzero exit, prints captured stdout and a truncated stderr tail via
+// tui::error, then throws "<Phase> shell script failed for <identity> (exit code N)" (or
+// the terminated-by-signal variant).
 void run_phase_shell_script(std::string_view script,
-                            std::string_view phase_label,
+                            pkg_phase phase,
                             std::filesystem::path const &cwd,
                             std::string const &identity,
                             resolved_shell shell,
                             tui::section_handle section,
-                            std::filesystem::path const &cache_root);
+                            std::filesystem::path const &cache_root,
+                            shell_stats &stats);
 
 }  // namespace envy::tui_actions
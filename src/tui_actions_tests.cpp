@@ -0,0 +1,206 @@
+#include "tui_actions.h"
+
+#include "util.h"
+
+#include "doctest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace envy::tui_actions {
+
+namespace {
+
+struct rendered_section {
+  rendered_section() {
+    tui::test::g_terminal_width = 120;
+    tui::test::g_isatty = false;
+    tui::test::g_now = std::chrono::steady_clock::now();
+  }
+  ~rendered_section() { tui::section_delete(handle); }
+
+  std::string render() const {
+    return tui::test::render_section_frame(tui::test::section_content(handle));
+  }
+
+  tui::section_handle const handle{ tui::section_create() };
+};
+
+bool contains(std::string const &haystack, std::string const &needle) {
+  return haystack.find(needle) != std::string::npos;
+}
+
+}  // namespace
+
+TEST_CASE("fetch_progress_tracker renders published transfer progress") {
+  rendered_section section;
+  fetch_progress_tracker tracker{ section.handle, "pkg@v1", "https://x/a.tgz" };
+  CHECK(contains(section.render(), "fetching https://x/a.tgz"));
+
+  tracker(fetch_transfer_progress{ .transferred = 512, .total = 2048 });
+  std::string const output{ section.render() };
+  CHECK(contains(output, "[pkg@v1]"));
+  CHECK(contains(output, "512B/2.00KB https://x/a.tgz"));
+
+  tracker(fetch_git_progress{ .total_objects = 10,
+                              .received_objects = 4,
+                              .received_bytes = 100 });
+  CHECK(contains(section.render(), "4/10 objects 100B https://x/a.tgz"));
+
+  // A larger total arriving later must not move the bar back.
+  tracker(fetch_git_progress{ .total_objects = 40, .received_objects = 6 });
+  std::string const git_output{ section.render() };
+  CHECK(contains(git_output, "6/40 objects 100B https://x/a.tgz: 40.0%"));
+}
+
+TEST_CASE("fetch_progress_tracker sets section content only once") {
+  rendered_section section;
+  fetch_progress_tracker tracker{ section.handle, "pkg@v1", "https://x/a.tgz" };
+  auto const frame{ tui::test::section_content(section.handle) };
+  tracker(fetch_transfer_progress{ .transferred = 1, .total = 2 });
+  tracker(fetch_transfer_progress{ .transferred = 2, .total = 2 });
+
+  // The cached frame still points at the same slot; only the snapshot moved on.
+  auto const *const before{ std::get_if<tui::live_progress_data>(&frame.content) };
+  auto const after{ tui::test::section_content(section.handle) };
+  auto const *const now{ std::get_if<tui::live_progress_data>(&after.content) };
+  REQUIRE(before);
+  REQUIRE(now);
+  CHECK(before->slot == now->slot);
+  CHECK(now->slot->read().version == 2);
+}
+
+TEST_CASE("extract_progress_tracker renders files and bytes") {
+  rendered_section section;
+  extract_progress_tracker tracker{ section.handle, "pkg@v1", "a.tar.gz" };
+  CHECK(contains(section.render(), "extracting a.tar.gz"));
+
+  tracker(extract_progress{ .bytes_processed = 1024,
+                            .total_bytes = 4096,
+                            .files_processed = 3,
+                            .total_files = 12 });
+  CHECK(contains(section.render(), "3/12 files 1.00KB/4.00KB a.tar.gz"));
+}
+
+TEST_CASE("fetch_all_progress_tracker groups children under the label") {
+  rendered_section section;
+  fetch_all_progress_tracker tracker{ section.handle,
+                                      "pkg@v1",
+                                      { "ninja.git", "googletest.git" },
+                                      "fetch" };
+  auto const ninja{ tracker.make_callback(0) };
+  auto const gtest{ tracker.make_callback(1) };
+
+  ninja(fetch_git_progress{ .total_objects = 100, .received_objects = 40 });
+  gtest(fetch_transfer_progress{ .transferred = 2048, .total = 4096 });
+  std::string output{ section.render() };
+  CHECK(contains(output, "fetch"));
+  CHECK(contains(output, "40/100 objects"));
+  CHECK(contains(output, "2.00KB/4.00KB"));
+
+  SUBCASE("git counters never go backwards") {
+    ninja(fetch_git_progress{ .total_objects = 80, .received_objects = 30 });
+    CHECK(contains(section.render(), "40/100 objects"));
+  }
+
+  SUBCASE("finished git fetches render as static text") {
+    ninja(fetch_git_progress{ .total_objects = 100, .received_objects = 100 });
+    CHECK(contains(section.render(), "100/100 objects"));
+  }
+}
+
+TEST_CASE("fetch_all_progress_tracker keeps the git percent monotonic") {
+  rendered_section section;
+  fetch_all_progress_tracker tracker{ section.handle, "pkg@v1", { "ninja.git" }, "fetch" };
+  auto const ninja{ tracker.make_callback(0) };
+
+  ninja(fetch_git_progress{ .total_objects = 100, .received_objects = 40 });
+  CHECK(contains(section.render(), "40/100 objects ninja.git: 40.0%"));
+
+  // A larger total arriving later must not move the bar back.
+  ninja(fetch_git_progress{ .total_objects = 200, .received_objects = 50 });
+  CHECK(contains(section.render(), "50/200 objects ninja.git: 40.0%"));
+  ninja(fetch_git_progress{ .total_objects = 200, .received_objects = 120 });
+  CHECK(contains(section.render(), "120/200 objects ninja.git: 60.0%"));
+}
+
+TEST_CASE("fetch_all_progress_tracker with one child labels it with the package") {
+  rendered_section section;
+  fetch_all_progress_tracker tracker{ section.handle, "pkg@v1", { "a.tgz" }, "fetch" };
+  CHECK(contains(section.render(), "a.tgz"));
+
+  tracker.make_callback(0)(fetch_transfer_progress{ .transferred = 100 });
+  std::string const output{ section.render() };
+  CHECK(contains(output, "[pkg@v1]"));
+  CHECK(contains(output, "100B a.tgz"));
+}
+
+TEST_CASE("progress callback overhead, 64 concurrent transfers" * doctest::skip()) {
+  constexpr int kTransfers{ 64 };
+  constexpr int kUpdates{ 20000 };
+
+  std::vector<std::string> labels;
+  for (int i{ 0 }; i < kTransfers; ++i) {
+    labels.push_back("file" + std::to_string(i) + ".tgz");
+  }
+
+  auto const run{ [&](auto &&make_callback, char const *name) {
+    auto const start{ std::chrono::steady_clock::now() };
+    std::vector<std::thread> threads;
+    for (int t{ 0 }; t < kTransfers; ++t) {
+      threads.emplace_back([&, t] {
+        auto const cb{ make_callback(static_cast<std::size_t>(t)) };
+        for (int i{ 1 }; i <= kUpdates; ++i) {
+          cb(fetch_transfer_progress{ .transferred = static_cast<std::uint64_t>(i) * 1024,
+                                      .total = std::uint64_t{ kUpdates } * 1024 });
+        }
+      });
+    }
+    for (auto &thread : threads) { thread.join(); }
+    auto const elapsed{ std::chrono::steady_clock::now() - start };
+    double const ns_per_update{
+      std::chrono::duration<double, std::nano>(elapsed).count() / (kTransfers * kUpdates)
+    };
+    MESSAGE(name << ": " << ns_per_update << " ns per progress callback");
+  } };
+
+  {
+    rendered_section section;
+    fetch_all_progress_tracker tracker{ section.handle, "pkg@v1", labels, "fetch" };
+    run([&](std::size_t slot) { return tracker.make_callback(slot); }, "progress slots");
+  }
+
+  {
+    // The previous tracker: format the status, then copy the group into the section.
+    rendered_section section;
+    std::mutex mutex;
+    std::vector<tui::section_frame> children(labels.size());
+    run(
+        [&](std::size_t slot) {
+          return [&, slot](fetch_transfer_progress const &p) {
+            std::ostringstream oss;
+            oss << util_format_bytes(p.transferred) << "/" << util_format_bytes(*p.total);
+            tui::section_frame child{
+              .label = labels[slot],
+              .content = tui::progress_data{ .percent = 100.0 * p.transferred / *p.total,
+                                             .status = oss.str() }
+            };
+            std::lock_guard const lock{ mutex };
+            children[slot] = std::move(child);
+            tui::section_set_content(
+                section.handle,
+                tui::section_frame{ .label = "[pkg@v1]",
+                                    .content = tui::static_text_data{ .text = "fetch" },
+                                    .children = children });
+          };
+        },
+        "formatted frames");
+  }
+}
+
+}  // namespace envy::tui_actions
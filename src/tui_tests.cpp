@@ -5,9 +5,13 @@
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cctype>
 #include <condition_variable>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <iterator>
+#include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <string>
@@ -295,6 +299,38 @@ TEST_CASE("trace file output writes JSONL format") {
   envy::tui::configure_trace_outputs({});
 }
 
+TEST_CASE("trace chrome output writes the timeline at shutdown") {
+  auto const chrome_path{ std::filesystem::temp_directory_path() /
+                          "envy_test_trace.chrome.json" };
+  std::error_code ec;
+  std::filesystem::remove(chrome_path, ec);
+
+  envy::tui::configure_trace_outputs(
+      { { envy::tui::trace_output_type::chrome, chrome_path } });
+  CHECK(envy::tui::g_trace_enabled);
+  CHECK_NOTHROW(envy::tui::run(envy::tui::level::TUI_DEBUG, false));
+  {
+    envy::phase_trace_scope const scope{ "test@v1",
+                                         envy::pkg_phase::pkg_build,
+                                         std::chrono::steady_clock::now() };
+  }
+  CHECK_NOTHROW(envy::tui::shutdown());
+
+  std::ifstream file{ chrome_path, std::ios::binary };
+  REQUIRE(file.is_open());
+  std::string const json{ std::istreambuf_iterator<char>{ file }, {} };
+  file.close();
+  CHECK(json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0) == 0);
+  CHECK(json.find("\"args\":{\"name\":\"test@v1\"}") != std::string::npos);
+  CHECK(json.find("{\"name\":\"build\",\"cat\":\"phase\",\"ph\":\"X\"") !=
+        std::string::npos);
+  CHECK(json.size() >= 4);
+  CHECK(json.substr(json.size() - 4) == "\n]}\n");
+
+  std::filesystem::remove(chrome_path, ec);
+  envy::tui::configure_trace_outputs({});
+}
+
 TEST_CASE_FIXTURE(captured_output, "trace multiple outputs simultaneously") {
   auto const trace_path{ std::filesystem::temp_directory_path() /
                          "envy_test_multi_trace.jsonl" };
@@ -438,6 +474,267 @@ TEST_CASE("grouped render fallback") {
   CHECK(output.find("  ninja.git") != std::string::npos);
 }
 
+TEST_CASE("progress_slot returns the latest publish") {
+  envy::tui::progress_slot slot;
+  auto const empty{ slot.read() };
+  CHECK(empty.version == 0);
+  CHECK(empty.kind == 0);
+
+  slot.publish(3, { 1, 2, 3, 4, 5, 6 });
+  slot.publish(7, { 10, 20, 30, 40, 50, 60 });
+  auto const latest{ slot.read() };
+  CHECK(latest.version == 2);
+  CHECK(latest.kind == 7);
+  CHECK(latest.values == envy::tui::progress_slot::values_t{ 10, 20, 30, 40, 50, 60 });
+}
+
+TEST_CASE("progress_slot readers never observe a partial publish") {
+  envy::tui::progress_slot slot;
+  constexpr std::uint64_t kPublishes{ 200000 };
+  std::thread writer{ [&] {
+    for (std::uint64_t i{ 1 }; i <= kPublishes; ++i) {
+      slot.publish(static_cast<std::uint32_t>(i), { i, i, i, i, i, i });
+    }
+  } };
+
+  std::uint64_t last_version{ 0 };
+  bool consistent{ true };
+  while (last_version < kPublishes) {
+    auto const snap{ slot.read() };
+    consistent = consistent && snap.version >= last_version &&
+                 std::ranges::all_of(snap.values,
+                                     [&](auto v) { return v == snap.version; }) &&
+                 snap.kind == static_cast<std::uint32_t>(snap.version);
+    last_version = snap.version;
+  }
+  writer.join();
+  CHECK(consistent);
+}
+
+TEST_CASE("live progress frame renders the slot's current snapshot") {
+  envy::tui::test::g_terminal_width = 80;
+  envy::tui::test::g_isatty = false;
+  envy::tui::test::g_now = std::chrono::steady_clock::now();
+
+  auto const slot{ std::make_shared<envy::tui::progress_slot>() };
+  envy::tui::section_frame const frame{
+    .label = "pkg",
+    .content = envy::tui::live_progress_data{
+        .slot = slot,
+        .format = [](envy::tui::progress_slot::snapshot const &s)
+            -> envy::tui::live_content {
+          if (s.version == 0) { return envy::tui::static_text_data{ .text = "waiting" }; }
+          return envy::tui::progress_data{ .percent = static_cast<double>(s.values[0]),
+                                           .status = std::to_string(s.values[0]) + "%" };
+        } }
+  };
+
+  CHECK(envy::tui::test::render_section_frame(frame).find("waiting") != std::string::npos);
+
+  slot->publish(1, { 42, 0, 0, 0, 0, 0 });
+  std::string const output{ envy::tui::test::render_section_frame(frame) };
+  CHECK(output.find("pkg") != std::string::npos);
+  CHECK(output.find("42%") != std::string::npos);
+
+  envy::tui::test::g_isatty = true;
+  CHECK(envy::tui::test::render_section_frame(frame).find("42%") != std::string::npos);
+}
+
+// Minimal model of the terminal features the progress painter uses: printable text,
+// CR, LF (as CR+LF, like a tty with ONLCR), CSI n F, CSI K, CSI 0 J, and ignored
+// private modes / SGR. Rows below the origin grow on demand, as a scrolling terminal.
+struct virtual_terminal {
+  std::vector<std::string> rows{ "" };
+  std::size_t row{ 0 };
+  std::size_t col{ 0 };
+  std::size_t origin{ 0 };  // First row of the progress area
+
+  void feed(std::string_view bytes) {
+    for (std::size_t i{ 0 }; i < bytes.size(); ++i) {
+      char const c{ bytes[i] };
+      if (c == '\r') {
+        col = 0;
+      } else if (c == '\n') {
+        col = 0;
+        if (++row == rows.size()) { rows.emplace_back(); }
+      } else if (c == '\x1b') {
+        REQUIRE(i + 1 < bytes.size());
+        REQUIRE(bytes[i + 1] == '[');
+        std::size_t end{ i + 2 };
+        while (end < bytes.size() &&
+               !std::isalpha(static_cast<unsigned char>(bytes[end]))) {
+          ++end;
+        }
+        REQUIRE(end < bytes.size());
+        std::string_view const params{ bytes.substr(i + 2, end - i - 2) };
+        csi(bytes[end], params);
+        i = end;
+      } else {
+        auto &line{ rows[row] };
+        if (line.size() <= col) { line.resize(col, ' '); }
+        line.replace(col, 1, 1, c);
+        ++col;
+      }
+    }
+  }
+
+  void csi(char command, std::string_view params) {
+    switch (command) {
+      case 'F': {
+        std::size_t const n{ params.empty() ? 1 : std::stoul(std::string{ params }) };
+        REQUIRE(n <= row);
+        row -= n;
+        col = 0;
+        break;
+      }
+      case 'K':
+        if (rows[row].size() > col) { rows[row].resize(col); }
+        break;
+      case 'J':
+        REQUIRE(params == "0");
+        if (rows[row].size() > col) { rows[row].resize(col); }
+        rows.resize(row + 1);
+        break;
+      case 'h':
+      case 'l':
+      case 'm': break;
+      default: FAIL("unexpected CSI command " << command);
+    }
+  }
+};
+
+std::vector<std::string> paint(virtual_terminal &term,
+                               std::vector<std::string> &painted,
+                               std::vector<std::string> const &next,
+                               std::size_t *bytes = nullptr) {
+  std::string const out{ envy::tui::test::paint_progress_lines(painted, next) };
+  term.feed(out);
+  if (bytes) { *bytes = out.size(); }
+  CHECK(term.row + 1 == term.origin + painted.size());  // Cursor on the last painted row
+  return term.rows;
+}
+
+TEST_CASE("differential painter matches a full repaint on a virtual terminal") {
+  virtual_terminal term;
+  std::vector<std::string> painted;
+
+  CHECK(paint(term, painted, { "a 10%", "b 20%", "c 30%" }) ==
+        std::vector<std::string>{ "a 10%", "b 20%", "c 30%" });
+
+  std::size_t bytes{ 0 };
+  CHECK(paint(term, painted, { "a 10%", "b 25%", "c 30%" }, &bytes) ==
+        std::vector<std::string>{ "a 10%", "b 25%", "c 30%" });
+  CHECK(bytes < 30);  // Only the middle row is rewritten
+
+  CHECK(paint(term, painted, { "a 10%", "b 25%", "c 30%", "d 0%" }) ==
+        std::vector<std::string>{ "a 10%", "b 25%", "c 30%", "d 0%" });
+
+  CHECK(paint(term, painted, { "a 100%", "d 5%" }) ==
+        std::vector<std::string>{ "a 100%", "d 5%", "" });
+
+  CHECK(paint(term, painted, { "a 100%", "d 5%", "e 1%", "f 2%" }) ==
+        std::vector<std::string>{ "a 100%", "d 5%", "e 1%", "f 2%" });
+
+  CHECK(paint(term, painted, { "short" }) == std::vector<std::string>{ "short", "" });
+
+  CHECK(paint(term, painted, {}) == std::vector<std::string>{ "" });
+}
+
+TEST_CASE("differential painter writes nothing for an unchanged frame") {
+  std::vector<std::string> painted;
+  CHECK_FALSE(envy::tui::test::paint_progress_lines(painted, { "a", "b" }).empty());
+  CHECK(envy::tui::test::paint_progress_lines(painted, { "a", "b" }).empty());
+
+  std::vector<std::string> none;
+  CHECK(envy::tui::test::paint_progress_lines(none, {}).empty());
+}
+
+TEST_CASE("differential painter starts below existing output") {
+  virtual_terminal term;
+  term.feed("log line\n");
+  term.origin = 1;
+  std::vector<std::string> painted;
+  CHECK(paint(term, painted, { "a", "b" }) ==
+        std::vector<std::string>{ "log line", "a", "b" });
+  CHECK(paint(term, painted, { "A", "b" }) ==
+        std::vector<std::string>{ "log line", "A", "b" });
+}
+
+TEST_CASE("refresh interval backs off for slow sinks") {
+  using namespace std::chrono_literals;
+  CHECK(envy::tui::test::refresh_interval(0ns) == 33ms);
+  CHECK(envy::tui::test::refresh_interval(1ms) == 33ms);
+  CHECK(envy::tui::test::refresh_interval(20ms) == 200ms);
+  CHECK(envy::tui::test::refresh_interval(5s) == 1000ms);
+}
+
+TEST_CASE("tui flushes a steady stream of log lines at most once per refresh interval") {
+  using namespace std::chrono_literals;
+  std::vector<std::chrono::steady_clock::time_point> flushed;
+  envy::tui::set_output_handler(
+      [&](std::string_view) { flushed.push_back(std::chrono::steady_clock::now()); });
+  envy::tui::run(envy::tui::level::TUI_INFO);
+
+  int lines{ 0 };
+  auto const end{ std::chrono::steady_clock::now() + 330ms };
+  while (std::chrono::steady_clock::now() < end) {
+    envy::tui::info("line %d", lines++);
+    std::this_thread::sleep_for(2ms);
+  }
+  envy::tui::shutdown();
+  envy::tui::set_output_handler([](std::string_view) {});
+
+  // Lines written within 1 ms of each other went out in the same cycle. Unpaced, every
+  // line gets a cycle of its own.
+  REQUIRE(flushed.size() == static_cast<std::size_t>(lines));
+  int cycles{ 1 };
+  for (std::size_t i{ 1 }; i < flushed.size(); ++i) {
+    if (flushed[i] - flushed[i - 1] > 1ms) { ++cycles; }
+  }
+  CHECK(cycles <= 20);
+}
+
+TEST_CASE("progress repaint bytes per second, 300 sections" * doctest::skip()) {
+  constexpr int kSections{ 300 };
+  constexpr int kFrames{ 300 };  // Ten seconds at 30fps
+  envy::tui::test::g_terminal_width = 120;
+  envy::tui::test::g_isatty = true;
+  auto const start{ std::chrono::steady_clock::now() };
+
+  // Each frame, a rotating tenth of the sections advance; the rest sit idle, as in a
+  // large graph where most packages wait on dependencies.
+  std::vector<double> percent(kSections, 0.0);
+  std::vector<std::string> painted;
+  std::size_t diff_bytes{ 0 };
+  std::size_t full_bytes{ 0 };
+  for (int frame{ 0 }; frame < kFrames; ++frame) {
+    envy::tui::test::g_now = start + std::chrono::milliseconds{ 33 * frame };
+    for (int i{ frame % 10 }; i < kSections; i += 10) {
+      percent[i] = std::min(100.0, percent[i] + 0.5);
+    }
+
+    std::vector<std::string> lines;
+    for (int i{ 0 }; i < kSections; ++i) {
+      envy::tui::section_frame const section{
+        .label = "[pkg" + std::to_string(i) + "@v1]",
+        .content = envy::tui::progress_data{ .percent = percent[i], .status = "fetch" }
+      };
+      std::string line{ envy::tui::test::render_section_frame(section) };
+      if (!line.empty() && line.back() == '\n') { line.pop_back(); }
+      lines.push_back(std::move(line));
+    }
+
+    // Previous renderer: every line plus a clear, every frame.
+    for (auto const &line : lines) { full_bytes += line.size() + 4; }
+    full_bytes += 16;
+    diff_bytes += envy::tui::test::paint_progress_lines(painted, lines).size();
+  }
+
+  double const seconds{ kFrames / 30.0 };
+  MESSAGE("full repaint: " << full_bytes / seconds << " bytes/s");
+  MESSAGE("differential: " << diff_bytes / seconds << " bytes/s");
+}
+
 TEST_CASE("interactive_mode_guard RAII") {
   {
     envy::tui::interactive_mode_guard guard;
@@ -0,0 +1,129 @@
+#include "verified_hash_db.h"
+
+#include "platform.h"
+#include "tui.h"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace envy {
+
+namespace {
+
+// One record per line: <sha256 hex> <size> <mtime_ns> <device> <inode> <relative path>.
+// The path comes last so it may contain spaces.
+constexpr std::string_view kHeader{ "envy-verified-hashes 1" };
+
+template <typename T>
+bool parse_field(std::string_view &line, T &out) {
+  auto const space{ line.find(' ') };
+  if (space == std::string_view::npos) { return false; }
+  auto const [ptr, ec]{ std::from_chars(line.data(), line.data() + space, out) };
+  if (ec != std::errc{} || ptr != line.data() + space) { return false; }
+  line.remove_prefix(space + 1);
+  return true;
+}
+
+}  // namespace
+
+verified_hash_db::verified_hash_db(std::filesystem::path db_path,
+                                   std::filesystem::path root)
+    : db_path_{ std::move(db_path) }, root_{ std::move(root) } {
+  load();
+}
+
+void verified_hash_db::load() {
+  std::ifstream in{ db_path_, std::ios::binary };
+  if (!in) { return; }
+
+  std::string line;
+  if (!std::getline(in, line) || line != kHeader) {
+    tui::debug("verified_hash_db: ignoring %s (unrecognized)", db_path_.string().c_str());
+    return;
+  }
+
+  while (std::getline(in, line)) {
+    std::string_view rest{ line };
+    if (rest.size() < 65 || rest[64] != ' ') { continue; }
+    std::vector<unsigned char> digest;
+    try {
+      digest = util_hex_to_bytes(std::string{ rest.substr(0, 64) });
+    } catch (std::exception const &) { continue; }
+    rest.remove_prefix(65);
+
+    record r{};
+    if (!parse_field(rest, r.size) || !parse_field(rest, r.mtime_ns) ||
+        !parse_field(rest, r.device) || !parse_field(rest, r.inode) || rest.empty()) {
+      continue;
+    }
+    std::copy_n(digest.begin(), r.sha256.size(), r.sha256.begin());
+    records_.insert_or_assign(std::string{ rest }, r);
+  }
+}
+
+sha256_t verified_hash_db::sha256(std::filesystem::path const &file) {
+  auto const key{ file.lexically_relative(root_).generic_string() };
+  auto const before{ platform::get_file_identity(file) };
+  if (!before) {
+    throw std::runtime_error("sha256: file does not exist: " + file.string());
+  }
+
+  auto const matches{ [](record const &r, platform::file_identity const &id) {
+    return r.size == id.size && r.mtime_ns == id.mtime_ns && r.device == id.device &&
+           r.inode == id.inode;
+  } };
+
+  if (auto const it{ records_.find(key) }; it != records_.end()) {
+    if (matches(it->second, *before)) { return it->second.sha256; }
+  }
+
+  auto const digest{ envy::sha256(file) };
+  ++files_hashed_;
+  dirty_ = true;
+
+  // Only remember the digest if nothing touched the file while it was being read.
+  record const r{ .size = before->size,
+                  .mtime_ns = before->mtime_ns,
+                  .device = before->device,
+                  .inode = before->inode,
+                  .sha256 = digest };
+  if (auto const after{ platform::get_file_identity(file) }; after && matches(r, *after)) {
+    records_.insert_or_assign(key, r);
+  } else {
+    records_.erase(key);
+  }
+  return digest;
+}
+
+void verified_hash_db::save() {
+  std::erase_if(records_, [&](auto const &kv) {
+    bool const gone{ !platform::file_exists(root_ / kv.first) };
+    dirty_ |= gone;
+    return gone;
+  });
+  if (!dirty_) { return; }
+
+  auto tmp{ db_path_ };
+  tmp += ".tmp";
+  {
+    std::ofstream out{ tmp, std::ios::binary | std::ios::trunc };
+    out << kHeader << '\n';
+    for (auto const &[key, r] : records_) {
+      out << util_bytes_to_hex(r.sha256.data(), r.sha256.size()) << ' ' << r.size << ' '
+          << r.mtime_ns << ' ' << r.device << ' ' << r.inode << ' ' << key << '\n';
+    }
+    if (!out.flush()) {
+      throw std::runtime_error("verified_hash_db: failed to write " + tmp.string());
+    }
+  }
+  platform::atomic_rename(tmp, db_path_);
+  dirty_ = false;
+}
+
+}  // namespace envy
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "sha256.h"
+#include "util.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+namespace envy {
+
+// Sidecar database of SHA256s already computed for files under one directory, keyed by
+// relative path and stat tuple (size, mtime_ns, device, inode). A file whose tuple still
+// matches its record is trusted without being read again; any other file is hashed and
+// its record replaced. Lets a retried fetch skip rehashing multi-gigabyte inputs that a
+// failed attempt already downloaded and verified. Not thread-safe; callers hold the
+// cache entry lock.
+class verified_hash_db : unmovable {
+ public:
+  // Loads db_path if present; a missing, foreign or corrupt sidecar starts empty.
+  verified_hash_db(std::filesystem::path db_path, std::filesystem::path root);
+
+  // SHA256 of `file` (under root). Throws std::runtime_error if it cannot be read.
+  sha256_t sha256(std::filesystem::path const &file);
+
+  // Rewrite the sidecar atomically if anything changed, dropping records for files that
+  // no longer exist.
+  void save();
+
+  // Files actually read by sha256() since construction.
+  std::size_t files_hashed() const { return files_hashed_; }
+
+ private:
+  struct record {
+    std::uint64_t size;
+    std::int64_t mtime_ns;
+    std::uint64_t device;
+    std::uint64_t inode;
+    sha256_t sha256;
+  };
+
+  void load();
+
+  std::filesystem::path db_path_;
+  std::filesystem::path root_;
+  std::unordered_map<std::string, record> records_;  // Keyed by generic relative path
+  std::size_t files_hashed_{ 0 };
+  bool dirty_{ false };
+};
+
+}  // namespace envy
@@ -0,0 +1,155 @@
+#include "verified_hash_db.h"
+
+#include "doctest.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::filesystem::path make_temp_dir() {
+  static std::mt19937_64 rng{ std::random_device{}() };
+  auto dir{ std::filesystem::temp_directory_path() /
+            ("envy-verified-hash-test-" + std::to_string(rng())) };
+  std::filesystem::create_directories(dir / "fetch");
+  return dir;
+}
+
+void write_file(std::filesystem::path const &path, std::string const &content) {
+  std::ofstream{ path, std::ios::binary | std::ios::trunc } << content;
+}
+
+}  // namespace
+
+TEST_CASE("verified_hash_db trusts unchanged files across instances") {
+  auto const root{ make_temp_dir() };
+  auto const db{ root / "fetch-hashes" };
+  auto const file{ root / "fetch" / "input with space.bin" };
+  write_file(file, "hello");
+  auto const expected{ envy::sha256(file) };
+
+  {
+    envy::verified_hash_db hashes{ db, root / "fetch" };
+    CHECK(hashes.sha256(file) == expected);
+    CHECK(hashes.sha256(file) == expected);
+    CHECK(hashes.files_hashed() == 1);
+    hashes.save();
+  }
+  REQUIRE(std::filesystem::exists(db));
+
+  envy::verified_hash_db reloaded{ db, root / "fetch" };
+  CHECK(reloaded.sha256(file) == expected);
+  CHECK(reloaded.files_hashed() == 0);
+
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("verified_hash_db rehashes changed files") {
+  auto const root{ make_temp_dir() };
+  auto const db{ root / "fetch-hashes" };
+  auto const file{ root / "fetch" / "input.bin" };
+  write_file(file, "original");
+  {
+    envy::verified_hash_db hashes{ db, root / "fetch" };
+    hashes.sha256(file);
+    hashes.save();
+  }
+  auto const mtime{ std::filesystem::last_write_time(file) };
+
+  SUBCASE("touch") {
+    std::filesystem::last_write_time(file, mtime + std::chrono::seconds{ 5 });
+    envy::verified_hash_db hashes{ db, root / "fetch" };
+    CHECK(hashes.sha256(file) == envy::sha256(file));
+    CHECK(hashes.files_hashed() == 1);
+  }
+
+  SUBCASE("truncate keeping mtime") {
+    std::filesystem::resize_file(file, 3);
+    std::filesystem::last_write_time(file, mtime);
+    envy::verified_hash_db hashes{ db, root / "fetch" };
+    CHECK(hashes.sha256(file) == envy::sha256(file));
+    CHECK(hashes.files_hashed() == 1);
+  }
+
+  SUBCASE("replace with same size and mtime") {
+    auto const other{ root / "fetch" / "other.bin" };
+    write_file(other, "ORIGINAL");
+    std::filesystem::last_write_time(other, mtime);
+    std::filesystem::rename(other, file);  // New inode
+    envy::verified_hash_db hashes{ db, root / "fetch" };
+    auto const digest{ hashes.sha256(file) };
+    CHECK(digest == envy::sha256(file));
+    CHECK(hashes.files_hashed() == 1);
+    hashes.save();
+
+    envy::verified_hash_db again{ db, root / "fetch" };
+    CHECK(again.sha256(file) == digest);
+    CHECK(again.files_hashed() == 0);
+  }
+
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("verified_hash_db drops records of removed files and ignores bad sidecars") {
+  auto const root{ make_temp_dir() };
+  auto const db{ root / "fetch-hashes" };
+  auto const a{ root / "fetch" / "a" };
+  auto const b{ root / "fetch" / "b" };
+  write_file(a, "a");
+  write_file(b, "b");
+  {
+    envy::verified_hash_db hashes{ db, root / "fetch" };
+    hashes.sha256(a);
+    hashes.sha256(b);
+    hashes.save();
+  }
+  std::filesystem::remove(b);
+  {
+    envy::verified_hash_db hashes{ db, root / "fetch" };
+    hashes.save();
+  }
+  std::ifstream in{ db };
+  std::string const contents{ std::istreambuf_iterator<char>{ in }, {} };
+  CHECK(contents.find(" a\n") != std::string::npos);
+  CHECK(contents.find(" b\n") == std::string::npos);
+
+  write_file(db, "something else\n");
+  envy::verified_hash_db hashes{ db, root / "fetch" };
+  CHECK(hashes.sha256(a) == envy::sha256(a));
+  CHECK(hashes.files_hashed() == 1);
+  CHECK_THROWS(hashes.sha256(root / "fetch" / "missing"));
+
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("verified_hash_db re-entry with 5 GiB of fetched inputs" * doctest::skip()) {
+  auto const root{ make_temp_dir() };
+  auto const db{ root / "fetch-hashes" };
+  std::vector<std::filesystem::path> files;
+  std::vector<char> chunk(64 * 1024 * 1024);
+  std::mt19937 rng{ 1 };
+  for (auto &c : chunk) { c = static_cast<char>(rng()); }
+  for (int i{ 0 }; i < 5; ++i) {
+    files.push_back(root / "fetch" / ("input" + std::to_string(i) + ".tar.zst"));
+    std::ofstream out{ files.back(), std::ios::binary };
+    for (int j{ 0 }; j < 16; ++j) {
+      out.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    }
+  }
+
+  for (char const *attempt : { "first attempt", "re-entry" }) {
+    auto const start{ std::chrono::steady_clock::now() };
+    envy::verified_hash_db hashes{ db, root / "fetch" };
+    for (auto const &f : files) { hashes.sha256(f); }
+    hashes.save();
+    std::chrono::duration<double> const elapsed{ std::chrono::steady_clock::now() -
+                                                 start };
+    MESSAGE(attempt << ": " << elapsed.count() * 1000 << " ms, "
+                    << hashes.files_hashed() << " file(s) read");
+  }
+  std::filesystem::remove_all(root);
+}